@@ -0,0 +1,94 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include "biorbd.h"
+
+///
+/// \brief main Benchmark the batch dynamics with an increasing number of threads
+/// \return Nothing
+///
+/// This examples shows how to
+///     1. Load a model
+///     2. Fill a series of frames of Q, Qdot and Tau (one column per frame)
+///     3. Compute the dynamics of all the frames at once using 1 to 32 threads
+///     4. Print the computation time and the speedup for each number of threads
+///
+/// Please note that this example will work only with the Eigen backend
+///
+
+using namespace BIORBD_NAMESPACE;
+
+int main()
+{
+    // Load a predefined model
+    Model model("pyomecaman.bioMod");
+
+    // Generate a trial (the seed is fixed so the results are reproducible)
+    unsigned int nbFrames(20000);
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    utils::Matrix Q(model.nbQ(), nbFrames);
+    utils::Matrix Qdot(model.nbQdot(), nbFrames);
+    utils::Matrix Qddot(model.nbQddot(), nbFrames);
+    utils::Matrix Tau(model.nbGeneralizedTorque(), nbFrames);
+    for (unsigned int j = 0; j < nbFrames; ++j) {
+        for (unsigned int i = 0; i < model.nbQ(); ++i) {
+            Q(i, j) = distribution(generator);
+        }
+        for (unsigned int i = 0; i < model.nbQdot(); ++i) {
+            Qdot(i, j) = distribution(generator);
+            Qddot(i, j) = distribution(generator);
+            Tau(i, j) = distribution(generator);
+        }
+    }
+
+    // Prepare the outputs once and for all
+    utils::Matrix TauID(model.nbGeneralizedTorque(), nbFrames);
+    utils::Matrix TauNLE(model.nbGeneralizedTorque(), nbFrames);
+    utils::Matrix QddotFD(model.nbQddot(), nbFrames);
+    utils::Matrix M(model.nbQdot(), model.nbQdot() * nbFrames);
+
+    std::cout << "Dynamics of " << nbFrames << " frames (wall time in ms)" << std::endl;
+    std::cout << std::setw(8) << "threads"
+              << std::setw(12) << "ID" << std::setw(12) << "NLE"
+              << std::setw(12) << "FD" << std::setw(12) << "massMatrix"
+              << std::setw(10) << "speedup" << std::endl;
+    double reference(0);
+    for (unsigned int nbThreads : {1, 2, 4, 8, 16, 32}) {
+        model.setNbThreads(nbThreads);
+        std::vector<double> times;
+
+        auto start = std::chrono::steady_clock::now();
+        model.InverseDynamicsBatch(Q, Qdot, Qddot, TauID);
+        auto lap = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(lap - start).count());
+
+        start = std::chrono::steady_clock::now();
+        model.NonLinearEffectBatch(Q, Qdot, TauNLE);
+        lap = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(lap - start).count());
+
+        start = std::chrono::steady_clock::now();
+        model.ForwardDynamicsBatch(Q, Qdot, Tau, QddotFD);
+        lap = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(lap - start).count());
+
+        start = std::chrono::steady_clock::now();
+        model.massMatrixBatch(Q, M);
+        lap = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(lap - start).count());
+
+        double total(times[0] + times[1] + times[2] + times[3]);
+        if (nbThreads == 1) {
+            reference = total;
+        }
+        std::cout << std::setw(8) << nbThreads << std::fixed << std::setprecision(2);
+        for (double time : times) {
+            std::cout << std::setw(12) << time;
+        }
+        std::cout << std::setw(10) << reference / total << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "biorbd.h"
+
+///
+/// \brief main Benchmark the analytical derivatives of the dynamics against finite differences
+/// \return Nothing
+///
+/// This examples shows how to
+///     1. Load a model
+///     2. Compute the derivatives of the inverse and the forward dynamics analytically
+///     3. Compute the same derivatives by forward finite differences
+///     4. Print the computation time of both approaches and the largest difference between them
+///
+/// Please note that this example will work only with the Eigen backend
+///
+
+using namespace BIORBD_NAMESPACE;
+
+int main()
+{
+    std::vector<std::string> modelPaths = {"pyomecaman.bioMod"};
+#ifdef MODULE_MUSCLES
+    modelPaths.push_back("arm26.bioMod");
+#endif
+    unsigned int nbRepeat(1000);
+    double h(1e-7);
+
+    for (const std::string& modelPath : modelPaths) {
+        // Load a predefined model
+        Model model(modelPath.c_str());
+
+        // Choose a state (the seed is fixed so the results are reproducible)
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+        rigidbody::GeneralizedCoordinates Q(model);
+        rigidbody::GeneralizedVelocity Qdot(model);
+        rigidbody::GeneralizedAcceleration Qddot(model);
+        rigidbody::GeneralizedTorque Tau(model);
+        for (unsigned int i = 0; i < model.nbQ(); ++i) {
+            Q[i] = distribution(generator);
+        }
+        for (unsigned int i = 0; i < model.nbQdot(); ++i) {
+            Qdot[i] = distribution(generator);
+            Qddot[i] = distribution(generator);
+            Tau[i] = distribution(generator);
+        }
+
+        // Inverse dynamics, analytically
+        utils::Matrix dTau_dQ, dTau_dQdot, dTau_dQddot;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int k = 0; k < nbRepeat; ++k) {
+            model.InverseDynamicsDerivatives(Q, Qdot, Qddot, dTau_dQ, dTau_dQdot,
+                                             dTau_dQddot);
+        }
+        auto lap = std::chrono::steady_clock::now();
+        double timeIdAnalytical(
+            std::chrono::duration<double, std::micro>(lap - start).count() / nbRepeat);
+
+        // Inverse dynamics, by finite differences
+        utils::Matrix dTau_dQFD(model.nbGeneralizedTorque(), model.nbQdot());
+        utils::Matrix dTau_dQdotFD(model.nbGeneralizedTorque(), model.nbQdot());
+        utils::Matrix dTau_dQddotFD(model.nbGeneralizedTorque(), model.nbQddot());
+        start = std::chrono::steady_clock::now();
+        for (unsigned int k = 0; k < nbRepeat; ++k) {
+            rigidbody::GeneralizedTorque TauRef(model.InverseDynamics(Q, Qdot, Qddot));
+            for (unsigned int j = 0; j < model.nbQdot(); ++j) {
+                rigidbody::GeneralizedCoordinates QPlus(Q);
+                QPlus[j] += h;
+                dTau_dQFD.col(j) = (model.InverseDynamics(QPlus, Qdot, Qddot) - TauRef) / h;
+                rigidbody::GeneralizedVelocity QdotPlus(Qdot);
+                QdotPlus[j] += h;
+                dTau_dQdotFD.col(j) = (model.InverseDynamics(Q, QdotPlus, Qddot) - TauRef) / h;
+                rigidbody::GeneralizedAcceleration QddotPlus(Qddot);
+                QddotPlus[j] += h;
+                dTau_dQddotFD.col(j) = (model.InverseDynamics(Q, Qdot, QddotPlus) - TauRef) / h;
+            }
+        }
+        lap = std::chrono::steady_clock::now();
+        double timeIdFD(
+            std::chrono::duration<double, std::micro>(lap - start).count() / nbRepeat);
+        double errorId(std::max(std::max(
+                                    (dTau_dQ - dTau_dQFD).cwiseAbs().maxCoeff(),
+                                    (dTau_dQdot - dTau_dQdotFD).cwiseAbs().maxCoeff()),
+                                (dTau_dQddot - dTau_dQddotFD).cwiseAbs().maxCoeff()));
+
+        // Forward dynamics, analytically
+        utils::Matrix dQddot_dQ, dQddot_dQdot, dQddot_dTau;
+        start = std::chrono::steady_clock::now();
+        for (unsigned int k = 0; k < nbRepeat; ++k) {
+            model.ForwardDynamicsDerivatives(Q, Qdot, Tau, dQddot_dQ, dQddot_dQdot,
+                                             dQddot_dTau);
+        }
+        lap = std::chrono::steady_clock::now();
+        double timeFdAnalytical(
+            std::chrono::duration<double, std::micro>(lap - start).count() / nbRepeat);
+
+        // Forward dynamics, by finite differences
+        utils::Matrix dQddot_dQFD(model.nbQddot(), model.nbQdot());
+        utils::Matrix dQddot_dQdotFD(model.nbQddot(), model.nbQdot());
+        utils::Matrix dQddot_dTauFD(model.nbQddot(), model.nbGeneralizedTorque());
+        start = std::chrono::steady_clock::now();
+        for (unsigned int k = 0; k < nbRepeat; ++k) {
+            rigidbody::GeneralizedAcceleration QddotRef(model.ForwardDynamics(Q, Qdot, Tau));
+            for (unsigned int j = 0; j < model.nbQdot(); ++j) {
+                rigidbody::GeneralizedCoordinates QPlus(Q);
+                QPlus[j] += h;
+                dQddot_dQFD.col(j) = (model.ForwardDynamics(QPlus, Qdot, Tau) - QddotRef) / h;
+                rigidbody::GeneralizedVelocity QdotPlus(Qdot);
+                QdotPlus[j] += h;
+                dQddot_dQdotFD.col(j) = (model.ForwardDynamics(Q, QdotPlus, Tau) - QddotRef) / h;
+                rigidbody::GeneralizedTorque TauPlus(Tau);
+                TauPlus[j] += h;
+                dQddot_dTauFD.col(j) = (model.ForwardDynamics(Q, Qdot, TauPlus) - QddotRef) / h;
+            }
+        }
+        lap = std::chrono::steady_clock::now();
+        double timeFdFD(
+            std::chrono::duration<double, std::micro>(lap - start).count() / nbRepeat);
+        double errorFd(std::max(std::max(
+                                    (dQddot_dQ - dQddot_dQFD).cwiseAbs().maxCoeff(),
+                                    (dQddot_dQdot - dQddot_dQdotFD).cwiseAbs().maxCoeff()),
+                                (dQddot_dTau - dQddot_dTauFD).cwiseAbs().maxCoeff()));
+
+        std::cout << modelPath << " (" << model.nbQdot() << " DoF), time per evaluation in us"
+                  << std::endl;
+        std::cout << std::setw(20) << "" << std::setw(12) << "analytical"
+                  << std::setw(12) << "finite diff" << std::setw(10) << "speedup"
+                  << std::setw(14) << "max diff" << std::endl;
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(20) << "inverse dynamics" << std::setw(12) << timeIdAnalytical
+                  << std::setw(12) << timeIdFD << std::setw(10) << timeIdFD / timeIdAnalytical
+                  << std::scientific << std::setw(14) << errorId << std::endl;
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(20) << "forward dynamics" << std::setw(12) << timeFdAnalytical
+                  << std::setw(12) << timeFdFD << std::setw(10) << timeFdFD / timeFdAnalytical
+                  << std::scientific << std::setw(14) << errorFd << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include "biorbd.h"
+
+///
+/// \brief main Benchmark the Kalman filter with an increasing rate of occluded markers
+/// \return Nothing
+///
+/// This examples shows how to
+///     1. Load a model
+///     2. Generate a smooth trial and the technical markers of each frame
+///     3. Randomly occlude 0%, 20% and 50% of the markers (NaN)
+///     4. Reconstruct the trial with a Kalman filter
+///     5. Print the time per frame and the error on the generalized coordinates
+///
+/// The occluded markers are removed from the innovation system of the filter,
+/// so a frame should get cheaper as the occlusion rate increases.
+///
+/// Please note that this example will work only with the Eigen backend.
+/// Please also note that kalman will be VERY slow if compiled in debug
+///
+
+using namespace BIORBD_NAMESPACE;
+
+int main()
+{
+    // Load a predefined whole-body model
+    Model model("pyomecaman.bioMod");
+    double frequency(100);
+
+    // Generate a trial (the seed is fixed so the results are reproducible)
+    unsigned int nbFrames(2000);
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> phase(0.0, 2.0 * M_PI);
+    std::vector<double> phases;
+    for (unsigned int i = 0; i < model.nbQ(); ++i) {
+        phases.push_back(phase(generator));
+    }
+    std::vector<rigidbody::GeneralizedCoordinates> targetQ;
+    std::vector<std::vector<rigidbody::NodeSegment>> targetMarkers;
+    for (unsigned int j = 0; j < nbFrames; ++j) {
+        rigidbody::GeneralizedCoordinates Q(model);
+        for (unsigned int i = 0; i < model.nbQ(); ++i) {
+            Q(i) = 0.3 * std::sin(2.0 * M_PI * 0.5 * j / frequency + phases[i]);
+        }
+        targetQ.push_back(Q);
+        targetMarkers.push_back(model.technicalMarkers(Q));
+    }
+
+    std::cout << "Kalman reconstruction of " << nbFrames << " frames with "
+              << model.nbTechnicalMarkers() << " markers" << std::endl;
+    std::cout << std::setw(12) << "occlusion"
+              << std::setw(16) << "us per frame"
+              << std::setw(16) << "RMS error Q" << std::endl;
+    for (double rate : {0.0, 0.2, 0.5}) {
+        // Occlude the markers, but the first frame that initializes the filter
+        std::bernoulli_distribution occluded(rate);
+        std::vector<std::vector<rigidbody::NodeSegment>> markers(targetMarkers);
+        for (unsigned int j = 1; j < nbFrames; ++j) {
+            for (auto& marker : markers[j]) {
+                if (occluded(generator)) {
+                    marker.setConstant(std::numeric_limits<double>::quiet_NaN());
+                }
+            }
+        }
+
+        rigidbody::KalmanReconsMarkers kalman(model,
+                                              rigidbody::KalmanParam(frequency));
+        rigidbody::GeneralizedCoordinates Q(model);
+        rigidbody::GeneralizedVelocity Qdot(model);
+        rigidbody::GeneralizedAcceleration Qddot(model);
+        kalman.reconstructFrame(model, markers[0], &Q, &Qdot, &Qddot);
+
+        double error(0);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int j = 1; j < nbFrames; ++j) {
+            kalman.reconstructFrame(model, markers[j], &Q, &Qdot, &Qddot);
+            error += (Q - targetQ[j]).squaredNorm();
+        }
+        auto stop = std::chrono::steady_clock::now();
+
+        std::cout << std::setw(11) << static_cast<int>(rate * 100) << "%"
+                  << std::fixed << std::setprecision(2) << std::setw(16)
+                  << std::chrono::duration<double, std::micro>(stop - start).count()
+                  / (nbFrames - 1)
+                  << std::scientific << std::setw(16)
+                  << std::sqrt(error / ((nbFrames - 1) * model.nbQ()))
+                  << std::endl;
+    }
+
+    return 0;
+}
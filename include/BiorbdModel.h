@@ -86,9 +86,11 @@ public:
     ///
     /// \brief Construct a model from a bioMod file
     /// \param path The path of the file
+    /// \param collapseDofs If the DoF of the segments are gathered into multi-DoF joints (see setCollapseDofs)
     ///
     Model(
-        const utils::Path& path);
+        const utils::Path& path,
+        bool collapseDofs = false);
 
 private:
     std::shared_ptr<utils::Path> m_path;
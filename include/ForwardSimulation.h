@@ -0,0 +1,317 @@
+#ifndef BIORBD_FORWARD_SIMULATION_H
+#define BIORBD_FORWARD_SIMULATION_H
+
+#include <memory>
+#include <vector>
+#include <Eigen/Dense>
+#include "biorbdConfig.h"
+#include "ModelWorkspace.h"
+#include "RigidBody/RigidBodyEnums.h"
+
+#ifndef BIORBD_USE_CASADI_MATH
+namespace BIORBD_NAMESPACE
+{
+namespace utils
+{
+class ThreadPool;
+}
+
+///
+/// \brief Integrate the forward dynamics of a model over time
+///
+/// The state is made of the generalized coordinates, the generalized
+/// velocities and, if required, the activations of the muscles. The controls
+/// (generalized torques and muscle excitations) are held constant over each
+/// interval of the trajectory.
+///
+/// The positions are integrated on the configuration manifold: the
+/// quaternions are moved along the exponential of their angular velocity and
+/// then renormalized, so the nbQ/nbQdot layout never has to be handled by the
+/// caller. The computations are performed on workspaces of the model, so the
+/// model itself is left untouched.
+///
+class BIORBD_API ForwardSimulation
+{
+public:
+    ///
+    /// \brief Prepare the simulation of a model
+    /// \param model The model to simulate
+    /// \param type The integrator
+    ///
+    ForwardSimulation(
+        const Model& model,
+        rigidbody::INTEGRATOR_TYPE type = rigidbody::RUNGE_KUTTA_4);
+
+    ///
+    /// \brief Set the integrator
+    /// \param type The integrator
+    ///
+    void setIntegrator(
+        rigidbody::INTEGRATOR_TYPE type);
+
+    ///
+    /// \brief Return the integrator
+    /// \return The integrator
+    ///
+    rigidbody::INTEGRATOR_TYPE integrator() const;
+
+    ///
+    /// \brief Set the number of steps of the fixed-step integrators per interval of the trajectory
+    /// \param nbSubSteps The number of steps per interval
+    ///
+    void setNbSubSteps(
+        unsigned int nbSubSteps);
+
+    ///
+    /// \brief Return the number of steps of the fixed-step integrators per interval of the trajectory
+    /// \return The number of steps per interval
+    ///
+    unsigned int nbSubSteps() const;
+
+    ///
+    /// \brief Set the tolerances of the adaptive integrator
+    /// \param absoluteTolerance The absolute tolerance on each state
+    /// \param relativeTolerance The relative tolerance on each state
+    ///
+    void setTolerances(
+        double absoluteTolerance,
+        double relativeTolerance);
+
+    ///
+    /// \brief Return the absolute tolerance of the adaptive integrator
+    /// \return The absolute tolerance of the adaptive integrator
+    ///
+    double absoluteTolerance() const;
+
+    ///
+    /// \brief Return the relative tolerance of the adaptive integrator
+    /// \return The relative tolerance of the adaptive integrator
+    ///
+    double relativeTolerance() const;
+
+    ///
+    /// \brief Set the number of threads used by the ensemble simulations
+    /// \param nbThreads The number of threads (including the calling thread), 0 uses all the cores available
+    ///
+    void setNbThreads(
+        unsigned int nbThreads);
+
+    ///
+    /// \brief Return the number of threads used by the ensemble simulations
+    /// \return The number of threads used by the ensemble simulations
+    ///
+    unsigned int nbThreads() const;
+
+    ///
+    /// \brief Integrate a trajectory
+    /// \param Q0 The initial generalized coordinates
+    /// \param Qdot0 The initial generalized velocities
+    /// \param Tau The generalized torques of each interval (nbGeneralizedTorque x nbIntervals)
+    /// \param dt The duration of an interval
+    /// \param Q The generalized coordinates at each node, the first one being Q0 (nbQ x nbIntervals+1) (output)
+    /// \param Qdot The generalized velocities at each node, the first one being Qdot0 (nbQdot x nbIntervals+1) (output)
+    ///
+    void integrate(
+        const rigidbody::GeneralizedCoordinates& Q0,
+        const rigidbody::GeneralizedVelocity& Qdot0,
+        const utils::Matrix& Tau,
+        double dt,
+        utils::Matrix& Q,
+        utils::Matrix& Qdot);
+
+    ///
+    /// \brief Integrate a trajectory for a set of initial conditions and controls
+    /// \param Q0 The initial generalized coordinates of each run (nbQ x nbRuns)
+    /// \param Qdot0 The initial generalized velocities of each run (nbQdot x nbRuns)
+    /// \param Tau The generalized torques of each run side by side (nbGeneralizedTorque x nbIntervals*nbRuns)
+    /// \param dt The duration of an interval
+    /// \param Q The generalized coordinates of each run side by side (nbQ x (nbIntervals+1)*nbRuns) (output)
+    /// \param Qdot The generalized velocities of each run side by side (nbQdot x (nbIntervals+1)*nbRuns) (output)
+    ///
+    /// The runs are dispatched on nbThreads() threads, each of them working
+    /// on its own workspace of the model. The results do not depend on the
+    /// number of threads.
+    ///
+    void integrateEnsemble(
+        const utils::Matrix& Q0,
+        const utils::Matrix& Qdot0,
+        const utils::Matrix& Tau,
+        double dt,
+        utils::Matrix& Q,
+        utils::Matrix& Qdot);
+
+#ifdef MODULE_MUSCLES
+    ///
+    /// \brief Integrate a trajectory with the activation dynamics of the muscles
+    /// \param Q0 The initial generalized coordinates
+    /// \param Qdot0 The initial generalized velocities
+    /// \param activations0 The initial muscle activations
+    /// \param excitations The muscle excitations of each interval (nbMuscles x nbIntervals)
+    /// \param Tau The generalized torques added to the muscular ones for each interval (nbGeneralizedTorque x nbIntervals)
+    /// \param dt The duration of an interval
+    /// \param Q The generalized coordinates at each node, the first one being Q0 (nbQ x nbIntervals+1) (output)
+    /// \param Qdot The generalized velocities at each node, the first one being Qdot0 (nbQdot x nbIntervals+1) (output)
+    /// \param activations The muscle activations at each node, the first one being activations0 (nbMuscles x nbIntervals+1) (output)
+    ///
+    /// The muscles must all have a dynamic state
+    ///
+    void integrate(
+        const rigidbody::GeneralizedCoordinates& Q0,
+        const rigidbody::GeneralizedVelocity& Qdot0,
+        const utils::Vector& activations0,
+        const utils::Matrix& excitations,
+        const utils::Matrix& Tau,
+        double dt,
+        utils::Matrix& Q,
+        utils::Matrix& Qdot,
+        utils::Matrix& activations);
+
+    ///
+    /// \brief Integrate a trajectory with the activation dynamics of the muscles for a set of initial conditions and controls
+    /// \param Q0 The initial generalized coordinates of each run (nbQ x nbRuns)
+    /// \param Qdot0 The initial generalized velocities of each run (nbQdot x nbRuns)
+    /// \param activations0 The initial muscle activations of each run (nbMuscles x nbRuns)
+    /// \param excitations The muscle excitations of each run side by side (nbMuscles x nbIntervals*nbRuns)
+    /// \param Tau The generalized torques of each run side by side (nbGeneralizedTorque x nbIntervals*nbRuns)
+    /// \param dt The duration of an interval
+    /// \param Q The generalized coordinates of each run side by side (nbQ x (nbIntervals+1)*nbRuns) (output)
+    /// \param Qdot The generalized velocities of each run side by side (nbQdot x (nbIntervals+1)*nbRuns) (output)
+    /// \param activations The muscle activations of each run side by side (nbMuscles x (nbIntervals+1)*nbRuns) (output)
+    ///
+    /// See integrateEnsemble for the threading
+    ///
+    void integrateEnsemble(
+        const utils::Matrix& Q0,
+        const utils::Matrix& Qdot0,
+        const utils::Matrix& activations0,
+        const utils::Matrix& excitations,
+        const utils::Matrix& Tau,
+        double dt,
+        utils::Matrix& Q,
+        utils::Matrix& Qdot,
+        utils::Matrix& activations);
+#endif
+
+protected:
+    ///
+    /// \brief Check the dimensions of an ensemble and return its number of intervals
+    /// \param Q0 The initial generalized coordinates of each run
+    /// \param Qdot0 The initial generalized velocities of each run
+    /// \param activations0 The initial muscle activations of each run
+    /// \param excitations The muscle excitations of each run side by side
+    /// \param Tau The generalized torques of each run side by side
+    /// \param Q The generalized coordinates of each run side by side
+    /// \param Qdot The generalized velocities of each run side by side
+    /// \param activations The muscle activations of each run side by side
+    /// \param nbMuscles The number of muscle activations in the state
+    /// \return The number of intervals of each run
+    ///
+    unsigned int checkDimensions(
+        const Eigen::Ref<const Eigen::MatrixXd>& Q0,
+        const Eigen::Ref<const Eigen::MatrixXd>& Qdot0,
+        const Eigen::Ref<const Eigen::MatrixXd>& activations0,
+        const Eigen::Ref<const Eigen::MatrixXd>& excitations,
+        const Eigen::Ref<const Eigen::MatrixXd>& Tau,
+        const Eigen::Ref<const Eigen::MatrixXd>& Q,
+        const Eigen::Ref<const Eigen::MatrixXd>& Qdot,
+        const Eigen::Ref<const Eigen::MatrixXd>& activations,
+        unsigned int nbMuscles) const;
+
+    ///
+    /// \brief Dispatch the runs of an ensemble on the threads
+    /// \param Q0 The initial generalized coordinates of each run
+    /// \param Qdot0 The initial generalized velocities of each run
+    /// \param activations0 The initial muscle activations of each run
+    /// \param excitations The muscle excitations of each run side by side
+    /// \param Tau The generalized torques of each run side by side
+    /// \param dt The duration of an interval
+    /// \param Q The generalized coordinates of each run side by side (output)
+    /// \param Qdot The generalized velocities of each run side by side (output)
+    /// \param activations The muscle activations of each run side by side (output)
+    /// \param nbMuscles The number of muscle activations in the state
+    ///
+    void runEnsemble(
+        const Eigen::Ref<const Eigen::MatrixXd>& Q0,
+        const Eigen::Ref<const Eigen::MatrixXd>& Qdot0,
+        const Eigen::Ref<const Eigen::MatrixXd>& activations0,
+        const Eigen::Ref<const Eigen::MatrixXd>& excitations,
+        const Eigen::Ref<const Eigen::MatrixXd>& Tau,
+        double dt,
+        Eigen::Ref<Eigen::MatrixXd> Q,
+        Eigen::Ref<Eigen::MatrixXd> Qdot,
+        Eigen::Ref<Eigen::MatrixXd> activations,
+        unsigned int nbMuscles);
+
+    ///
+    /// \brief Integrate one trajectory whose initial state is in the first column of the outputs
+    /// \param model The workspace to compute the dynamics with
+    /// \param excitations The muscle excitations of each interval
+    /// \param Tau The generalized torques of each interval
+    /// \param dt The duration of an interval
+    /// \param Q The generalized coordinates at each node (input/output)
+    /// \param Qdot The generalized velocities at each node (input/output)
+    /// \param activations The muscle activations at each node (input/output)
+    ///
+    /// The activation dynamics is integrated if activations has rows
+    ///
+    void integrateRun(
+        ModelWorkspace& model,
+        const Eigen::Ref<const Eigen::MatrixXd>& excitations,
+        const Eigen::Ref<const Eigen::MatrixXd>& Tau,
+        double dt,
+        Eigen::Ref<Eigen::MatrixXd> Q,
+        Eigen::Ref<Eigen::MatrixXd> Qdot,
+        Eigen::Ref<Eigen::MatrixXd> activations) const;
+
+    ///
+    /// \brief Move a state along a time derivative
+    /// \param x The state (nbQ + nbQdot + nbActivations)
+    /// \param dx The time derivative of the state (nbQdot + nbQdot + nbActivations)
+    /// \param h The time step
+    /// \param xOut The new state, must not be x (output)
+    ///
+    /// The quaternions are rotated by the exponential of their angular
+    /// velocity and renormalized, all the other states are moved linearly
+    ///
+    void increment(
+        const Eigen::Ref<const Eigen::VectorXd>& x,
+        const Eigen::Ref<const Eigen::VectorXd>& dx,
+        double h,
+        Eigen::Ref<Eigen::VectorXd> xOut) const;
+
+    ///
+    /// \brief Express the angular velocities of the quaternions at a stage in the coordinates of the rotation vector of the step
+    /// \param dx The time derivative the stage was reached with
+    /// \param h The time step the stage was reached with
+    /// \param stage The time derivative of the state at the stage (input/output)
+    ///
+    /// This keeps the order of the Runge-Kutta methods on the rotations
+    /// (Runge-Kutta-Munthe-Kaas)
+    ///
+    void correctAngularVelocities(
+        const Eigen::Ref<const Eigen::VectorXd>& dx,
+        double h,
+        Eigen::Ref<Eigen::VectorXd> stage) const;
+
+    std::shared_ptr<std::vector<ModelWorkspace>>
+            m_workspaces; ///< One workspace of the model per thread
+    std::shared_ptr<utils::ThreadPool>
+    m_threadPool; ///< Threads used by the ensemble simulations
+    std::shared_ptr<rigidbody::INTEGRATOR_TYPE>
+    m_type; ///< The integrator
+    std::shared_ptr<unsigned int>
+    m_nbSubSteps; ///< Number of steps of the fixed-step integrators per interval
+    std::shared_ptr<double>
+    m_absoluteTolerance; ///< Absolute tolerance of the adaptive integrator
+    std::shared_ptr<double>
+    m_relativeTolerance; ///< Relative tolerance of the adaptive integrator
+    std::shared_ptr<std::vector<unsigned int>>
+            m_quaternionIdx; ///< Index of the imaginary part of each quaternion (same in Q and Qdot)
+    std::shared_ptr<std::vector<unsigned int>>
+            m_quaternionWIdx; ///< Index of the real part of each quaternion in Q
+};
+
+}
+#endif
+
+#endif // BIORBD_FORWARD_SIMULATION_H
@@ -0,0 +1,46 @@
+#ifndef BIORBD_CODE_GENERATOR_H
+#define BIORBD_CODE_GENERATOR_H
+
+#include "biorbdConfig.h"
+namespace BIORBD_NAMESPACE
+{
+class Model;
+
+namespace utils
+{
+class Path;
+}
+
+///
+/// \brief Generator of model-specific C++ code
+///
+/// The generated translation unit only depends on Eigen. It contains, for the
+/// topology of the model, the unrolled forward kinematics, the markers and
+/// their jacobian, the inverse (RNEA) and forward (ABA) dynamics and, if the
+/// model has muscles, their lengths and length jacobian (the moment arms being
+/// minus that jacobian). The constant transforms, inertias and joint axes are
+/// written as literals so the compiler can fold them. The generated files
+/// can be built into a library with the biorbd_add_generated_model CMake
+/// function (share/biorbdCodeGeneration.cmake).
+///
+class BIORBD_API CodeGenerator
+{
+public:
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Write the code of a model
+    /// \param model The model to generate the code from
+    /// \param pathToWrite The path of the files to write, the filename (which must be a valid C++ identifier) is used for the header, the source and the namespace of the generated code
+    ///
+    /// The model must not have quaternions nor wrapping objects. The markers
+    /// are generated without removing any axis.
+    ///
+    static void generateModel(
+        Model &model,
+        const utils::Path& pathToWrite);
+#endif
+};
+
+}
+
+#endif // BIORBD_CODE_GENERATOR_H
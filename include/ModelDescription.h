@@ -0,0 +1,115 @@
+#ifndef BIORBD_MODEL_DESCRIPTION_H
+#define BIORBD_MODEL_DESCRIPTION_H
+
+#include <vector>
+#include <Eigen/Dense>
+#include "biorbdConfig.h"
+
+#ifndef BIORBD_USE_CASADI_MATH
+namespace BIORBD_NAMESPACE
+{
+class Model;
+
+///
+/// \brief Constant description of the topology and the parameters of a model
+///
+/// The templated kinematics and the code generator both evaluate a model
+/// outside of RBDL. They read it through this description so they share the
+/// same interpretation of the segments, the markers and the muscles, and
+/// the same restrictions on what they can handle.
+///
+/// The model must not have quaternions nor wrapping objects and the
+/// description is not updated if the original model is modified afterward.
+///
+class BIORBD_API ModelDescription
+{
+public:
+    ///
+    /// \brief Degree of freedom of a segment
+    ///
+    struct Dof {
+        bool isRotation; ///< If the DoF is a rotation or a translation
+        unsigned int axis; ///< The axis of the DoF in the reference frame of the previous DoF
+        unsigned int q; ///< The index of the DoF in the generalized coordinates
+    };
+
+    ///
+    /// \brief Constant description of a segment
+    ///
+    struct Segment {
+        int parent; ///< The index of the parent segment, -1 for the root
+        Eigen::Matrix3d rotation; ///< The orientation of the segment in its parent
+        Eigen::Vector3d translation; ///< The origin of the segment in its parent
+        std::vector<Dof> dofs; ///< The DoF, the translations then the rotations in their sequence
+        double mass; ///< The mass of the segment
+        Eigen::Vector3d CoM; ///< The center of mass in the reference frame of the segment
+        Eigen::Matrix3d inertia; ///< The inertia at the center of mass
+    };
+
+    ///
+    /// \brief Point attached to a segment
+    ///
+    struct Point {
+        unsigned int segment; ///< The index of the segment
+        Eigen::Vector3d position; ///< The position in the reference frame of the segment
+        Eigen::Vector3d positionAxisRemoved; ///< The position once the axes to remove are removed
+    };
+
+    ///
+    /// \brief Path of a muscle from its origin to its insertion
+    ///
+    struct Muscle {
+        std::vector<Point> points; ///< The origin, the via points and the insertion
+        double tendonSlackLength; ///< The tendon slack length
+        double cosPennation; ///< The cosine of the pennation angle
+    };
+
+    ///
+    /// \brief Extract the description of a model
+    /// \param model The model to describe
+    ///
+    ModelDescription(
+        Model& model);
+
+    ///
+    /// \brief Return the number of generalized coordinates
+    /// \return The number of generalized coordinates
+    ///
+    unsigned int nbQ() const;
+
+    ///
+    /// \brief Return the gravity
+    /// \return The gravity
+    ///
+    const Eigen::Vector3d& gravity() const;
+
+    ///
+    /// \brief Return the segments
+    /// \return The segments, each one after its parent
+    ///
+    const std::vector<Segment>& segments() const;
+
+    ///
+    /// \brief Return the markers
+    /// \return The markers
+    ///
+    const std::vector<Point>& markers() const;
+
+    ///
+    /// \brief Return the muscles
+    /// \return The muscles of all the muscle groups, in order
+    ///
+    const std::vector<Muscle>& muscles() const;
+
+protected:
+    unsigned int m_nbQ; ///< The number of generalized coordinates
+    Eigen::Vector3d m_gravity; ///< The gravity
+    std::vector<Segment> m_segments; ///< The segments
+    std::vector<Point> m_markers; ///< The markers
+    std::vector<Muscle> m_muscles; ///< The muscles
+};
+
+}
+#endif
+
+#endif // BIORBD_MODEL_DESCRIPTION_H
@@ -0,0 +1,185 @@
+#ifndef BIORBD_MODEL_FUNCTION_CACHE_H
+#define BIORBD_MODEL_FUNCTION_CACHE_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include "biorbdConfig.h"
+
+#ifdef BIORBD_USE_CASADI_MATH
+#include <casadi/casadi.hpp>
+
+namespace BIORBD_NAMESPACE
+{
+class Model;
+class ModelWorkspace;
+
+namespace utils
+{
+class String;
+}
+
+///
+/// \brief Cache of the casadi::Function of a model
+///
+/// Calling a method of the model with symbolic arguments rebuilds its MX
+/// graph each time. The cache creates each function once, keyed by the name
+/// of the method and the shapes of its arguments. The functions can be
+/// expanded to SX and JIT-compiled. If a cache folder is set, the functions
+/// are also written on disk (serialized, or as a compiled library when JIT is
+/// enabled) so later runs do not have to build them again. The name of the
+/// files depends on the graph of each function, so a model modified after
+/// being loaded does not reuse the files of the original one, and on the
+/// versions of biorbd and CasADi. The functions of a model that was not read
+/// from a file are kept in memory only.
+///
+/// The functions are built on a workspace of the model, so the model itself
+/// is left untouched.
+///
+class BIORBD_API ModelFunctionCache
+{
+public:
+    ///
+    /// \brief Prepare the cache of a model
+    /// \param model The model to build the functions from
+    ///
+    ModelFunctionCache(
+        const Model& model);
+
+    ///
+    /// \brief Set if the functions are expanded to SX when created
+    /// \param expand If the functions are expanded
+    ///
+    void setExpand(
+        bool expand);
+
+    ///
+    /// \brief Return if the functions are expanded to SX when created
+    /// \return If the functions are expanded
+    ///
+    bool expand() const;
+
+    ///
+    /// \brief Set if the functions are JIT-compiled when created
+    /// \param jit If the functions are JIT-compiled
+    ///
+    void setJit(
+        bool jit);
+
+    ///
+    /// \brief Return if the functions are JIT-compiled when created
+    /// \return If the functions are JIT-compiled
+    ///
+    bool jit() const;
+
+    ///
+    /// \brief Set the compiler of the JIT
+    /// \param compiler The compiler command given to the shell compiler of CasADi, which adds the flags of the platform (gcc by default)
+    ///
+    void setCompiler(
+        const utils::String& compiler);
+
+    ///
+    /// \brief Set the folder where the functions are stored on disk
+    /// \param folder The folder, an empty string disables the cache on disk
+    ///
+    /// The folder is ignored if the model was not read from a file.
+    ///
+    void setCacheFolder(
+        const utils::String& folder);
+
+    ///
+    /// \brief Return the folder where the functions are stored on disk
+    /// \return The folder, empty if the functions are not stored
+    ///
+    const utils::String& cacheFolder() const;
+
+    ///
+    /// \brief Return the number of functions in memory
+    /// \return The number of functions in memory
+    ///
+    unsigned int nbFunctions() const;
+
+    ///
+    /// \brief Remove the functions from memory (the files on disk are kept)
+    ///
+    void clear();
+
+#ifndef SWIG
+    ///
+    /// \brief Return the function of a method, creating it if needed
+    /// \param method The name of the method
+    /// \param inputNames The name of each argument
+    /// \param inputShapes The number of rows and columns of each argument
+    /// \param expression The function computing the output from the symbolic arguments (only called if the function is not cached yet)
+    /// \return The function
+    ///
+    const casadi::Function& function(
+        const utils::String& method,
+        const std::vector<utils::String>& inputNames,
+        const std::vector<std::pair<unsigned int, unsigned int>>& inputShapes,
+        const std::function<casadi::MX(ModelWorkspace&, const std::vector<casadi::MX>&)>&
+        expression);
+#endif
+
+    ///
+    /// \brief Return the function of the forward dynamics
+    /// \return The function of inputs Q, Qdot and Tau and output ForwardDynamics
+    ///
+    const casadi::Function& ForwardDynamics();
+
+    ///
+    /// \brief Return the function of the inverse dynamics
+    /// \return The function of inputs Q, Qdot and Qddot and output InverseDynamics
+    ///
+    const casadi::Function& InverseDynamics();
+
+    ///
+    /// \brief Return the function of the markers in the global reference frame
+    /// \return The function of input Q and output markers (3 x nbMarkers)
+    ///
+    const casadi::Function& markers();
+
+#ifdef MODULE_MUSCLES
+    ///
+    /// \brief Return the function of the muscular joint torque
+    /// \return The function of inputs F (the forces of the muscles), Q and Qdot and output muscularJointTorque
+    ///
+    const casadi::Function& muscularJointTorque();
+#endif
+
+protected:
+#ifndef SWIG
+    ///
+    /// \brief Create a function, from the disk if it was stored
+    /// \param method The name of the method
+    /// \param key The key of the function
+    /// \param inputNames The name of each argument
+    /// \param inputShapes The number of rows and columns of each argument
+    /// \param expression The function computing the output from the symbolic arguments
+    /// \return The function
+    ///
+    casadi::Function create(
+        const utils::String& method,
+        const std::string& key,
+        const std::vector<utils::String>& inputNames,
+        const std::vector<std::pair<unsigned int, unsigned int>>& inputShapes,
+        const std::function<casadi::MX(ModelWorkspace&, const std::vector<casadi::MX>&)>&
+        expression);
+#endif
+
+    std::shared_ptr<ModelWorkspace> m_model; ///< The workspace the functions are built on
+    std::shared_ptr<std::map<std::string, casadi::Function>>
+            m_functions; ///< The functions, by method and shapes of the arguments
+    std::shared_ptr<bool> m_expand; ///< If the functions are expanded to SX
+    std::shared_ptr<bool> m_jit; ///< If the functions are JIT-compiled
+    std::shared_ptr<utils::String> m_compiler; ///< The compiler of the JIT
+    std::shared_ptr<utils::String> m_cacheFolder; ///< The folder of the cache on disk
+    std::shared_ptr<bool> m_hasFile; ///< If the model was read from a file, otherwise nothing is stored on disk
+};
+
+}
+#endif
+
+#endif // BIORBD_MODEL_FUNCTION_CACHE_H
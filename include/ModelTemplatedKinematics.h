@@ -0,0 +1,282 @@
+#ifndef BIORBD_TEMPLATED_KINEMATICS_H
+#define BIORBD_TEMPLATED_KINEMATICS_H
+
+#include <cmath>
+#include <vector>
+#include <Eigen/Dense>
+#include "biorbdConfig.h"
+#include "ModelDescription.h"
+
+#ifndef BIORBD_USE_CASADI_MATH
+namespace BIORBD_NAMESPACE
+{
+class Model;
+
+///
+/// \brief Kinematics of a model for any scalar type
+///
+/// RBDL only computes in double, so the differentiation of the Eigen build
+/// would otherwise need finite differences or a separate CasADi build. This
+/// class extracts the topology and the constant parameters of a model once
+/// (see ModelDescription) and evaluates the global JCS, the markers, the
+/// center of mass and the muscle lengths for a scalar type given by the
+/// generalized coordinates.
+/// Using a dual number or an Eigen::AutoDiffScalar as scalar gives exact
+/// derivatives, which is how the jacobians of this class are computed.
+///
+/// The model must not have quaternions nor wrapping objects and it is not
+/// updated if the original model is modified afterward.
+///
+class BIORBD_API TemplatedKinematics
+{
+public:
+    ///
+    /// \brief Extract the kinematics of a model
+    /// \param model The model to extract the kinematics from
+    ///
+    TemplatedKinematics(
+        Model& model);
+
+    ///
+    /// \brief Return the number of generalized coordinates
+    /// \return The number of generalized coordinates
+    ///
+    unsigned int nbQ() const;
+
+    ///
+    /// \brief Return the number of segments
+    /// \return The number of segments
+    ///
+    unsigned int nbSegment() const;
+
+    ///
+    /// \brief Return the number of markers
+    /// \return The number of markers
+    ///
+    unsigned int nbMarkers() const;
+
+    ///
+    /// \brief Return the number of muscles
+    /// \return The number of muscles
+    ///
+    unsigned int nbMuscles() const;
+
+#ifndef SWIG
+    ///
+    /// \brief Compute the global JCS of all the segments
+    /// \param Q The generalized coordinates
+    /// \param jcs The homogeneous matrices of the segments side by side (output, 4 x 4*nbSegment)
+    ///
+    template<typename Derived>
+    void globalJCS(
+        const Eigen::MatrixBase<Derived>& Q,
+        Eigen::Matrix<typename Derived::Scalar, 4, Eigen::Dynamic>& jcs) const
+    {
+        typedef typename Derived::Scalar T;
+        Eigen::Matrix<T, 3, Eigen::Dynamic> rotations;
+        Eigen::Matrix<T, 3, Eigen::Dynamic> translations;
+        segmentsInGlobal(Q, rotations, translations);
+        jcs.setZero(4, 4*nbSegment());
+        for (unsigned int s=0; s<nbSegment(); ++s) {
+            jcs.block(0, 4*s, 3, 3) = rotations.middleCols(3*s, 3);
+            jcs.block(0, 4*s+3, 3, 1) = translations.col(s);
+            jcs(3, 4*s+3) = T(1);
+        }
+    }
+
+    ///
+    /// \brief Compute the position of all the markers in the global reference frame
+    /// \param Q The generalized coordinates
+    /// \param markers The markers, one per column (output, 3 x nbMarkers)
+    /// \param removeAxis If there are axis to remove from the position variables
+    ///
+    template<typename Derived>
+    void markers(
+        const Eigen::MatrixBase<Derived>& Q,
+        Eigen::Matrix<typename Derived::Scalar, 3, Eigen::Dynamic>& markers,
+        bool removeAxis = true) const
+    {
+        typedef typename Derived::Scalar T;
+        Eigen::Matrix<T, 3, Eigen::Dynamic> rotations;
+        Eigen::Matrix<T, 3, Eigen::Dynamic> translations;
+        segmentsInGlobal(Q, rotations, translations);
+        markers.resize(3, nbMarkers());
+        for (unsigned int i=0; i<nbMarkers(); ++i) {
+            markers.col(i) = pointInGlobal(
+                                 rotations, translations, m_markers[i].segment,
+                                 removeAxis ? m_markers[i].positionAxisRemoved : m_markers[i].position);
+        }
+    }
+
+    ///
+    /// \brief Compute the position of the center of mass in the global reference frame
+    /// \param Q The generalized coordinates
+    /// \param com The position of the center of mass (output)
+    ///
+    template<typename Derived>
+    void CoM(
+        const Eigen::MatrixBase<Derived>& Q,
+        Eigen::Matrix<typename Derived::Scalar, 3, 1>& com) const
+    {
+        typedef typename Derived::Scalar T;
+        Eigen::Matrix<T, 3, Eigen::Dynamic> rotations;
+        Eigen::Matrix<T, 3, Eigen::Dynamic> translations;
+        segmentsInGlobal(Q, rotations, translations);
+        com.setZero();
+        for (unsigned int s=0; s<nbSegment(); ++s) {
+            if (m_segments[s].mass > 0) {
+                com += pointInGlobal(rotations, translations, s, m_segments[s].CoM)
+                       * T(m_segments[s].mass / m_mass);
+            }
+        }
+    }
+
+    ///
+    /// \brief Compute the musculotendon and the muscle lengths
+    /// \param Q The generalized coordinates
+    /// \param musculoTendonLength The length from the origin to the insertion through the via points (output, nbMuscles)
+    /// \param length The length of the muscles, without the tendon and projected on the line of action (output, nbMuscles)
+    ///
+    template<typename Derived>
+    void musclesLength(
+        const Eigen::MatrixBase<Derived>& Q,
+        Eigen::Matrix<typename Derived::Scalar, Eigen::Dynamic, 1>& musculoTendonLength,
+        Eigen::Matrix<typename Derived::Scalar, Eigen::Dynamic, 1>& length) const
+    {
+        typedef typename Derived::Scalar T;
+        Eigen::Matrix<T, 3, Eigen::Dynamic> rotations;
+        Eigen::Matrix<T, 3, Eigen::Dynamic> translations;
+        segmentsInGlobal(Q, rotations, translations);
+        musculoTendonLength.resize(nbMuscles());
+        length.resize(nbMuscles());
+        for (unsigned int m=0; m<nbMuscles(); ++m) {
+            const MusclePath& muscle(m_muscles[m]);
+            musculoTendonLength(m) = T(0);
+            Eigen::Matrix<T, 3, 1> previous(pointInGlobal(
+                                                rotations, translations, muscle.points[0].segment,
+                                                muscle.points[0].position));
+            for (unsigned int i=1; i<muscle.points.size(); ++i) {
+                Eigen::Matrix<T, 3, 1> current(pointInGlobal(
+                                                   rotations, translations, muscle.points[i].segment,
+                                                   muscle.points[i].position));
+                musculoTendonLength(m) += (current - previous).norm();
+                previous = current;
+            }
+            length(m) = (musculoTendonLength(m) - T(muscle.tendonSlackLength))
+                        / T(muscle.cosPennation);
+        }
+    }
+#endif
+
+    ///
+    /// \brief Compute the jacobian of the markers by forward-mode automatic differentiation
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobians of the markers stacked vertically (output, 3*nbMarkers x nbQ)
+    /// \param removeAxis If there are axis to remove from the position variables
+    ///
+    void markersJacobian(
+        const Eigen::VectorXd& Q,
+        Eigen::MatrixXd& jacobian,
+        bool removeAxis = true) const;
+
+    ///
+    /// \brief Compute the jacobian of the center of mass by forward-mode automatic differentiation
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobian of the center of mass (output, 3 x nbQ)
+    ///
+    void CoMJacobian(
+        const Eigen::VectorXd& Q,
+        Eigen::MatrixXd& jacobian) const;
+
+    ///
+    /// \brief Compute the jacobian of the muscle lengths by forward-mode automatic differentiation
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobian of the muscle lengths (output, nbMuscles x nbQ)
+    ///
+    void musclesLengthJacobian(
+        const Eigen::VectorXd& Q,
+        Eigen::MatrixXd& jacobian) const;
+
+protected:
+#ifndef SWIG
+    typedef ModelDescription::Dof Dof; ///< Degree of freedom of a segment
+    typedef ModelDescription::Segment SegmentDescription; ///< Constant description of a segment
+    typedef ModelDescription::Point SegmentPoint; ///< Point attached to a segment
+    typedef ModelDescription::Muscle MusclePath; ///< Path of a muscle from its origin to its insertion
+
+    ///
+    /// \brief Compute the orientation and the position of all the segments
+    /// \param Q The generalized coordinates
+    /// \param rotations The orientations of the segments side by side (output, 3 x 3*nbSegment)
+    /// \param translations The positions of the segments (output, 3 x nbSegment)
+    ///
+    template<typename Derived>
+    void segmentsInGlobal(
+        const Eigen::MatrixBase<Derived>& Q,
+        Eigen::Matrix<typename Derived::Scalar, 3, Eigen::Dynamic>& rotations,
+        Eigen::Matrix<typename Derived::Scalar, 3, Eigen::Dynamic>& translations) const
+    {
+        typedef typename Derived::Scalar T;
+        using std::cos;
+        using std::sin;
+        rotations.resize(3, 3*nbSegment());
+        translations.resize(3, nbSegment());
+        for (unsigned int s=0; s<nbSegment(); ++s) {
+            const SegmentDescription& segment(m_segments[s]);
+            Eigen::Matrix<T, 3, 3> R(segment.rotation.cast<T>());
+            Eigen::Matrix<T, 3, 1> t(segment.translation.cast<T>());
+            if (segment.parent >= 0) {
+                const Eigen::Matrix<T, 3, 3> parentR(
+                    rotations.middleCols(3*segment.parent, 3));
+                t = parentR * t + translations.col(segment.parent);
+                R = parentR * R;
+            }
+            for (const Dof& dof : segment.dofs) {
+                if (!dof.isRotation) {
+                    t += R.col(dof.axis) * Q(dof.q);
+                    continue;
+                }
+                T c(cos(Q(dof.q)));
+                T sn(sin(Q(dof.q)));
+                unsigned int i((dof.axis + 1) % 3);
+                unsigned int j((dof.axis + 2) % 3);
+                Eigen::Matrix<T, 3, 1> colI(R.col(i) * c + R.col(j) * sn);
+                R.col(j) = R.col(j) * c - R.col(i) * sn;
+                R.col(i) = colI;
+            }
+            rotations.middleCols(3*s, 3) = R;
+            translations.col(s) = t;
+        }
+    }
+
+    ///
+    /// \brief Express a point of a segment in the global reference frame
+    /// \param rotations The orientations of the segments side by side
+    /// \param translations The positions of the segments
+    /// \param segment The index of the segment
+    /// \param position The position of the point in the reference frame of the segment
+    /// \return The position of the point in the global reference frame
+    ///
+    template<typename T>
+    static Eigen::Matrix<T, 3, 1> pointInGlobal(
+        const Eigen::Matrix<T, 3, Eigen::Dynamic>& rotations,
+        const Eigen::Matrix<T, 3, Eigen::Dynamic>& translations,
+        unsigned int segment,
+        const Eigen::Vector3d& position)
+    {
+        return rotations.middleCols(3*segment, 3) * position.cast<T>()
+               + translations.col(segment);
+    }
+
+    std::vector<SegmentDescription> m_segments; ///< The segments, each one after its parent
+    std::vector<SegmentPoint> m_markers; ///< The markers
+    std::vector<MusclePath> m_muscles; ///< The muscles
+#endif
+    unsigned int m_nbQ; ///< The number of generalized coordinates
+    double m_mass; ///< The total mass of the model
+};
+
+}
+#endif
+
+#endif // BIORBD_TEMPLATED_KINEMATICS_H
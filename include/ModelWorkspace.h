@@ -0,0 +1,50 @@
+#ifndef BIORBD_MODEL_WORKSPACE_H
+#define BIORBD_MODEL_WORKSPACE_H
+
+#include "biorbdConfig.h"
+#include "BiorbdModel.h"
+
+namespace BIORBD_NAMESPACE
+{
+///
+/// \brief A model that shares its description with another model, but owns
+/// everything that is modified during the computations
+///
+/// The segments, meshes, markers, IMUs, RT and actuators are shared with the
+/// original model. The workspace owns the RBDL kinematic and dynamic buffers,
+/// the kinematics cache, the contact buffers and the muscles (geometry and
+/// states). Different workspaces of the same model can therefore be used
+/// concurrently (one per thread), as long as the description of the model
+/// is not modified meanwhile.
+///
+/// Kalman filters keep their own buffers, so one filter should be created
+/// per workspace.
+///
+class BIORBD_API ModelWorkspace : public Model
+{
+public:
+    ///
+    /// \brief Create a workspace for a model
+    /// \param model The model to share the description with
+    ///
+    ModelWorkspace(
+        const Model& model);
+
+    ///
+    /// \brief Create a workspace that shares the same description as another workspace
+    /// \param other The other workspace
+    ///
+    ModelWorkspace(
+        const ModelWorkspace& other);
+
+protected:
+    ///
+    /// \brief Detach the state modified during the computations from the copied model
+    ///
+    void detachMutableState();
+
+};
+
+}
+
+#endif // BIORBD_MODEL_WORKSPACE_H
@@ -13,6 +13,7 @@ namespace utils
 class Matrix;
 class Vector;
 class Vector3d;
+class String;
 }
 
 namespace rigidbody
@@ -222,6 +223,19 @@ public:
     ///
     const utils::Matrix& jacobianLength() const;
 
+    ///
+    /// \brief Resolve the body id (in RBDL) of the parent of each point of the muscle
+    /// \param model The joint model
+    /// \param pathModifiers The set of path modifiers
+    ///
+    /// This is done once the muscle is complete (when the model is read or
+    /// a workspace is created), so the updates only read the ids. If the
+    /// parent of a point changed afterward, the points are looked up by name
+    /// until the ids are resolved again.
+    ///
+    void resolvePointsBodyId(
+        const rigidbody::Joints& model,
+        const PathModifiers* pathModifiers);
 
 protected:
     ///
@@ -273,6 +287,14 @@ protected:
         const rigidbody::GeneralizedCoordinates& Q,
         PathModifiers* pathModifiers = nullptr);
 
+    ///
+    /// \brief Return if the body ids resolved match the current points of the muscle
+    /// \param pathModifiers The set of path modifiers
+    /// \return If the parents of the points did not change since the ids were resolved
+    ///
+    bool isPointsBodyIdResolved(
+        const PathModifiers* pathModifiers) const;
+
 
     ///
     /// \brief Update the kinematics, compute and return the muscle length
@@ -332,6 +354,12 @@ protected:
             m_pointsInGlobal; ///< Position of all the points in the global reference
     std::shared_ptr<std::vector<utils::Vector3d>>
             m_pointsInLocal; ///< Position of all the points in local
+    std::shared_ptr<std::vector<unsigned int>>
+            m_pointsBodyId; ///< Body id (in RBDL) of the parent of all the points (empty if the origin or the insertion changed since they were resolved)
+    std::shared_ptr<std::vector<utils::String>>
+            m_pointsParent; ///< Name of the parent of all the points when their body id was resolved
+    std::shared_ptr<bool>
+    m_isPointsBodyIdResolved; ///< If the body ids matched the points on the last update
     std::shared_ptr<utils::Matrix> m_jacobian; ///<The jacobian matrix
     std::shared_ptr<utils::Matrix>
     m_G; ///< Internal matrix of the jacobian dimension to speed up calculation
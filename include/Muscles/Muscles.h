@@ -322,6 +322,15 @@ public:
     ///
     unsigned int nbMuscles() const;
 
+    ///
+    /// \brief Resolve the body id (in RBDL) of the parent of the points of all the muscles
+    ///
+    /// The updates of the muscles only read these ids, so this must be
+    /// called again once the points of a muscle are modified, otherwise the
+    /// modified points are looked up by name at each update.
+    ///
+    void resolveMusclesPointsBodyId();
+
 protected:
     std::shared_ptr<std::vector<MuscleGroup>>
             m_mus; ///< Holder for muscle groups
@@ -5,6 +5,7 @@
 #include <memory>
 #include <rbdl/Constraints.h>
 #include "biorbdConfig.h"
+#include "RigidBody/RigidBodyEnums.h"
 
 namespace BIORBD_NAMESPACE
 {
@@ -153,9 +154,26 @@ public:
     ///
     utils::Vector getForce() const;
 
+    ///
+    /// \brief Set the solver used by the constrained dynamics
+    /// \param type The solver type
+    ///
+    /// The workspace of the constraint set is bound once and reused by every
+    /// solver, so changing the solver does not reallocate anything.
+    ///
+    void setContactSolver(
+        CONTACT_SOLVER_TYPE type);
+
+    ///
+    /// \brief Return the solver used by the constrained dynamics
+    /// \return The solver type
+    ///
+    CONTACT_SOLVER_TYPE contactSolver() const;
+
 protected:
     std::shared_ptr<unsigned int> m_nbreConstraint; ///< Number of constraints
     std::shared_ptr<bool> m_isBinded; ///< If the model is ready
+    std::shared_ptr<CONTACT_SOLVER_TYPE> m_solver; ///< The solver of the constrained dynamics
 
 };
 
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <memory>
+#include <Eigen/Dense>
 #include "biorbdConfig.h"
 
 namespace BIORBD_NAMESPACE
@@ -71,6 +72,9 @@ public:
     /// \param technical True if the IMU is technical
     /// \param anatomical True if the IMU is anatomical
     ///
+    /// The parent of the IMU is resolved once and for all here (or at first
+    /// use if the IMUs are not part of a model yet)
+    ///
     void addIMU(
         const utils::RotoTransNode &RotoTrans,
         bool technical = true,
@@ -221,6 +225,30 @@ public:
         const GeneralizedCoordinates &Q,
         bool updateKin = true);
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Fill the rotations of the technical inertial measurement units (IMU) without allocating
+    /// \param Q The generalized coordinates
+    /// \param rotations The columns of each rotation stacked vertically (output, 9*nbTechIMUs)
+    /// \param updateKin If the model should be updated
+    ///
+    void technicalIMU(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::VectorXd> rotations,
+        bool updateKin = true);
+
+    ///
+    /// \brief Fill the jacobian of the technical inertial measurement units (IMU) without allocating
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobians of the technical IMU stacked vertically (output, 9*nbTechIMUs x nbQdot)
+    /// \param updateKin If the model should be updated
+    ///
+    void TechnicalIMUJacobian(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::MatrixXd> jacobian,
+        bool updateKin = true);
+#endif
+
 protected:
 
     ///
@@ -234,8 +262,33 @@ protected:
         bool updateKin,
         bool lookForTechnical);
 
+    ///
+    /// \brief Resolve the parent of the last IMU added to the set
+    ///
+    void resolveLastIMUParent();
+
+    ///
+    /// \brief Return the index of the parent segment of an IMU
+    /// \param idx The index of the IMU
+    /// \return The index of the parent segment of the IMU
+    ///
+    unsigned int IMUSegmentIdx(
+        unsigned int idx);
+
+    ///
+    /// \brief Return the body id (in RBDL) of the parent of an IMU
+    /// \param idx The index of the IMU
+    /// \return The body id of the parent of the IMU
+    ///
+    unsigned int IMUBodyId(
+        unsigned int idx);
+
     std::shared_ptr<std::vector<rigidbody::IMU>>
             m_IMUs; ///< All the inertial Measurement Units
+    std::shared_ptr<std::vector<unsigned int>>
+            m_IMUsBodyId; ///< The body id (in RBDL) of the parent of each IMU
+    std::shared_ptr<std::vector<int>>
+            m_IMUsSegmentIdx; ///< The index of the parent segment of each IMU (-1 if not found)
 
 };
 
@@ -2,10 +2,12 @@
 #define BIORBD_RIGIDBODY_JOINTS_H
 
 #include <memory>
+#include <functional>
 #include <rbdl/Model.h>
 #include <rbdl/Constraints.h>
 #include "biorbdConfig.h"
 #include "Utils/Scalar.h"
+#include "RigidBody/RigidBodyEnums.h"
 
 namespace BIORBD_NAMESPACE
 {
@@ -19,6 +21,7 @@ class Vector;
 class Vector3d;
 class Range;
 class SpatialVector;
+class ThreadPool;
 }
 
 namespace rigidbody
@@ -138,6 +141,25 @@ public:
     void setGravity(
         const utils::Vector3d& newGravity);
 
+    ///
+    /// \brief Set if the DoF of the segments are gathered into multi-DoF joints
+    /// \param collapse If the DoF should be gathered
+    ///
+    /// By default, each DoF of a segment is an RBDL body of its own. When
+    /// collapsing, the translations "xyz" and the Euler rotations "xyz", "zyx"
+    /// and "yxz" of a segment are declared as a single joint each, so a 6 DoF
+    /// segment is made of 2 bodies instead of 6. The generalized coordinates
+    /// (order and names) are not affected. It must be set before adding any segment.
+    ///
+    void setCollapseDofs(
+        bool collapse);
+
+    ///
+    /// \brief Return if the DoF of the segments are gathered into multi-DoF joints
+    /// \return If the DoF of the segments are gathered into multi-DoF joints
+    ///
+    bool isCollapsingDofs() const;
+
     // -- INFORMATION ON THE MODEL -- //
     ///
     /// \brief Return the biorbd body identification
@@ -275,11 +297,48 @@ public:
     /// \param Qdot The generalized velocities
     /// \param Qddot The generalized accelerations
     ///
+    /// If the requested Q, Qdot and Qddot are exactly the same as the ones of
+    /// the last update, the kinematics already stored in the model is reused
+    /// and the sweep is skipped (not available with CasADi)
+    ///
     void UpdateKinematicsCustom(
         const GeneralizedCoordinates *Q = nullptr,
         const GeneralizedVelocity *Qdot = nullptr,
         const rigidbody::GeneralizedAcceleration *Qddot = nullptr);
 
+    ///
+    /// \brief Force the next UpdateKinematicsCustom to recompute the kinematics
+    ///
+    /// This must be called if the kinematics of the model was modified
+    /// directly through RBDL
+    ///
+    void invalidateKinematicsCache();
+
+    ///
+    /// \brief Force the next batch computation to copy the model again for each worker
+    ///
+    /// This must be called if the description of the model (e.g. the
+    /// inertia or the gravity) was modified directly through RBDL
+    ///
+    void invalidateBatchModels();
+
+    ///
+    /// \brief Return the number of UpdateKinematicsCustom that reused the previously computed kinematics
+    /// \return The number of hits of the kinematics cache
+    ///
+    unsigned long nbKinematicsCacheHits() const;
+
+    ///
+    /// \brief Return the number of UpdateKinematicsCustom that had to compute the kinematics
+    /// \return The number of misses of the kinematics cache
+    ///
+    unsigned long nbKinematicsCacheMisses() const;
+
+    ///
+    /// \brief Reset the hits and misses counters of the kinematics cache
+    ///
+    void resetKinematicsCacheCounters();
+
 
     // -- POSITION INTERFACE OF THE MODEL -- //
 
@@ -299,6 +358,22 @@ public:
     ///
     std::vector<utils::RotoTrans> allGlobalJCS() const;
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Fill the joint coordinate system (JCS) in global reference frame at a given Q
+    /// \param Q The generalized coordinates
+    /// \param JCS The homogeneous matrices of all the segments (output)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// Nothing is allocated once JCS has the right size, so this is the
+    /// version to use in loops
+    ///
+    void allGlobalJCS(
+        const GeneralizedCoordinates &Q,
+        std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>> &JCS,
+        bool updateKin = true);
+#endif
+
     ///
     /// \brief Return the joint coordinate system (JCS) for the segment in global reference frame at a given Q
     /// \param Q The generalized coordinates
@@ -468,6 +543,19 @@ public:
         const GeneralizedCoordinates &Q,
         bool updateKin=true);
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Compute the position of the center of mass without allocating
+    /// \param Q The generalized coordinates
+    /// \param com The position of the center of mass (output)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    void CoM(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::Vector3d> com,
+        bool updateKin=true);
+#endif
+
     ///
     /// \brief Return the position of the center of mass of each segment
     /// \param Q The generalized coordinates
@@ -591,6 +679,40 @@ public:
     utils::Matrix CoMJacobian(
         const GeneralizedCoordinates &Q,
         bool updateKin = true);
+
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Compute the jacobian matrix of the center of mass into a preallocated matrix
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobian matrix of the center of mass (3 x nbQdot)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// The mass and the first moment of mass of each subtree are accumulated
+    /// from the leaves to the root, so each column is computed once from the
+    /// subtree moved by its DoF (O(n) instead of one point jacobian per segment).
+    ///
+    void CoMJacobian(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::MatrixXd> jacobian,
+        bool updateKin = true);
+
+    ///
+    /// \brief Compute the jacobian matrix of the center of mass and its bias acceleration
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param jacobian The jacobian matrix of the center of mass (3 x nbQdot)
+    /// \param jacobianDotQdot The time derivative of the jacobian times Qdot, that is the acceleration of the center of mass when Qddot is zero
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// The acceleration of the center of mass is therefore jacobian * Qddot + jacobianDotQdot
+    ///
+    void CoMJacobian(
+        const GeneralizedCoordinates &Q,
+        const GeneralizedVelocity &Qdot,
+        Eigen::Ref<Eigen::MatrixXd> jacobian,
+        Eigen::Ref<Eigen::Vector3d> jacobianDotQdot,
+        bool updateKin = true);
+#endif
     // ------------------------ //
 
 
@@ -655,6 +777,12 @@ public:
     ///
     const Mesh& mesh(
         unsigned int  idx) const;
+
+    ///
+    /// \brief Return the total number of vertices of the meshes of all the segments
+    /// \return The total number of vertices
+    ///
+    unsigned int nbMeshVertices() const;
     // ----------------------- //
 
 
@@ -682,6 +810,46 @@ public:
         const GeneralizedCoordinates &Q,
         bool updateKin = true);
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Get the inverse of the mass matrix at a given position Q
+    /// \param Q The generalized coordinates
+    /// \param updateKin If the kinematics should be updated
+    /// \return The inverse of the mass matrix
+    ///
+    /// The inverse is computed directly in O(n^2) by running the articulated
+    /// body algorithm on all the unit torques at once, without building nor
+    /// inverting the mass matrix
+    ///
+    utils::Matrix massMatrixInverse(
+        const GeneralizedCoordinates &Q,
+        bool updateKin = true);
+
+    ///
+    /// \brief Get the LTDL factorization of the mass matrix at a given position Q
+    /// \param Q The generalized coordinates
+    /// \param LTDL The factorization M = L^T D L, D being on the diagonal and L (unit lower triangular) under it (output)
+    /// \param updateKin If the kinematics should be updated
+    ///
+    /// The factorization follows the kinematic tree so L has the same
+    /// sparsity as the mass matrix (no fill-in). Only the diagonal and the
+    /// lower triangle of LTDL are meaningful.
+    ///
+    void massMatrixLTDL(
+        const GeneralizedCoordinates &Q,
+        utils::Matrix &LTDL,
+        bool updateKin = true);
+
+    ///
+    /// \brief Solve M * X = B in place from the LTDL factorization of the mass matrix
+    /// \param LTDL The factorization computed by massMatrixLTDL
+    /// \param B The right-hand sides, one per column, replaced by the solutions (nbQdot x nbRhs)
+    ///
+    void massMatrixLTDLSolve(
+        const utils::Matrix &LTDL,
+        Eigen::Ref<Eigen::MatrixXd> B) const;
+#endif
+
     ///
     /// \brief Calculate the angular momentum of the center of mass
     /// \param Q The generalized coordinates
@@ -733,6 +901,64 @@ public:
         const GeneralizedVelocity &Qdot,
         const rigidbody::GeneralizedAcceleration &Qddot,
         bool updateKin);
+
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Return the centroidal momentum matrix
+    /// \param Q The generalized coordinates
+    /// \param updateKin If the kinematics of the model should be computed
+    /// \return The centroidal momentum matrix (6 x nbQdot)
+    ///
+    /// The centroidal momentum (angular momentum about the center of mass
+    /// followed by the linear momentum, in the global reference frame) is
+    /// the centroidal momentum matrix times Qdot
+    ///
+    utils::Matrix centroidalMomentumMatrix(
+        const GeneralizedCoordinates &Q,
+        bool updateKin = true);
+
+    ///
+    /// \brief Compute the centroidal momentum matrix into a preallocated matrix
+    /// \param Q The generalized coordinates
+    /// \param matrix The centroidal momentum matrix (6 x nbQdot)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// Each column is the momentum of the composite body moved by its DoF,
+    /// so the whole matrix is computed in O(n) from a single backward pass
+    ///
+    void centroidalMomentumMatrix(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::MatrixXd> matrix,
+        bool updateKin = true);
+
+    ///
+    /// \brief Return the bias term of the rate of change of the centroidal momentum
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param updateKin If the kinematics of the model should be computed
+    /// \return The time derivative of the centroidal momentum matrix times Qdot
+    ///
+    /// The rate of change of the centroidal momentum is the centroidal momentum
+    /// matrix times Qddot plus this bias term
+    ///
+    utils::Vector centroidalMomentumBias(
+        const GeneralizedCoordinates &Q,
+        const GeneralizedVelocity &Qdot,
+        bool updateKin = true);
+
+    ///
+    /// \brief Compute the bias term of the rate of change of the centroidal momentum into a preallocated vector
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param bias The time derivative of the centroidal momentum matrix times Qdot (6)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    void centroidalMomentumBias(
+        const GeneralizedCoordinates &Q,
+        const GeneralizedVelocity &Qdot,
+        Eigen::Ref<Eigen::VectorXd> bias,
+        bool updateKin = true);
+#endif
     // -------------------------------- //
 
     ///
@@ -750,6 +976,58 @@ public:
         RigidBodyDynamics::Math::MatrixNd &G,
         bool updateKin);
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Calculate the jacobian matrix of a rotation matrix without allocating
+    /// \param Q The generalized coordinates
+    /// \param bodyId The body id (in RBDL) the rotation is attached to
+    /// \param rotation The rotation matrix in the reference frame of the body
+    /// \param G The jacobian of the columns of the rotation stacked vertically (9 x nbQdot) (output)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// Only the columns of the DoF the body depends on are written, the
+    /// other columns must be zeroed by the caller
+    ///
+    void CalcMatRotJacobian(
+        const GeneralizedCoordinates &Q,
+        unsigned int bodyId,
+        const RigidBodyDynamics::Math::Matrix3d &rotation,
+        Eigen::Ref<Eigen::MatrixXd> G,
+        bool updateKin);
+
+    ///
+    /// \brief Calculate the jacobian of a point attached to a body without allocating
+    /// \param Q The generalized coordinates
+    /// \param bodyId The body id (in RBDL) the point is attached to
+    /// \param point The position of the point in the reference frame of the body
+    /// \param G The jacobian (3 x nbQdot) (output)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// Only the columns of the DoF the body depends on are written, the
+    /// other columns must be zeroed by the caller
+    ///
+    void CalcPointJacobian(
+        const GeneralizedCoordinates &Q,
+        unsigned int bodyId,
+        const RigidBodyDynamics::Math::Vector3d &point,
+        Eigen::Ref<Eigen::MatrixXd> G,
+        bool updateKin);
+
+    ///
+    /// \brief Calculate the motion subspace of every DoF expressed in the global reference frame
+    /// \param Q The generalized coordinates
+    /// \param axes The spatial axis (angular then linear, at the origin of the global reference frame) of each DoF (output, 6 x nbQdot)
+    /// \param updateKin If the kinematics of the model should be computed
+    ///
+    /// The spatial jacobian of a body is made of the columns of the DoF it
+    /// depends on, so this computes the jacobians of all the bodies in one sweep
+    ///
+    void CalcMotionSubspaceInGlobal(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::MatrixXd> axes,
+        bool updateKin);
+#endif
+
     ///
     /// \brief Return the derivate of Q in function of Qdot (if not Quaternion, Qdot is directly returned)
     /// \param Q The generalized coordinates
@@ -777,6 +1055,34 @@ public:
         const rigidbody::GeneralizedAcceleration &QDDot,
         std::vector<utils::SpatialVector>* f_ext = nullptr);
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Inverse dynamics and its analytical derivatives
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param QDDot The Generalzed Acceleration
+    /// \param dTau_dQ The derivative of the Generalized Torques with respect to Q (nbGeneralizedTorque x nbQdot) (output)
+    /// \param dTau_dQDot The derivative of the Generalized Torques with respect to QDot (nbGeneralizedTorque x nbQdot) (output)
+    /// \param dTau_dQDDot The derivative of the Generalized Torques with respect to QDDot, that is the mass matrix (nbGeneralizedTorque x nbQddot) (output)
+    /// \param f_ext External force acting on the system if there are any
+    /// \return The Generalized Torques
+    ///
+    /// Everything is computed in a single pass of the recursive Newton-Euler
+    /// algorithm. The external forces are considered as fixed in the global
+    /// reference frame, as in InverseDynamics. For spherical joints, the
+    /// derivatives with respect to Q are taken along a rotation vector
+    /// expressed in the local reference frame (hence the nbQdot columns).
+    ///
+    GeneralizedTorque InverseDynamicsDerivatives(
+        const GeneralizedCoordinates &Q,
+        const GeneralizedVelocity &QDot,
+        const rigidbody::GeneralizedAcceleration &QDDot,
+        utils::Matrix &dTau_dQ,
+        utils::Matrix &dTau_dQDot,
+        utils::Matrix &dTau_dQDDot,
+        std::vector<utils::SpatialVector>* f_ext = nullptr);
+#endif
+
     ///
     /// \brief Interface to NonLinearEffect
     /// \param Q The Generalized Coordinates
@@ -803,6 +1109,37 @@ public:
         const GeneralizedTorque& Tau,
         std::vector<utils::SpatialVector>* f_ext = nullptr);
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Analytical derivatives of the forward dynamics
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param Tau The Generalized Torques
+    /// \param dQDDot_dQ The derivative of the Generalized Accelerations with respect to Q (nbQddot x nbQdot) (output)
+    /// \param dQDDot_dQDot The derivative of the Generalized Accelerations with respect to QDot (nbQddot x nbQdot) (output)
+    /// \param dQDDot_dTau The derivative of the Generalized Accelerations with respect to Tau, that is the inverse of the mass matrix (nbQddot x nbGeneralizedTorque) (output)
+    /// \param f_ext External force acting on the system if there are any
+    ///
+    /// The accelerations are computed once, then a single pass of the
+    /// recursive Newton-Euler algorithm gives the derivatives of the inverse
+    /// dynamics and the mass matrix at these accelerations. Since
+    /// ID(Q, QDot, FD(Q, QDot, Tau)) = Tau, the derivatives of the forward
+    /// dynamics are -M^-1 times the ones of the inverse dynamics.
+    ///
+    /// For spherical joints, the derivatives with respect to Q are taken
+    /// along a rotation vector expressed in the local reference frame (hence
+    /// the nbQdot columns).
+    ///
+    void ForwardDynamicsDerivatives(
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDot,
+        const GeneralizedTorque& Tau,
+        utils::Matrix& dQDDot_dQ,
+        utils::Matrix& dQDDot_dQDot,
+        utils::Matrix& dQDDot_dTau,
+        std::vector<utils::SpatialVector>* f_ext = nullptr);
+#endif
+
     ///
     /// \brief Interface for the forward dynamics with contact of RBDL
     /// \param Q The Generalized Coordinates
@@ -868,6 +1205,207 @@ public:
         const GeneralizedCoordinates& Q,
         const GeneralizedVelocity& QDotPre);
 
+    ///
+    /// \brief Forward dynamics with contact, solved with the solver set on the constraint set
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param Tau The Generalized Torques
+    /// \param CS The Constraint set that will be filled
+    /// \param f_ext External force acting on the system if there are any
+    /// \return The Generalized Accelerations
+    ///
+    /// The direct solver factorizes the full KKT system, the range-space
+    /// solver uses the sparse (tree) factorization of the mass matrix and the
+    /// null-space solver projects the dynamics on the null-space of the
+    /// constraint jacobian (see Contacts::setContactSolver)
+    ///
+    rigidbody::GeneralizedAcceleration ForwardDynamicsConstraints(
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDot,
+        const GeneralizedTorque& Tau,
+        Contacts& CS,
+        std::vector<utils::SpatialVector>* f_ext = nullptr);
+
+    ///
+    /// \brief Forward dynamics with contact, solved with the solver set on the model
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param Tau The Generalized Torques
+    /// \param f_ext External force acting on the system if there are any
+    /// \return The Generalized Accelerations
+    ///
+    /// Unlike the *Direct functions, which solve in a copy of the constraint
+    /// set of the model, this family solves in the constraint set of the
+    /// model so its workspace is reused. Its forces, impulses and workspace
+    /// are therefore overwritten by each call.
+    ///
+    rigidbody::GeneralizedAcceleration ForwardDynamicsConstraints(
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDot,
+        const GeneralizedTorque& Tau,
+        std::vector<utils::SpatialVector>* f_ext = nullptr);
+
+    ///
+    /// \brief Contact forces of the forward dynamics with contact, solved with the solver set on the model
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param Tau The Generalized Torques
+    /// \param f_ext External force acting on the system if there are any
+    /// \return The contact forces
+    ///
+    /// The constraint set of the model is changed (see ForwardDynamicsConstraints)
+    ///
+    utils::Vector ContactForcesFromForwardDynamicsConstraints(
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDot,
+        const GeneralizedTorque& Tau,
+        std::vector<utils::SpatialVector>* f_ext = nullptr);
+
+    ///
+    /// \brief Compute the QDot post from an impact, solved with the solver set on the model
+    /// \param Q The Generalized Coordinates
+    /// \param QDotPre The Generalized Velocities before impact
+    /// \return The Generalized Velocities post acceleration
+    ///
+    /// The constraint set of the model is changed (see ForwardDynamicsConstraints)
+    ///
+    GeneralizedVelocity ComputeConstraintImpulses(
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDotPre);
+
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Time a solver of the forward dynamics with contact
+    /// \param type The solver to time
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param Tau The Generalized Torques
+    /// \param nbCalls The number of calls to average on
+    /// \return The mean time of one call in seconds
+    ///
+    double timeContactSolver(
+        CONTACT_SOLVER_TYPE type,
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDot,
+        const GeneralizedTorque& Tau,
+        unsigned int nbCalls = 100);
+
+    ///
+    /// \brief Time every solver of the forward dynamics with contact and keep the fastest
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param Tau The Generalized Torques
+    /// \param nbCalls The number of calls to average on for each solver
+    /// \return The fastest solver, which is now set on the model
+    ///
+    CONTACT_SOLVER_TYPE selectFastestContactSolver(
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDot,
+        const GeneralizedTorque& Tau,
+        unsigned int nbCalls = 100);
+#endif
+    // -------------------------------- //
+
+    // ---- BATCH DYNAMIC INTERFACE ---- //
+    ///
+    /// \brief Set the number of threads used by the batch dynamics
+    /// \param nbThreads The number of threads, 0 uses all the cores available
+    ///
+    /// Each copy of the model (including the workspaces) has its own
+    /// threads, which start with the number of threads of the copied model.
+    ///
+    void setNbThreads(
+        unsigned int nbThreads);
+
+    ///
+    /// \brief Return the number of threads used by the batch dynamics
+    /// \return The number of threads used by the batch dynamics
+    ///
+    unsigned int nbThreads() const;
+
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Inverse dynamics of a series of frames
+    /// \param Q The Generalized Coordinates (nbQ x nbFrames)
+    /// \param QDot The Generalized Velocities (nbQdot x nbFrames)
+    /// \param QDDot The Generalized Accelerations (nbQddot x nbFrames)
+    /// \param Tau The Generalized Torques (nbGeneralizedTorque x nbFrames) (output)
+    ///
+    /// The frames are dispatched on nbThreads() threads, each of them
+    /// working on its own copy of the kinematics of the model, so the model
+    /// itself is left untouched. The results do not depend on the number of
+    /// threads.
+    ///
+    void InverseDynamicsBatch(
+        const utils::Matrix &Q,
+        const utils::Matrix &QDot,
+        const utils::Matrix &QDDot,
+        utils::Matrix &Tau);
+
+    ///
+    /// \brief Non linear effects of a series of frames
+    /// \param Q The Generalized Coordinates (nbQ x nbFrames)
+    /// \param QDot The Generalized Velocities (nbQdot x nbFrames)
+    /// \param Tau The Generalized Torques of the bias effects (nbGeneralizedTorque x nbFrames) (output)
+    ///
+    /// See InverseDynamicsBatch for the threading
+    ///
+    void NonLinearEffectBatch(
+        const utils::Matrix &Q,
+        const utils::Matrix &QDot,
+        utils::Matrix &Tau);
+
+    ///
+    /// \brief Forward dynamics of a series of frames
+    /// \param Q The Generalized Coordinates (nbQ x nbFrames)
+    /// \param QDot The Generalized Velocities (nbQdot x nbFrames)
+    /// \param Tau The Generalized Torques (nbGeneralizedTorque x nbFrames)
+    /// \param QDDot The Generalized Accelerations (nbQddot x nbFrames) (output)
+    ///
+    /// See InverseDynamicsBatch for the threading
+    ///
+    void ForwardDynamicsBatch(
+        const utils::Matrix &Q,
+        const utils::Matrix &QDot,
+        const utils::Matrix &Tau,
+        utils::Matrix &QDDot);
+
+    ///
+    /// \brief Mass matrices of a series of frames
+    /// \param Q The Generalized Coordinates (nbQ x nbFrames)
+    /// \param M The mass matrices side by side (nbQdot x nbQdot*nbFrames), frame i being in the columns [i*nbQdot, (i+1)*nbQdot[ (output)
+    ///
+    /// See InverseDynamicsBatch for the threading
+    ///
+    void massMatrixBatch(
+        const utils::Matrix &Q,
+        utils::Matrix &M);
+
+    ///
+    /// \brief Vertices of the meshes of all the segments for a series of frames
+    /// \param Q The Generalized Coordinates (nbQ x nbFrames)
+    /// \param points The vertices stacked vertically, segment after segment (3*nbMeshVertices() x nbFrames) (output)
+    ///
+    /// See InverseDynamicsBatch for the threading
+    ///
+    void meshPointsBatch(
+        const utils::Matrix &Q,
+        Eigen::Ref<Eigen::MatrixXd> points);
+
+    ///
+    /// \brief Vertices of the meshes of all the segments for a series of frames in single precision
+    /// \param Q The Generalized Coordinates (nbQ x nbFrames)
+    /// \param points The vertices stacked vertically, segment after segment (3*nbMeshVertices() x nbFrames) (output)
+    ///
+    /// The transformations of the segments are computed in double precision
+    /// and rounded once before being applied to the vertices, so the error
+    /// does not accumulate along the kinematic chain
+    ///
+    void meshPointsBatch(
+        const utils::Matrix &Q,
+        Eigen::Ref<Eigen::MatrixXf> points);
+#endif
+
 protected:
     std::shared_ptr<std::vector<Segment>>
             m_segments; ///< All the articulations
@@ -883,8 +1421,24 @@ protected:
     m_nRotAQuat; ///< The number of segments per quaternion
     std::shared_ptr<bool>
     m_isKinematicsComputed; ///< If the kinematics are computed
+    std::shared_ptr<utils::Vector>
+    m_kinematicsCacheQ; ///< Generalized coordinates of the last kinematics update (empty if unknown)
+    std::shared_ptr<utils::Vector>
+    m_kinematicsCacheQdot; ///< Generalized velocities of the last kinematics update (empty if unknown)
+    std::shared_ptr<utils::Vector>
+    m_kinematicsCacheQddot; ///< Generalized accelerations of the last kinematics update (empty if unknown)
+    std::shared_ptr<unsigned long>
+    m_nbKinematicsCacheHits; ///< Number of kinematics updates that were skipped
+    std::shared_ptr<unsigned long>
+    m_nbKinematicsCacheMisses; ///< Number of kinematics updates that were computed
     std::shared_ptr<utils::Scalar>
     m_totalMass; ///< Mass of all the bodies combined
+    std::shared_ptr<utils::ThreadPool>
+    m_threadPool; ///< Threads used by the batch dynamics (own to each instance, created with the number of threads of the copied model)
+    std::shared_ptr<std::vector<rigidbody::Joints>>
+    m_batchModels; ///< The copy of the model of each worker of the batch dynamics (own to each instance)
+    std::shared_ptr<bool>
+    m_collapseDofs; ///< If the DoF of the segments are gathered into multi-DoF joints
 
     ///
     /// \brief Calculate the joint coordinate system (JCS) in global reference frame of a specified segment
@@ -918,7 +1472,128 @@ protected:
         const std::vector<utils::RotoTrans> &RT,
         unsigned int idx) const;
 
+    ///
+    /// \brief Check if the kinematics stored in the model already reflects the variables passed
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param Qddot The generalized accelerations
+    /// \return If the kinematics can be reused as is
+    ///
+    bool isKinematicsCached(
+        const GeneralizedCoordinates *Q,
+        const GeneralizedVelocity *Qdot,
+        const rigidbody::GeneralizedAcceleration *Qddot) const;
+
+    ///
+    /// \brief Remember the variables that were used to update the kinematics
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param Qddot The generalized accelerations
+    ///
+    void cacheKinematics(
+        const GeneralizedCoordinates *Q,
+        const GeneralizedVelocity *Qdot,
+        const rigidbody::GeneralizedAcceleration *Qddot);
+
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Return the parent of each DoF in the kinematic tree
+    /// \return The index of the parent DoF of each DoF (-1 for the DoF attached to the base)
+    ///
+    std::vector<int> dofParents() const;
+
+    ///
+    /// \brief Compute the LTDL factorization of a mass matrix in place
+    /// \param H The mass matrix, replaced by its factorization
+    ///
+    void factorizeLTDL(
+        utils::Matrix &H) const;
+
+    ///
+    /// \brief Compute the inverse dynamics and its analytical derivatives in one pass
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param QDDot The Generalized Accelerations
+    /// \param f_ext External force acting on each body of RBDL, expressed in the base reference frame (nullptr if there are none)
+    /// \param Tau The Generalized Torques (output)
+    /// \param dTau_dQ The derivative of the Generalized Torques with respect to Q (output)
+    /// \param dTau_dQDot The derivative of the Generalized Torques with respect to QDot (output)
+    /// \param M The mass matrix, that is the derivative of the Generalized Torques with respect to QDDot (output)
+    ///
+    /// The recursive Newton-Euler algorithm is written in the base reference
+    /// frame, where moving a joint only rotates the spatial quantities of its
+    /// subtree. The derivatives with respect to the coordinates of a joint
+    /// then reduce to a few spatial cross products per joint, combined with
+    /// the composite inertias during the backward pass.
+    ///
+    void computeInverseDynamicsDerivatives(
+        const GeneralizedCoordinates &Q,
+        const GeneralizedVelocity &QDot,
+        const rigidbody::GeneralizedAcceleration &QDDot,
+        const std::vector<RigidBodyDynamics::Math::SpatialVector>* f_ext,
+        GeneralizedTorque &Tau,
+        utils::Matrix &dTau_dQ,
+        utils::Matrix &dTau_dQDot,
+        utils::Matrix &M);
+#endif
+
+    ///
+    /// \brief Forward dynamics with contact using a specified solver
+    /// \param type The solver to use
+    /// \param Q The Generalized Coordinates
+    /// \param QDot The Generalized Velocities
+    /// \param Tau The Generalized Torques
+    /// \param CS The Constraint set that will be filled
+    /// \param f_ext External force acting on the system if there are any
+    /// \return The Generalized Accelerations
+    ///
+    rigidbody::GeneralizedAcceleration forwardDynamicsConstraints(
+        CONTACT_SOLVER_TYPE type,
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDot,
+        const GeneralizedTorque& Tau,
+        Contacts& CS,
+        std::vector<utils::SpatialVector>* f_ext = nullptr);
+
+    ///
+    /// \brief Compute the QDot post from an impact using a specified solver
+    /// \param type The solver to use
+    /// \param Q The Generalized Coordinates
+    /// \param QDotPre The Generalized Velocities before impact
+    /// \param CS The Constraint set that will be filled
+    /// \return The Generalized Velocities post acceleration
+    ///
+    GeneralizedVelocity computeConstraintImpulses(
+        CONTACT_SOLVER_TYPE type,
+        const GeneralizedCoordinates& Q,
+        const GeneralizedVelocity& QDotPre,
+        Contacts& CS);
+
+#if !defined(BIORBD_USE_CASADI_MATH) && !defined(SWIG)
+    ///
+    /// \brief Fill the vertices of the meshes of all the segments for a series of frames
+    /// \param Q The Generalized Coordinates (nbQ x nbFrames)
+    /// \param points The vertices stacked vertically, segment after segment (3*nbMeshVertices() x nbFrames) (output)
+    ///
+    template<typename T>
+    void fillMeshPointsBatch(
+        const utils::Matrix &Q,
+        Eigen::Ref<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>> points);
+#endif
+
 public:
+#ifndef SWIG
+    ///
+    /// \brief Dispatch a series of frames on the threads of the batch dynamics
+    /// \param nbFrames The number of frames
+    /// \param frameFunction The function to call for each frame, receiving the copy of the model of the worker, the index of the frame and the index of the worker
+    ///
+    void runBatch(
+        unsigned int nbFrames,
+        const std::function<void(rigidbody::Joints&, unsigned int, unsigned int)>&
+        frameFunction);
+#endif
+
     ///
     /// \brief Check for the Generalized coordinates, velocities, acceleration and torque dimensions
     /// \param Q The generalized coordinates
@@ -3,6 +3,8 @@
 
 #include <memory>
 #include <vector>
+#include <functional>
+#include <rbdl/rbdl_math.h>
 #include "biorbdConfig.h"
 
 
@@ -33,11 +35,17 @@ public:
     /// \param frequency The acquisition frequency express in Hertz
     /// \param noiseFactor The noise factor (on measurement matrix)
     /// \param errorFactor The error factor (on prediction matrix
+    /// \param initMaxIterations The maximum number of iterations of the initialization on the first frame
+    /// \param initTolerance The tolerance of the initialization on the first frame
+    /// \param imuNoiseFactor The noise factor on the IMUs, when they are fused with markers
     ///
     KalmanParam(
         double frequency = 100,
         double noiseFactor = 1e-10,
-        double errorFactor = 1e-5);
+        double errorFactor = 1e-5,
+        unsigned int initMaxIterations = 100,
+        double initTolerance = 1e-10,
+        double imuNoiseFactor = 0.005);
 
     ///
     /// \brief Return the acquisition frequency
@@ -54,10 +62,34 @@ public:
     ///
     double errorFactor() const;
 
+    ///
+    /// \brief Return the maximum number of iterations of the initialization on the first frame
+    ///
+    unsigned int initMaxIterations() const;
+
+    ///
+    /// \brief Return the tolerance of the initialization on the first frame
+    ///
+    /// The initialization stops when the largest step on the generalized
+    /// coordinates is below the tolerance and the covariance matrix stops
+    /// when its relative change is below it.
+    ///
+    double initTolerance() const;
+
+    ///
+    /// \brief Return the noise factor on the IMUs, when they are fused with markers
+    ///
+    /// The noiseFactor is then the one of the markers.
+    ///
+    double imuNoiseFactor() const;
+
 private:
     double m_acquisitionFrequency; ///< The acquisition frequency
     double m_noiseFactor; ///< The noise factor
     double m_errorFactor; ///< The error factor
+    unsigned int m_initMaxIterations; ///< The maximum number of iterations of the initialization
+    double m_initTolerance; ///< The tolerance of the initialization
+    double m_imuNoiseFactor; ///< The noise factor on the IMUs fused with markers
 };
 
 ///
@@ -119,6 +151,27 @@ public:
         const GeneralizedVelocity *Qdot = nullptr,
         const GeneralizedAcceleration *Qddot = nullptr);
 
+    ///
+    /// \brief Return the number of iterations the initialization on the first frame took
+    /// \return The number of evaluations of the measurements, 0 if the filter is not initialized yet
+    ///
+    unsigned int nbInitIterations() const;
+
+    ///
+    /// \brief Advance the filter of one frame without any measurement
+    /// \param Q The predicted generalized coordinates
+    /// \param Qdot The predicted generalized velocities
+    /// \param Qddot The predicted generalized accelerations
+    ///
+    /// The state and the covariance are only predicted, so a frame that is
+    /// skipped keeps the time step of the filter without evaluating the
+    /// kinematics.
+    ///
+    void predictFrame(
+        GeneralizedCoordinates *Q = nullptr,
+        GeneralizedVelocity *Qdot = nullptr,
+        GeneralizedAcceleration *Qddot = nullptr);
+
     ///
     /// \brief Proceed to one iteration of the Kalman filter
     ///
@@ -180,30 +233,125 @@ protected:
     GeneralizedCoordinates initState(
         const unsigned int nbQ);
 
+    ///
+    /// \brief Predict the state at the next frame
+    /// \return The predicted state (Q, Qdot, Qddot)
+    ///
+    /// The evolution matrix is the Kronecker product of a small matrix of
+    /// Taylor coefficients by the identity, so only blocks of the state are
+    /// combined instead of multiplying by the dense matrix.
+    ///
+    const utils::Vector& predictState();
+
+    ///
+    /// \brief Predict the covariance matrix at the next frame, using the block structure of the evolution matrix
+    ///
+    void predictCovariance();
+
     ///
     /// \brief Compute an iteration of the Kalman filter
     /// \param measure The vector actual measurement to track
     /// \param projectedMeasure The projected measurement from the update step of the filter
-    /// \param Hessian The hessian matrix
+    /// \param jacobian The jacobian of the measurements with respect to the generalized coordinates (nMeasure x nbDof)
     /// \param occlusion The vector where occlusionsoccurs
     ///
+    /// The measurements do not depend on the velocities and accelerations,
+    /// so only the first block of the covariance matrix is projected. Only
+    /// the rows of the visible measurements are kept in the innovation
+    /// system, which is factorized (Cholesky) instead of inverted.
+    ///
     void iteration(
-        utils::Vector measure,
+        const utils::Vector &measure,
         const utils::Vector &projectedMeasure,
-        const utils::Matrix &Hessian,
+        const utils::Matrix &jacobian,
         const std::vector<unsigned int> &occlusion = std::vector<unsigned int>());
 
     ///
-    /// \brief Manage the occlusion during the iteration
-    /// \param InvTp The inverse of the Tp matrix
+    /// \brief Store the lower triangle of the covariance matrix
+    /// \param covariance The packed covariance (output, 3*nbDof*(3*nbDof+1)/2)
+    ///
+    void packCovariance(
+        Eigen::Ref<Eigen::VectorXd> covariance) const;
+
+    ///
+    /// \brief Set the covariance matrix from its packed lower triangle
+    /// \param covariance The packed covariance
+    ///
+    void unpackCovariance(
+        const Eigen::Ref<const Eigen::VectorXd>& covariance);
+
+    ///
+    /// \brief Smooth the states of a trial with a Rauch-Tung-Striebel backward pass
+    /// \param states The filtered states, one frame per column, replaced by the smoothed states
+    /// \param covariances The packed filtered covariances, one frame per column
+    ///
+    /// The predicted covariances are computed again from the filtered ones
+    /// instead of being stored. The filter is left at the last frame of the
+    /// trial.
+    ///
+    void smoothStates(
+        utils::Matrix& states,
+        const utils::Matrix& covariances);
+
+    ///
+    /// \brief Gather the rows of the visible measurements
     /// \param measure The vector actual measurement to track
+    /// \param projectedMeasure The projected measurement
+    /// \param jacobian The jacobian of the measurements with respect to the generalized coordinates
     /// \param occlusion The vector where occlusions occurs
+    /// \return The number of visible measurements
     ///
-    virtual void manageOcclusionDuringIteration(
-        utils::Matrix &InvTp,
-        utils::Vector &measure,
+    unsigned int gatherVisibleMeasurements(
+        const utils::Vector &measure,
+        const utils::Vector &projectedMeasure,
+        const utils::Matrix &jacobian,
         const std::vector<unsigned int> &occlusion);
 
+    ///
+    /// \brief Correct the predicted covariance (and state) with the gathered measurements
+    /// \param nbVisible The number of visible measurements
+    /// \param updateState If the state is corrected too
+    ///
+    void correction(
+        unsigned int nbVisible,
+        bool updateState = true);
+
+#ifndef SWIG
+    ///
+    /// \brief Solve the generalized coordinates of the current measurements by Gauss-Newton
+    /// \param measure The vector actual measurement to track
+    /// \param project The function filling m_zest, m_H and the occlusions for given generalized coordinates
+    /// \return The number of evaluations of the measurements
+    ///
+    /// The iterations start from the current state, the velocities and
+    /// accelerations are set to zero.
+    ///
+    unsigned int initializePose(
+        const utils::Vector &measure,
+        const std::function<void(const GeneralizedCoordinates&, std::vector<unsigned int>&)>
+        &project);
+
+    ///
+    /// \brief Iterate the covariance matrix to its steady state at the current pose
+    /// \param measure The vector actual measurement to track
+    /// \param project The function filling m_zest, m_H and the occlusions for given generalized coordinates
+    ///
+    /// Only the covariance is iterated, the measurements are linearized
+    /// once, so the filter then responds as if it had been tracking the
+    /// pose for a while.
+    ///
+    void initializeCovariance(
+        const utils::Vector &measure,
+        const std::function<void(const GeneralizedCoordinates&, std::vector<unsigned int>&)>
+        &project);
+#endif
+
+    ///
+    /// \brief Return the number of measurements of a sensor, to which the occlusion indices refer
+    /// \return The number of measurements of a sensor
+    ///
+    virtual unsigned int nbMeasurementsPerSensor() const;
+
     // Variables attributes
     std::shared_ptr<KalmanParam> m_params; ///< The parameters of the Kalman filter
     std::shared_ptr<double> m_Te; ///< Inherent parameter to the frequency
@@ -215,8 +363,26 @@ protected:
     std::shared_ptr<utils::Matrix> m_A; ///< Evolution matrix
     std::shared_ptr<utils::Matrix> m_Q; ///< Noise matrix
     std::shared_ptr<utils::Matrix>
-    m_R; ///< Matrix of the noise on the measurements
+    m_R; ///< Matrix of the noise on the measurements (diagonal)
     std::shared_ptr<utils::Matrix> m_Pp; ///< Covariance matrix
+    std::shared_ptr<unsigned int>
+    m_nbInitIterations; ///< Number of iterations of the initialization on the first frame
+
+    // Buffers of the iteration, allocated once by initialize
+    std::shared_ptr<utils::Vector> m_xkm; ///< Predicted state
+    std::shared_ptr<utils::Matrix> m_Pkm; ///< Predicted covariance matrix
+    std::shared_ptr<utils::Matrix> m_APkm; ///< Product of the evolution and the covariance matrices
+    std::shared_ptr<utils::Matrix>
+    m_H; ///< Jacobian of the measurements with respect to the generalized coordinates
+    std::shared_ptr<utils::Vector> m_zest; ///< Projected measurements
+    std::shared_ptr<std::vector<unsigned int>>
+            m_visibleRows; ///< Rows of the measurements that are not occluded
+    std::shared_ptr<utils::Matrix>
+    m_Hvisible; ///< Rows of the jacobian of the visible measurements
+    std::shared_ptr<utils::Matrix>
+    m_HP; ///< Jacobian times predicted covariance, then its solve by the Cholesky factor
+    std::shared_ptr<utils::Matrix> m_S; ///< Innovation covariance, then its Cholesky factor
+    std::shared_ptr<utils::Vector> m_innovation; ///< Innovation of the visible measurements
 
 };
 
@@ -95,23 +95,24 @@ public:
 
 protected:
     ///
-    /// \brief Initialization of the filter
+    /// \brief Project the IMUs and their jacobian at a pose in the measurement buffers of the filter
+    /// \param model The joint model
+    /// \param Q The generalized coordinates
+    /// \param IMUobs The observed IMUs, used to find the occluded ones
+    /// \param occlusion The occluded IMUs (output)
     ///
-    virtual void initialize();
+    void projectIMUs(
+        Model &model,
+        const GeneralizedCoordinates &Q,
+        const utils::Vector &IMUobs,
+        std::vector<unsigned int> &occlusion);
 
     ///
-    /// \brief Manage the occlusion during the iteration
-    /// \param InvTp The inverse of the Tp matrix
-    /// \param measure The vector actual measurement to track
-    /// \param occlusion The vector where occlusions occurs
+    /// \brief Return the number of measurements of an IMU
+    /// \return The number of measurements of an IMU (9)
     ///
-    virtual void manageOcclusionDuringIteration(
-        utils::Matrix &InvTp,
-        utils::Vector &measure,
-        const std::vector<unsigned int> &occlusion);
+    virtual unsigned int nbMeasurementsPerSensor() const;
 
-    std::shared_ptr<utils::Matrix>
-    m_PpInitial; ///< Initial covariance matrix
     std::shared_ptr<bool> m_firstIteration; ///< If first iteration was done
 };
 
@@ -98,6 +98,53 @@ public:
         GeneralizedAcceleration *Qddot = nullptr,
         bool removeAxes=true);
 
+    ///
+    /// \brief Reconstruct the kinematics of a whole trial
+    /// \param model The joint model
+    /// \param markers The observed technical markers, one frame per column (3*nbTechnicalMarkers x nbFrames)
+    /// \param Q The generalized coordinates (output, nbDof x nbFrames)
+    /// \param Qdot The generalized velocities (output, nbDof x nbFrames)
+    /// \param Qddot The generalized accelerations (output, nbDof x nbFrames)
+    /// \param smooth If the forward pass is followed by a Rauch-Tung-Striebel backward pass, which removes the lag of the filter
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
+    ///
+    /// The trial continues from the current state of the filter, so a new
+    /// filter should be used for each independent trial.
+    ///
+    void reconstructTrial(
+        Model &model,
+        const utils::Matrix &markers,
+        utils::Matrix &Q,
+        utils::Matrix &Qdot,
+        utils::Matrix &Qddot,
+        bool smooth = true,
+        bool removeAxes = true);
+
+    ///
+    /// \brief Reconstruct the kinematics of independent trials on the threads of the model
+    /// \param model The joint model
+    /// \param markers The observed technical markers of each trial, one frame per column (3*nbTechnicalMarkers x nbFrames)
+    /// \param Q The generalized coordinates of each trial (output, resized to nbDof x nbFrames)
+    /// \param Qdot The generalized velocities of each trial (output, resized to nbDof x nbFrames)
+    /// \param Qddot The generalized accelerations of each trial (output, resized to nbDof x nbFrames)
+    /// \param params The Kalman filter parameters
+    /// \param smooth If the forward pass is followed by a Rauch-Tung-Striebel backward pass
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
+    ///
+    /// The trials are dispatched on nbThreads() threads of the model. Each
+    /// worker has its own workspace of the model and a new filter is created
+    /// for each trial.
+    ///
+    static void reconstructTrials(
+        Model &model,
+        const std::vector<utils::Matrix> &markers,
+        std::vector<utils::Matrix> &Q,
+        std::vector<utils::Matrix> &Qdot,
+        std::vector<utils::Matrix> &Qddot,
+        const KalmanParam &params = KalmanParam(),
+        bool smooth = true,
+        bool removeAxes = true);
+
     ///
     /// \brief This function cannot be used to reconstruct frames
     ///
@@ -111,24 +158,29 @@ public:
 
 protected:
     ///
-    /// \brief Initialization of the filter
+    /// \brief Project the markers and their jacobian at a pose in the measurement buffers of the filter
+    /// \param model The joint model
+    /// \param Q The generalized coordinates
+    /// \param Tobs The observed markers, used to find the occluded ones
+    /// \param occlusion The occluded markers (output)
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
     ///
-    virtual void initialize();
+    void projectMarkers(
+        Model &model,
+        const GeneralizedCoordinates &Q,
+        const utils::Vector &Tobs,
+        std::vector<unsigned int> &occlusion,
+        bool removeAxes);
 
     ///
-    /// \brief Manage the occlusion during the iteration
-    /// \param InvTp The inverse of the Tp matrix
-    /// \param measure The vector actual measurement to track
-    /// \param occlusion The vector where occlusions occurs
+    /// \brief Return the number of measurements of a marker
+    /// \return The number of measurements of a marker (3)
     ///
-    virtual void manageOcclusionDuringIteration(
-        utils::Matrix& InvTp,
-        utils::Vector &measure,
-        const std::vector<unsigned int> &occlusion);
+    virtual unsigned int nbMeasurementsPerSensor() const;
 
-    std::shared_ptr<utils::Matrix>
-    m_PpInitial; ///< Initial covariance matrix
     std::shared_ptr<bool> m_firstIteration; ///< If first iteration was done
+    std::shared_ptr<std::vector<unsigned int>>
+    m_occlusion; ///< The occluded markers of the frame, reserved for all the markers
 };
 
 }
@@ -0,0 +1,145 @@
+#ifndef BIORBD_RIGIDBODY_KALMAN_RECONS_MARKERS_IMU_H
+#define BIORBD_RIGIDBODY_KALMAN_RECONS_MARKERS_IMU_H
+
+#include "biorbdConfig.h"
+#include "RigidBody/KalmanRecons.h"
+
+namespace BIORBD_NAMESPACE
+{
+namespace rigidbody
+{
+class NodeSegment;
+class IMU;
+
+///
+/// \brief Class Kinematic reconstruction algorithm using an Extended Kalman Filter fusing skin markers and IMU
+///
+/// The measurement vector stacks the technical markers (X, Y, Z of each
+/// marker) followed by the rotation matrices of the technical IMUs (column
+/// by column). The markers have the noiseFactor of the parameters and the
+/// IMUs have their imuNoiseFactor. A marker or an IMU that is missing (zero
+/// or NaN) is removed from the correction, independently of the other source.
+///
+class BIORBD_API KalmanReconsMarkersIMU : public KalmanRecons
+{
+public:
+
+    // Constructor
+
+    ///
+    /// \brief Initialize the Kalman filter and Kalman reconstruction for Markers and IMU data
+    ///
+    KalmanReconsMarkersIMU();
+
+    ///
+    /// \brief Initialize the Kalman filter and Kalman reconstruction for Markers and IMU data
+    /// \param model The joint model
+    /// \param params The Kalman filter parameters
+    ///
+    KalmanReconsMarkersIMU(
+        Model& model,
+        KalmanParam params = KalmanParam());
+
+    ///
+    /// \brief Deep copy of the Kalman reconstruction
+    /// \return Copy of the Kalman reconstruction
+    ///
+    KalmanReconsMarkersIMU DeepCopy() const;
+
+    ///
+    /// \brief Deep copy of the Kalman reconstruction
+    /// \param other The Kalman reconstruction to copy
+    ///
+    void DeepCopy(const KalmanReconsMarkersIMU& other);
+
+    ///
+    /// \brief Reconstruct the kinematics from markers and IMU data
+    /// \param model The joint model
+    /// \param Tobs The observed markers
+    /// \param IMUobs The observed inertial measurement units (IMU)
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param Qddot The generalized accelerations
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
+    ///
+    virtual void reconstructFrame(
+        Model &model,
+        const std::vector<NodeSegment> &Tobs,
+        const std::vector<IMU> &IMUobs,
+        GeneralizedCoordinates *Q,
+        GeneralizedVelocity *Qdot,
+        GeneralizedAcceleration *Qddot,
+        bool removeAxes=true);
+
+    ///
+    /// \brief Reconstruct the kinematics from markers and IMU data
+    /// \param model The joint model
+    /// \param Tobs The observed markers in a column-major vector
+    /// \param IMUobs The observed inertial measurement units (IMU) in one large column-major vector
+    /// \param Q The generalized coordinates
+    /// \param Qdot The generalized velocities
+    /// \param Qddot The generalized accelerations
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
+    ///
+    virtual void reconstructFrame(
+        Model &model,
+        const utils::Vector &Tobs,
+        const utils::Vector &IMUobs,
+        GeneralizedCoordinates *Q = nullptr,
+        GeneralizedVelocity *Qdot = nullptr,
+        GeneralizedAcceleration *Qddot = nullptr,
+        bool removeAxes=true);
+
+    ///
+    /// \brief This function cannot be used to reconstruct frames
+    ///
+    virtual void reconstructFrame();
+
+    ///
+    /// \brief Return if the first iteration was done
+    /// \return If the first iteration was done
+    ///
+    bool first();
+
+protected:
+    ///
+    /// \brief Initialization of the filter
+    ///
+    virtual void initialize();
+
+    ///
+    /// \brief Project the markers, the IMUs and their jacobian at a pose in the measurement buffers of the filter
+    /// \param model The joint model
+    /// \param Q The generalized coordinates
+    /// \param measure The observed markers followed by the observed IMUs, used to find the occluded ones
+    /// \param occlusion The occluded triplets of measurements (output)
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
+    ///
+    /// The kinematics is updated once for the markers and the IMUs.
+    ///
+    void project(
+        Model &model,
+        const GeneralizedCoordinates &Q,
+        const utils::Vector &measure,
+        std::vector<unsigned int> &occlusion,
+        bool removeAxes);
+
+    ///
+    /// \brief Return the number of measurements to which the occlusion indices refer
+    /// \return The number of measurements of a marker (3), an IMU being 3 of them
+    ///
+    virtual unsigned int nbMeasurementsPerSensor() const;
+
+    std::shared_ptr<unsigned int> m_nbMarkers; ///< Number of technical markers
+    std::shared_ptr<unsigned int> m_nbIMUs; ///< Number of technical IMUs
+    std::shared_ptr<utils::Vector>
+    m_measure; ///< The markers and the IMUs of the frame stacked in one vector
+    std::shared_ptr<bool> m_firstIteration; ///< If first iteration was done
+    std::shared_ptr<std::vector<unsigned int>>
+    m_occlusion; ///< The occluded triplets of the frame, reserved for all the markers and the IMUs
+};
+
+}
+}
+
+#endif // BIORBD_RIGIDBODY_KALMAN_RECONS_MARKERS_IMU_H
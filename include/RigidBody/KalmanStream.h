@@ -0,0 +1,358 @@
+#ifndef BIORBD_RIGIDBODY_KALMAN_STREAM_H
+#define BIORBD_RIGIDBODY_KALMAN_STREAM_H
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "biorbdConfig.h"
+#include "Utils/RingBuffer.h"
+#include "Utils/TripleBuffer.h"
+#include "Utils/Vector.h"
+#include "RigidBody/KalmanRecons.h"
+#include "RigidBody/RigidBodyEnums.h"
+#include "RigidBody/GeneralizedCoordinates.h"
+#include "RigidBody/GeneralizedVelocity.h"
+#include "RigidBody/GeneralizedAcceleration.h"
+
+namespace BIORBD_NAMESPACE
+{
+class Model;
+class ModelWorkspace;
+
+namespace utils
+{
+class Path;
+}
+
+namespace rigidbody
+{
+class KalmanReconsMarkers;
+class NodeSegment;
+
+///
+/// \brief Real-time kinematic reconstruction of a stream of markers with a Kalman filter
+///
+/// An acquisition thread (the producer) pushes the frames without locking.
+/// A dedicated thread (the consumer) reconstructs them on its own workspace
+/// of the model and publishes the last reconstructed state in a double
+/// buffer, which any thread can read with latest. The frames and the
+/// published states are allocated on construction, so pushing a frame and
+/// reading the latest state do not allocate.
+///
+/// When the consumer cannot keep up, the drop policy either rejects the
+/// frames pushed in a full queue (REJECT_NEW_FRAMES) or lets each frame
+/// replace the one still waiting, so only the latest frame is reconstructed
+/// (SKIP_TO_LATEST_FRAME). Once the filter is initialized, the replaced
+/// frames are still predicted so it keeps its time step. The latency from
+/// the push of a frame to the publication of its state is accumulated in a
+/// histogram.
+///
+/// Only one thread may push the frames, and start and stop must be called
+/// from the same controlling thread.
+///
+class BIORBD_API KalmanStream
+{
+public:
+    ///
+    /// \brief Prepare a stream (the consumer is not started)
+    /// \param model The joint model, which is not modified by the stream
+    /// \param params The Kalman filter parameters
+    /// \param capacity The maximum number of frames waiting to be reconstructed with REJECT_NEW_FRAMES (only the latest frame waits with SKIP_TO_LATEST_FRAME)
+    /// \param dropPolicy What to do with the frames that cannot be reconstructed in time
+    /// \param removeAxes If the algo should ignore or not the removeAxis defined in the bioMod file
+    /// \param latencyBinWidth The width of the bins of the latency histogram in seconds
+    /// \param nbLatencyBins The number of bins of the latency histogram, the last one gathering all the larger latencies
+    ///
+    KalmanStream(
+        const Model& model,
+        const KalmanParam& params = KalmanParam(),
+        unsigned int capacity = 16,
+        STREAM_DROP_POLICY dropPolicy = REJECT_NEW_FRAMES,
+        bool removeAxes = true,
+        double latencyBinWidth = 1e-4,
+        unsigned int nbLatencyBins = 100);
+
+    ///
+    /// \brief Stop the consumer thread
+    ///
+    virtual ~KalmanStream();
+
+    KalmanStream(const KalmanStream&) = delete;
+    KalmanStream& operator=(const KalmanStream&) = delete;
+
+    ///
+    /// \brief Start the consumer thread
+    ///
+    void start();
+
+    ///
+    /// \brief Stop the consumer thread once the queued frames are reconstructed
+    ///
+    /// If the reconstruction threw, the exception is rethrown here.
+    ///
+    void stop();
+
+    ///
+    /// \brief Return if the consumer thread is started
+    /// \return If the consumer thread is started
+    ///
+    bool isRunning() const;
+
+    ///
+    /// \brief Push a frame of technical markers (producer thread only)
+    /// \param markers The observed technical markers in a column-major vector
+    /// \return If the frame was queued, false if it was rejected because the queue is full (never with SKIP_TO_LATEST_FRAME)
+    ///
+    bool push(
+        const utils::Vector& markers);
+
+    ///
+    /// \brief Push a frame of technical markers (producer thread only)
+    /// \param markers The observed technical markers
+    /// \return If the frame was queued, false if it was rejected because the queue is full (never with SKIP_TO_LATEST_FRAME)
+    ///
+    bool push(
+        const std::vector<NodeSegment>& markers);
+
+    ///
+    /// \brief Return if the queue is full (exact from the producer thread)
+    /// \return If the queue is full, always false with SKIP_TO_LATEST_FRAME
+    ///
+    bool isFull() const;
+
+    ///
+    /// \brief Copy the last reconstructed state
+    /// \param Q The generalized coordinates (output)
+    /// \param Qdot The generalized velocities (output)
+    /// \param Qddot The generalized accelerations (output)
+    /// \param frame The index of the reconstructed frame, in the order of the pushes (output)
+    /// \return If a state was published yet, the outputs are not modified otherwise
+    ///
+    bool latest(
+        GeneralizedCoordinates& Q,
+        GeneralizedVelocity& Qdot,
+        GeneralizedAcceleration& Qddot,
+        unsigned long* frame = nullptr) const;
+
+    ///
+    /// \brief Return the number of frames pushed, including the ones that were dropped
+    /// \return The number of frames pushed
+    ///
+    unsigned long nbPushedFrames() const;
+
+    ///
+    /// \brief Return the number of frames reconstructed
+    /// \return The number of frames reconstructed
+    ///
+    unsigned long nbProcessedFrames() const;
+
+    ///
+    /// \brief Return the number of frames dropped by the drop policy
+    /// \return The number of frames rejected or replaced before being reconstructed
+    ///
+    unsigned long nbDroppedFrames() const;
+
+    ///
+    /// \brief Return the latency histogram
+    /// \return The number of frames per bin of latency
+    ///
+    std::vector<unsigned long> latencyHistogram() const;
+
+    ///
+    /// \brief Return the width of the bins of the latency histogram
+    /// \return The width of the bins in seconds
+    ///
+    double latencyBinWidth() const;
+
+    ///
+    /// \brief Return the largest latency
+    /// \return The largest latency in seconds
+    ///
+    double maxLatency() const;
+
+    ///
+    /// \brief Return the number of technical markers of a frame
+    /// \return The number of technical markers
+    ///
+    unsigned int nbTechnicalMarkers() const;
+
+    ///
+    /// \brief Return the maximum number of frames waiting to be reconstructed
+    /// \return The capacity of the queue
+    ///
+    unsigned int capacity() const;
+
+    ///
+    /// \brief Return the drop policy
+    /// \return The drop policy
+    ///
+    STREAM_DROP_POLICY dropPolicy() const;
+
+protected:
+#ifndef SWIG
+    ///
+    /// \brief Frame waiting in the queue
+    ///
+    struct Frame {
+        utils::Vector markers; ///< The observed technical markers
+        std::chrono::steady_clock::time_point pushed; ///< When the frame was pushed
+        unsigned long index; ///< The index of the frame
+    };
+
+    ///
+    /// \brief State published to the readers
+    ///
+    struct State {
+        GeneralizedCoordinates Q; ///< The generalized coordinates
+        GeneralizedVelocity Qdot; ///< The generalized velocities
+        GeneralizedAcceleration Qddot; ///< The generalized accelerations
+        unsigned long frame; ///< The index of the frame
+    };
+#endif
+
+    ///
+    /// \brief Main loop of the consumer thread
+    ///
+    void consumerLoop();
+
+    ///
+    /// \brief Make the frame filled by the producer available to the consumer, according to the drop policy
+    ///
+    void commitWrite();
+
+    ///
+    /// \brief Return if a frame waits to be reconstructed
+    /// \return If a frame waits to be reconstructed
+    ///
+    bool hasWaitingFrame() const;
+
+    ///
+    /// \brief Reconstruct the oldest frame of the queue (REJECT_NEW_FRAMES)
+    /// \return If a frame was reconstructed
+    ///
+    bool processQueuedFrame();
+
+    ///
+    /// \brief Predict the replaced frames and reconstruct the latest one (SKIP_TO_LATEST_FRAME)
+    /// \return If a frame was reconstructed
+    ///
+    bool processLatestFrame();
+
+#ifndef SWIG
+    ///
+    /// \brief Return the slot the producer fills, according to the drop policy
+    /// \return The slot to fill, nullptr if the frame must be rejected
+    ///
+    Frame* writeSlot();
+
+    ///
+    /// \brief Reconstruct a frame, publish its state and record its latency
+    /// \param frame The frame
+    ///
+    void process(
+        const Frame& frame);
+#endif
+
+    std::shared_ptr<ModelWorkspace> m_model; ///< The workspace of the model used by the consumer
+    std::shared_ptr<KalmanReconsMarkers> m_kalman; ///< The Kalman filter
+    unsigned int m_nbMarkers; ///< The number of technical markers
+    bool m_removeAxes; ///< If the removeAxis of the bioMod file are ignored
+    STREAM_DROP_POLICY m_dropPolicy; ///< The drop policy
+#ifndef SWIG
+    utils::RingBuffer<Frame> m_queue; ///< The frames waiting to be reconstructed (REJECT_NEW_FRAMES)
+    utils::TripleBuffer<Frame> m_latestFrame; ///< The latest frame waiting to be reconstructed (SKIP_TO_LATEST_FRAME)
+    unsigned long m_lastIndex; ///< The index of the last reconstructed frame
+    State m_states[2]; ///< The double buffer of the published states
+    State* m_front; ///< The state read by latest
+    State* m_back; ///< The state being reconstructed
+#endif
+    mutable std::mutex m_publishMutex; ///< Protect the swap of the states against the readers
+    bool m_hasPublished; ///< If a state was published
+    std::thread m_consumer; ///< The consumer thread
+    std::atomic<bool> m_stop; ///< If the consumer should stop once the queue is empty
+    std::exception_ptr m_error; ///< The exception thrown by the consumer
+    std::atomic<unsigned long> m_nbPushed; ///< The number of frames pushed
+    std::atomic<unsigned long> m_nbProcessed; ///< The number of frames reconstructed
+    std::atomic<unsigned long> m_nbDropped; ///< The number of frames dropped
+    double m_latencyBinWidth; ///< The width of the bins of the latency histogram
+    std::vector<std::atomic<unsigned long>> m_latency; ///< The latency histogram
+    std::atomic<double> m_maxLatency; ///< The largest latency
+};
+
+///
+/// \brief Replay a file of markers in a stream, in place of a live acquisition
+///
+/// The markers of the file must be the technical markers of the model, in
+/// the same order.
+///
+class BIORBD_API MarkersFileReplayer
+{
+public:
+    ///
+    /// \brief Load the markers of a bioMark file
+    /// \param path The path of the file
+    /// \param frequency The acquisition frequency of the file in Hertz
+    ///
+    MarkersFileReplayer(
+        const utils::Path& path,
+        double frequency = 100);
+
+    ///
+    /// \brief Wait for the end of the replay
+    ///
+    virtual ~MarkersFileReplayer();
+
+    MarkersFileReplayer(const MarkersFileReplayer&) = delete;
+    MarkersFileReplayer& operator=(const MarkersFileReplayer&) = delete;
+
+    ///
+    /// \brief Return the number of frames
+    /// \return The number of frames
+    ///
+    unsigned int nbFrames() const;
+
+    ///
+    /// \brief Return a frame
+    /// \param index The index of the frame
+    /// \return The markers of the frame in a column-major vector
+    ///
+    const utils::Vector& frame(
+        unsigned int index) const;
+
+    ///
+    /// \brief Push all the frames in a stream from a producer thread
+    /// \param stream The stream, which must not be pushed to by another thread meanwhile
+    /// \param realTime If the frames are pushed at the acquisition frequency (and may be dropped), otherwise they are pushed as fast as the stream accepts them
+    ///
+    void start(
+        KalmanStream& stream,
+        bool realTime = true);
+
+    ///
+    /// \brief Wait until all the frames are pushed
+    ///
+    void join();
+
+protected:
+    ///
+    /// \brief Main loop of the producer thread
+    /// \param stream The stream
+    /// \param realTime If the frames are pushed at the acquisition frequency
+    ///
+    void producerLoop(
+        KalmanStream& stream,
+        bool realTime);
+
+    std::vector<utils::Vector> m_frames; ///< The frames
+    double m_frequency; ///< The acquisition frequency
+    std::thread m_producer; ///< The producer thread
+};
+
+}
+}
+
+#endif // BIORBD_RIGIDBODY_KALMAN_STREAM_H
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <vector>
+#include <rbdl/rbdl_math.h>
 #include "biorbdConfig.h"
 
 namespace BIORBD_NAMESPACE
@@ -64,6 +65,9 @@ public:
     /// \param axesToRemove Axes to remove while projecting the marker
     /// \param id The index of the parent segment
     ///
+    /// The body id of the parent is resolved once and for all here (or at
+    /// first use if the markers are not part of a model yet)
+    ///
     void addMarker(
         const NodeSegment &pos,
         const utils::String &name,
@@ -166,6 +170,49 @@ public:
     std::vector<NodeSegment> markers(
         bool removeAxis = true);
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Fill all the markers at a given Q in the global reference frame without allocating
+    /// \param Q The generalized coordinates
+    /// \param markers The markers in the global reference frame, one per column (output, 3 x nbMarkers)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    void markers(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::Matrix3Xd> markers,
+        bool removeAxis = true,
+        bool updateKin = true);
+
+    ///
+    /// \brief Compute all the markers in the global reference frame for a series of frames
+    /// \param Q The generalized coordinates (nbQ x nbFrames)
+    /// \param markers The markers stacked vertically (3*nbMarkers x nbFrames) (output)
+    /// \param removeAxis If there are axis to remove from the position variables
+    ///
+    /// The frames are dispatched on the threads of the batch dynamics (see
+    /// rigidbody::Joints::InverseDynamicsBatch)
+    ///
+    void markersBatch(
+        const utils::Matrix &Q,
+        Eigen::Ref<Eigen::MatrixXd> markers,
+        bool removeAxis = true);
+
+    ///
+    /// \brief Compute all the markers in the global reference frame for a series of frames in single precision
+    /// \param Q The generalized coordinates (nbQ x nbFrames)
+    /// \param markers The markers stacked vertically (3*nbMarkers x nbFrames) (output)
+    /// \param removeAxis If there are axis to remove from the position variables
+    ///
+    /// The kinematics is computed in double precision, only the transformation
+    /// of the markers and the output are in single precision
+    ///
+    void markersBatch(
+        const utils::Matrix &Q,
+        Eigen::Ref<Eigen::MatrixXf> markers,
+        bool removeAxis = true);
+#endif
+
     ///
     /// \brief Return the velocity of a marker
     /// \param Q The generalized coordinates
@@ -331,6 +378,34 @@ public:
         bool removeAxis=true,
         bool updateKin = true);
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Fill the jacobian of all the markers without allocating
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobians of the markers stacked vertically (output, 3*nbMarkers x nbQdot)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    void markersJacobian(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::MatrixXd> jacobian,
+        bool removeAxis = true,
+        bool updateKin = true);
+
+    ///
+    /// \brief Fill the jacobian of the technical markers without allocating
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobians of the technical markers stacked vertically (output, 3*nbTechnicalMarkers x nbQdot)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    ///
+    void technicalMarkersJacobian(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::MatrixXd> jacobian,
+        bool removeAxis = true,
+        bool updateKin = true);
+#endif
+
     ///
     /// \brief Return the jacobian of the technical markers
     /// \param Q The generalized coordinates
@@ -370,6 +445,36 @@ public:
         const GeneralizedCoordinates& Qinit,
         GeneralizedCoordinates &Q,
         bool removeAxes=true);
+
+    ///
+    /// \brief Performs the inverse kinematics of a whole trial
+    /// \param markers The technical markers to track, stacked vertically (3*nbTechnicalMarkers x nbFrames), NaN for an occluded marker
+    /// \param Qinit The initial guess for the generalized coordinates
+    /// \param Q The generalized coordinates that track the markers (output, nbQ x nbFrames)
+    /// \param residuals The root mean square distance between the markers and the model markers of each frame (output, nbFrames), NaN if no marker is visible
+    /// \param removeAxes If the markers should be projected on the axes
+    /// \param maxIterations The maximum number of iterations per frame
+    /// \param tolerance The norm of the step under which a frame is converged
+    /// \return The number of frames that did not converge, including the frames without any visible marker and the ones where no step decreases the cost before the tolerance is reached
+    ///
+    /// Each frame is solved by Levenberg-Marquardt on the stacked jacobian of
+    /// the visible markers, starting from the solution of the previous frame.
+    /// The trial is split into one chunk of consecutive frames per thread of
+    /// the batch dynamics (see rigidbody::Joints::InverseDynamicsBatch), the
+    /// first frame of each chunk starting from Qinit. The results therefore
+    /// depend on the number of threads, within the tolerance for the frames
+    /// that converge, and a Qinit far from the first frame of a chunk can lead
+    /// that chunk to another solution. A frame without any visible marker keeps
+    /// the solution of the previous frame. The model must not have quaternions.
+    ///
+    unsigned int inverseKinematics(
+        const utils::Matrix& markers,
+        const GeneralizedCoordinates& Qinit,
+        utils::Matrix& Q,
+        Eigen::Ref<Eigen::VectorXd> residuals,
+        bool removeAxes = true,
+        unsigned int maxIterations = 100,
+        double tolerance = 1e-10);
 #endif
 
 protected:
@@ -387,8 +492,66 @@ protected:
         bool updateKin,
         bool lookForTechnical); // Retourne la jacobienne des markers
 
+#ifndef BIORBD_USE_CASADI_MATH
+    ///
+    /// \brief Compute the stacked jacobian of the markers from a single sweep over the DoF
+    /// \param Q The generalized coordinates
+    /// \param jacobian The jacobians of the markers stacked vertically (output)
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \param updateKin If the model should be updated
+    /// \param lookForTechnical Check if only technical markers are to be computed
+    ///
+    void markersJacobian(
+        const GeneralizedCoordinates &Q,
+        Eigen::Ref<Eigen::MatrixXd> jacobian,
+        bool removeAxis,
+        bool updateKin,
+        bool lookForTechnical);
+#endif
+
+#if !defined(BIORBD_USE_CASADI_MATH) && !defined(SWIG)
+    ///
+    /// \brief Fill all the markers in the global reference frame for a series of frames
+    /// \param Q The generalized coordinates (nbQ x nbFrames)
+    /// \param markers The markers stacked vertically (3*nbMarkers x nbFrames) (output)
+    /// \param removeAxis If there are axis to remove from the position variables
+    ///
+    template<typename T>
+    void fillMarkersBatch(
+        const utils::Matrix &Q,
+        Eigen::Ref<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>> markers,
+        bool removeAxis);
+#endif
+
+    ///
+    /// \brief Return the position of a marker in the reference frame of its parent
+    /// \param idx The index of the marker
+    /// \param removeAxis If there are axis to remove from the position variables
+    /// \return The position of the marker in the reference frame of its parent
+    ///
+    RigidBodyDynamics::Math::Vector3d markerInLocal(
+        unsigned int idx,
+        bool removeAxis) const;
+
+    ///
+    /// \brief Return the body id (in RBDL) of the parent of a marker
+    /// \param idx The index of the marker
+    /// \return The body id of the parent of the marker
+    ///
+    /// The ids are resolved when the markers are added, so this lookup does
+    /// not modify the markers shared between the copies of the model.
+    ///
+    unsigned int markerBodyId(
+        unsigned int idx) const;
+
     std::shared_ptr<std::vector<NodeSegment>>
             m_marks; ///< The markers
+    std::shared_ptr<std::vector<unsigned int>>
+            m_marksBodyId; ///< The body id (in RBDL) of the parent of each marker
+    std::shared_ptr<std::vector<RigidBodyDynamics::Math::Vector3d>>
+            m_marksPositionInLocal; ///< The position of each marker in the reference frame of its parent
+    std::shared_ptr<RigidBodyDynamics::Math::MatrixNd>
+            m_motionSubspaceInGlobal; ///< Workspace holding the spatial axes of the DoF when computing the jacobians (own to each copy)
 
 };
 
@@ -1,11 +1,94 @@
 #ifndef BIORBD_RIGIDBODY_ENUMS_H
 #define BIORBD_RIGIDBODY_ENUMS_H
 
-namespace biorbd
+#include "biorbdConfig.h"
+
+namespace BIORBD_NAMESPACE
 {
 namespace rigidbody
 {
 
+///
+/// \brief The available integrators of the forward dynamics
+///
+enum INTEGRATOR_TYPE {
+    RUNGE_KUTTA_4,
+    RUNGE_KUTTA_45,
+    SEMI_IMPLICIT_EULER
+};
+
+///
+/// \brief INTEGRATOR_TYPE_toStr returns the type name in a string format
+/// \param type The type to convert to string
+/// \return The name of the type
+///
+inline const char* INTEGRATOR_TYPE_toStr(INTEGRATOR_TYPE type)
+{
+    switch (type) {
+    case RUNGE_KUTTA_4:
+        return "RungeKutta4";
+    case RUNGE_KUTTA_45:
+        return "RungeKutta45";
+    case SEMI_IMPLICIT_EULER:
+        return "SemiImplicitEuler";
+    default:
+        return "NoType";
+    }
+}
+
+///
+/// \brief The available solvers of the constrained dynamics
+///
+enum CONTACT_SOLVER_TYPE {
+    DIRECT,
+    RANGE_SPACE_SPARSE,
+    NULL_SPACE
+};
+
+///
+/// \brief CONTACT_SOLVER_TYPE_toStr returns the type name in a string format
+/// \param type The type to convert to string
+/// \return The name of the type
+///
+inline const char* CONTACT_SOLVER_TYPE_toStr(CONTACT_SOLVER_TYPE type)
+{
+    switch (type) {
+    case DIRECT:
+        return "Direct";
+    case RANGE_SPACE_SPARSE:
+        return "RangeSpaceSparse";
+    case NULL_SPACE:
+        return "NullSpace";
+    default:
+        return "NoType";
+    }
+}
+
+///
+/// \brief What a stream does with the frames it cannot process in time
+///
+enum STREAM_DROP_POLICY {
+    REJECT_NEW_FRAMES, ///< A frame pushed in a full queue is dropped
+    SKIP_TO_LATEST_FRAME ///< A frame pushed replaces the one still waiting, so only the latest frame is reconstructed
+};
+
+///
+/// \brief STREAM_DROP_POLICY_toStr returns the type name in a string format
+/// \param type The type to convert to string
+/// \return The name of the type
+///
+inline const char* STREAM_DROP_POLICY_toStr(STREAM_DROP_POLICY type)
+{
+    switch (type) {
+    case REJECT_NEW_FRAMES:
+        return "RejectNewFrames";
+    case SKIP_TO_LATEST_FRAME:
+        return "SkipToLatestFrame";
+    default:
+        return "NoType";
+    }
+}
+
 }
 }
 
@@ -318,7 +318,7 @@ protected:
     void determineIfRotIsQuaternion(const utils::String &seqR);
 
     std::shared_ptr<std::vector<RigidBodyDynamics::Joint>>
-            m_dof; ///< Actual DoF: t1, t2, t3, r1, r2, r3; where the order depends on seqT and seqR
+            m_dof; ///< Actual joints (one body each): t1, t2, t3, r1, r2, r3; where the order depends on seqT and seqR (fewer if the DoF are collapsed)
     std::shared_ptr<std::vector<unsigned int>>
                                             m_idxDof;  ///< Index of the parent segment
 
@@ -375,6 +375,15 @@ protected:
     ///
     virtual void setJointAxis();
 
+    ///
+    /// \brief Replace the single DoF joints by multi-DoF joints when possible
+    ///
+    /// The translations in the "xyz" sequence and the rotations in the "xyz",
+    /// "zyx" or "yxz" sequences are each gathered in a single RBDL joint. The
+    /// other sequences are kept as a chain of single DoF joints.
+    ///
+    void collapseJointAxis();
+
     std::shared_ptr<std::vector<unsigned int>>
                                             m_dofPosition;  ///< Position in the x, y, and z sequence
 
@@ -382,7 +391,7 @@ protected:
     /// \brief Set the DoF segment characteristics on the last body
     ///
     /// The idea is that since a segment is described by all of its DoF, the inertia
-    /// and masses must be put on the last body
+    /// and masses must be put on the last body. It must be called once the joints are set.
     ///
     void setDofCharacteristicsOnLastBody();
 
@@ -23,6 +23,8 @@
     #include "RigidBody/KalmanRecons.h"
     #include "RigidBody/KalmanReconsIMU.h"
     #include "RigidBody/KalmanReconsMarkers.h"
+    #include "RigidBody/KalmanReconsMarkersIMU.h"
+    #include "RigidBody/KalmanStream.h"
 #endif
 
 #endif // BIORBD_RIGIDBODY_ALL_H
@@ -32,6 +32,18 @@ public:
         bool cond,
         const String &message);
 
+    ///
+    /// \brief Assert that raises the error message if false
+    /// \param cond The condition to assert
+    /// \param message The error message to display in case of failing
+    ///
+    /// The message is only converted to a String if the assert fails, so
+    /// nothing is allocated when checking in loops
+    ///
+    static void check(
+        bool cond,
+        const char *message);
+
     ///
     /// \brief Non-blocking assert that displays the error message if false
     /// \param cond The condition to assert
@@ -0,0 +1,176 @@
+#ifndef BIORBD_UTILS_RING_BUFFER_H
+#define BIORBD_UTILS_RING_BUFFER_H
+
+#include <atomic>
+#include <vector>
+#include "biorbdConfig.h"
+#include "Utils/Error.h"
+
+namespace BIORBD_NAMESPACE
+{
+namespace utils
+{
+
+///
+/// \brief Bounded lock-free queue between one producer thread and one consumer thread
+///
+/// The slots are allocated once by copying a prototype, so an element whose
+/// assignment does not allocate (e.g. a vector of the same size) can go
+/// through the queue without any allocation. The producer fills the slot
+/// returned by writeSlot and then calls commitWrite, the consumer reads
+/// the slot returned by readSlot and then calls commitRead. Only one thread
+/// may produce and only one thread may consume at a time.
+///
+template<typename T>
+class RingBuffer
+{
+public:
+    ///
+    /// \brief Construct a ring buffer
+    /// \param capacity The maximum number of elements in the queue
+    /// \param prototype The element the slots are initialized with
+    ///
+    RingBuffer(
+        unsigned int capacity,
+        const T& prototype = T()) :
+        m_slots(capacity + 1, prototype),
+        m_head(0),
+        m_tail(0)
+    {
+        utils::Error::check(capacity > 0, "The capacity must be positive");
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    ///
+    /// \brief Return the maximum number of elements in the queue
+    /// \return The maximum number of elements in the queue
+    ///
+    unsigned int capacity() const
+    {
+        return static_cast<unsigned int>(m_slots.size()) - 1;
+    }
+
+    ///
+    /// \brief Return the number of elements in the queue
+    /// \return The number of elements in the queue (exact only when called by the producer or the consumer while the other is idle)
+    ///
+    unsigned int size() const
+    {
+        unsigned int head(m_head.load(std::memory_order_acquire));
+        unsigned int tail(m_tail.load(std::memory_order_acquire));
+        return head >= tail ? head - tail
+               : head + static_cast<unsigned int>(m_slots.size()) - tail;
+    }
+
+    ///
+    /// \brief Return if the queue is empty
+    /// \return If the queue is empty
+    ///
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire)
+               == m_tail.load(std::memory_order_acquire);
+    }
+
+    ///
+    /// \brief Return the slot to fill (producer only)
+    /// \return The slot to fill, nullptr if the queue is full
+    ///
+    T* writeSlot()
+    {
+        unsigned int head(m_head.load(std::memory_order_relaxed));
+        if (next(head) == m_tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &m_slots[head];
+    }
+
+    ///
+    /// \brief Make the slot returned by writeSlot available to the consumer (producer only)
+    ///
+    void commitWrite()
+    {
+        m_head.store(next(m_head.load(std::memory_order_relaxed)),
+                     std::memory_order_release);
+    }
+
+    ///
+    /// \brief Copy an element in the queue (producer only)
+    /// \param value The element to copy
+    /// \return If the element was added, false if the queue is full
+    ///
+    bool push(
+        const T& value)
+    {
+        T* slot(writeSlot());
+        if (!slot) {
+            return false;
+        }
+        *slot = value;
+        commitWrite();
+        return true;
+    }
+
+    ///
+    /// \brief Return the oldest element of the queue (consumer only)
+    /// \return The oldest element, nullptr if the queue is empty
+    ///
+    T* readSlot()
+    {
+        unsigned int tail(m_tail.load(std::memory_order_relaxed));
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &m_slots[tail];
+    }
+
+    ///
+    /// \brief Release the slot returned by readSlot to the producer (consumer only)
+    ///
+    void commitRead()
+    {
+        m_tail.store(next(m_tail.load(std::memory_order_relaxed)),
+                     std::memory_order_release);
+    }
+
+    ///
+    /// \brief Copy the oldest element out of the queue (consumer only)
+    /// \param value The oldest element (output)
+    /// \return If an element was removed, false if the queue is empty
+    ///
+    bool pop(
+        T& value)
+    {
+        T* slot(readSlot());
+        if (!slot) {
+            return false;
+        }
+        value = *slot;
+        commitRead();
+        return true;
+    }
+
+protected:
+    ///
+    /// \brief Return the index of the slot following another one
+    /// \param index The index of the slot
+    /// \return The index of the following slot
+    ///
+    unsigned int next(
+        unsigned int index) const
+    {
+        return index + 1 == m_slots.size() ? 0 : index + 1;
+    }
+
+    std::vector<T> m_slots; ///< The slots, one of them is always left empty to tell a full queue from an empty one
+    std::atomic<unsigned int> m_head; ///< The next slot to write (modified by the producer)
+    char m_padding[64]; ///< Keep the indices on different cache lines so the threads do not invalidate each other
+    std::atomic<unsigned int> m_tail; ///< The next slot to read (modified by the consumer)
+};
+
+}
+}
+
+#endif // BIORBD_UTILS_RING_BUFFER_H
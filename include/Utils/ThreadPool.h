@@ -0,0 +1,117 @@
+#ifndef BIORBD_UTILS_THREAD_POOL_H
+#define BIORBD_UTILS_THREAD_POOL_H
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "biorbdConfig.h"
+
+namespace BIORBD_NAMESPACE
+{
+namespace utils
+{
+
+///
+/// \brief Set of worker threads to dispatch independent tasks on
+///
+/// The tasks are statically split in contiguous chunks (one per thread),
+/// the calling thread taking care of the first chunk. A given task is
+/// therefore always computed by the same worker for a given number of
+/// threads. The threads are only spawned the first time they are needed
+/// and are kept alive until the pool is destroyed or resized.
+///
+class BIORBD_API ThreadPool
+{
+public:
+    ///
+    /// \brief Construct a thread pool
+    /// \param nbThreads The number of threads (including the calling thread), 0 uses all the cores available
+    ///
+    ThreadPool(
+        unsigned int nbThreads = 0);
+
+    ///
+    /// \brief Destroy the thread pool, joining all the worker threads
+    ///
+    virtual ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ///
+    /// \brief Set the number of threads
+    /// \param nbThreads The number of threads (including the calling thread), 0 uses all the cores available
+    ///
+    void setNbThreads(
+        unsigned int nbThreads);
+
+    ///
+    /// \brief Return the number of threads
+    /// \return The number of threads (including the calling thread)
+    ///
+    unsigned int nbThreads() const;
+
+    ///
+    /// \brief Run a set of tasks and wait until they are all done
+    /// \param nbTasks The number of tasks
+    /// \param task The function to call for each task, receiving the index of the task and the index of the worker [0, nbThreads[ computing it
+    ///
+    /// If a task throws, the remaining tasks of its chunk are skipped and
+    /// the first exception is rethrown in the calling thread once all the
+    /// workers are done. Concurrent calls are serialized. A call made from
+    /// a task (of this pool or of another one) runs all its tasks serially
+    /// in the calling thread, with the worker index 0, instead of waiting
+    /// for the busy workers.
+    ///
+    void run(
+        unsigned int nbTasks,
+        const std::function<void(unsigned int task, unsigned int worker)>& task);
+
+protected:
+    ///
+    /// \brief Spawn the worker threads
+    ///
+    void startWorkers();
+
+    ///
+    /// \brief Ask the worker threads to terminate and join them
+    ///
+    void stopWorkers();
+
+    ///
+    /// \brief Main loop of a worker thread
+    /// \param worker The index of the worker
+    /// \param generation The index of the last run when the worker was spawned
+    ///
+    void workerLoop(
+        unsigned int worker,
+        unsigned long generation);
+
+    ///
+    /// \brief Compute the chunk of the current tasks associated to a worker
+    /// \param worker The index of the worker
+    ///
+    void runChunk(
+        unsigned int worker);
+
+    unsigned int m_nbThreads; ///< The number of threads (including the calling thread)
+    std::vector<std::thread> m_workers; ///< The spawned worker threads
+    std::mutex m_runMutex; ///< Serialize the calls to run
+    std::mutex m_mutex; ///< Protect the state shared with the workers
+    std::condition_variable m_wakeUp; ///< Signal the workers that tasks are available
+    std::condition_variable m_done; ///< Signal the calling thread that the workers are done
+    unsigned long m_generation; ///< Index of the current run
+    unsigned int m_nbPending; ///< Number of workers still running their chunk
+    bool m_stop; ///< If the workers should terminate
+    const std::function<void(unsigned int, unsigned int)>* m_task; ///< The task of the current run
+    unsigned int m_nbTasks; ///< The number of tasks of the current run
+    std::exception_ptr m_error; ///< The first exception thrown by a task
+};
+
+}
+}
+
+#endif // BIORBD_UTILS_THREAD_POOL_H
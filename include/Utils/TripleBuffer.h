@@ -0,0 +1,102 @@
+#ifndef BIORBD_UTILS_TRIPLE_BUFFER_H
+#define BIORBD_UTILS_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <vector>
+#include "biorbdConfig.h"
+
+namespace BIORBD_NAMESPACE
+{
+namespace utils
+{
+
+///
+/// \brief Lock-free exchange of the latest value between one producer thread and one consumer thread
+///
+/// The producer and the consumer each own a slot and swap it with a third
+/// one, so a write never waits for the reader and never overwrites the slot
+/// being read. A value that is not read before the next commitWrite is
+/// replaced by the newer one. The slots are allocated once by copying a
+/// prototype, so an element whose assignment does not allocate can go
+/// through the buffer without any allocation.
+///
+template<typename T>
+class TripleBuffer
+{
+public:
+    ///
+    /// \brief Construct a triple buffer
+    /// \param prototype The element the slots are initialized with
+    ///
+    TripleBuffer(
+        const T& prototype = T()) :
+        m_slots(3, prototype),
+        m_write(0),
+        m_middle(1),
+        m_read(2)
+    {
+
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    ///
+    /// \brief Return the slot to fill (producer only)
+    /// \return The slot to fill
+    ///
+    T* writeSlot()
+    {
+        return &m_slots[m_write];
+    }
+
+    ///
+    /// \brief Make the slot returned by writeSlot the latest value (producer only)
+    /// \return If a value that was not read yet was replaced
+    ///
+    bool commitWrite()
+    {
+        unsigned int previous(m_middle.exchange(m_write | m_isNew,
+                                                std::memory_order_acq_rel));
+        m_write = previous & ~m_isNew;
+        return (previous & m_isNew) != 0;
+    }
+
+    ///
+    /// \brief Return if a value was written since the last readSlot (exact only from the consumer thread)
+    /// \return If a new value is available
+    ///
+    bool hasNew() const
+    {
+        return (m_middle.load(std::memory_order_acquire) & m_isNew) != 0;
+    }
+
+    ///
+    /// \brief Take the latest value (consumer only)
+    /// \return The latest value, which stays valid until the next call, nullptr if no new value was written
+    ///
+    T* readSlot()
+    {
+        if (!hasNew()) {
+            return nullptr;
+        }
+        unsigned int previous(m_middle.exchange(m_read, std::memory_order_acq_rel));
+        m_read = previous & ~m_isNew;
+        return &m_slots[m_read];
+    }
+
+protected:
+    static const unsigned int m_isNew = 4; ///< Flag of the middle index telling it holds a value that was not read
+
+    std::vector<T> m_slots; ///< The slots
+    unsigned int m_write; ///< The slot owned by the producer
+    char m_padding[64]; ///< Keep the indices of the threads on different cache lines
+    std::atomic<unsigned int> m_middle; ///< The slot exchanged between the threads, with the m_isNew flag
+    char m_padding2[64]; ///< Keep the indices of the threads on different cache lines
+    unsigned int m_read; ///< The slot owned by the consumer
+};
+
+}
+}
+
+#endif // BIORBD_UTILS_TRIPLE_BUFFER_H
@@ -12,11 +12,13 @@
 #include "Utils/Path.h"
 #include "Utils/Quaternion.h"
 #include "Utils/Range.h"
+#include "Utils/RingBuffer.h"
 #include "Utils/Rotation.h"
 #include "Utils/RotoTrans.h"
 #include "Utils/RotoTransNode.h"
 #include "Utils/SpatialVector.h"
 #include "Utils/String.h"
+#include "Utils/ThreadPool.h"
 #include "Utils/Timer.h"
 #include "Utils/UtilsEnum.h"
 #include "Utils/Vector.h"
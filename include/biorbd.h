@@ -7,6 +7,12 @@
 #include "BiorbdModel.h"
 #include "ModelReader.h"
 #include "ModelWriter.h"
+#include "ModelDescription.h"
+#include "ModelCodeGenerator.h"
+#include "ModelTemplatedKinematics.h"
+#include "ModelFunctionCache.h"
+#include "ModelWorkspace.h"
+#include "ForwardSimulation.h"
 
 #include "Utils/all.h"
 #include "RigidBody/all.h"
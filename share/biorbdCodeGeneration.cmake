@@ -0,0 +1,20 @@
+# biorbd_add_generated_model(<target> <folder> <name>)
+#
+# Build the code written by CodeGenerator::generateModel into a shared library.
+# <folder> and <name> are the folder and the filename (without extension) that
+# were given to generateModel. The generated header and Eigen are made available
+# to the targets linking to <target>.
+function(biorbd_add_generated_model TARGET FOLDER NAME)
+    if (NOT EIGEN3_INCLUDE_DIR)
+        find_package(Eigen3 REQUIRED)
+    endif()
+
+    add_library(${TARGET} SHARED "${FOLDER}/${NAME}.cpp")
+    string(TOUPPER "${NAME}" API_NAME)
+    target_compile_definitions(${TARGET} PRIVATE "${API_NAME}_EXPORTS")
+    target_include_directories(${TARGET} PUBLIC
+        "${FOLDER}"
+        "${EIGEN3_INCLUDE_DIR}"
+    )
+    set_target_properties(${TARGET} PROPERTIES POSITION_INDEPENDENT_CODE ON)
+endfunction()
@@ -21,10 +21,12 @@ Model::Model() :
 
 }
 
-Model::Model(const utils::Path &path) :
+Model::Model(
+    const utils::Path &path,
+    bool collapseDofs) :
     m_path(std::make_shared<utils::Path>(path))
 {
-
+    setCollapseDofs(collapseDofs);
     Reader::readModelFile(*m_path, this);
 }
 
@@ -0,0 +1,453 @@
+#define BIORBD_API_EXPORTS
+#include "ForwardSimulation.h"
+
+#ifndef BIORBD_USE_CASADI_MATH
+#include <cmath>
+#include <algorithm>
+#include <rbdl/Dynamics.h>
+#include "Utils/Error.h"
+#include "Utils/Matrix.h"
+#include "Utils/Quaternion.h"
+#include "Utils/ThreadPool.h"
+#include "RigidBody/Segment.h"
+#include "RigidBody/GeneralizedCoordinates.h"
+#include "RigidBody/GeneralizedVelocity.h"
+#include "RigidBody/GeneralizedAcceleration.h"
+#include "RigidBody/GeneralizedTorque.h"
+#ifdef MODULE_MUSCLES
+    #include "Muscles/State.h"
+#endif
+
+using namespace BIORBD_NAMESPACE;
+
+ForwardSimulation::ForwardSimulation(
+    const Model& model,
+    rigidbody::INTEGRATOR_TYPE type) :
+    m_workspaces(std::make_shared<std::vector<ModelWorkspace>>()),
+    m_threadPool(std::make_shared<utils::ThreadPool>()),
+    m_type(std::make_shared<rigidbody::INTEGRATOR_TYPE>(type)),
+    m_nbSubSteps(std::make_shared<unsigned int>(1)),
+    m_absoluteTolerance(std::make_shared<double>(1e-8)),
+    m_relativeTolerance(std::make_shared<double>(1e-6)),
+    m_quaternionIdx(std::make_shared<std::vector<unsigned int>>()),
+    m_quaternionWIdx(std::make_shared<std::vector<unsigned int>>())
+{
+    m_workspaces->push_back(ModelWorkspace(model));
+
+    // The imaginary parts of the quaternions are stored with the other DoF
+    // while the real parts are appended at the end of Q
+    unsigned int cmpDof(0);
+    for (unsigned int i=0; i<model.nbSegment(); ++i) {
+        const rigidbody::Segment& segment(model.segment(i));
+        if (segment.isRotationAQuaternion()) {
+            m_quaternionIdx->push_back(cmpDof + segment.nbDofTrans());
+            m_quaternionWIdx->push_back(
+                model.nbQdot() + static_cast<unsigned int>(m_quaternionWIdx->size()));
+        }
+        cmpDof += segment.nbDof();
+    }
+}
+
+void ForwardSimulation::setIntegrator(
+    rigidbody::INTEGRATOR_TYPE type)
+{
+    *m_type = type;
+}
+
+rigidbody::INTEGRATOR_TYPE ForwardSimulation::integrator() const
+{
+    return *m_type;
+}
+
+void ForwardSimulation::setNbSubSteps(
+    unsigned int nbSubSteps)
+{
+    utils::Error::check(nbSubSteps > 0, "The number of sub steps must be positive");
+    *m_nbSubSteps = nbSubSteps;
+}
+
+unsigned int ForwardSimulation::nbSubSteps() const
+{
+    return *m_nbSubSteps;
+}
+
+void ForwardSimulation::setTolerances(
+    double absoluteTolerance,
+    double relativeTolerance)
+{
+    utils::Error::check(absoluteTolerance > 0 && relativeTolerance >= 0,
+                        "The absolute tolerance must be positive and the relative tolerance must not be negative");
+    *m_absoluteTolerance = absoluteTolerance;
+    *m_relativeTolerance = relativeTolerance;
+}
+
+double ForwardSimulation::absoluteTolerance() const
+{
+    return *m_absoluteTolerance;
+}
+
+double ForwardSimulation::relativeTolerance() const
+{
+    return *m_relativeTolerance;
+}
+
+void ForwardSimulation::setNbThreads(
+    unsigned int nbThreads)
+{
+    m_threadPool->setNbThreads(nbThreads);
+}
+
+unsigned int ForwardSimulation::nbThreads() const
+{
+    return m_threadPool->nbThreads();
+}
+
+void ForwardSimulation::integrate(
+    const rigidbody::GeneralizedCoordinates& Q0,
+    const rigidbody::GeneralizedVelocity& Qdot0,
+    const utils::Matrix& Tau,
+    double dt,
+    utils::Matrix& Q,
+    utils::Matrix& Qdot)
+{
+    utils::Matrix noMuscles(0, 1);
+    utils::Matrix noExcitations(0, static_cast<unsigned int>(Tau.cols()));
+    utils::Matrix noActivations(0, static_cast<unsigned int>(Q.cols()));
+    checkDimensions(Q0, Qdot0, noMuscles, noExcitations, Tau, Q, Qdot, noActivations, 0);
+
+    Q.col(0) = Q0;
+    Qdot.col(0) = Qdot0;
+    integrateRun((*m_workspaces)[0], noExcitations, Tau, dt, Q, Qdot, noActivations);
+}
+
+void ForwardSimulation::integrateEnsemble(
+    const utils::Matrix& Q0,
+    const utils::Matrix& Qdot0,
+    const utils::Matrix& Tau,
+    double dt,
+    utils::Matrix& Q,
+    utils::Matrix& Qdot)
+{
+    utils::Matrix noMuscles(0, static_cast<unsigned int>(Q0.cols()));
+    utils::Matrix noExcitations(0, static_cast<unsigned int>(Tau.cols()));
+    utils::Matrix noActivations(0, static_cast<unsigned int>(Q.cols()));
+    runEnsemble(Q0, Qdot0, noMuscles, noExcitations, Tau, dt, Q, Qdot, noActivations, 0);
+}
+
+#ifdef MODULE_MUSCLES
+void ForwardSimulation::integrate(
+    const rigidbody::GeneralizedCoordinates& Q0,
+    const rigidbody::GeneralizedVelocity& Qdot0,
+    const utils::Vector& activations0,
+    const utils::Matrix& excitations,
+    const utils::Matrix& Tau,
+    double dt,
+    utils::Matrix& Q,
+    utils::Matrix& Qdot,
+    utils::Matrix& activations)
+{
+    unsigned int nbMuscles((*m_workspaces)[0].nbMuscles());
+    checkDimensions(Q0, Qdot0, activations0, excitations, Tau, Q, Qdot, activations,
+                    nbMuscles);
+
+    Q.col(0) = Q0;
+    Qdot.col(0) = Qdot0;
+    activations.col(0) = activations0;
+    integrateRun((*m_workspaces)[0], excitations, Tau, dt, Q, Qdot, activations);
+}
+
+void ForwardSimulation::integrateEnsemble(
+    const utils::Matrix& Q0,
+    const utils::Matrix& Qdot0,
+    const utils::Matrix& activations0,
+    const utils::Matrix& excitations,
+    const utils::Matrix& Tau,
+    double dt,
+    utils::Matrix& Q,
+    utils::Matrix& Qdot,
+    utils::Matrix& activations)
+{
+    runEnsemble(Q0, Qdot0, activations0, excitations, Tau, dt, Q, Qdot, activations,
+                (*m_workspaces)[0].nbMuscles());
+}
+#endif
+
+unsigned int ForwardSimulation::checkDimensions(
+    const Eigen::Ref<const Eigen::MatrixXd>& Q0,
+    const Eigen::Ref<const Eigen::MatrixXd>& Qdot0,
+    const Eigen::Ref<const Eigen::MatrixXd>& activations0,
+    const Eigen::Ref<const Eigen::MatrixXd>& excitations,
+    const Eigen::Ref<const Eigen::MatrixXd>& Tau,
+    const Eigen::Ref<const Eigen::MatrixXd>& Q,
+    const Eigen::Ref<const Eigen::MatrixXd>& Qdot,
+    const Eigen::Ref<const Eigen::MatrixXd>& activations,
+    unsigned int nbMuscles) const
+{
+    const ModelWorkspace& model((*m_workspaces)[0]);
+    utils::Error::check(
+        Q0.rows() == model.nbQ() && Qdot0.rows() == model.nbQdot()
+        && activations0.rows() == nbMuscles,
+        "The initial states must respectively have nbQ, nbQdot and nbMuscles rows");
+    utils::Error::check(
+        Tau.rows() == model.nbGeneralizedTorque() && excitations.rows() == nbMuscles,
+        "Tau and the excitations must respectively have nbGeneralizedTorque and nbMuscles rows");
+    utils::Error::check(
+        Q.rows() == model.nbQ() && Qdot.rows() == model.nbQdot()
+        && activations.rows() == nbMuscles,
+        "Q, Qdot and the activations must respectively have nbQ, nbQdot and nbMuscles rows");
+
+    Eigen::Index nbRuns(Q0.cols());
+    utils::Error::check(
+        nbRuns > 0 && Qdot0.cols() == nbRuns && activations0.cols() == nbRuns,
+        "The initial states must have the same number of runs");
+    utils::Error::check(
+        Tau.cols() % nbRuns == 0 && excitations.cols() == Tau.cols(),
+        "Tau and the excitations must have the same number of intervals for each run");
+    Eigen::Index nbIntervals(Tau.cols() / nbRuns);
+    utils::Error::check(
+        Q.cols() == (nbIntervals + 1) * nbRuns && Qdot.cols() == Q.cols()
+        && activations.cols() == Q.cols(),
+        "Q, Qdot and the activations must have one more node than intervals for each run");
+    return static_cast<unsigned int>(nbIntervals);
+}
+
+void ForwardSimulation::runEnsemble(
+    const Eigen::Ref<const Eigen::MatrixXd>& Q0,
+    const Eigen::Ref<const Eigen::MatrixXd>& Qdot0,
+    const Eigen::Ref<const Eigen::MatrixXd>& activations0,
+    const Eigen::Ref<const Eigen::MatrixXd>& excitations,
+    const Eigen::Ref<const Eigen::MatrixXd>& Tau,
+    double dt,
+    Eigen::Ref<Eigen::MatrixXd> Q,
+    Eigen::Ref<Eigen::MatrixXd> Qdot,
+    Eigen::Ref<Eigen::MatrixXd> activations,
+    unsigned int nbMuscles)
+{
+    unsigned int nbIntervals(checkDimensions(
+                                 Q0, Qdot0, activations0, excitations, Tau,
+                                 Q, Qdot, activations, nbMuscles));
+
+    // Each worker gets its own workspace (kinematics and muscles) of the model
+    while (m_workspaces->size() < m_threadPool->nbThreads()) {
+        m_workspaces->push_back(ModelWorkspace(m_workspaces->front()));
+    }
+    m_threadPool->run(static_cast<unsigned int>(Q0.cols()),
+    [&](unsigned int run, unsigned int worker) {
+        Eigen::Index firstNode(run * (nbIntervals + 1));
+        Q.col(firstNode) = Q0.col(run);
+        Qdot.col(firstNode) = Qdot0.col(run);
+        activations.col(firstNode) = activations0.col(run);
+        integrateRun((*m_workspaces)[worker],
+                     excitations.middleCols(run * nbIntervals, nbIntervals),
+                     Tau.middleCols(run * nbIntervals, nbIntervals), dt,
+                     Q.middleCols(firstNode, nbIntervals + 1),
+                     Qdot.middleCols(firstNode, nbIntervals + 1),
+                     activations.middleCols(firstNode, nbIntervals + 1));
+    });
+}
+
+void ForwardSimulation::integrateRun(
+    ModelWorkspace& model,
+    const Eigen::Ref<const Eigen::MatrixXd>& excitations,
+    const Eigen::Ref<const Eigen::MatrixXd>& Tau,
+    double dt,
+    Eigen::Ref<Eigen::MatrixXd> Q,
+    Eigen::Ref<Eigen::MatrixXd> Qdot,
+    Eigen::Ref<Eigen::MatrixXd> activations) const
+{
+    // Dormand-Prince 5(4) coefficients, the last stage being the solution
+    static const double a[7][6] = {
+        {0, 0, 0, 0, 0, 0},
+        {1.0/5, 0, 0, 0, 0, 0},
+        {3.0/40, 9.0/40, 0, 0, 0, 0},
+        {44.0/45, -56.0/15, 32.0/9, 0, 0, 0},
+        {19372.0/6561, -25360.0/2187, 64448.0/6561, -212.0/729, 0, 0},
+        {9017.0/3168, -355.0/33, 46732.0/5247, 49.0/176, -5103.0/18656, 0},
+        {35.0/384, 0, 500.0/1113, 125.0/192, -2187.0/6784, 11.0/84}
+    };
+    static const double e[7] = {
+        71.0/57600, 0, -71.0/16695, 71.0/1920, -17253.0/339200, 22.0/525, -1.0/40
+    };
+
+    utils::Error::check(dt > 0, "The duration of an interval must be positive");
+    unsigned int nbQ(model.nbQ());
+    unsigned int nbQdot(model.nbQdot());
+    unsigned int nbActivations(static_cast<unsigned int>(activations.rows()));
+    unsigned int nbIntervals(static_cast<unsigned int>(Tau.cols()));
+    Eigen::Index nbStates(nbQ + nbQdot + nbActivations);
+    Eigen::Index nbDerivatives(2 * nbQdot + nbActivations);
+
+    rigidbody::GeneralizedCoordinates q(model);
+    rigidbody::GeneralizedVelocity qdot(model);
+    rigidbody::GeneralizedTorque tau(model);
+    rigidbody::GeneralizedAcceleration qddot(model);
+#ifdef MODULE_MUSCLES
+    std::vector<std::shared_ptr<muscles::State>> states;
+    if (nbActivations) {
+        states = model.stateSet();
+    }
+#endif
+    auto dynamics = [&](const Eigen::Ref<const Eigen::VectorXd>& x,
+                        unsigned int interval,
+    Eigen::Ref<Eigen::VectorXd> dx) {
+        q = x.head(nbQ);
+        qdot = x.segment(nbQ, nbQdot);
+        tau = Tau.col(interval);
+#ifdef MODULE_MUSCLES
+        if (nbActivations) {
+            for (unsigned int i = 0; i < nbActivations; ++i) {
+                states[i]->setExcitation(excitations(i, interval), true);
+                states[i]->setActivation(x(nbQ + nbQdot + i), true);
+            }
+            tau += model.muscularJointTorque(states, q, qdot);
+            dx.tail(nbActivations) = model.activationDot(states);
+        }
+#endif
+        RigidBodyDynamics::ForwardDynamics(model, q, qdot, tau, qddot);
+        model.invalidateKinematicsCache();
+        dx.head(nbQdot) = qdot;
+        dx.segment(nbQdot, nbQdot) = qddot;
+    };
+
+    Eigen::VectorXd x(nbStates);
+    Eigen::VectorXd xStage(nbStates);
+    Eigen::VectorXd dx(nbDerivatives);
+    Eigen::VectorXd firstStage(nbDerivatives);
+    Eigen::VectorXd lastStage(nbDerivatives);
+    Eigen::MatrixXd k(nbDerivatives, 7);
+    double h(dt / *m_nbSubSteps);
+    double hAdaptive(dt);
+
+    x.head(nbQ) = Q.col(0);
+    x.segment(nbQ, nbQdot) = Qdot.col(0);
+    x.tail(nbActivations) = activations.col(0);
+    for (unsigned int interval = 0; interval < nbIntervals; ++interval) {
+        if (*m_type == rigidbody::SEMI_IMPLICIT_EULER) {
+            for (unsigned int s = 0; s < *m_nbSubSteps; ++s) {
+                // The positions are moved with the updated velocities
+                dynamics(x, interval, k.col(0));
+                k.col(0).head(nbQdot) = x.segment(nbQ, nbQdot)
+                                        + h * k.col(0).segment(nbQdot, nbQdot);
+                increment(x, k.col(0), h, xStage);
+                x.swap(xStage);
+            }
+        } else if (*m_type == rigidbody::RUNGE_KUTTA_4) {
+            for (unsigned int s = 0; s < *m_nbSubSteps; ++s) {
+                dynamics(x, interval, k.col(0));
+                for (unsigned int j = 1; j < 4; ++j) {
+                    double hStage(j < 3 ? h / 2.0 : h);
+                    increment(x, k.col(j - 1), hStage, xStage);
+                    dynamics(xStage, interval, k.col(j));
+                    correctAngularVelocities(k.col(j - 1), hStage, k.col(j));
+                }
+                dx = (k.col(0) + 2.0 * k.col(1) + 2.0 * k.col(2) + k.col(3)) / 6.0;
+                increment(x, dx, h, xStage);
+                x.swap(xStage);
+            }
+        } else if (*m_type == rigidbody::RUNGE_KUTTA_45) {
+            // The controls change at each interval, so the first stage cannot
+            // be taken from the last stage of the previous interval
+            double t(0);
+            dynamics(x, interval, firstStage);
+            while (t < dt) {
+                bool isLast(hAdaptive >= dt - t);
+                double hStep(isLast ? dt - t : hAdaptive);
+                k.col(0) = firstStage;
+                for (unsigned int j = 1; j < 7; ++j) {
+                    dx.setZero();
+                    for (unsigned int l = 0; l < j; ++l) {
+                        dx += a[j][l] * k.col(l);
+                    }
+                    increment(x, dx, hStep, xStage);
+                    dynamics(xStage, interval, k.col(j));
+                    if (j == 6) {
+                        lastStage = k.col(6);
+                    }
+                    correctAngularVelocities(dx, hStep, k.col(j));
+                }
+
+                // Root mean square of the error relative to the tolerances
+                dx.setZero();
+                for (unsigned int l = 0; l < 7; ++l) {
+                    dx += e[l] * k.col(l);
+                }
+                double error(0);
+                for (Eigen::Index i = 0; i < nbDerivatives; ++i) {
+                    Eigen::Index idx(i < nbQdot ? i : i + nbQ - nbQdot);
+                    double scale(*m_absoluteTolerance + *m_relativeTolerance
+                                 * std::max(std::fabs(x(idx)), std::fabs(xStage(idx))));
+                    error += (hStep * dx(i) / scale) * (hStep * dx(i) / scale);
+                }
+                error = std::sqrt(error / static_cast<double>(nbDerivatives));
+
+                double hNext(hStep * (error == 0 ? 5 : std::min(5.0, std::max(0.2,
+                                      0.9 * std::pow(error, -0.2)))));
+                if (error <= 1) {
+                    // The last stage is evaluated at the accepted state
+                    t = isLast ? dt : t + hStep;
+                    x.swap(xStage);
+                    firstStage.swap(lastStage);
+                    hAdaptive = isLast ? std::max(hAdaptive, hNext) : hNext;
+                } else {
+                    hAdaptive = hNext;
+                    utils::Error::check(hAdaptive > dt * 1e-12,
+                                        "The step of the adaptive integrator became too small");
+                }
+            }
+        } else {
+            utils::Error::raise("Unknown integrator");
+        }
+
+        x.tail(nbActivations) = x.tail(nbActivations).cwiseMax(0).cwiseMin(1);
+        Q.col(interval + 1) = x.head(nbQ);
+        Qdot.col(interval + 1) = x.segment(nbQ, nbQdot);
+        activations.col(interval + 1) = x.tail(nbActivations);
+    }
+}
+
+void ForwardSimulation::increment(
+    const Eigen::Ref<const Eigen::VectorXd>& x,
+    const Eigen::Ref<const Eigen::VectorXd>& dx,
+    double h,
+    Eigen::Ref<Eigen::VectorXd> xOut) const
+{
+    const ModelWorkspace& model(m_workspaces->front());
+    unsigned int nbQ(model.nbQ());
+    unsigned int nbQdot(model.nbQdot());
+
+    xOut.head(nbQdot) = x.head(nbQdot) + h * dx.head(nbQdot);
+    xOut.segment(nbQdot, nbQ - nbQdot) = x.segment(nbQdot, nbQ - nbQdot);
+    xOut.tail(x.size() - nbQ) = x.tail(x.size() - nbQ) + h * dx.tail(dx.size() - nbQdot);
+
+    // The angular velocity of a quaternion is expressed in its local frame
+    for (size_t i = 0; i < m_quaternionIdx->size(); ++i) {
+        unsigned int idx((*m_quaternionIdx)[i]);
+        unsigned int idxW((*m_quaternionWIdx)[i]);
+        utils::Vector3d rotationVector(h * dx.segment<3>(idx));
+        utils::Quaternion quat(x(idxW), x(idx), x(idx + 1), x(idx + 2));
+        utils::Scalar angle(rotationVector.norm());
+        if (angle > 0) {
+            quat = quat * utils::Quaternion::fromAxisAngle(angle, rotationVector);
+        }
+        quat.normalize();
+        xOut(idxW) = quat[0];
+        xOut.segment<3>(idx) = quat.block(1, 0, 3, 1);
+    }
+}
+
+void ForwardSimulation::correctAngularVelocities(
+    const Eigen::Ref<const Eigen::VectorXd>& dx,
+    double h,
+    Eigen::Ref<Eigen::VectorXd> stage) const
+{
+    // Inverse of the differential of the exponential map, truncated after
+    // the terms needed by the fourth order methods
+    for (size_t i = 0; i < m_quaternionIdx->size(); ++i) {
+        unsigned int idx((*m_quaternionIdx)[i]);
+        utils::Vector3d rotationVector(h * dx.segment<3>(idx));
+        utils::Vector3d omega(stage.segment<3>(idx));
+        stage.segment<3>(idx) = omega + rotationVector.cross(omega) / 2.0
+                                + rotationVector.cross(rotationVector.cross(omega)) / 12.0;
+    }
+}
+#endif
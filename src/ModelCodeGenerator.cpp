@@ -0,0 +1,834 @@
+#define BIORBD_API_EXPORTS
+#include "ModelCodeGenerator.h"
+
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BiorbdModel.h"
+#include "ModelDescription.h"
+#include "Utils/Error.h"
+#include "Utils/String.h"
+#include "Utils/Path.h"
+
+using namespace BIORBD_NAMESPACE;
+
+#ifndef BIORBD_USE_CASADI_MATH
+namespace
+{
+enum GeneratedJoint {
+    FIXED,
+    REVOLUTE,
+    PRISMATIC
+};
+
+// One body per DoF, or a fixed one for a segment without DoF
+struct GeneratedBody {
+    int parent; // -1 for the root
+    GeneratedJoint joint;
+    unsigned int axis;
+    unsigned int q;
+    double rotation[3][3]; // constant orientation in the parent (v_parent = R * v_body)
+    double translation[3]; // constant origin in the parent
+    bool hasMass;
+    double inertia[6][6]; // spatial inertia at the origin of the body
+};
+
+struct GeneratedPoint {
+    unsigned int body;
+    double position[3];
+};
+
+struct GeneratedMuscle {
+    std::vector<GeneratedPoint> points;
+    double tendonSlackLength;
+    double cosPennation;
+};
+
+struct GeneratedModel {
+    std::string name;
+    unsigned int nbQ;
+    double gravity[3];
+    std::vector<GeneratedBody> bodies;
+    std::vector<unsigned int> segments; // last body of each segment
+    std::vector<GeneratedPoint> markers;
+    std::vector<GeneratedMuscle> muscles;
+};
+
+std::string literal(double value)
+{
+    std::ostringstream os;
+    os << std::setprecision(17) << value;
+    std::string s(os.str());
+    if (s.find_first_of(".en") == std::string::npos) {
+        s += ".0";
+    }
+    return s;
+}
+
+// Sum of coefficient * symbol, an empty symbol being a constant
+std::string linear(
+    const std::vector<std::pair<double, std::string>>& terms)
+{
+    std::string out;
+    for (const auto& term : terms) {
+        if (term.first == 0.0) {
+            continue;
+        }
+        double coef(term.first);
+        if (out.empty()) {
+            if (coef < 0) {
+                out += "-";
+            }
+        } else {
+            out += coef < 0 ? " - " : " + ";
+        }
+        coef = std::fabs(coef);
+        if (term.second.empty()) {
+            out += literal(coef);
+        } else if (coef == 1.0) {
+            out += term.second;
+        } else {
+            out += literal(coef) + "*" + term.second;
+        }
+    }
+    return out.empty() ? "0.0" : out;
+}
+
+bool isIdentity(const GeneratedBody& body)
+{
+    for (unsigned int i=0; i<3; ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            if (body.rotation[i][j] != (i == j ? 1.0 : 0.0)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Index of the DoF in a spatial vector (angular part first)
+unsigned int spatialIdx(const GeneratedBody& body)
+{
+    return body.joint == REVOLUTE ? body.axis : 3 + body.axis;
+}
+
+std::string parentOf(
+    const GeneratedBody& body,
+    const std::string& array,
+    const std::string& root)
+{
+    return body.parent < 0 ? root : array + "[" + std::to_string(
+               body.parent) + "]";
+}
+
+std::vector<unsigned int> ancestorsWithDof(
+    const GeneratedModel& model,
+    unsigned int body)
+{
+    std::vector<unsigned int> out;
+    for (int i = static_cast<int>(body); i >= 0; i = model.bodies[i].parent) {
+        if (model.bodies[i].joint != FIXED) {
+            out.push_back(static_cast<unsigned int>(i));
+        }
+    }
+    return out;
+}
+
+void writeHeader(
+    std::ostream& os,
+    const GeneratedModel& model)
+{
+    std::string api(model.name);
+    for (auto& c : api) {
+        c = static_cast<char>(std::toupper(c));
+    }
+
+    os << "// Generated by biorbd, do not edit" << std::endl;
+    os << "#ifndef " << api << "_GENERATED_H" << std::endl;
+    os << "#define " << api << "_GENERATED_H" << std::endl;
+    os << std::endl;
+    os << "#include <Eigen/Dense>" << std::endl;
+    os << std::endl;
+    os << "#ifdef _WIN32" << std::endl;
+    os << "#  ifdef " << api << "_EXPORTS" << std::endl;
+    os << "#    define " << api << "_API __declspec(dllexport)" << std::endl;
+    os << "#  else" << std::endl;
+    os << "#    define " << api << "_API __declspec(dllimport)" << std::endl;
+    os << "#  endif" << std::endl;
+    os << "#else" << std::endl;
+    os << "#  define " << api << "_API" << std::endl;
+    os << "#endif" << std::endl;
+    os << std::endl;
+    os << "namespace " << model.name << std::endl;
+    os << "{" << std::endl;
+    os << "const unsigned int nbQ = " << model.nbQ << ";" << std::endl;
+    os << "const unsigned int nbSegments = " << model.segments.size() << ";" <<
+       std::endl;
+    os << "const unsigned int nbMarkers = " << model.markers.size() << ";" <<
+       std::endl;
+    os << "const unsigned int nbMuscles = " << model.muscles.size() << ";" <<
+       std::endl;
+    os << std::endl;
+    os << "typedef Eigen::Matrix<double, nbQ, 1> VectorQ;" << std::endl;
+    os << std::endl;
+    os << "// Homogeneous matrices of the segments in the global reference frame, side by side"
+       << std::endl;
+    os << api << "_API void globalJCS(" << std::endl;
+    os << "    const VectorQ& Q," << std::endl;
+    os << "    Eigen::Matrix<double, 4, 4*nbSegments>& jcs);" << std::endl;
+    os << std::endl;
+    if (model.markers.size()) {
+        os << "// Markers in the global reference frame, one per column" << std::endl;
+        os << api << "_API void markers(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, 3, nbMarkers>& markers);" << std::endl;
+        os << std::endl;
+        os << "// Jacobians of the markers stacked vertically" << std::endl;
+        os << api << "_API void markersJacobian(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, 3*nbMarkers, nbQ>& jacobian);" << std::endl;
+        os << std::endl;
+    }
+    os << "// Recursive Newton-Euler algorithm" << std::endl;
+    os << api << "_API void inverseDynamics(" << std::endl;
+    os << "    const VectorQ& Q," << std::endl;
+    os << "    const VectorQ& Qdot," << std::endl;
+    os << "    const VectorQ& Qddot," << std::endl;
+    os << "    VectorQ& Tau);" << std::endl;
+    os << std::endl;
+    os << "// Articulated body algorithm" << std::endl;
+    os << api << "_API void forwardDynamics(" << std::endl;
+    os << "    const VectorQ& Q," << std::endl;
+    os << "    const VectorQ& Qdot," << std::endl;
+    os << "    const VectorQ& Tau," << std::endl;
+    os << "    VectorQ& Qddot);" << std::endl;
+    if (model.muscles.size()) {
+        os << std::endl;
+        os << "// Length from origin to insertion of the muscles" << std::endl;
+        os << api << "_API void musculoTendonLength(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, nbMuscles, 1>& length);" << std::endl;
+        os << std::endl;
+        os << "// Length of the muscles without the tendon and the pennation" << std::endl;
+        os << api << "_API void musclesLength(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, nbMuscles, 1>& length);" << std::endl;
+        os << std::endl;
+        os << "// Jacobian of the musculo-tendon lengths (the moment arms are minus this jacobian)"
+           << std::endl;
+        os << api << "_API void musclesLengthJacobian(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, nbMuscles, nbQ>& jacobian);" << std::endl;
+    }
+    os << "}" << std::endl;
+    os << std::endl;
+    os << "#endif // " << api << "_GENERATED_H" << std::endl;
+}
+
+void writeHelpers(
+    std::ostream& os,
+    const GeneratedModel& model)
+{
+    os << "namespace" << std::endl;
+    os << "{" << std::endl;
+    os << "typedef Eigen::Matrix<double, 6, 1> Vector6d;" << std::endl;
+    os << "typedef Eigen::Matrix<double, 6, 6> Matrix6d;" << std::endl;
+    os << "const unsigned int nbBodies = " << model.bodies.size() << ";" <<
+       std::endl;
+    os << R"(
+// Placement of a body in its parent: v_parent = R * v_body, r being the origin
+struct Transform {
+    Eigen::Matrix3d R;
+    Eigen::Vector3d r;
+};
+
+Eigen::Matrix3d skew(const Eigen::Vector3d& v)
+{
+    Eigen::Matrix3d m;
+    m << 0, -v(2), v(1),
+         v(2), 0, -v(0),
+         -v(1), v(0), 0;
+    return m;
+}
+
+// Motion vector from the parent to the body coordinates
+Vector6d motionToBody(const Transform& X, const Vector6d& m)
+{
+    Vector6d out;
+    out.head<3>() = X.R.transpose() * m.head<3>();
+    out.tail<3>() = X.R.transpose() * (m.tail<3>() - X.r.cross(m.head<3>()));
+    return out;
+}
+
+// Force vector from the body to the parent coordinates
+Vector6d forceToParent(const Transform& X, const Vector6d& f)
+{
+    Vector6d out;
+    out.tail<3>() = X.R * f.tail<3>();
+    out.head<3>() = X.R * f.head<3>() + X.r.cross(out.tail<3>());
+    return out;
+}
+
+// Articulated inertia from the body to the parent coordinates
+Matrix6d inertiaToParent(const Transform& X, const Matrix6d& I)
+{
+    Matrix6d Xm;
+    Xm.topLeftCorner<3, 3>() = X.R.transpose();
+    Xm.topRightCorner<3, 3>().setZero();
+    Xm.bottomLeftCorner<3, 3>() = -X.R.transpose() * skew(X.r);
+    Xm.bottomRightCorner<3, 3>() = X.R.transpose();
+    return Xm.transpose() * I * Xm;
+}
+
+Vector6d crossMotion(const Vector6d& v, const Vector6d& m)
+{
+    Vector6d out;
+    out.head<3>() = v.head<3>().cross(m.head<3>());
+    out.tail<3>() = v.head<3>().cross(m.tail<3>()) + v.tail<3>().cross(m.head<3>());
+    return out;
+}
+
+Vector6d crossForce(const Vector6d& v, const Vector6d& f)
+{
+    Vector6d out;
+    out.head<3>() = v.head<3>().cross(f.head<3>()) + v.tail<3>().cross(f.tail<3>());
+    out.tail<3>() = v.head<3>().cross(f.tail<3>());
+    return out;
+}
+)";
+    os << std::endl;
+
+    // The base acceleration accounts for the gravity
+    os << "const Vector6d baseAcceleration((Vector6d() << 0.0, 0.0, 0.0, "
+       << literal(-model.gravity[0]) << ", " << literal(-model.gravity[1]) << ", "
+       << literal(-model.gravity[2]) << ").finished());" << std::endl;
+    for (unsigned int b=0; b<model.bodies.size(); ++b) {
+        const GeneratedBody& body(model.bodies[b]);
+        if (!body.hasMass) {
+            continue;
+        }
+        os << "const Matrix6d inertia" << b << "((Matrix6d() <<";
+        for (unsigned int i=0; i<6; ++i) {
+            os << std::endl << "    ";
+            for (unsigned int j=0; j<6; ++j) {
+                os << literal(body.inertia[i][j]) << (j == 5 ? (i == 5 ? "" : ",") : ", ");
+            }
+        }
+        os << ").finished());" << std::endl;
+    }
+    os << std::endl;
+
+    // Placement of each body in its parent
+    os << "void localTransforms(const " << model.name <<
+       "::VectorQ& Q, Transform* X)" << std::endl;
+    os << "{" << std::endl;
+    for (unsigned int b=0; b<model.bodies.size(); ++b) {
+        const GeneratedBody& body(model.bodies[b]);
+        std::string X("X[" + std::to_string(b) + "]");
+        std::string q("Q(" + std::to_string(body.q) + ")");
+        if (body.joint == REVOLUTE) {
+            // Elementary rotation, as coefficients of (cos, sin, 1)
+            double rot[3][3][3] = {};
+            unsigned int a(body.axis), a1((body.axis + 1) % 3), a2((body.axis + 2) % 3);
+            rot[a][a][2] = 1;
+            rot[a1][a1][0] = 1;
+            rot[a2][a2][0] = 1;
+            rot[a2][a1][1] = 1;
+            rot[a1][a2][1] = -1;
+
+            os << "    {" << std::endl;
+            os << "        const double c(std::cos(" << q << ")), s(std::sin(" << q << "));" <<
+               std::endl;
+            os << "        " << X << ".R <<";
+            for (unsigned int i=0; i<3; ++i) {
+                os << std::endl << "            ";
+                for (unsigned int j=0; j<3; ++j) {
+                    double coef[3] = {0, 0, 0};
+                    for (unsigned int k=0; k<3; ++k) {
+                        for (unsigned int n=0; n<3; ++n) {
+                            coef[n] += body.rotation[i][k] * rot[k][j][n];
+                        }
+                    }
+                    os << linear({{coef[0], "c"}, {coef[1], "s"}, {coef[2], ""}})
+                       << (j == 2 ? (i == 2 ? ";" : ",") : ", ");
+                }
+            }
+            os << std::endl;
+            os << "        " << X << ".r << " << literal(body.translation[0]) << ", "
+               << literal(body.translation[1]) << ", " << literal(body.translation[2]) << ";"
+               << std::endl;
+            os << "    }" << std::endl;
+        } else {
+            os << "    " << X << ".R <<";
+            for (unsigned int i=0; i<3; ++i) {
+                os << std::endl << "        ";
+                for (unsigned int j=0; j<3; ++j) {
+                    os << literal(body.rotation[i][j]) << (j == 2 ? (i == 2 ? ";" : ",") : ", ");
+                }
+            }
+            os << std::endl;
+            os << "    " << X << ".r << ";
+            for (unsigned int i=0; i<3; ++i) {
+                double slide(body.joint == PRISMATIC ? body.rotation[i][body.axis] : 0.0);
+                os << linear({{body.translation[i], ""}, {slide, q}})
+                   << (i == 2 ? ";" : ", ");
+            }
+            os << std::endl;
+        }
+    }
+    os << "}" << std::endl;
+    os << std::endl;
+
+    // Placement of each body in the global reference frame
+    os << "void globalTransforms(const Transform* X, Eigen::Matrix3d* R, Eigen::Vector3d* p)"
+       << std::endl;
+    os << "{" << std::endl;
+    for (unsigned int b=0; b<model.bodies.size(); ++b) {
+        const GeneratedBody& body(model.bodies[b]);
+        std::string i(std::to_string(b));
+        if (body.parent < 0) {
+            os << "    R[" << i << "] = X[" << i << "].R;" << std::endl;
+            os << "    p[" << i << "] = X[" << i << "].r;" << std::endl;
+        } else {
+            std::string par(std::to_string(body.parent));
+            if (isIdentity(body) && body.joint != REVOLUTE) {
+                os << "    R[" << i << "] = R[" << par << "];" << std::endl;
+            } else {
+                os << "    R[" << i << "] = R[" << par << "] * X[" << i << "].R;" << std::endl;
+            }
+            os << "    p[" << i << "] = p[" << par << "] + R[" << par << "] * X[" << i << "].r;"
+               << std::endl;
+        }
+    }
+    os << "}" << std::endl;
+    os << std::endl;
+
+    // Jacobian of a point attached to a body
+    os << "template<typename Jacobian>" << std::endl;
+    os << "void pointJacobian(" << std::endl;
+    os << "    unsigned int body," << std::endl;
+    os << "    const Eigen::Vector3d& x," << std::endl;
+    os << "    const Eigen::Matrix3d* R," << std::endl;
+    os << "    const Eigen::Vector3d* p," << std::endl;
+    os << "    unsigned int row," << std::endl;
+    os << "    Jacobian& J)" << std::endl;
+    os << "{" << std::endl;
+    os << "    switch (body) {" << std::endl;
+    for (unsigned int b=0; b<model.bodies.size(); ++b) {
+        os << "    case " << b << ":" << std::endl;
+        for (auto j : ancestorsWithDof(model, b)) {
+            const GeneratedBody& dof(model.bodies[j]);
+            os << "        J.template block<3, 1>(row, " << dof.q << ") = R[" << j <<
+               "].col(" << dof.axis << ")";
+            if (dof.joint == REVOLUTE) {
+                os << ".cross(x - p[" << j << "])";
+            }
+            os << ";" << std::endl;
+        }
+        os << "        break;" << std::endl;
+    }
+    os << "    }" << std::endl;
+    os << "}" << std::endl;
+    os << "}" << std::endl;
+}
+
+void writeKinematics(
+    std::ostream& os,
+    const GeneratedModel& model)
+{
+    const std::string ns(model.name + "::");
+    const std::string prologue(
+        "    Transform X[nbBodies];\n"
+        "    Eigen::Matrix3d R[nbBodies];\n"
+        "    Eigen::Vector3d p[nbBodies];\n"
+        "    localTransforms(Q, X);\n"
+        "    globalTransforms(X, R, p);\n");
+
+    os << "void " << ns << "globalJCS(" << std::endl;
+    os << "    const VectorQ& Q," << std::endl;
+    os << "    Eigen::Matrix<double, 4, 4*nbSegments>& jcs)" << std::endl;
+    os << "{" << std::endl;
+    os << prologue;
+    os << "    jcs.setZero();" << std::endl;
+    for (unsigned int s=0; s<model.segments.size(); ++s) {
+        unsigned int b(model.segments[s]);
+        os << "    jcs.block<3, 3>(0, " << 4*s << ") = R[" << b << "];" << std::endl;
+        os << "    jcs.block<3, 1>(0, " << 4*s+3 << ") = p[" << b << "];" << std::endl;
+        os << "    jcs(3, " << 4*s+3 << ") = 1.0;" << std::endl;
+    }
+    os << "}" << std::endl;
+    os << std::endl;
+
+    if (model.markers.size()) {
+        os << "void " << ns << "markers(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, 3, nbMarkers>& markers)" << std::endl;
+        os << "{" << std::endl;
+        os << prologue;
+        for (unsigned int m=0; m<model.markers.size(); ++m) {
+            const GeneratedPoint& pt(model.markers[m]);
+            os << "    markers.col(" << m << ") = R[" << pt.body << "] * Eigen::Vector3d("
+               << literal(pt.position[0]) << ", " << literal(pt.position[1]) << ", "
+               << literal(pt.position[2]) << ") + p[" << pt.body << "];" << std::endl;
+        }
+        os << "}" << std::endl;
+        os << std::endl;
+
+        os << "void " << ns << "markersJacobian(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, 3*nbMarkers, nbQ>& jacobian)" << std::endl;
+        os << "{" << std::endl;
+        os << prologue;
+        os << "    jacobian.setZero();" << std::endl;
+        for (unsigned int m=0; m<model.markers.size(); ++m) {
+            const GeneratedPoint& pt(model.markers[m]);
+            os << "    pointJacobian(" << pt.body << ", R[" << pt.body << "] * Eigen::Vector3d("
+               << literal(pt.position[0]) << ", " << literal(pt.position[1]) << ", "
+               << literal(pt.position[2]) << ") + p[" << pt.body << "], R, p, " << 3*m
+               << ", jacobian);" << std::endl;
+        }
+        os << "}" << std::endl;
+        os << std::endl;
+    }
+
+    if (model.muscles.size()) {
+        os << "void " << ns << "musculoTendonLength(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, nbMuscles, 1>& length)" << std::endl;
+        os << "{" << std::endl;
+        os << prologue;
+        for (unsigned int m=0; m<model.muscles.size(); ++m) {
+            const GeneratedMuscle& muscle(model.muscles[m]);
+            os << "    {" << std::endl;
+            os << "        Eigen::Vector3d x[" << muscle.points.size() << "];" << std::endl;
+            for (unsigned int i=0; i<muscle.points.size(); ++i) {
+                const GeneratedPoint& pt(muscle.points[i]);
+                os << "        x[" << i << "] = R[" << pt.body << "] * Eigen::Vector3d("
+                   << literal(pt.position[0]) << ", " << literal(pt.position[1]) << ", "
+                   << literal(pt.position[2]) << ") + p[" << pt.body << "];" << std::endl;
+            }
+            os << "        length(" << m << ") = ";
+            for (unsigned int i=0; i<muscle.points.size()-1; ++i) {
+                os << (i ? " + " : "") << "(x[" << i+1 << "] - x[" << i << "]).norm()";
+            }
+            os << ";" << std::endl;
+            os << "    }" << std::endl;
+        }
+        os << "}" << std::endl;
+        os << std::endl;
+
+        os << "void " << ns << "musclesLength(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, nbMuscles, 1>& length)" << std::endl;
+        os << "{" << std::endl;
+        os << "    musculoTendonLength(Q, length);" << std::endl;
+        for (unsigned int m=0; m<model.muscles.size(); ++m) {
+            const GeneratedMuscle& muscle(model.muscles[m]);
+            os << "    length(" << m << ") = (length(" << m << ") - " << literal(
+                   muscle.tendonSlackLength) << ") / " << literal(muscle.cosPennation) << ";"
+               << std::endl;
+        }
+        os << "}" << std::endl;
+        os << std::endl;
+
+        os << "void " << ns << "musclesLengthJacobian(" << std::endl;
+        os << "    const VectorQ& Q," << std::endl;
+        os << "    Eigen::Matrix<double, nbMuscles, nbQ>& jacobian)" << std::endl;
+        os << "{" << std::endl;
+        os << prologue;
+        os << "    jacobian.setZero();" << std::endl;
+        for (unsigned int m=0; m<model.muscles.size(); ++m) {
+            const GeneratedMuscle& muscle(model.muscles[m]);
+            size_t nbPoints(muscle.points.size());
+            os << "    {" << std::endl;
+            os << "        Eigen::Vector3d x[" << nbPoints << "];" << std::endl;
+            os << "        Eigen::Matrix<double, " << 3*nbPoints << ", nbQ> J;" << std::endl;
+            os << "        J.setZero();" << std::endl;
+            for (unsigned int i=0; i<nbPoints; ++i) {
+                const GeneratedPoint& pt(muscle.points[i]);
+                os << "        x[" << i << "] = R[" << pt.body << "] * Eigen::Vector3d("
+                   << literal(pt.position[0]) << ", " << literal(pt.position[1]) << ", "
+                   << literal(pt.position[2]) << ") + p[" << pt.body << "];" << std::endl;
+                os << "        pointJacobian(" << pt.body << ", x[" << i << "], R, p, " << 3*i
+                   << ", J);" << std::endl;
+            }
+            for (unsigned int i=0; i<nbPoints-1; ++i) {
+                os << "        jacobian.row(" << m << ") += (x[" << i+1 << "] - x[" << i
+                   << "]).normalized().transpose() * (J.block<3, nbQ>(" << 3*(i+1)
+                   << ", 0) - J.block<3, nbQ>(" << 3*i << ", 0));" << std::endl;
+            }
+            os << "    }" << std::endl;
+        }
+        os << "}" << std::endl;
+        os << std::endl;
+    }
+}
+
+void writeDynamics(
+    std::ostream& os,
+    const GeneratedModel& model)
+{
+    const std::string ns(model.name + "::");
+    const size_t nbBodies(model.bodies.size());
+
+    // Recursive Newton-Euler algorithm
+    os << "void " << ns << "inverseDynamics(" << std::endl;
+    os << "    const VectorQ& Q," << std::endl;
+    os << "    const VectorQ& Qdot," << std::endl;
+    os << "    const VectorQ& Qddot," << std::endl;
+    os << "    VectorQ& Tau)" << std::endl;
+    os << "{" << std::endl;
+    os << "    Transform X[nbBodies];" << std::endl;
+    os << "    Vector6d v[nbBodies], a[nbBodies], f[nbBodies];" << std::endl;
+    os << "    localTransforms(Q, X);" << std::endl;
+    for (unsigned int b=0; b<nbBodies; ++b) {
+        const GeneratedBody& body(model.bodies[b]);
+        std::string i(std::to_string(b));
+        if (body.parent < 0) {
+            os << "    v[" << i << "].setZero();" << std::endl;
+        } else {
+            os << "    v[" << i << "] = motionToBody(X[" << i << "], v[" << body.parent << "]);"
+               << std::endl;
+        }
+        os << "    a[" << i << "] = motionToBody(X[" << i << "], " << parentOf(body, "a",
+                "baseAcceleration") << ");" << std::endl;
+        if (body.joint != FIXED) {
+            unsigned int idx(spatialIdx(body));
+            os << "    a[" << i << "] += Qdot(" << body.q << ") * crossMotion(v[" << i <<
+               "], Vector6d::Unit(" << idx << "));" << std::endl;
+            os << "    v[" << i << "](" << idx << ") += Qdot(" << body.q << ");" << std::endl;
+            os << "    a[" << i << "](" << idx << ") += Qddot(" << body.q << ");" << std::endl;
+        }
+        if (body.hasMass) {
+            os << "    f[" << i << "] = inertia" << i << " * a[" << i << "] + crossForce(v[" << i
+               << "], inertia" << i << " * v[" << i << "]);" << std::endl;
+        } else {
+            os << "    f[" << i << "].setZero();" << std::endl;
+        }
+    }
+    for (int b = static_cast<int>(nbBodies) - 1; b >= 0; --b) {
+        const GeneratedBody& body(model.bodies[b]);
+        if (body.joint != FIXED) {
+            os << "    Tau(" << body.q << ") = f[" << b << "](" << spatialIdx(body) << ");" <<
+               std::endl;
+        }
+        if (body.parent >= 0) {
+            os << "    f[" << body.parent << "] += forceToParent(X[" << b << "], f[" << b <<
+               "]);" << std::endl;
+        }
+    }
+    os << "}" << std::endl;
+    os << std::endl;
+
+    // Articulated body algorithm
+    os << "void " << ns << "forwardDynamics(" << std::endl;
+    os << "    const VectorQ& Q," << std::endl;
+    os << "    const VectorQ& Qdot," << std::endl;
+    os << "    const VectorQ& Tau," << std::endl;
+    os << "    VectorQ& Qddot)" << std::endl;
+    os << "{" << std::endl;
+    os << "    Transform X[nbBodies];" << std::endl;
+    os << "    Vector6d v[nbBodies], c[nbBodies], pA[nbBodies], U[nbBodies], a[nbBodies];"
+       << std::endl;
+    os << "    Matrix6d IA[nbBodies];" << std::endl;
+    os << "    double D[nbBodies], u[nbBodies];" << std::endl;
+    os << "    localTransforms(Q, X);" << std::endl;
+    for (unsigned int b=0; b<nbBodies; ++b) {
+        const GeneratedBody& body(model.bodies[b]);
+        std::string i(std::to_string(b));
+        if (body.parent < 0) {
+            os << "    v[" << i << "].setZero();" << std::endl;
+        } else {
+            os << "    v[" << i << "] = motionToBody(X[" << i << "], v[" << body.parent << "]);"
+               << std::endl;
+        }
+        if (body.joint != FIXED) {
+            unsigned int idx(spatialIdx(body));
+            os << "    c[" << i << "] = Qdot(" << body.q << ") * crossMotion(v[" << i <<
+               "], Vector6d::Unit(" << idx << "));" << std::endl;
+            os << "    v[" << i << "](" << idx << ") += Qdot(" << body.q << ");" << std::endl;
+        } else {
+            os << "    c[" << i << "].setZero();" << std::endl;
+        }
+        if (body.hasMass) {
+            os << "    IA[" << i << "] = inertia" << i << ";" << std::endl;
+            os << "    pA[" << i << "] = crossForce(v[" << i << "], inertia" << i << " * v[" << i
+               << "]);" << std::endl;
+        } else {
+            os << "    IA[" << i << "].setZero();" << std::endl;
+            os << "    pA[" << i << "].setZero();" << std::endl;
+        }
+    }
+    for (int b = static_cast<int>(nbBodies) - 1; b >= 0; --b) {
+        const GeneratedBody& body(model.bodies[b]);
+        std::string i(std::to_string(b));
+        if (body.joint != FIXED) {
+            unsigned int idx(spatialIdx(body));
+            os << "    U[" << i << "] = IA[" << i << "].col(" << idx << ");" << std::endl;
+            os << "    D[" << i << "] = U[" << i << "](" << idx << ");" << std::endl;
+            os << "    u[" << i << "] = Tau(" << body.q << ") - pA[" << i << "](" << idx << ");"
+               << std::endl;
+            if (body.parent >= 0) {
+                os << "    {" << std::endl;
+                os << "        const Matrix6d Ia(IA[" << i << "] - U[" << i << "] * U[" << i
+                   << "].transpose() / D[" << i << "]);" << std::endl;
+                os << "        IA[" << body.parent << "] += inertiaToParent(X[" << i << "], Ia);"
+                   << std::endl;
+                os << "        pA[" << body.parent << "] += forceToParent(X[" << i << "], pA[" <<
+                   i << "] + Ia * c[" << i << "] + U[" << i << "] * (u[" << i << "] / D[" << i
+                   << "]));" << std::endl;
+                os << "    }" << std::endl;
+            }
+        } else if (body.parent >= 0) {
+            os << "    IA[" << body.parent << "] += inertiaToParent(X[" << i << "], IA[" << i
+               << "]);" << std::endl;
+            os << "    pA[" << body.parent << "] += forceToParent(X[" << i << "], pA[" << i <<
+               "]);" << std::endl;
+        }
+    }
+    for (unsigned int b=0; b<nbBodies; ++b) {
+        const GeneratedBody& body(model.bodies[b]);
+        std::string i(std::to_string(b));
+        os << "    a[" << i << "] = motionToBody(X[" << i << "], " << parentOf(body, "a",
+                "baseAcceleration") << ") + c[" << i << "];" << std::endl;
+        if (body.joint != FIXED) {
+            unsigned int idx(spatialIdx(body));
+            os << "    Qddot(" << body.q << ") = (u[" << i << "] - U[" << i << "].dot(a[" << i
+               << "])) / D[" << i << "];" << std::endl;
+            os << "    a[" << i << "](" << idx << ") += Qddot(" << body.q << ");" << std::endl;
+        }
+    }
+    os << "}" << std::endl;
+}
+
+void writeSource(
+    std::ostream& os,
+    const GeneratedModel& model)
+{
+    os << "// Generated by biorbd, do not edit" << std::endl;
+    os << "#include \"" << model.name << ".h\"" << std::endl;
+    os << std::endl;
+    os << "#include <cmath>" << std::endl;
+    os << std::endl;
+    writeHelpers(os, model);
+    os << std::endl;
+    writeKinematics(os, model);
+    writeDynamics(os, model);
+}
+}
+
+void CodeGenerator::generateModel(
+    Model &model,
+    const utils::Path& pathToWrite)
+{
+    GeneratedModel gen;
+    gen.name = pathToWrite.filename();
+    utils::Error::check(!gen.name.empty() && !std::isdigit(gen.name[0]),
+                        "The filename must be a valid C++ identifier");
+    for (auto c : gen.name) {
+        utils::Error::check(std::isalnum(c) || c == '_',
+                            "The filename must be a valid C++ identifier");
+    }
+    utils::Error::check(model.nbQ() > 0,
+                        "The model must have degrees of freedom to generate its code");
+    ModelDescription description(model);
+    gen.nbQ = description.nbQ();
+    for (unsigned int i=0; i<3; ++i) {
+        gen.gravity[i] = description.gravity()(i);
+    }
+
+    // The bodies, one per DoF, the mass being on the last body of the segment
+    for (const ModelDescription::Segment& segment : description.segments()) {
+        int parent(segment.parent < 0 ? -1 : static_cast<int>
+                   (gen.segments[segment.parent]));
+        unsigned int nbBodies(segment.dofs.size() > 0 ?
+                              static_cast<unsigned int>(segment.dofs.size()) : 1);
+        for (unsigned int i=0; i<nbBodies; ++i) {
+            GeneratedBody body;
+            body.parent = parent;
+            body.q = 0;
+            body.axis = 0;
+            if (segment.dofs.empty()) {
+                body.joint = FIXED;
+            } else {
+                const ModelDescription::Dof& dof(segment.dofs[i]);
+                body.joint = dof.isRotation ? REVOLUTE : PRISMATIC;
+                body.axis = dof.axis;
+                body.q = dof.q;
+            }
+            for (unsigned int j=0; j<3; ++j) {
+                for (unsigned int k=0; k<3; ++k) {
+                    body.rotation[j][k] = i == 0 ? segment.rotation(j, k) : (j == k ? 1.0 : 0.0);
+                }
+                body.translation[j] = i == 0 ? segment.translation(j) : 0.0;
+            }
+
+            body.hasMass = i == nbBodies - 1 && segment.mass > 0;
+            if (body.hasMass) {
+                double m(segment.mass);
+                const Eigen::Vector3d& com(segment.CoM);
+                Eigen::Matrix3d cx;
+                cx << 0, -com(2), com(1),
+                   com(2), 0, -com(0),
+                   -com(1), com(0), 0;
+                Eigen::Matrix3d inertia(segment.inertia + m * cx * cx.transpose());
+                for (unsigned int j=0; j<3; ++j) {
+                    for (unsigned int k=0; k<3; ++k) {
+                        body.inertia[j][k] = inertia(j, k);
+                        body.inertia[j][k+3] = m * cx(j, k);
+                        body.inertia[j+3][k] = m * cx(k, j);
+                        body.inertia[j+3][k+3] = j == k ? m : 0.0;
+                    }
+                }
+            }
+            parent = static_cast<int>(gen.bodies.size());
+            gen.bodies.push_back(body);
+        }
+        gen.segments.push_back(static_cast<unsigned int>(gen.bodies.size() - 1));
+    }
+
+    // The markers are generated without removing any axis
+    auto point = [&](const ModelDescription::Point& source) {
+        GeneratedPoint pt;
+        pt.body = gen.segments[source.segment];
+        for (unsigned int i=0; i<3; ++i) {
+            pt.position[i] = source.position(i);
+        }
+        return pt;
+    };
+
+    for (const ModelDescription::Point& marker : description.markers()) {
+        gen.markers.push_back(point(marker));
+    }
+
+    for (const ModelDescription::Muscle& muscle : description.muscles()) {
+        GeneratedMuscle gm;
+        for (const ModelDescription::Point& pt : muscle.points) {
+            gm.points.push_back(point(pt));
+        }
+        gm.tendonSlackLength = muscle.tendonSlackLength;
+        gm.cosPennation = muscle.cosPennation;
+        gen.muscles.push_back(gm);
+    }
+
+    // Manage the case where the destination folder does not exist
+    if(!pathToWrite.isFolderExist()) {
+        pathToWrite.createFolder();
+    }
+    utils::String base(pathToWrite.absoluteFolder() + pathToWrite.filename());
+
+    std::ofstream header((base + ".h").c_str());
+    writeHeader(header, gen);
+    header.close();
+
+    std::ofstream source((base + ".cpp").c_str());
+    writeSource(source, gen);
+    source.close();
+}
+#endif
@@ -0,0 +1,121 @@
+#define BIORBD_API_EXPORTS
+#include "ModelDescription.h"
+
+#include <cctype>
+#include <cmath>
+
+#include "BiorbdModel.h"
+#include "Utils/Error.h"
+#include "Utils/String.h"
+#include "Utils/Vector3d.h"
+#include "Utils/RotoTrans.h"
+#include "RigidBody/Segment.h"
+#include "RigidBody/SegmentCharacteristics.h"
+#include "RigidBody/NodeSegment.h"
+#ifdef MODULE_MUSCLES
+#include "Muscles/Muscle.h"
+#include "Muscles/MuscleGroup.h"
+#include "Muscles/Geometry.h"
+#include "Muscles/Characteristics.h"
+#include "Muscles/PathModifiers.h"
+#endif
+
+using namespace BIORBD_NAMESPACE;
+
+#ifndef BIORBD_USE_CASADI_MATH
+ModelDescription::ModelDescription(
+    Model& model) :
+    m_nbQ(model.nbQ()),
+    m_gravity(model.getGravity())
+{
+    utils::Error::check(model.nbQuat() == 0,
+                        "The model description does not handle quaternions");
+
+    unsigned int q(0);
+    for (unsigned int s=0; s<model.nbSegment(); ++s) {
+        const rigidbody::Segment& segment(model.segment(s));
+        Segment description;
+        description.parent = model.GetBodyBiorbdId(segment.parent());
+        utils::RotoTrans jcs(segment.localJCS());
+        description.rotation = jcs.block<3, 3>(0, 0);
+        description.translation = jcs.block<3, 1>(0, 3);
+
+        // The translations are applied first, then the rotations in their sequence
+        utils::String seq(segment.seqT() + segment.seqR());
+        for (unsigned int i=0; i<segment.nbDof(); ++i) {
+            Dof dof;
+            dof.isRotation = i >= segment.nbDofTrans();
+            dof.axis = static_cast<unsigned int>(std::tolower(seq[i]) - 'x');
+            dof.q = q++;
+            description.dofs.push_back(dof);
+        }
+
+        const rigidbody::SegmentCharacteristics& charac(segment.characteristics());
+        description.mass = charac.mass();
+        description.CoM = charac.CoM();
+        description.inertia = charac.inertia();
+        m_segments.push_back(description);
+    }
+
+    auto point = [&](const rigidbody::NodeSegment& node) {
+        Point pt;
+        int segment(model.GetBodyBiorbdId(node.parent()));
+        utils::Error::check(segment >= 0, node.parent() + " is not a segment of the model");
+        pt.segment = static_cast<unsigned int>(segment);
+        pt.position = node;
+        pt.positionAxisRemoved = node.removeAxes();
+        return pt;
+    };
+
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        m_markers.push_back(point(model.marker(i)));
+    }
+
+#ifdef MODULE_MUSCLES
+    for (unsigned int g=0; g<model.nbMuscleGroups(); ++g) {
+        muscles::MuscleGroup& group(model.muscleGroup(g));
+        for (unsigned int m=0; m<group.nbMuscles(); ++m) {
+            muscles::Muscle& muscle(group.muscle(m));
+            const muscles::PathModifiers& modifiers(muscle.pathModifier());
+            utils::Error::check(modifiers.nbWraps() == 0,
+                                "The model description does not handle wrapping objects");
+
+            Muscle path;
+            path.points.push_back(point(muscle.position().originInLocal()));
+            for (unsigned int i=0; i<modifiers.nbObjects(); ++i) {
+                path.points.push_back(point(modifiers.object(i)));
+            }
+            path.points.push_back(point(muscle.position().insertionInLocal()));
+            path.tendonSlackLength = muscle.characteristics().tendonSlackLength();
+            path.cosPennation = std::cos(muscle.characteristics().pennationAngle());
+            m_muscles.push_back(path);
+        }
+    }
+#endif
+}
+
+unsigned int ModelDescription::nbQ() const
+{
+    return m_nbQ;
+}
+
+const Eigen::Vector3d& ModelDescription::gravity() const
+{
+    return m_gravity;
+}
+
+const std::vector<ModelDescription::Segment>& ModelDescription::segments() const
+{
+    return m_segments;
+}
+
+const std::vector<ModelDescription::Point>& ModelDescription::markers() const
+{
+    return m_markers;
+}
+
+const std::vector<ModelDescription::Muscle>& ModelDescription::muscles() const
+{
+    return m_muscles;
+}
+#endif
@@ -0,0 +1,277 @@
+#define BIORBD_API_EXPORTS
+#include "ModelFunctionCache.h"
+
+#ifdef BIORBD_USE_CASADI_MATH
+#include <iomanip>
+#include <sstream>
+
+#include "BiorbdModel.h"
+#include "ModelWorkspace.h"
+#include "Utils/Error.h"
+#include "Utils/String.h"
+#include "Utils/Path.h"
+#include "Utils/Vector.h"
+#include "RigidBody/GeneralizedCoordinates.h"
+#include "RigidBody/GeneralizedVelocity.h"
+#include "RigidBody/GeneralizedAcceleration.h"
+#include "RigidBody/GeneralizedTorque.h"
+#include "RigidBody/NodeSegment.h"
+
+using namespace BIORBD_NAMESPACE;
+
+namespace
+{
+// FNV-1a, whose value does not depend on the run nor on the standard library
+std::string stableHash(
+    const std::string& content)
+{
+    unsigned long long hash(14695981039346656037ULL);
+    for (unsigned char c : content) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    std::stringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return out.str();
+}
+}
+
+ModelFunctionCache::ModelFunctionCache(
+    const Model& model) :
+    m_model(std::make_shared<ModelWorkspace>(model)),
+    m_functions(std::make_shared<std::map<std::string, casadi::Function>>()),
+    m_expand(std::make_shared<bool>(false)),
+    m_jit(std::make_shared<bool>(false)),
+    m_compiler(std::make_shared<utils::String>("gcc")),
+    m_cacheFolder(std::make_shared<utils::String>()),
+    m_hasFile(std::make_shared<bool>(utils::Path(model.path()).isFileExist()))
+{
+
+}
+
+void ModelFunctionCache::setExpand(
+    bool expand)
+{
+    if (expand != *m_expand) {
+        clear();
+    }
+    *m_expand = expand;
+}
+
+bool ModelFunctionCache::expand() const
+{
+    return *m_expand;
+}
+
+void ModelFunctionCache::setJit(
+    bool jit)
+{
+    if (jit != *m_jit) {
+        clear();
+    }
+    *m_jit = jit;
+}
+
+bool ModelFunctionCache::jit() const
+{
+    return *m_jit;
+}
+
+void ModelFunctionCache::setCompiler(
+    const utils::String& compiler)
+{
+    *m_compiler = compiler;
+}
+
+void ModelFunctionCache::setCacheFolder(
+    const utils::String& folder)
+{
+    *m_cacheFolder = folder;
+    if (!folder.empty() && folder.back() != '/') {
+        *m_cacheFolder += "/";
+    }
+}
+
+const utils::String& ModelFunctionCache::cacheFolder() const
+{
+    return *m_cacheFolder;
+}
+
+unsigned int ModelFunctionCache::nbFunctions() const
+{
+    return static_cast<unsigned int>(m_functions->size());
+}
+
+void ModelFunctionCache::clear()
+{
+    m_functions->clear();
+}
+
+const casadi::Function& ModelFunctionCache::function(
+    const utils::String& method,
+    const std::vector<utils::String>& inputNames,
+    const std::vector<std::pair<unsigned int, unsigned int>>& inputShapes,
+    const std::function<casadi::MX(ModelWorkspace&, const std::vector<casadi::MX>&)>&
+    expression)
+{
+    utils::Error::check(inputNames.size() == inputShapes.size(),
+                        "There must be one name per argument");
+    std::stringstream key;
+    key << method;
+    for (const auto& shape : inputShapes) {
+        key << "_" << shape.first << "x" << shape.second;
+    }
+
+    std::map<std::string, casadi::Function>::iterator it(m_functions->find(key.str()));
+    if (it == m_functions->end()) {
+        it = m_functions->insert(std::make_pair(
+                                     key.str(), create(method, key.str(), inputNames, inputShapes, expression))).first;
+    }
+    return it->second;
+}
+
+const casadi::Function& ModelFunctionCache::ForwardDynamics()
+{
+    return function("ForwardDynamics", {"Q", "Qdot", "Tau"}, {
+        {m_model->nbQ(), 1}, {m_model->nbQdot(), 1}, {m_model->nbGeneralizedTorque(), 1}
+    },
+    [](ModelWorkspace& model, const std::vector<casadi::MX>& in) -> casadi::MX {
+        return model.ForwardDynamics(
+            rigidbody::GeneralizedCoordinates(in[0]),
+            rigidbody::GeneralizedVelocity(in[1]),
+            rigidbody::GeneralizedTorque(in[2]));
+    });
+}
+
+const casadi::Function& ModelFunctionCache::InverseDynamics()
+{
+    return function("InverseDynamics", {"Q", "Qdot", "Qddot"}, {
+        {m_model->nbQ(), 1}, {m_model->nbQdot(), 1}, {m_model->nbQddot(), 1}
+    },
+    [](ModelWorkspace& model, const std::vector<casadi::MX>& in) -> casadi::MX {
+        return model.InverseDynamics(
+            rigidbody::GeneralizedCoordinates(in[0]),
+            rigidbody::GeneralizedVelocity(in[1]),
+            rigidbody::GeneralizedAcceleration(in[2]));
+    });
+}
+
+const casadi::Function& ModelFunctionCache::markers()
+{
+    return function("markers", {"Q"}, {{m_model->nbQ(), 1}},
+    [](ModelWorkspace& model, const std::vector<casadi::MX>& in) -> casadi::MX {
+        std::vector<rigidbody::NodeSegment> markers(
+            model.markers(rigidbody::GeneralizedCoordinates(in[0])));
+        std::vector<casadi::MX> columns;
+        for (unsigned int i=0; i<markers.size(); ++i) {
+            columns.push_back(markers[i]);
+        }
+        return casadi::MX::horzcat(columns);
+    });
+}
+
+#ifdef MODULE_MUSCLES
+const casadi::Function& ModelFunctionCache::muscularJointTorque()
+{
+    return function("muscularJointTorque", {"F", "Q", "Qdot"}, {
+        {m_model->nbMuscles(), 1}, {m_model->nbQ(), 1}, {m_model->nbQdot(), 1}
+    },
+    [](ModelWorkspace& model, const std::vector<casadi::MX>& in) -> casadi::MX {
+        return model.muscularJointTorque(
+            utils::Vector(in[0]),
+            rigidbody::GeneralizedCoordinates(in[1]),
+            rigidbody::GeneralizedVelocity(in[2]));
+    });
+}
+#endif
+
+casadi::Function ModelFunctionCache::create(
+    const utils::String& method,
+    const std::string& key,
+    const std::vector<utils::String>& inputNames,
+    const std::vector<std::pair<unsigned int, unsigned int>>& inputShapes,
+    const std::function<casadi::MX(ModelWorkspace&, const std::vector<casadi::MX>&)>&
+    expression)
+{
+    std::vector<casadi::MX> inputs;
+    std::vector<std::string> names;
+    for (unsigned int i=0; i<inputShapes.size(); ++i) {
+        inputs.push_back(casadi::MX::sym(inputNames[i], inputShapes[i].first,
+                                         inputShapes[i].second));
+        names.push_back(inputNames[i]);
+    }
+    casadi::MX output(expression(*m_model, inputs));
+    std::vector<std::string> outputNames(1, method);
+
+    // The files are named after the graph of the function, which holds the
+    // current parameters of the model, and the versions that produced it.
+    // A model without file is usually built in code, so its functions are
+    // kept in memory only
+    utils::String name;
+    if (!m_cacheFolder->empty() && *m_hasFile) {
+        std::string content(casadi::Function(key, inputs, {output}).serialize());
+        content += BIORBD_VERSION;
+        content += casadi::CasadiMeta::version();
+        name = key + "_" + stableHash(content) + (*m_expand ? "_sx" : "_mx");
+    }
+#if defined(_WIN32)
+    utils::String library(*m_cacheFolder + name + ".dll");
+#elif defined(__APPLE__)
+    utils::String library(*m_cacheFolder + name + ".dylib");
+#else
+    utils::String library(*m_cacheFolder + name + ".so");
+#endif
+    utils::String serialized(*m_cacheFolder + name + ".casadi");
+
+    // A previous run already did the work
+    if (!name.empty() && *m_jit && utils::Path::isFileExist(library)) {
+        return casadi::external(key, library);
+    }
+    if (!name.empty() && !*m_jit && utils::Path::isFileExist(serialized)) {
+        return casadi::Function::load(serialized);
+    }
+
+    // The compilation is done once on disk when the functions are stored,
+    // otherwise it is left to the JIT of CasADi at each run. Both go through
+    // the shell compiler of CasADi, which adds the flags of the platform
+    casadi::Dict compilerOptions{
+        {"compiler", std::string(*m_compiler)},
+        {"linker", std::string(*m_compiler)},
+        {"flags", std::vector<std::string>{"-O2"}}
+    };
+    casadi::Dict options;
+    if (*m_jit && name.empty()) {
+        options["jit"] = true;
+        options["compiler"] = "shell";
+        options["jit_options"] = compilerOptions;
+    }
+
+    casadi::Function f;
+    if (*m_expand) {
+        f = casadi::Function(key, inputs, {output}, names, outputNames).expand(key,
+                options);
+    } else {
+        f = casadi::Function(key, inputs, {output}, names, outputNames, options);
+    }
+
+    if (name.empty()) {
+        return f;
+    }
+    if (!utils::Path::isFolderExist(*m_cacheFolder)) {
+        utils::Path(*m_cacheFolder).createFolder();
+    }
+    if (!*m_jit) {
+        f.save(serialized);
+        return f;
+    }
+
+    casadi::CodeGenerator generator(name + ".c");
+    generator.add(f);
+    utils::String source(generator.generate(*m_cacheFolder));
+    compilerOptions["name"] = std::string(name);
+    compilerOptions["directory"] = std::string(*m_cacheFolder);
+    compilerOptions["temp_suffix"] = false;
+    compilerOptions["cleanup"] = false;
+    return casadi::external(key, casadi::Importer(source, "shell", compilerOptions));
+}
+#endif
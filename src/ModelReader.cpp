@@ -1058,6 +1058,10 @@ void Reader::readModelFile(
         model->closeActuator();
     }
 #endif // MODULE_ACTUATORS
+#ifdef MODULE_MUSCLES
+    // The muscles are complete, so their points can be attached to the bodies once
+    model->resolveMusclesPointsBodyId();
+#endif // MODULE_MUSCLES
     // Close file
     // std::cout << "Model file successfully loaded" << std::endl;
     file.close();
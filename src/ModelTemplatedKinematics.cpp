@@ -0,0 +1,115 @@
+#define BIORBD_API_EXPORTS
+#include "ModelTemplatedKinematics.h"
+
+#include <unsupported/Eigen/AutoDiff>
+
+#include "BiorbdModel.h"
+#include "Utils/Error.h"
+
+using namespace BIORBD_NAMESPACE;
+
+#ifndef BIORBD_USE_CASADI_MATH
+namespace
+{
+typedef Eigen::AutoDiffScalar<Eigen::VectorXd> AutoDiff;
+
+// Seed the derivatives of Q with the identity so a forward sweep gives the jacobian
+Eigen::Matrix<AutoDiff, Eigen::Dynamic, 1> seed(
+    const Eigen::VectorXd& Q)
+{
+    Eigen::Matrix<AutoDiff, Eigen::Dynamic, 1> out(Q.size());
+    for (Eigen::Index i=0; i<Q.size(); ++i) {
+        out(i) = AutoDiff(Q(i), Q.size(), i);
+    }
+    return out;
+}
+
+Eigen::VectorXd derivatives(
+    const AutoDiff& value,
+    unsigned int nbQ)
+{
+    // A value that does not depend on Q keeps empty derivatives
+    if (value.derivatives().size() == 0) {
+        return Eigen::VectorXd::Zero(nbQ);
+    }
+    return value.derivatives();
+}
+}
+
+TemplatedKinematics::TemplatedKinematics(
+    Model& model) :
+    m_nbQ(model.nbQ()),
+    m_mass(0)
+{
+    ModelDescription description(model);
+    m_segments = description.segments();
+    m_markers = description.markers();
+    m_muscles = description.muscles();
+    for (const SegmentDescription& segment : m_segments) {
+        m_mass += segment.mass;
+    }
+}
+
+unsigned int TemplatedKinematics::nbQ() const
+{
+    return m_nbQ;
+}
+
+unsigned int TemplatedKinematics::nbSegment() const
+{
+    return static_cast<unsigned int>(m_segments.size());
+}
+
+unsigned int TemplatedKinematics::nbMarkers() const
+{
+    return static_cast<unsigned int>(m_markers.size());
+}
+
+unsigned int TemplatedKinematics::nbMuscles() const
+{
+    return static_cast<unsigned int>(m_muscles.size());
+}
+
+void TemplatedKinematics::markersJacobian(
+    const Eigen::VectorXd& Q,
+    Eigen::MatrixXd& jacobian,
+    bool removeAxis) const
+{
+    utils::Error::check(Q.size() == nbQ(), "Q must have nbQ elements");
+    Eigen::Matrix<AutoDiff, 3, Eigen::Dynamic> positions;
+    markers(seed(Q), positions, removeAxis);
+    jacobian.resize(3*nbMarkers(), nbQ());
+    for (unsigned int i=0; i<nbMarkers(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            jacobian.row(3*i+j) = derivatives(positions(j, i), nbQ()).transpose();
+        }
+    }
+}
+
+void TemplatedKinematics::CoMJacobian(
+    const Eigen::VectorXd& Q,
+    Eigen::MatrixXd& jacobian) const
+{
+    utils::Error::check(Q.size() == nbQ(), "Q must have nbQ elements");
+    Eigen::Matrix<AutoDiff, 3, 1> com;
+    CoM(seed(Q), com);
+    jacobian.resize(3, nbQ());
+    for (unsigned int j=0; j<3; ++j) {
+        jacobian.row(j) = derivatives(com(j), nbQ()).transpose();
+    }
+}
+
+void TemplatedKinematics::musclesLengthJacobian(
+    const Eigen::VectorXd& Q,
+    Eigen::MatrixXd& jacobian) const
+{
+    utils::Error::check(Q.size() == nbQ(), "Q must have nbQ elements");
+    Eigen::Matrix<AutoDiff, Eigen::Dynamic, 1> musculoTendonLength;
+    Eigen::Matrix<AutoDiff, Eigen::Dynamic, 1> length;
+    musclesLength(seed(Q), musculoTendonLength, length);
+    jacobian.resize(nbMuscles(), nbQ());
+    for (unsigned int m=0; m<nbMuscles(); ++m) {
+        jacobian.row(m) = derivatives(length(m), nbQ()).transpose();
+    }
+}
+#endif
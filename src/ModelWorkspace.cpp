@@ -0,0 +1,46 @@
+#define BIORBD_API_EXPORTS
+#include "ModelWorkspace.h"
+
+#ifdef MODULE_MUSCLES
+    #include "Muscles/MuscleGroup.h"
+#endif
+
+using namespace BIORBD_NAMESPACE;
+
+ModelWorkspace::ModelWorkspace(
+    const Model &model) :
+    Model(model)
+{
+    detachMutableState();
+}
+
+ModelWorkspace::ModelWorkspace(
+    const ModelWorkspace &other) :
+    Model(other)
+{
+    detachMutableState();
+}
+
+void ModelWorkspace::detachMutableState()
+{
+    // The RBDL buffers and the kinematics cache are already copied by
+    // the Joints copy constructor. The contacts buffers are copied as well,
+    // but the flag telling if they are bound to the model is not
+    m_isBinded = std::make_shared<bool>(*m_isBinded);
+
+    // The workspace of the markers jacobians is written on each call
+    m_motionSubspaceInGlobal = std::make_shared<RigidBodyDynamics::Math::MatrixNd>();
+
+#ifdef MODULE_MUSCLES
+    // Muscles store their geometry and states while being computed
+    std::shared_ptr<std::vector<muscles::MuscleGroup>> groups(
+                std::make_shared<std::vector<muscles::MuscleGroup>>());
+    for (unsigned int i=0; i<m_mus->size(); ++i) {
+        groups->push_back((*m_mus)[i].DeepCopy());
+    }
+    m_mus = groups;
+
+    // The lookups of the body ids during the updates are then read-only
+    resolveMusclesPointsBodyId();
+#endif
+}
@@ -4,6 +4,7 @@
 #include <rbdl/Model.h>
 #include <rbdl/Kinematics.h>
 #include "Utils/Error.h"
+#include "Utils/String.h"
 #include "Utils/Matrix.h"
 #include "Utils/RotoTrans.h"
 #include "RigidBody/NodeSegment.h"
@@ -27,6 +28,9 @@ muscles::Geometry::Geometry() :
                         (utils::Vector3d::Zero())),
     m_pointsInGlobal(std::make_shared<std::vector<utils::Vector3d>>()),
     m_pointsInLocal(std::make_shared<std::vector<utils::Vector3d>>()),
+    m_pointsBodyId(std::make_shared<std::vector<unsigned int>>()),
+    m_pointsParent(std::make_shared<std::vector<utils::String>>()),
+    m_isPointsBodyIdResolved(std::make_shared<bool>(false)),
     m_jacobian(std::make_shared<utils::Matrix>()),
     m_G(std::make_shared<utils::Matrix>()),
     m_jacobianLength(std::make_shared<utils::Matrix>()),
@@ -51,6 +55,9 @@ muscles::Geometry::Geometry(
                         (utils::Vector3d::Zero())),
     m_pointsInGlobal(std::make_shared<std::vector<utils::Vector3d>>()),
     m_pointsInLocal(std::make_shared<std::vector<utils::Vector3d>>()),
+    m_pointsBodyId(std::make_shared<std::vector<unsigned int>>()),
+    m_pointsParent(std::make_shared<std::vector<utils::String>>()),
+    m_isPointsBodyIdResolved(std::make_shared<bool>(false)),
     m_jacobian(std::make_shared<utils::Matrix>()),
     m_G(std::make_shared<utils::Matrix>()),
     m_jacobianLength(std::make_shared<utils::Matrix>()),
@@ -85,6 +92,9 @@ void muscles::Geometry::DeepCopy(const muscles::Geometry &other)
     for (unsigned int i=0; i<other.m_pointsInLocal->size(); ++i) {
         (*m_pointsInLocal)[i] = (*other.m_pointsInLocal)[i].DeepCopy();
     }
+    *m_pointsBodyId = *other.m_pointsBodyId;
+    *m_pointsParent = *other.m_pointsParent;
+    *m_isPointsBodyIdResolved = *other.m_isPointsBodyIdResolved;
     *m_jacobian = *other.m_jacobian;
     *m_G = *other.m_G;
     *m_jacobianLength = *other.m_jacobianLength;
@@ -204,6 +214,7 @@ void muscles::Geometry::setOrigin(
 {
     if (dynamic_cast<const rigidbody::NodeSegment*>(&position)) {
         *m_origin = position;
+        m_pointsBodyId->clear();
     } else {
         // Preserve the Node information
         m_origin->RigidBodyDynamics::Math::Vector3d::operator=(position);
@@ -219,6 +230,7 @@ void muscles::Geometry::setInsertionInLocal(
 {
     if (dynamic_cast<const rigidbody::NodeSegment*>(&position)) {
         *m_insertion = position;
+        m_pointsBodyId->clear();
     } else {
         // Preserve the Node information
         m_insertion->RigidBodyDynamics::Math::Vector3d::operator=(position);
@@ -332,10 +344,13 @@ const utils::Vector3d &muscles::Geometry::originInGlobal(
     rigidbody::Joints &model,
     const rigidbody::GeneralizedCoordinates &Q)
 {
+    unsigned int id(m_pointsBodyId->empty() ?
+                    model.GetBodyId(m_origin->parent().c_str()) : m_pointsBodyId->front());
+
     // Return the position of the marker in function of the given position
     m_originInGlobal->block(0,0,3,
                             1) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q,
-                                    model.GetBodyId(m_origin->parent().c_str()), *m_origin,false);
+                                    id, *m_origin,false);
     return *m_originInGlobal;
 }
 
@@ -343,10 +358,13 @@ const utils::Vector3d &muscles::Geometry::insertionInGlobal(
     rigidbody::Joints &model,
     const rigidbody::GeneralizedCoordinates &Q)
 {
+    unsigned int id(m_pointsBodyId->empty() ?
+                    model.GetBodyId(m_insertion->parent().c_str()) : m_pointsBodyId->back());
+
     // Return the position of the marker in function of the given position
     m_insertionInGlobal->block(0,0,3,
                                1) = RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q,
-                                       model.GetBodyId(m_insertion->parent().c_str()), *m_insertion,false);
+                                       id, *m_insertion,false);
     return *m_insertionInGlobal;
 }
 
@@ -368,8 +386,15 @@ void muscles::Geometry::setMusclesPointsInGlobal(
     m_pointsInLocal->clear();
     m_pointsInGlobal->clear();
 
+    // The ids are only read, the points whose parent changed since they were resolved are looked up by name
+    bool isResolved(isPointsBodyIdResolved(pathModifiers));
+    *m_isPointsBodyIdResolved = isResolved;
+    auto bodyId = [&](unsigned int idx, const utils::String& parent) {
+        return isResolved ? (*m_pointsBodyId)[idx] : model.GetBodyId(parent.c_str());
+    };
+
     // Do not apply on wrapping objects
-    if (pathModifiers->nbWraps()!=0) {
+    if (pathModifiers != nullptr && pathModifiers->nbWraps()!=0) {
         // CHECK TO MODIFY BEFOR GOING FORWARD WITH PROJECTS
         utils::Error::check(pathModifiers->nbVia() == 0,
                                     "Cannot mix wrapping and via points yet") ;
@@ -399,11 +424,11 @@ void muscles::Geometry::setMusclesPointsInGlobal(
         m_pointsInLocal->push_back(originInLocal());
         m_pointsInLocal->push_back(
             utils::Vector3d(RigidBodyDynamics::CalcBodyToBaseCoordinates(
-                                        model, Q, model.GetBodyId(w.parent().c_str()),po_wrap, false),
+                                        model, Q, bodyId(1, w.parent()), po_wrap, false),
                                     "wrap_o", w.parent()));
         m_pointsInLocal->push_back(
             utils::Vector3d(RigidBodyDynamics::CalcBodyToBaseCoordinates(
-                                        model, Q, model.GetBodyId(w.parent().c_str()),pi_wrap, false),
+                                        model, Q, bodyId(2, w.parent()), pi_wrap, false),
                                     "wrap_i", w.parent()));
         m_pointsInLocal->push_back(insertionInLocal());
 
@@ -415,7 +440,7 @@ void muscles::Geometry::setMusclesPointsInGlobal(
 
     }
 
-    else if (pathModifiers->nbObjects()!=0
+    else if (pathModifiers != nullptr && pathModifiers->nbObjects()!=0
              && pathModifiers->object(0).typeOfNode() ==
              utils::NODE_TYPE::VIA_POINT) {
         m_pointsInLocal->push_back(originInLocal());
@@ -426,12 +451,12 @@ void muscles::Geometry::setMusclesPointsInGlobal(
             m_pointsInLocal->push_back(node);
             m_pointsInGlobal->push_back(RigidBodyDynamics::CalcBodyToBaseCoordinates(model,
                                         Q,
-                                        model.GetBodyId(node.parent().c_str()), node, false));
+                                        bodyId(i+1, node.parent()), node, false));
         }
         m_pointsInLocal->push_back(insertionInLocal());
         m_pointsInGlobal->push_back(insertionInGlobal(model,Q));
 
-    } else if (pathModifiers->nbObjects()==0) {
+    } else if (pathModifiers == nullptr || pathModifiers->nbObjects()==0) {
         m_pointsInLocal->push_back(originInLocal());
         m_pointsInLocal->push_back(insertionInLocal());
         m_pointsInGlobal->push_back(originInGlobal(model, Q));
@@ -444,6 +469,54 @@ void muscles::Geometry::setMusclesPointsInGlobal(
     setJacobianDimension(model);
 }
 
+void muscles::Geometry::resolvePointsBodyId(
+    const rigidbody::Joints &model,
+    const muscles::PathModifiers *pathModifiers)
+{
+    // The points are the origin, the path modifiers (a wrapping adds two points) and the insertion
+    m_pointsParent->clear();
+    m_pointsParent->push_back(m_origin->parent());
+    if (pathModifiers != nullptr) {
+        if (pathModifiers->nbWraps() != 0) {
+            m_pointsParent->push_back(pathModifiers->object(0).parent());
+            m_pointsParent->push_back(pathModifiers->object(0).parent());
+        } else {
+            for (unsigned int i=0; i<pathModifiers->nbObjects(); ++i) {
+                m_pointsParent->push_back(pathModifiers->object(i).parent());
+            }
+        }
+    }
+    m_pointsParent->push_back(m_insertion->parent());
+
+    m_pointsBodyId->clear();
+    for (const utils::String& parent : *m_pointsParent) {
+        m_pointsBodyId->push_back(model.GetBodyId(parent.c_str()));
+    }
+}
+
+bool muscles::Geometry::isPointsBodyIdResolved(
+    const muscles::PathModifiers *pathModifiers) const
+{
+    const std::vector<utils::String>& parents(*m_pointsParent);
+    size_t nbPoints(2);
+    if (pathModifiers != nullptr) {
+        nbPoints += pathModifiers->nbWraps() != 0 ? 2 : pathModifiers->nbObjects();
+    }
+    if (m_pointsBodyId->size() != nbPoints || parents.size() != nbPoints
+            || parents.front().compare(m_origin->parent())
+            || parents.back().compare(m_insertion->parent())) {
+        return false;
+    }
+    for (size_t i=1; i<nbPoints-1; ++i) {
+        const utils::Vector3d& object(pathModifiers->object(
+                                          pathModifiers->nbWraps() != 0 ? 0 : static_cast<unsigned int>(i-1)));
+        if (parents[i].compare(object.parent())) {
+            return false;
+        }
+    }
+    return true;
+}
+
 const utils::Scalar& muscles::Geometry::length(
     const muscles::Characteristics *characteristics,
     muscles::PathModifiers *pathModifiers)
@@ -510,10 +583,12 @@ void muscles::Geometry::jacobian(
     rigidbody::Joints &model,
     const rigidbody::GeneralizedCoordinates &Q)
 {
+    bool isResolved(*m_isPointsBodyIdResolved);
     for (unsigned int i=0; i<m_pointsInLocal->size(); ++i) {
         m_G->setZero();
         RigidBodyDynamics::CalcPointJacobian(model, Q,
-                                             model.GetBodyId((*m_pointsInLocal)[i].parent().c_str()),
+                                             isResolved ? (*m_pointsBodyId)[i]
+                                             : model.GetBodyId((*m_pointsInLocal)[i].parent().c_str()),
                                              (*m_pointsInLocal)[i], *m_G, false); // False for speed
         m_jacobian->block(3*i,0,3,model.dof_count) = *m_G;
     }
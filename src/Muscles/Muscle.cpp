@@ -109,7 +109,20 @@ void muscles::Muscle::DeepCopy(const muscles::Muscle &other)
     this->muscles::Compound::DeepCopy(other);
     *m_position = other.m_position->DeepCopy();
     *m_characteristics = other.m_characteristics->DeepCopy();
-    *m_state = other.m_state->DeepCopy();
+
+    // Keep the dynamic type of the state, on which activationDot relies
+    if (auto buchanan = std::dynamic_pointer_cast<muscles::StateDynamicsBuchanan>
+                        (other.m_state)) {
+        m_state = std::make_shared<muscles::StateDynamicsBuchanan>(buchanan->DeepCopy());
+    } else if (auto deGroote = std::dynamic_pointer_cast<muscles::StateDynamicsDeGroote>
+                               (other.m_state)) {
+        m_state = std::make_shared<muscles::StateDynamicsDeGroote>(deGroote->DeepCopy());
+    } else if (auto dynamic = std::dynamic_pointer_cast<muscles::StateDynamics>
+                              (other.m_state)) {
+        m_state = std::make_shared<muscles::StateDynamics>(dynamic->DeepCopy());
+    } else {
+        *m_state = other.m_state->DeepCopy();
+    }
 }
 
 void muscles::Muscle::updateOrientations(
@@ -61,29 +61,34 @@ void muscles::MuscleGroup::DeepCopy(const muscles::MuscleGroup
     for (unsigned int i=0; i<other.m_mus->size(); ++i) {
         if ((*other.m_mus)[i]->type() ==
                 muscles::MUSCLE_TYPE::IDEALIZED_ACTUATOR) {
-            (*m_mus)[i] = std::make_shared<muscles::IdealizedActuator>((
-                              *other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<muscles::IdealizedActuator>(
+                              std::static_pointer_cast<muscles::IdealizedActuator>(
+                                  (*other.m_mus)[i])->DeepCopy());
         } else if ((*other.m_mus)[i]->type() == muscles::MUSCLE_TYPE::HILL) {
-            (*m_mus)[i] = std::make_shared<muscles::HillType>((*other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<muscles::HillType>(
+                              std::static_pointer_cast<muscles::HillType>(
+                                  (*other.m_mus)[i])->DeepCopy());
         } else if ((*other.m_mus)[i]->type() ==
                    muscles::MUSCLE_TYPE::HILL_THELEN) {
-            (*m_mus)[i] = std::make_shared<muscles::HillThelenType>((
-                              *other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<muscles::HillThelenType>(
+                              std::static_pointer_cast<muscles::HillThelenType>(
+                                  (*other.m_mus)[i])->DeepCopy());
         } else if ((*other.m_mus)[i]->type() ==
                    muscles::MUSCLE_TYPE::HILL_THELEN_ACTIVE) {
-            (*m_mus)[i] = std::make_shared<muscles::HillThelenActiveOnlyType>((
-                              *other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<muscles::HillThelenActiveOnlyType>(
+                              std::static_pointer_cast<muscles::HillThelenActiveOnlyType>(
+                                  (*other.m_mus)[i])->DeepCopy());
         } else if ((*other.m_mus)[i]->type() ==
                    muscles::MUSCLE_TYPE::HILL_THELEN_FATIGABLE) {
-            (*m_mus)[i] = std::make_shared<muscles::HillThelenTypeFatigable>((
-                              *other.m_mus)[i]);
+            (*m_mus)[i] = std::make_shared<muscles::HillThelenTypeFatigable>(
+                              std::static_pointer_cast<muscles::HillThelenTypeFatigable>(
+                                  (*other.m_mus)[i])->DeepCopy());
         } else {
             utils::Error::raise("DeepCopy was not prepared to copy " +
                                         utils::String(
                                             muscles::MUSCLE_TYPE_toStr((*other.m_mus)[i]->type())) + " type");
         }
     }
-    *m_mus = *other.m_mus;
     *m_name = *other.m_name;
     *m_originName = *other.m_originName;
     *m_insertName = *other.m_insertName;
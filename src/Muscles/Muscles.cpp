@@ -277,6 +277,18 @@ unsigned int muscles::Muscles::nbMuscles() const
     return total;
 }
 
+void muscles::Muscles::resolveMusclesPointsBodyId()
+{
+    // Assuming that this is also a Joints type (via BiorbdModel)
+    const rigidbody::Joints &model = dynamic_cast<const rigidbody::Joints &>(*this);
+    for (auto& group : *m_mus) {
+        for (unsigned int i=0; i<group.nbMuscles(); ++i) {
+            muscles::Muscle& muscle(group.muscle(i));
+            muscle.m_position->resolvePointsBodyId(model, muscle.m_pathChanger.get());
+        }
+    }
+}
+
 void muscles::Muscles::updateMuscles(
     const rigidbody::GeneralizedCoordinates& Q,
     const rigidbody::GeneralizedVelocity& QDot,
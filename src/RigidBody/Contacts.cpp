@@ -16,7 +16,8 @@ using namespace BIORBD_NAMESPACE;
 rigidbody::Contacts::Contacts() :
     RigidBodyDynamics::ConstraintSet (),
     m_nbreConstraint(std::make_shared<unsigned int>(0)),
-    m_isBinded(std::make_shared<bool>(false))
+    m_isBinded(std::make_shared<bool>(false)),
+    m_solver(std::make_shared<CONTACT_SOLVER_TYPE>(DIRECT))
 {
 
 }
@@ -34,6 +35,7 @@ void rigidbody::Contacts::DeepCopy(const rigidbody::Contacts
     static_cast<RigidBodyDynamics::ConstraintSet&>(*this) = other;
     *m_nbreConstraint = *other.m_nbreConstraint;
     *m_isBinded = *other.m_isBinded;
+    *m_solver = *other.m_solver;
 
 }
 
@@ -158,6 +160,10 @@ rigidbody::Contacts::constraintsInGlobal(
     updateKin = true;
 #endif
 
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
+
     // Output variable
     std::vector<utils::Vector3d> tp;
 
@@ -167,10 +173,7 @@ rigidbody::Contacts::constraintsInGlobal(
         for (unsigned int j=0; j<contactConstraints[i]->getConstraintSize(); ++j) {
             tp.push_back(RigidBodyDynamics::CalcBodyToBaseCoordinates(
                              model, Q, contactConstraints[i]->getBodyIds()[0],
-                             contactConstraints[i]->getBodyFrames()[0].r, updateKin));
-#ifndef BIORBD_USE_CASADI_MATH
-            updateKin = false;
-#endif
+                             contactConstraints[i]->getBodyFrames()[0].r, false));
         }
     }
 
@@ -181,3 +184,14 @@ utils::Vector rigidbody::Contacts::getForce() const
 {
     return static_cast<utils::Vector>(this->force);
 }
+
+void rigidbody::Contacts::setContactSolver(
+    rigidbody::CONTACT_SOLVER_TYPE type)
+{
+    *m_solver = type;
+}
+
+rigidbody::CONTACT_SOLVER_TYPE rigidbody::Contacts::contactSolver() const
+{
+    return *m_solver;
+}
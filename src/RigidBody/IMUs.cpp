@@ -1,8 +1,10 @@
 #define BIORBD_API_EXPORTS
 #include "RigidBody/IMUs.h"
 
+#include <limits>
 #include <rbdl/Model.h>
 #include <rbdl/Kinematics.h>
+#include "Utils/Error.h"
 #include "Utils/String.h"
 #include "Utils/Matrix.h"
 #include "Utils/Rotation.h"
@@ -14,7 +16,9 @@
 using namespace BIORBD_NAMESPACE;
 
 rigidbody::IMUs::IMUs() :
-    m_IMUs(std::make_shared<std::vector<rigidbody::IMU>>())
+    m_IMUs(std::make_shared<std::vector<rigidbody::IMU>>()),
+    m_IMUsBodyId(std::make_shared<std::vector<unsigned int>>()),
+    m_IMUsSegmentIdx(std::make_shared<std::vector<int>>())
 {
     //ctor
 }
@@ -22,6 +26,8 @@ rigidbody::IMUs::IMUs() :
 rigidbody::IMUs::IMUs(const rigidbody::IMUs &other)
 {
     m_IMUs = other.m_IMUs;
+    m_IMUsBodyId = other.m_IMUsBodyId;
+    m_IMUsSegmentIdx = other.m_IMUsSegmentIdx;
 }
 
 rigidbody::IMUs::~IMUs()
@@ -42,6 +48,8 @@ void rigidbody::IMUs::DeepCopy(const rigidbody::IMUs &other)
     for (unsigned int i=0; i<other.m_IMUs->size(); ++i) {
         (*m_IMUs)[i] = (*other.m_IMUs)[i].DeepCopy();
     }
+    *m_IMUsBodyId = *other.m_IMUsBodyId;
+    *m_IMUsSegmentIdx = *other.m_IMUsSegmentIdx;
 }
 
 void rigidbody::IMUs::addIMU(
@@ -49,6 +57,7 @@ void rigidbody::IMUs::addIMU(
     bool anatomical)
 {
     m_IMUs->push_back(rigidbody::IMU(technical, anatomical));
+    resolveLastIMUParent();
 }
 
 // Add a new marker to the existing pool of markers
@@ -58,6 +67,41 @@ void rigidbody::IMUs::addIMU(
     bool anatomical)
 {
     m_IMUs->push_back(rigidbody::IMU(RotoTrans, technical, anatomical));
+    resolveLastIMUParent();
+}
+
+void rigidbody::IMUs::resolveLastIMUParent()
+{
+    // Resolve the parent once so the kinematics does not have to look it up by name
+    const rigidbody::Joints* model = dynamic_cast<const rigidbody::Joints*>(this);
+    const utils::String& parent(m_IMUs->back().parent());
+    m_IMUsBodyId->push_back(model ? model->GetBodyId(parent.c_str())
+                            : std::numeric_limits<unsigned int>::max());
+    m_IMUsSegmentIdx->push_back(model ? model->GetBodyBiorbdId(parent) : -1);
+}
+
+unsigned int rigidbody::IMUs::IMUSegmentIdx(
+    unsigned int idx)
+{
+    int& segmentIdx((*m_IMUsSegmentIdx)[idx]);
+    if (segmentIdx < 0) {
+        // The IMU was added while not being part of a model
+        segmentIdx = dynamic_cast<rigidbody::Joints &>(*this).GetBodyBiorbdId(
+                         (*m_IMUs)[idx].parent());
+    }
+    return static_cast<unsigned int>(segmentIdx);
+}
+
+unsigned int rigidbody::IMUs::IMUBodyId(
+    unsigned int idx)
+{
+    unsigned int& id((*m_IMUsBodyId)[idx]);
+    if (id == std::numeric_limits<unsigned int>::max()) {
+        // The IMU was added while not being part of a model
+        id = dynamic_cast<rigidbody::Joints &>(*this).GetBodyId(
+                 (*m_IMUs)[idx].parent().c_str());
+    }
+    return id;
 }
 
 unsigned int rigidbody::IMUs::nbIMUs() const
@@ -119,11 +163,7 @@ rigidbody::IMU rigidbody::IMUs::IMU(
         model.UpdateKinematicsCustom (&Q);
     }
 
-    rigidbody::IMU node = IMU(idx);
-    unsigned int id = static_cast<unsigned int>(model.GetBodyBiorbdId(
-                          node.parent()));
-
-    return model.globalJCS(id) * node;
+    return model.globalJCS(IMUSegmentIdx(idx)) * IMU(idx);
 }
 
 // Get the technical IMUs
@@ -214,6 +254,66 @@ rigidbody::IMUs::TechnicalIMUJacobian(
     return IMUJacobian(Q, updateKin, true);
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::IMUs::technicalIMU(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::VectorXd> rotations,
+    bool updateKin)
+{
+#ifndef SKIP_ASSERT
+    utils::Error::check(static_cast<unsigned int>(rotations.size()) == 9*nbTechIMUs(),
+                                "Wrong size for the rotations of the IMUs");
+#endif
+    // Assuming that this is also a Joints type (via BiorbdModel)
+    rigidbody::Joints &model = dynamic_cast<rigidbody::Joints &>(*this);
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
+
+    unsigned int row(0);
+    for (unsigned int idx=0; idx<nbIMUs(); ++idx) {
+        if (!IMU(idx).isTechnical()) {
+            continue;
+        }
+        RigidBodyDynamics::Math::Matrix3d rot(
+            RigidBodyDynamics::CalcBodyWorldOrientation(model, Q, IMUBodyId(idx), false).transpose()
+            * IMU(idx).rot());
+        for (unsigned int j=0; j<3; ++j) {
+            rotations.segment<3>(row + 3*j) = rot.col(j);
+        }
+        row += 9;
+    }
+}
+
+void rigidbody::IMUs::TechnicalIMUJacobian(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::MatrixXd> jacobian,
+    bool updateKin)
+{
+    // Assuming that this is also a Joints type (via BiorbdModel)
+    rigidbody::Joints &model = dynamic_cast<rigidbody::Joints &>(*this);
+#ifndef SKIP_ASSERT
+    utils::Error::check(static_cast<unsigned int>(jacobian.rows()) == 9*nbTechIMUs()
+                                && static_cast<unsigned int>(jacobian.cols()) == model.nbQdot(),
+                                "Wrong size for the jacobian of the IMUs");
+#endif
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
+
+    jacobian.setZero();
+    unsigned int row(0);
+    for (unsigned int idx=0; idx<nbIMUs(); ++idx) {
+        const rigidbody::IMU& node(IMU(idx));
+        if (!node.isTechnical()) {
+            continue;
+        }
+        model.CalcMatRotJacobian(Q, IMUBodyId(idx), node.rot(),
+                                 jacobian.block(row, 0, 9, jacobian.cols()), false);
+        row += 9;
+    }
+}
+#endif
 
 // Protected function
 std::vector<utils::Matrix> rigidbody::IMUs::IMUJacobian(
@@ -229,16 +329,16 @@ std::vector<utils::Matrix> rigidbody::IMUs::IMUJacobian(
 
     for (unsigned int idx=0; idx<nbIMUs(); ++idx) {
         // Actual marker
-        rigidbody::IMU node = IMU(idx);
+        const rigidbody::IMU& node(IMU(idx));
         if (lookForTechnical && !node.isTechnical()) {
             continue;
         }
 
-        unsigned int id = model.GetBodyId(node.parent().c_str());
         utils::Matrix G_tp(utils::Matrix::Zero(9,model.dof_count));
 
         // Calculate the Jacobian of this Tag
-        model.CalcMatRotJacobian(Q, id, node.rot(), G_tp, updateKin); // False for speed
+        model.CalcMatRotJacobian(Q, IMUBodyId(idx), node.rot(), G_tp,
+                                 updateKin); // False for speed
 
         G.push_back(G_tp);
     }
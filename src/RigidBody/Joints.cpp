@@ -13,6 +13,8 @@
 #include "Utils/RotoTrans.h"
 #include "Utils/Rotation.h"
 #include "Utils/SpatialVector.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/Timer.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedVelocity.h"
 #include "RigidBody/GeneralizedAcceleration.h"
@@ -37,7 +39,15 @@ rigidbody::Joints::Joints() :
     m_nbQddot(std::make_shared<unsigned int>(0)),
     m_nRotAQuat(std::make_shared<unsigned int>(0)),
     m_isKinematicsComputed(std::make_shared<bool>(false)),
-    m_totalMass(std::make_shared<utils::Scalar>(0))
+    m_kinematicsCacheQ(std::make_shared<utils::Vector>()),
+    m_kinematicsCacheQdot(std::make_shared<utils::Vector>()),
+    m_kinematicsCacheQddot(std::make_shared<utils::Vector>()),
+    m_nbKinematicsCacheHits(std::make_shared<unsigned long>(0)),
+    m_nbKinematicsCacheMisses(std::make_shared<unsigned long>(0)),
+    m_totalMass(std::make_shared<utils::Scalar>(0)),
+    m_threadPool(std::make_shared<utils::ThreadPool>()),
+    m_batchModels(std::make_shared<std::vector<rigidbody::Joints>>()),
+    m_collapseDofs(std::make_shared<bool>(false))
 {
     // Redefining gravity so it is on z by default
     this->gravity = utils::Vector3d (0, 0, -9.81);
@@ -52,8 +62,20 @@ rigidbody::Joints::Joints(const rigidbody::Joints &other) :
     m_nbQdot(other.m_nbQdot),
     m_nbQddot(other.m_nbQddot),
     m_nRotAQuat(other.m_nRotAQuat),
-    m_isKinematicsComputed(other.m_isKinematicsComputed),
-    m_totalMass(other.m_totalMass)
+    // The RBDL kinematics is copied (not shared), so is the kinematics cache
+    m_isKinematicsComputed(std::make_shared<bool>(*other.m_isKinematicsComputed)),
+    m_kinematicsCacheQ(std::make_shared<utils::Vector>(*other.m_kinematicsCacheQ)),
+    m_kinematicsCacheQdot(std::make_shared<utils::Vector>(*other.m_kinematicsCacheQdot)),
+    m_kinematicsCacheQddot(std::make_shared<utils::Vector>(*other.m_kinematicsCacheQddot)),
+    m_nbKinematicsCacheHits(std::make_shared<unsigned long>(*other.m_nbKinematicsCacheHits)),
+    m_nbKinematicsCacheMisses(std::make_shared<unsigned long>(*other.m_nbKinematicsCacheMisses)),
+    m_totalMass(other.m_totalMass),
+    // Each copy has its own threads (only spawned when needed), so batches
+    // on different copies neither wait for each other nor deadlock
+    m_threadPool(std::make_shared<utils::ThreadPool>(other.m_threadPool->nbThreads())),
+    // The copies of the workers are made from this instance when first needed
+    m_batchModels(std::make_shared<std::vector<rigidbody::Joints>>()),
+    m_collapseDofs(other.m_collapseDofs)
 {
 
 }
@@ -84,7 +106,15 @@ void rigidbody::Joints::DeepCopy(const rigidbody::Joints &other)
     *m_nbQddot = *other.m_nbQddot;
     *m_nRotAQuat = *other.m_nRotAQuat;
     *m_isKinematicsComputed = *other.m_isKinematicsComputed;
+    *m_kinematicsCacheQ = *other.m_kinematicsCacheQ;
+    *m_kinematicsCacheQdot = *other.m_kinematicsCacheQdot;
+    *m_kinematicsCacheQddot = *other.m_kinematicsCacheQddot;
+    *m_nbKinematicsCacheHits = *other.m_nbKinematicsCacheHits;
+    *m_nbKinematicsCacheMisses = *other.m_nbKinematicsCacheMisses;
     *m_totalMass = *other.m_totalMass;
+    m_threadPool->setNbThreads(other.m_threadPool->nbThreads());
+    invalidateBatchModels();
+    *m_collapseDofs = *other.m_collapseDofs;
 }
 
 unsigned int rigidbody::Joints::nbGeneralizedTorque() const
@@ -170,6 +200,8 @@ unsigned int rigidbody::Joints::AddSegment(
     *m_totalMass +=
         characteristics.mMass; // Add the segment mass to the total body mass
     m_segments->push_back(tp);
+    invalidateKinematicsCache();
+    invalidateBatchModels();
     return 0;
 }
 unsigned int rigidbody::Joints::AddSegment(
@@ -198,9 +230,24 @@ unsigned int rigidbody::Joints::AddSegment(
     *m_totalMass +=
         characteristics.mMass; // Add the segment mass to the total body mass
     m_segments->push_back(tp);
+    invalidateKinematicsCache();
+    invalidateBatchModels();
     return 0;
 }
 
+void rigidbody::Joints::setCollapseDofs(
+    bool collapse)
+{
+    utils::Error::check(m_segments->size() == 0,
+                        "The DoF collapsing must be set before adding any segment");
+    *m_collapseDofs = collapse;
+}
+
+bool rigidbody::Joints::isCollapsingDofs() const
+{
+    return *m_collapseDofs;
+}
+
 utils::Vector3d rigidbody::Joints::getGravity() const
 {
     return gravity;
@@ -210,6 +257,8 @@ void rigidbody::Joints::setGravity(
     const utils::Vector3d &newGravity)
 {
     gravity = newGravity;
+    invalidateKinematicsCache();
+    invalidateBatchModels();
 }
 
 void rigidbody::Joints::updateSegmentCharacteristics(
@@ -219,6 +268,8 @@ void rigidbody::Joints::updateSegmentCharacteristics(
     utils::Error::check(idx < m_segments->size(),
                                 "Asked for a wrong segment (out of range)");
     (*m_segments)[idx].updateCharacteristics(*this, characteristics);
+    invalidateKinematicsCache();
+    invalidateBatchModels();
 }
 
 const rigidbody::Segment& rigidbody::Joints::segment(
@@ -261,29 +312,17 @@ rigidbody::Joints::dispatchedForce(
     std::vector<utils::SpatialVector> &sv)
 const  // a spatialVector per platform
 {
-    // Output table
-    std::vector<RigidBodyDynamics::Math::SpatialVector> sv_out;
-
-    // Null Spatial vector nul to fill the final table
+    // Output table, one per body (the first one is associated with the universe)
     utils::SpatialVector sv_zero(0.,0.,0.,0.,0.,0.);
-    sv_out.push_back(sv_zero); // The first one is associated with the universe
+    std::vector<RigidBodyDynamics::Math::SpatialVector> sv_out(
+        this->mBodies.size(), sv_zero);
 
-    // Dispatch the forces
+    // Dispatch the forces on the last body of each segment
     for (auto segment : *m_segments) {
-        unsigned int nbDof = segment.nbDof();
-        if (nbDof != 0) { // Do not add anything if the nbDoF is zero
-            // For each segment
-            for (unsigned int i=0; i<nbDof-1;
-                    ++i) { // Put a sv_zero on each DoF except the last one
-                sv_out.push_back(sv_zero);
-            }
-            if (segment.platformIdx() >=
-                    0) { // If the solid is in contact with the platform (!= -1)
-                sv_out.push_back(sv[static_cast<unsigned int>
-                                    (segment.platformIdx())]); // Put the force of the corresponding platform
-            } else {
-                sv_out.push_back(sv_zero);    // Otherwise, put zero
-            }
+        if (segment.nbDof() != 0 // Do not add anything if the nbDoF is zero
+                && segment.platformIdx() >= 0) { // If the solid is in contact with the platform (!= -1)
+            sv_out[segment.id()] = sv[static_cast<unsigned int>
+                                      (segment.platformIdx())]; // Put the force of the corresponding platform
         }
     }
 
@@ -318,6 +357,26 @@ const
     return out;
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Joints::allGlobalJCS(
+    const rigidbody::GeneralizedCoordinates &Q,
+    std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>> &JCS,
+    bool updateKin)
+{
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
+    JCS.resize(m_segments->size());
+    for (unsigned int i=0; i<m_segments->size(); ++i) {
+        const RigidBodyDynamics::Math::SpatialTransform& transform(
+            CalcBodyWorldTransformation((*m_segments)[i].id()));
+        JCS[i].block<3, 3>(0, 0) = transform.E;
+        JCS[i].block<3, 1>(0, 3) = transform.r;
+        JCS[i].block<1, 4>(3, 0) << 0, 0, 0, 1;
+    }
+}
+#endif
+
 utils::RotoTrans rigidbody::Joints::globalJCS(
     const rigidbody::GeneralizedCoordinates &Q,
     const utils::String &name)
@@ -575,6 +634,28 @@ utils::Vector3d rigidbody::Joints::CoM(
     return com;
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Joints::CoM(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::Vector3d> com,
+    bool updateKin)
+{
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
+
+    // CoM = sum(segment_mass * pos_com_seg) / total mass
+    com.setZero();
+    for (unsigned int i=0; i<m_segments->size(); ++i) {
+        const rigidbody::Segment& segment((*m_segments)[i]);
+        com += segment.characteristics().mMass
+               * RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                   *this, Q, segment.id(), segment.characteristics().mCenterOfMass, false);
+    }
+    com /= *m_totalMass;
+}
+#endif
+
 utils::Vector3d rigidbody::Joints::angularMomentum(
     const rigidbody::GeneralizedCoordinates &Q,
     const rigidbody::GeneralizedVelocity &Qdot,
@@ -590,12 +671,161 @@ utils::Matrix rigidbody::Joints::massMatrix (
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
     RigidBodyDynamics::Math::MatrixNd massMatrix(nbQ(), nbQ());
     massMatrix.setZero();
-    RigidBodyDynamics::CompositeRigidBodyAlgorithm(*this, Q, massMatrix, updateKin);
+    RigidBodyDynamics::CompositeRigidBodyAlgorithm(*this, Q, massMatrix, false);
     return massMatrix;
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+utils::Matrix rigidbody::Joints::massMatrixInverse (
+    const rigidbody::GeneralizedCoordinates &Q,
+    bool updateKin)
+{
+    using RigidBodyDynamics::Math::SpatialMatrix;
+    using RigidBodyDynamics::Math::MatrixNd;
+
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
+
+    unsigned int nbBodies(static_cast<unsigned int>(this->mBodies.size()));
+    unsigned int nbDof(nbQdot());
+    std::vector<SpatialMatrix, Eigen::aligned_allocator<SpatialMatrix>>
+            IA(nbBodies, SpatialMatrix::Zero());
+    std::vector<MatrixNd> U(nbBodies);
+    std::vector<MatrixNd> Dinv(nbBodies);
+    // Bias forces of all the unit torques (then accelerations in the forward pass)
+    std::vector<MatrixNd> F(nbBodies, MatrixNd::Zero(6, nbDof));
+    MatrixNd axes(6, nbDof);
+    utils::Matrix Minv(nbDof, nbDof);
+
+    // Everything is expressed in the base reference frame
+    for (unsigned int i=1; i<nbBodies; ++i) {
+        unsigned int q_index(this->mJoints[i].q_index);
+        if (this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeCustom) {
+            utils::Error::raise("Custom joints are not implemented for the inverse of the mass matrix");
+        } else if (this->mJoints[i].mDoFCount == 3) {
+            axes.block(0, q_index, 6, 3) = this->X_base[i].inverse().toMatrix()
+                                           * this->multdof3_S[i];
+        } else {
+            axes.col(q_index) = this->X_base[i].inverse().apply(this->S[i]);
+        }
+        const SpatialMatrix& X(this->X_base[i].toMatrix());
+        IA[i] = X.transpose() * this->I[i].toMatrix() * X;
+    }
+
+    // Backward pass, articulated inertias
+    for (unsigned int i=nbBodies-1; i>0; --i) {
+        unsigned int q_index(this->mJoints[i].q_index);
+        unsigned int nbDofJoint(this->mJoints[i].mDoFCount);
+        const MatrixNd& S(axes.block(0, q_index, 6, nbDofJoint));
+        U[i] = IA[i] * S;
+        Dinv[i] = (S.transpose() * U[i]).inverse();
+        Minv.block(q_index, 0, nbDofJoint, nbDof) = -Dinv[i] * S.transpose() * F[i];
+        Minv.block(q_index, q_index, nbDofJoint, nbDofJoint) += Dinv[i];
+
+        unsigned int parent(this->lambda[i]);
+        if (parent != 0) {
+            F[i] += U[i] * Minv.block(q_index, 0, nbDofJoint, nbDof);
+            F[parent] += F[i];
+            IA[parent] += IA[i] - U[i] * Dinv[i] * U[i].transpose();
+        }
+    }
+
+    // Forward pass, the bias forces are not needed anymore so F now holds the accelerations
+    for (unsigned int i=1; i<nbBodies; ++i) {
+        unsigned int q_index(this->mJoints[i].q_index);
+        unsigned int nbDofJoint(this->mJoints[i].mDoFCount);
+        unsigned int parent(this->lambda[i]);
+        if (parent != 0) {
+            Minv.block(q_index, 0, nbDofJoint, nbDof) -=
+                Dinv[i] * U[i].transpose() * F[parent];
+            F[i] = F[parent] + axes.block(0, q_index, 6, nbDofJoint)
+                   * Minv.block(q_index, 0, nbDofJoint, nbDof);
+        } else {
+            F[i] = axes.block(0, q_index, 6, nbDofJoint)
+                   * Minv.block(q_index, 0, nbDofJoint, nbDof);
+        }
+    }
+    return Minv;
+}
+
+void rigidbody::Joints::massMatrixLTDL(
+    const rigidbody::GeneralizedCoordinates &Q,
+    utils::Matrix &LTDL,
+    bool updateKin)
+{
+    LTDL = massMatrix(Q, updateKin);
+    factorizeLTDL(LTDL);
+}
+
+void rigidbody::Joints::massMatrixLTDLSolve(
+    const utils::Matrix &LTDL,
+    Eigen::Ref<Eigen::MatrixXd> B) const
+{
+    utils::Error::check(LTDL.rows() == nbQdot() && LTDL.cols() == nbQdot()
+                        && B.rows() == nbQdot(),
+                        "The factorization must be nbQdot x nbQdot and the right-hand sides must have nbQdot rows");
+    std::vector<int> parents(dofParents());
+
+    // L^T * Y = B
+    for (int i=static_cast<int>(nbQdot())-1; i>=0; --i) {
+        for (int j=parents[i]; j>=0; j=parents[j]) {
+            B.row(j) -= LTDL(i, j) * B.row(i);
+        }
+    }
+    // D * Z = Y
+    for (unsigned int i=0; i<nbQdot(); ++i) {
+        B.row(i) /= LTDL(i, i);
+    }
+    // L * X = Z
+    for (int i=0; i<static_cast<int>(nbQdot()); ++i) {
+        for (int j=parents[i]; j>=0; j=parents[j]) {
+            B.row(i) -= LTDL(i, j) * B.row(j);
+        }
+    }
+}
+
+std::vector<int> rigidbody::Joints::dofParents() const
+{
+    // The DoF of a joint are chained, the first one hanging from the last DoF of the parent joint
+    std::vector<int> parents(nbQdot(), -1);
+    for (unsigned int i=1; i<this->mBodies.size(); ++i) {
+        unsigned int q_index(this->mJoints[i].q_index);
+        unsigned int parent(this->lambda[i]);
+        if (parent != 0) {
+            parents[q_index] = static_cast<int>(this->mJoints[parent].q_index
+                                                + this->mJoints[parent].mDoFCount) - 1;
+        }
+        for (unsigned int j=1; j<this->mJoints[i].mDoFCount; ++j) {
+            parents[q_index + j] = static_cast<int>(q_index + j) - 1;
+        }
+    }
+    return parents;
+}
+
+void rigidbody::Joints::factorizeLTDL(
+    utils::Matrix &H) const
+{
+    std::vector<int> parents(dofParents());
+
+    // Featherstone's LTDL, only the DoF on the path to the base are visited
+    for (int k=static_cast<int>(nbQdot())-1; k>=0; --k) {
+        for (int i=parents[k]; i>=0; i=parents[i]) {
+            double a(H(k, i) / H(k, k));
+            for (int j=i; j>=0; j=parents[j]) {
+                H(i, j) -= a * H(k, j);
+            }
+            H(k, i) = a;
+        }
+    }
+}
+#endif
+
 utils::Vector3d rigidbody::Joints::CoMdot(
     const rigidbody::GeneralizedCoordinates &Q,
     const rigidbody::GeneralizedVelocity &Qdot,
@@ -604,6 +834,10 @@ utils::Vector3d rigidbody::Joints::CoMdot(
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
+
     // For each segment, find the CoM
     utils::Vector3d com_dot(0,0,0);
 
@@ -613,9 +847,8 @@ utils::Vector3d rigidbody::Joints::CoMdot(
         Jac.setZero();
         RigidBodyDynamics::CalcPointJacobian(
             *this, Q, GetBodyId(segment.name().c_str()),
-            segment.characteristics().mCenterOfMass, Jac, updateKin);
+            segment.characteristics().mCenterOfMass, Jac, false);
         com_dot += ((Jac*Qdot) * segment.characteristics().mMass);
-        updateKin = false;
     }
     // Divide by total mass
     com_dot = com_dot/mass();
@@ -632,11 +865,14 @@ utils::Vector3d rigidbody::Joints::CoMddot(
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot, &Qddot);
+    }
     utils::Scalar mass;
     RigidBodyDynamics::Math::Vector3d com, com_ddot;
     RigidBodyDynamics::Utils::CalcCenterOfMass(
         *this, Q, Qdot, &Qddot, mass, com, nullptr, &com_ddot,
-        nullptr, nullptr, updateKin);
+        nullptr, nullptr, false);
 
 
     // Return the acceleration of CoM
@@ -650,6 +886,14 @@ utils::Matrix rigidbody::Joints::CoMJacobian(
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+#ifndef BIORBD_USE_CASADI_MATH
+    utils::Matrix JacTotal(3, nbQdot());
+    CoMJacobian(Q, JacTotal, updateKin);
+    return JacTotal;
+#else
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
 
     // Total jacobian
     utils::Matrix JacTotal(utils::Matrix::Zero(3,this->dof_count));
@@ -660,9 +904,8 @@ utils::Matrix rigidbody::Joints::CoMJacobian(
         Jac.setZero();
         RigidBodyDynamics::CalcPointJacobian(
             *this, Q, GetBodyId(segment.name().c_str()),
-            segment.characteristics().mCenterOfMass, Jac, updateKin);
+            segment.characteristics().mCenterOfMass, Jac, false);
         JacTotal += segment.characteristics().mMass*Jac;
-        updateKin = false;
     }
 
     // Divide by total mass
@@ -670,8 +913,84 @@ utils::Matrix rigidbody::Joints::CoMJacobian(
 
     // Return the Jacobian of CoM
     return JacTotal;
+#endif
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Joints::CoMJacobian(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::MatrixXd> jacobian,
+    bool updateKin)
+{
+    utils::Error::check(jacobian.rows() == 3 && jacobian.cols() == nbQdot(),
+                        "The CoM jacobian must be 3 x nbQdot");
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
+
+    // Mass and first moment of mass of the subtrees (in the body reference frame)
+    for (unsigned int i = 1; i < this->mBodies.size(); ++i) {
+        this->Ic[i] = this->I[i];
+    }
+    for (unsigned int i = static_cast<unsigned int>(this->mBodies.size()) - 1; i > 0;
+            --i) {
+        unsigned int q_index(this->mJoints[i].q_index);
+        const RigidBodyDynamics::Math::Matrix3d& E(this->X_base[i].E);
+        if (this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeCustom) {
+            utils::Error::raise("Custom joints are not implemented for the CoM jacobian");
+        } else if (this->mJoints[i].mDoFCount == 3) {
+            for (unsigned int j = 0; j < 3; ++j) {
+                jacobian.col(q_index + j) = E.transpose() * (
+                                                this->Ic[i].m * this->multdof3_S[i].block<3, 1>(3, j)
+                                                + this->multdof3_S[i].block<3, 1>(0, j).cross(this->Ic[i].h));
+            }
+        } else {
+            jacobian.col(q_index) = E.transpose() * (
+                                        this->Ic[i].m * this->S[i].tail<3>()
+                                        + this->S[i].head<3>().cross(this->Ic[i].h));
+        }
+
+        unsigned int parent(this->lambda[i]);
+        if (parent != 0) {
+            this->Ic[parent] = this->Ic[parent] + this->X_lambda[i].applyTranspose(
+                                   this->Ic[i]);
+        }
+    }
+    jacobian /= *m_totalMass;
+}
+
+void rigidbody::Joints::CoMJacobian(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &Qdot,
+    Eigen::Ref<Eigen::MatrixXd> jacobian,
+    Eigen::Ref<Eigen::Vector3d> jacobianDotQdot,
+    bool updateKin)
+{
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot);
+    }
+    CoMJacobian(Q, jacobian, false);
+
+    // Acceleration of the bodies without Qddot (in the body reference frame)
+    jacobianDotQdot.setZero();
+    this->a[0].setZero();
+    for (unsigned int i = 1; i < this->mBodies.size(); ++i) {
+        this->a[i] = this->X_lambda[i].apply(this->a[this->lambda[i]]) + this->c[i];
+
+        // Acceleration of the center of mass of the body, times its mass
+        const RigidBodyDynamics::Math::Vector3d& omega(this->v[i].head<3>());
+        RigidBodyDynamics::Math::Vector3d momentum(
+            this->I[i].m * this->v[i].tail<3>() + omega.cross(this->I[i].h));
+        jacobianDotQdot += this->X_base[i].E.transpose() * (
+                               this->I[i].m * this->a[i].tail<3>()
+                               + this->a[i].head<3>().cross(this->I[i].h)
+                               + omega.cross(momentum));
+    }
+    jacobianDotQdot /= *m_totalMass;
+    m_kinematicsCacheQddot->resize(0); // The accelerations of the model are now unknown
+}
+#endif
+
 
 std::vector<rigidbody::NodeSegment>
 rigidbody::Joints::CoMbySegment(
@@ -709,9 +1028,12 @@ utils::Vector3d rigidbody::Joints::CoMbySegment(
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
     return RigidBodyDynamics::CalcBodyToBaseCoordinates(
                *this, Q, (*m_segments)[idx].id(),
-               (*m_segments)[idx].characteristics().mCenterOfMass, updateKin);
+               (*m_segments)[idx].characteristics().mCenterOfMass, false);
 }
 
 
@@ -741,9 +1063,12 @@ utils::Vector3d rigidbody::Joints::CoMdotBySegment(
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot);
+    }
     return CalcPointVelocity(
                *this, Q, Qdot, (*m_segments)[idx].id(),
-               (*m_segments)[idx].characteristics().mCenterOfMass,updateKin);
+               (*m_segments)[idx].characteristics().mCenterOfMass, false);
 }
 
 
@@ -775,9 +1100,12 @@ utils::Vector3d rigidbody::Joints::CoMddotBySegment(
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot, &Qddot);
+    }
     return RigidBodyDynamics::CalcPointAcceleration(
                *this, Q, Qdot, Qddot, (*m_segments)[idx].id(),
-               (*m_segments)[idx].characteristics().mCenterOfMass,updateKin);
+               (*m_segments)[idx].characteristics().mCenterOfMass, false);
 }
 
 std::vector<std::vector<utils::Vector3d>>
@@ -894,6 +1222,15 @@ const rigidbody::Mesh &rigidbody::Joints::mesh(
     return segment(idx).characteristics().mesh();
 }
 
+unsigned int rigidbody::Joints::nbMeshVertices() const
+{
+    unsigned int nbVertices(0);
+    for (unsigned int i=0; i<nbSegment(); ++i) {
+        nbVertices += mesh(i).nbVertex();
+    }
+    return nbVertices;
+}
+
 utils::Vector3d rigidbody::Joints::CalcAngularMomentum (
     const rigidbody::GeneralizedCoordinates &Q,
     const rigidbody::GeneralizedVelocity &Qdot,
@@ -907,9 +1244,12 @@ utils::Vector3d rigidbody::Joints::CalcAngularMomentum (
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot);
+    }
     RigidBodyDynamics::Utils::CalcCenterOfMass(
         *this, Q, Qdot, nullptr, mass, com, nullptr, nullptr,
-        &angular_momentum, nullptr, updateKin);
+        &angular_momentum, nullptr, false);
     return angular_momentum;
 }
 
@@ -928,9 +1268,12 @@ utils::Vector3d rigidbody::Joints::CalcAngularMomentum (
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot, &Qddot);
+    }
     RigidBodyDynamics::Utils::CalcCenterOfMass(
         *this, Q, Qdot, &Qddot, mass, com, nullptr, nullptr,
-        &angular_momentum, nullptr, updateKin);
+        &angular_momentum, nullptr, false);
 
     return angular_momentum;
 }
@@ -945,11 +1288,14 @@ rigidbody::Joints::CalcSegmentsAngularMomentum (
     updateKin = true;
 #endif
 
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot);
+    }
     utils::Scalar mass;
     RigidBodyDynamics::Math::Vector3d com;
     RigidBodyDynamics::Utils::CalcCenterOfMass (
         *this, Q, Qdot, nullptr, mass, com, nullptr,
-        nullptr, nullptr, nullptr, updateKin);
+        nullptr, nullptr, nullptr, false);
     RigidBodyDynamics::Math::SpatialTransform X_to_COM (
         RigidBodyDynamics::Math::Xtrans(com));
 
@@ -986,11 +1332,14 @@ rigidbody::Joints::CalcSegmentsAngularMomentum (
     updateKin = true;
 #endif
 
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot, &Qddot);
+    }
     utils::Scalar mass;
     RigidBodyDynamics::Math::Vector3d com;
     RigidBodyDynamics::Utils::CalcCenterOfMass (*this, Q, Qdot, &Qddot, mass, com,
             nullptr, nullptr, nullptr, nullptr,
-            updateKin);
+            false);
     RigidBodyDynamics::Math::SpatialTransform X_to_COM (
         RigidBodyDynamics::Math::Xtrans(com));
 
@@ -1016,6 +1365,112 @@ rigidbody::Joints::CalcSegmentsAngularMomentum (
     return h_segment;
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+utils::Matrix rigidbody::Joints::centroidalMomentumMatrix(
+    const rigidbody::GeneralizedCoordinates &Q,
+    bool updateKin)
+{
+    utils::Matrix matrix(6, nbQdot());
+    centroidalMomentumMatrix(Q, matrix, updateKin);
+    return matrix;
+}
+
+void rigidbody::Joints::centroidalMomentumMatrix(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::MatrixXd> matrix,
+    bool updateKin)
+{
+    utils::Error::check(matrix.rows() == 6 && matrix.cols() == nbQdot(),
+                        "The centroidal momentum matrix must be 6 x nbQdot");
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q);
+    }
+
+    // Composite inertias (in the body reference frame), each column being the
+    // momentum of the subtree moved by the DoF, about the origin of the global reference frame
+    for (unsigned int i = 1; i < this->mBodies.size(); ++i) {
+        this->Ic[i] = this->I[i];
+    }
+    RigidBodyDynamics::Math::SpatialRigidBodyInertia Itot;
+    for (unsigned int i = static_cast<unsigned int>(this->mBodies.size()) - 1; i > 0;
+            --i) {
+        unsigned int q_index(this->mJoints[i].q_index);
+        const RigidBodyDynamics::Math::SpatialMatrix& Ic(this->Ic[i].toMatrix());
+        if (this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeCustom) {
+            utils::Error::raise("Custom joints are not implemented for the centroidal momentum matrix");
+        } else if (this->mJoints[i].mDoFCount == 3) {
+            for (unsigned int j = 0; j < 3; ++j) {
+                matrix.col(q_index + j) = this->X_base[i].applyTranspose(
+                                              Ic * this->multdof3_S[i].col(j));
+            }
+        } else {
+            matrix.col(q_index) = this->X_base[i].applyTranspose(Ic * this->S[i]);
+        }
+
+        unsigned int parent(this->lambda[i]);
+        if (parent != 0) {
+            this->Ic[parent] = this->Ic[parent] + this->X_lambda[i].applyTranspose(
+                                   this->Ic[i]);
+        } else {
+            Itot = Itot + this->X_lambda[i].applyTranspose(this->Ic[i]);
+        }
+    }
+
+    // Move the angular momentum to the center of mass
+    RigidBodyDynamics::Math::Vector3d com(Itot.h / Itot.m);
+    for (unsigned int j = 0; j < nbQdot(); ++j) {
+        matrix.block<3, 1>(0, j) -= com.cross(matrix.block<3, 1>(3, j));
+    }
+}
+
+utils::Vector rigidbody::Joints::centroidalMomentumBias(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &Qdot,
+    bool updateKin)
+{
+    utils::Vector bias(6);
+    centroidalMomentumBias(Q, Qdot, bias, updateKin);
+    return bias;
+}
+
+void rigidbody::Joints::centroidalMomentumBias(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &Qdot,
+    Eigen::Ref<Eigen::VectorXd> bias,
+    bool updateKin)
+{
+    utils::Error::check(bias.size() == 6,
+                        "The centroidal momentum bias must be of size 6");
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, &Qdot);
+    }
+
+    // Rate of change of the momentum of each body when Qddot is zero, about
+    // the origin of the global reference frame
+    RigidBodyDynamics::Math::SpatialVector hDot(
+        RigidBodyDynamics::Math::SpatialVector::Zero());
+    RigidBodyDynamics::Math::Vector3d firstMoment(
+        RigidBodyDynamics::Math::Vector3d::Zero());
+    utils::Scalar totalMass(0);
+    this->a[0].setZero();
+    for (unsigned int i = 1; i < this->mBodies.size(); ++i) {
+        this->a[i] = this->X_lambda[i].apply(this->a[this->lambda[i]]) + this->c[i];
+        const RigidBodyDynamics::Math::SpatialMatrix& inertia(this->I[i].toMatrix());
+        hDot += this->X_base[i].applyTranspose(
+                    inertia * this->a[i]
+                    + RigidBodyDynamics::Math::crossf(this->v[i], inertia * this->v[i]));
+        firstMoment += this->X_base[i].E.transpose() * this->I[i].h
+                       + this->I[i].m * this->X_base[i].r;
+        totalMass += this->I[i].m;
+    }
+
+    // Move the angular part to the center of mass (that moves parallel to the linear momentum)
+    bias = hDot;
+    bias.head<3>() -= (firstMoment / totalMass).cross(hDot.tail<3>());
+    m_kinematicsCacheQddot->resize(0); // The accelerations of the model are now unknown
+}
+#endif
+
 unsigned int rigidbody::Joints::nbQuat() const
 {
     return *m_nRotAQuat;
@@ -1079,6 +1534,7 @@ rigidbody::GeneralizedTorque rigidbody::Joints::InverseDynamics(
     } else {
         RigidBodyDynamics::InverseDynamics(*this, Q, QDot, QDDot, Tau);
     }
+    invalidateKinematicsCache();
     return Tau;
 }
 
@@ -1095,6 +1551,7 @@ rigidbody::GeneralizedTorque rigidbody::Joints::NonLinearEffect(
     } else {
         RigidBodyDynamics::NonlinearEffects(*this, Q, QDot, Tau);
     }
+    invalidateKinematicsCache();
     return Tau;
 }
 
@@ -1117,32 +1574,251 @@ rigidbody::Joints::ForwardDynamics(
     } else {
         RigidBodyDynamics::ForwardDynamics(*this, Q, QDot, Tau, QDDot);
     }
+    invalidateKinematicsCache();
     return QDDot;
 }
 
-rigidbody::GeneralizedAcceleration
-rigidbody::Joints::ForwardDynamicsConstraintsDirect(
+#ifndef BIORBD_USE_CASADI_MATH
+rigidbody::GeneralizedTorque rigidbody::Joints::InverseDynamicsDerivatives(
     const rigidbody::GeneralizedCoordinates &Q,
     const rigidbody::GeneralizedVelocity &QDot,
-    const rigidbody::GeneralizedTorque &Tau,
-    rigidbody::Contacts &CS,
-    std::vector<utils::SpatialVector> *f_ext)
+    const rigidbody::GeneralizedAcceleration &QDDot,
+    utils::Matrix &dTau_dQ,
+    utils::Matrix &dTau_dQDot,
+    utils::Matrix &dTau_dQDDot,
+    std::vector<utils::SpatialVector>* f_ext)
 {
-#ifdef BIORBD_USE_CASADI_MATH
-    UpdateKinematicsCustom(&Q, &QDot);
-#endif
-
-    rigidbody::GeneralizedAcceleration QDDot(*this);
+    checkGeneralizedDimensions(&Q, &QDot, &QDDot);
+    rigidbody::GeneralizedTorque Tau(*this);
     if (f_ext) {
         std::vector<RigidBodyDynamics::Math::SpatialVector> f_ext_rbdl(dispatchedForce(
                     *f_ext));
-        RigidBodyDynamics::ForwardDynamicsConstraintsDirect(*this, Q, QDot, Tau, CS,
-                QDDot, &f_ext_rbdl);
+        computeInverseDynamicsDerivatives(
+            Q, QDot, QDDot, &f_ext_rbdl, Tau, dTau_dQ, dTau_dQDot, dTau_dQDDot);
     } else {
-        RigidBodyDynamics::ForwardDynamicsConstraintsDirect(*this, Q, QDot, Tau, CS,
-                QDDot);
+        computeInverseDynamicsDerivatives(
+            Q, QDot, QDDot, nullptr, Tau, dTau_dQ, dTau_dQDot, dTau_dQDDot);
     }
-    return QDDot;
+    return Tau;
+}
+
+void rigidbody::Joints::ForwardDynamicsDerivatives(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedTorque &Tau,
+    utils::Matrix &dQDDot_dQ,
+    utils::Matrix &dQDDot_dQDot,
+    utils::Matrix &dQDDot_dTau,
+    std::vector<utils::SpatialVector>* f_ext)
+{
+    checkGeneralizedDimensions(&Q, &QDot, nullptr, &Tau);
+    std::vector<RigidBodyDynamics::Math::SpatialVector> f_ext_rbdl;
+    if (f_ext) {
+        f_ext_rbdl = dispatchedForce(*f_ext);
+    }
+
+    // The derivatives are evaluated at the actual accelerations
+    rigidbody::GeneralizedAcceleration QDDot(*this);
+    RigidBodyDynamics::ForwardDynamics(
+        *this, Q, QDot, Tau, QDDot, f_ext ? &f_ext_rbdl : nullptr);
+    invalidateKinematicsCache();
+
+    rigidbody::GeneralizedTorque TauID(*this);
+    utils::Matrix dTau_dQ;
+    utils::Matrix dTau_dQDot;
+    utils::Matrix M;
+    computeInverseDynamicsDerivatives(
+        Q, QDot, QDDot, f_ext ? &f_ext_rbdl : nullptr, TauID, dTau_dQ, dTau_dQDot, M);
+
+    // dQDDot = -M^-1 * dTau, the factorization of the mass matrix is shared by all the right-hand sides
+    factorizeLTDL(M);
+    dQDDot_dTau = utils::Matrix::Identity(nbQdot(), nbQdot());
+    massMatrixLTDLSolve(M, dQDDot_dTau);
+    dQDDot_dQ = -dTau_dQ;
+    massMatrixLTDLSolve(M, dQDDot_dQ);
+    dQDDot_dQDot = -dTau_dQDot;
+    massMatrixLTDLSolve(M, dQDDot_dQDot);
+}
+
+void rigidbody::Joints::computeInverseDynamicsDerivatives(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedAcceleration &QDDot,
+    const std::vector<RigidBodyDynamics::Math::SpatialVector>* f_ext,
+    rigidbody::GeneralizedTorque &Tau,
+    utils::Matrix &dTau_dQ,
+    utils::Matrix &dTau_dQDot,
+    utils::Matrix &M)
+{
+    using RigidBodyDynamics::Math::SpatialVector;
+    using RigidBodyDynamics::Math::SpatialMatrix;
+    using RigidBodyDynamics::Math::VectorCrossMatrix;
+    using RigidBodyDynamics::Math::crossm;
+    using RigidBodyDynamics::Math::crossf;
+
+    UpdateKinematicsCustom(&Q);
+
+    unsigned int nbBodies(static_cast<unsigned int>(this->mBodies.size()));
+    unsigned int nbDof(nbQdot());
+    std::vector<SpatialVector, Eigen::aligned_allocator<SpatialVector>>
+            v(nbBodies, SpatialVector::Zero());
+    std::vector<SpatialVector, Eigen::aligned_allocator<SpatialVector>>
+            a(nbBodies, SpatialVector::Zero());
+    std::vector<SpatialVector, Eigen::aligned_allocator<SpatialVector>>
+            f(nbBodies, SpatialVector::Zero());
+    std::vector<SpatialVector, Eigen::aligned_allocator<SpatialVector>>
+            fExt(nbBodies, SpatialVector::Zero());
+    std::vector<SpatialMatrix, Eigen::aligned_allocator<SpatialMatrix>>
+            Ic(nbBodies, SpatialMatrix::Zero());
+    std::vector<SpatialMatrix, Eigen::aligned_allocator<SpatialMatrix>>
+            dIc(nbBodies, SpatialMatrix::Zero());
+    // One column per DoF: its spatial axis and how it moves the subtree
+    RigidBodyDynamics::Math::MatrixNd axes(6, nbDof);
+    RigidBodyDynamics::Math::MatrixNd dVdq(6, nbDof);
+    RigidBodyDynamics::Math::MatrixNd dAdq(6, nbDof);
+    RigidBodyDynamics::Math::MatrixNd dAdv(6, nbDof);
+
+    // Forward pass, everything is expressed in the base reference frame
+    a[0].tail<3>() = -this->gravity;
+    for (unsigned int i=1; i<nbBodies; ++i) {
+        unsigned int parent(this->lambda[i]);
+        unsigned int q_index(this->mJoints[i].q_index);
+        unsigned int nbDofJoint(this->mJoints[i].mDoFCount);
+        if (this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeCustom) {
+            utils::Error::raise("Custom joints are not implemented for the dynamics derivatives");
+        }
+
+        const SpatialMatrix& X(this->X_base[i].toMatrix());
+        bool isSpherical(this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeSpherical);
+        if (nbDofJoint == 3) {
+            // The other multi-DoF joints must behave as a chain of single DoF joints
+            utils::Error::check(
+                isSpherical
+                || this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeTranslationXYZ
+                || this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeEulerXYZ
+                || this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeEulerZYX
+                || this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeEulerYXZ,
+                "This multi-DoF joint is not implemented for the dynamics derivatives");
+            axes.block(0, q_index, 6, 3) = this->X_base[i].inverse().toMatrix()
+                                           * this->multdof3_S[i];
+        } else {
+            axes.col(q_index) = this->X_base[i].inverse().apply(this->S[i]);
+        }
+
+        if (isSpherical) {
+            // The DoF of a spherical joint move together, the derivatives with
+            // respect to Q are along a rotation vector in the local reference
+            // frame, which moves the axes of the joint as well
+            const SpatialVector& vJ(axes.block(0, q_index, 6, 3)
+                                    * QDot.segment(q_index, 3));
+            v[i] = v[parent] + vJ;
+            a[i] = a[parent] + axes.block(0, q_index, 6, 3) * QDDot.segment(q_index, 3)
+                   + crossm(v[parent], vJ);
+            for (unsigned int j=q_index; j<q_index+3; ++j) {
+                const SpatialVector& axis(axes.col(j));
+                dVdq.col(j) = crossm(v[parent], axis);
+                dAdq.col(j) = crossm(a[parent], axis) + crossm(v[parent], dVdq.col(j));
+                dAdv.col(j) = crossm(v[i], axis) + dVdq.col(j);
+            }
+        } else {
+            // The DoF of the joint are chained, each one moving the following ones
+            v[i] = v[parent];
+            a[i] = a[parent];
+            for (unsigned int j=q_index; j<q_index+nbDofJoint; ++j) {
+                const SpatialVector& axis(axes.col(j));
+                const SpatialVector& vJ(axis * QDot(j));
+                dVdq.col(j) = crossm(v[i], axis);
+                dAdq.col(j) = crossm(a[i], axis) + crossm(v[i], dVdq.col(j));
+                a[i] += axis * QDDot(j) + crossm(v[i], vJ);
+                v[i] += vJ;
+                dAdv.col(j) = crossm(v[i], axis) + dVdq.col(j);
+            }
+        }
+
+        // Inertia and its time derivative (including the momentum cross product)
+        Ic[i] = X.transpose() * this->I[i].toMatrix() * X;
+        const SpatialVector& h(Ic[i] * v[i]);
+        dIc[i] = crossf(v[i]) * Ic[i] - Ic[i] * crossm(v[i]);
+        dIc[i].block<3, 3>(0, 0) -= VectorCrossMatrix(h.head<3>());
+        dIc[i].block<3, 3>(0, 3) -= VectorCrossMatrix(h.tail<3>());
+        dIc[i].block<3, 3>(3, 0) -= VectorCrossMatrix(h.tail<3>());
+
+        if (f_ext) {
+            fExt[i] = (*f_ext)[i];
+        }
+        f[i] = Ic[i] * a[i] + crossf(v[i], h) - fExt[i];
+    }
+
+    // Backward pass, the quantities are accumulated on the subtrees
+    Tau.setZero(nbDof);
+    dTau_dQ.setZero(nbDof, nbDof);
+    dTau_dQDot.setZero(nbDof, nbDof);
+    M.setZero(nbDof, nbDof);
+    for (unsigned int i=nbBodies-1; i>0; --i) {
+        unsigned int q_index(this->mJoints[i].q_index);
+        unsigned int nbDofJoint(this->mJoints[i].mDoFCount);
+        bool isSpherical(this->mJoints[i].mJointType == RigidBodyDynamics::JointTypeSpherical);
+        for (unsigned int row=q_index; row<q_index+nbDofJoint; ++row) {
+            Tau(row) = axes.col(row).dot(f[i]);
+
+            // With respect to the DoF of the joint itself (up to row, or all
+            // of them for a spherical joint) and of its ancestors
+            for (unsigned int k=i; k!=0; k=this->lambda[k]) {
+                unsigned int k_index(this->mJoints[k].q_index);
+                unsigned int k_end(k == i && !isSpherical ? row + 1
+                                   : k_index + this->mJoints[k].mDoFCount);
+                for (unsigned int col=k_index; col<k_end; ++col) {
+                    dTau_dQ(row, col) = axes.col(row).dot(
+                                            crossf(axes.col(col), fExt[i])
+                                            + Ic[i] * dAdq.col(col) + dIc[i] * dVdq.col(col));
+                    dTau_dQDot(row, col) = axes.col(row).dot(
+                                               dIc[i] * axes.col(col) + Ic[i] * dAdv.col(col));
+                    M(row, col) = axes.col(row).dot(Ic[i] * axes.col(col));
+                    M(col, row) = M(row, col);
+                }
+            }
+        }
+
+        // The preceding DoF and the ancestors with respect to the DoF of the joint, the whole subtree moving with it
+        for (unsigned int col=q_index; col<q_index+nbDofJoint; ++col) {
+            const SpatialVector& dFdq(crossf(axes.col(col), f[i] + fExt[i])
+                                      + Ic[i] * dAdq.col(col) + dIc[i] * dVdq.col(col));
+            const SpatialVector& dFdv(dIc[i] * axes.col(col) + Ic[i] * dAdv.col(col));
+            for (unsigned int row=q_index; row<col && !isSpherical; ++row) {
+                dTau_dQ(row, col) = axes.col(row).dot(dFdq);
+                dTau_dQDot(row, col) = axes.col(row).dot(dFdv);
+            }
+            for (unsigned int k=this->lambda[i]; k!=0; k=this->lambda[k]) {
+                unsigned int k_index(this->mJoints[k].q_index);
+                for (unsigned int row=k_index; row<k_index+this->mJoints[k].mDoFCount;
+                        ++row) {
+                    dTau_dQ(row, col) = axes.col(row).dot(dFdq);
+                    dTau_dQDot(row, col) = axes.col(row).dot(dFdv);
+                }
+            }
+        }
+
+        unsigned int parent(this->lambda[i]);
+        if (parent != 0) {
+            Ic[parent] += Ic[i];
+            dIc[parent] += dIc[i];
+            f[parent] += f[i];
+            fExt[parent] += fExt[i];
+        }
+    }
+}
+#endif
+
+rigidbody::GeneralizedAcceleration
+rigidbody::Joints::ForwardDynamicsConstraintsDirect(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedTorque &Tau,
+    rigidbody::Contacts &CS,
+    std::vector<utils::SpatialVector> *f_ext)
+{
+    return forwardDynamicsConstraints(
+               rigidbody::DIRECT, Q, QDot, Tau, CS, f_ext);
 }
 
 utils::Vector
@@ -1165,7 +1841,6 @@ rigidbody::Joints::ForwardDynamicsConstraintsDirect(
     const rigidbody::GeneralizedTorque &Tau,
     std::vector<utils::SpatialVector> *f_ext)
 {
-
     rigidbody::Contacts CS = dynamic_cast<rigidbody::Contacts*>
                                      (this)->getConstraints();
     return this->ForwardDynamicsConstraintsDirect(Q, QDot, Tau, CS, f_ext);
@@ -1179,16 +1854,393 @@ rigidbody::Joints::ComputeConstraintImpulsesDirect(
 {
     rigidbody::Contacts CS = dynamic_cast<rigidbody::Contacts*>
                                      (this)->getConstraints();
+    return computeConstraintImpulses(rigidbody::DIRECT, Q, QDotPre, CS);
+}
+
+rigidbody::GeneralizedAcceleration
+rigidbody::Joints::ForwardDynamicsConstraints(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedTorque &Tau,
+    rigidbody::Contacts &CS,
+    std::vector<utils::SpatialVector> *f_ext)
+{
+    return forwardDynamicsConstraints(
+               CS.contactSolver(), Q, QDot, Tau, CS, f_ext);
+}
+
+rigidbody::GeneralizedAcceleration
+rigidbody::Joints::ForwardDynamicsConstraints(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedTorque &Tau,
+    std::vector<utils::SpatialVector> *f_ext)
+{
+    rigidbody::Contacts &CS = dynamic_cast<rigidbody::Contacts*>
+                                     (this)->getConstraints();
+    return this->ForwardDynamicsConstraints(Q, QDot, Tau, CS, f_ext);
+}
+
+utils::Vector
+rigidbody::Joints::ContactForcesFromForwardDynamicsConstraints(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedTorque &Tau,
+    std::vector<utils::SpatialVector> *f_ext)
+{
+    rigidbody::Contacts &CS = dynamic_cast<rigidbody::Contacts*>
+                                     (this)->getConstraints();
+    this->ForwardDynamicsConstraints(Q, QDot, Tau, CS, f_ext);
+    return CS.getForce();
+}
+
+rigidbody::GeneralizedVelocity
+rigidbody::Joints::ComputeConstraintImpulses(
+    const rigidbody::GeneralizedCoordinates& Q,
+    const rigidbody::GeneralizedVelocity& QDotPre)
+{
+    rigidbody::Contacts &CS = dynamic_cast<rigidbody::Contacts*>
+                                     (this)->getConstraints();
+    return computeConstraintImpulses(CS.contactSolver(), Q, QDotPre, CS);
+}
+
+#ifndef BIORBD_USE_CASADI_MATH
+double rigidbody::Joints::timeContactSolver(
+    rigidbody::CONTACT_SOLVER_TYPE type,
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedTorque &Tau,
+    unsigned int nbCalls)
+{
+    utils::Error::check(nbCalls > 0, "nbCalls must be positive");
+    rigidbody::Contacts &CS = dynamic_cast<rigidbody::Contacts*>
+                                     (this)->getConstraints();
+
+    // A first call outside the timer so every solver starts with a warm workspace
+    forwardDynamicsConstraints(type, Q, QDot, Tau, CS);
+
+    utils::Timer timer(true);
+    for (unsigned int i=0; i<nbCalls; ++i) {
+        forwardDynamicsConstraints(type, Q, QDot, Tau, CS);
+    }
+    return timer.stop() / static_cast<double>(nbCalls);
+}
+
+rigidbody::CONTACT_SOLVER_TYPE rigidbody::Joints::selectFastestContactSolver(
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedTorque &Tau,
+    unsigned int nbCalls)
+{
+    rigidbody::CONTACT_SOLVER_TYPE types[] = {
+        rigidbody::DIRECT, rigidbody::RANGE_SPACE_SPARSE, rigidbody::NULL_SPACE
+    };
+    rigidbody::CONTACT_SOLVER_TYPE fastest(rigidbody::DIRECT);
+    double bestTime(-1);
+    for (auto type : types) {
+        double time(timeContactSolver(type, Q, QDot, Tau, nbCalls));
+        if (bestTime < 0 || time < bestTime) {
+            bestTime = time;
+            fastest = type;
+        }
+    }
+    dynamic_cast<rigidbody::Contacts*>(this)->setContactSolver(fastest);
+    return fastest;
+}
+#endif
+
+rigidbody::GeneralizedAcceleration
+rigidbody::Joints::forwardDynamicsConstraints(
+    rigidbody::CONTACT_SOLVER_TYPE type,
+    const rigidbody::GeneralizedCoordinates &Q,
+    const rigidbody::GeneralizedVelocity &QDot,
+    const rigidbody::GeneralizedTorque &Tau,
+    rigidbody::Contacts &CS,
+    std::vector<utils::SpatialVector> *f_ext)
+{
+#ifdef BIORBD_USE_CASADI_MATH
+    UpdateKinematicsCustom(&Q, &QDot);
+#endif
+
+    std::vector<RigidBodyDynamics::Math::SpatialVector> f_ext_rbdl;
+    if (f_ext) {
+        f_ext_rbdl = dispatchedForce(*f_ext);
+    }
+    std::vector<RigidBodyDynamics::Math::SpatialVector> *f_ext_ptr(
+        f_ext ? &f_ext_rbdl : nullptr);
+
+    rigidbody::GeneralizedAcceleration QDDot(*this);
+    switch (type) {
+    case rigidbody::DIRECT:
+        RigidBodyDynamics::ForwardDynamicsConstraintsDirect(
+            *this, Q, QDot, Tau, CS, QDDot, f_ext_ptr);
+        break;
+    case rigidbody::RANGE_SPACE_SPARSE:
+        RigidBodyDynamics::ForwardDynamicsConstraintsRangeSpaceSparse(
+            *this, Q, QDot, Tau, CS, QDDot, f_ext_ptr);
+        break;
+    case rigidbody::NULL_SPACE:
+        RigidBodyDynamics::ForwardDynamicsConstraintsNullSpace(
+            *this, Q, QDot, Tau, CS, QDDot, f_ext_ptr);
+        break;
+    default:
+        utils::Error::raise("Unknown contact solver");
+    }
+    invalidateKinematicsCache();
+    return QDDot;
+}
+
+rigidbody::GeneralizedVelocity
+rigidbody::Joints::computeConstraintImpulses(
+    rigidbody::CONTACT_SOLVER_TYPE type,
+    const rigidbody::GeneralizedCoordinates& Q,
+    const rigidbody::GeneralizedVelocity& QDotPre,
+    rigidbody::Contacts &CS)
+{
     if (CS.nbContacts() == 0) {
         return QDotPre;
-    } else {
-        CS = dynamic_cast<rigidbody::Contacts*>(this)->getConstraints();
+    }
+
+    rigidbody::GeneralizedVelocity QDotPost(*this);
+    switch (type) {
+    case rigidbody::DIRECT:
+        RigidBodyDynamics::ComputeConstraintImpulsesDirect(
+            *this, Q, QDotPre, CS, QDotPost);
+        break;
+    case rigidbody::RANGE_SPACE_SPARSE:
+        RigidBodyDynamics::ComputeConstraintImpulsesRangeSpaceSparse(
+            *this, Q, QDotPre, CS, QDotPost);
+        break;
+    case rigidbody::NULL_SPACE:
+        RigidBodyDynamics::ComputeConstraintImpulsesNullSpace(
+            *this, Q, QDotPre, CS, QDotPost);
+        break;
+    default:
+        utils::Error::raise("Unknown contact solver");
+    }
+    invalidateKinematicsCache();
+    return QDotPost;
+}
+
+void rigidbody::Joints::setNbThreads(
+    unsigned int nbThreads)
+{
+    m_threadPool->setNbThreads(nbThreads);
+}
+
+unsigned int rigidbody::Joints::nbThreads() const
+{
+    return m_threadPool->nbThreads();
+}
+
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Joints::InverseDynamicsBatch(
+    const utils::Matrix &Q,
+    const utils::Matrix &QDot,
+    const utils::Matrix &QDDot,
+    utils::Matrix &Tau)
+{
+    unsigned int nbFrames(static_cast<unsigned int>(Q.cols()));
+    utils::Error::check(
+        Q.rows() == nbQ() && QDot.rows() == nbQdot() && QDDot.rows() == nbQddot()
+        && Tau.rows() == nbGeneralizedTorque(),
+        "Q, QDot, QDDot and Tau must respectively have nbQ, nbQdot, nbQddot and nbGeneralizedTorque rows");
+    utils::Error::check(
+        QDot.cols() == nbFrames && QDDot.cols() == nbFrames && Tau.cols() == nbFrames,
+        "Q, QDot, QDDot and Tau must have the same number of frames");
+
+    std::vector<RigidBodyDynamics::Math::VectorNd> q(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQ()));
+    std::vector<RigidBodyDynamics::Math::VectorNd> qdot(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQdot()));
+    std::vector<RigidBodyDynamics::Math::VectorNd> qddot(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQddot()));
+    std::vector<RigidBodyDynamics::Math::VectorNd> tau(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbGeneralizedTorque()));
+    runBatch(nbFrames, [&](rigidbody::Joints& model, unsigned int frame,
+    unsigned int worker) {
+        q[worker] = Q.col(frame);
+        qdot[worker] = QDot.col(frame);
+        qddot[worker] = QDDot.col(frame);
+        RigidBodyDynamics::InverseDynamics(
+            model, q[worker], qdot[worker], qddot[worker], tau[worker]);
+        model.invalidateKinematicsCache();
+        Tau.col(frame) = tau[worker];
+    });
+}
+
+void rigidbody::Joints::NonLinearEffectBatch(
+    const utils::Matrix &Q,
+    const utils::Matrix &QDot,
+    utils::Matrix &Tau)
+{
+    unsigned int nbFrames(static_cast<unsigned int>(Q.cols()));
+    utils::Error::check(
+        Q.rows() == nbQ() && QDot.rows() == nbQdot()
+        && Tau.rows() == nbGeneralizedTorque(),
+        "Q, QDot and Tau must respectively have nbQ, nbQdot and nbGeneralizedTorque rows");
+    utils::Error::check(
+        QDot.cols() == nbFrames && Tau.cols() == nbFrames,
+        "Q, QDot and Tau must have the same number of frames");
+
+    std::vector<RigidBodyDynamics::Math::VectorNd> q(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQ()));
+    std::vector<RigidBodyDynamics::Math::VectorNd> qdot(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQdot()));
+    std::vector<RigidBodyDynamics::Math::VectorNd> tau(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbGeneralizedTorque()));
+    runBatch(nbFrames, [&](rigidbody::Joints& model, unsigned int frame,
+    unsigned int worker) {
+        q[worker] = Q.col(frame);
+        qdot[worker] = QDot.col(frame);
+        RigidBodyDynamics::NonlinearEffects(
+            model, q[worker], qdot[worker], tau[worker]);
+        model.invalidateKinematicsCache();
+        Tau.col(frame) = tau[worker];
+    });
+}
+
+void rigidbody::Joints::ForwardDynamicsBatch(
+    const utils::Matrix &Q,
+    const utils::Matrix &QDot,
+    const utils::Matrix &Tau,
+    utils::Matrix &QDDot)
+{
+    unsigned int nbFrames(static_cast<unsigned int>(Q.cols()));
+    utils::Error::check(
+        Q.rows() == nbQ() && QDot.rows() == nbQdot()
+        && Tau.rows() == nbGeneralizedTorque() && QDDot.rows() == nbQddot(),
+        "Q, QDot, Tau and QDDot must respectively have nbQ, nbQdot, nbGeneralizedTorque and nbQddot rows");
+    utils::Error::check(
+        QDot.cols() == nbFrames && Tau.cols() == nbFrames && QDDot.cols() == nbFrames,
+        "Q, QDot, Tau and QDDot must have the same number of frames");
+
+    std::vector<RigidBodyDynamics::Math::VectorNd> q(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQ()));
+    std::vector<RigidBodyDynamics::Math::VectorNd> qdot(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQdot()));
+    std::vector<RigidBodyDynamics::Math::VectorNd> tau(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbGeneralizedTorque()));
+    std::vector<RigidBodyDynamics::Math::VectorNd> qddot(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQddot()));
+    runBatch(nbFrames, [&](rigidbody::Joints& model, unsigned int frame,
+    unsigned int worker) {
+        q[worker] = Q.col(frame);
+        qdot[worker] = QDot.col(frame);
+        tau[worker] = Tau.col(frame);
+        RigidBodyDynamics::ForwardDynamics(
+            model, q[worker], qdot[worker], tau[worker], qddot[worker]);
+        model.invalidateKinematicsCache();
+        QDDot.col(frame) = qddot[worker];
+    });
+}
+
+void rigidbody::Joints::massMatrixBatch(
+    const utils::Matrix &Q,
+    utils::Matrix &M)
+{
+    unsigned int nbFrames(static_cast<unsigned int>(Q.cols()));
+    utils::Error::check(
+        Q.rows() == nbQ() && M.rows() == nbQdot(),
+        "Q and M must respectively have nbQ and nbQdot rows");
+    utils::Error::check(
+        M.cols() == nbQdot() * nbFrames,
+        "M must have nbQdot columns per frame of Q");
+
+    std::vector<RigidBodyDynamics::Math::VectorNd> q(
+        nbThreads(), RigidBodyDynamics::Math::VectorNd(nbQ()));
+    std::vector<RigidBodyDynamics::Math::MatrixNd> massMatrix(
+        nbThreads(), RigidBodyDynamics::Math::MatrixNd(nbQdot(), nbQdot()));
+    runBatch(nbFrames, [&](rigidbody::Joints& model, unsigned int frame,
+    unsigned int worker) {
+        q[worker] = Q.col(frame);
+        massMatrix[worker].setZero();
+        RigidBodyDynamics::CompositeRigidBodyAlgorithm(
+            model, q[worker], massMatrix[worker], true);
+        model.invalidateKinematicsCache();
+        M.block(0, frame * nbQdot(), nbQdot(), nbQdot()) = massMatrix[worker];
+    });
+}
+#endif
+
+#ifndef BIORBD_USE_CASADI_MATH
+template<typename T>
+void rigidbody::Joints::fillMeshPointsBatch(
+    const utils::Matrix &Q,
+    Eigen::Ref<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>> points)
+{
+    unsigned int nbFrames(static_cast<unsigned int>(Q.cols()));
+    utils::Error::check(Q.rows() == nbQ(), "Q must have nbQ rows");
+    utils::Error::check(
+        points.rows() == 3*nbMeshVertices() && points.cols() == nbFrames,
+        "points must have 3*nbMeshVertices() rows and as many columns as Q");
+
+    // The vertices are converted once to the precision of the output
+    std::vector<Eigen::Matrix<T, 3, Eigen::Dynamic>> vertices(nbSegment());
+    for (unsigned int i=0; i<nbSegment(); ++i) {
+        vertices[i].resize(3, mesh(i).nbVertex());
+        for (unsigned int j=0; j<mesh(i).nbVertex(); ++j) {
+            vertices[i].col(j) = mesh(i).point(j).cast<T>();
+        }
+    }
 
-        rigidbody::GeneralizedVelocity QDotPost(*this);
-        RigidBodyDynamics::ComputeConstraintImpulsesDirect(*this, Q, QDotPre, CS,
-                QDotPost);
-        return QDotPost;
+    std::vector<rigidbody::GeneralizedCoordinates> q(
+        nbThreads(), rigidbody::GeneralizedCoordinates(*this));
+    std::vector<std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>>>
+            jcs(nbThreads());
+    runBatch(nbFrames, [&](rigidbody::Joints& model, unsigned int frame,
+    unsigned int worker) {
+        q[worker] = Q.col(frame);
+        model.allGlobalJCS(q[worker], jcs[worker], true);
+        Eigen::Index row(0);
+        for (unsigned int i=0; i<vertices.size(); ++i) {
+            // The transformation is rounded once per segment, not per vertex
+            const Eigen::Matrix<T, 3, 3> rotation(
+                jcs[worker][i].block<3, 3>(0, 0).cast<T>());
+            const Eigen::Matrix<T, 3, 1> translation(
+                jcs[worker][i].block<3, 1>(0, 3).cast<T>());
+            for (Eigen::Index j=0; j<vertices[i].cols(); ++j, row += 3) {
+                points.col(frame).segment(row, 3) = rotation * vertices[i].col(j) + translation;
+            }
+        }
+    });
+}
+
+void rigidbody::Joints::meshPointsBatch(
+    const utils::Matrix &Q,
+    Eigen::Ref<Eigen::MatrixXd> points)
+{
+    fillMeshPointsBatch<double>(Q, points);
+}
+
+void rigidbody::Joints::meshPointsBatch(
+    const utils::Matrix &Q,
+    Eigen::Ref<Eigen::MatrixXf> points)
+{
+    fillMeshPointsBatch<float>(Q, points);
+}
+#endif
+
+void rigidbody::Joints::runBatch(
+    unsigned int nbFrames,
+    const std::function<void(rigidbody::Joints&, unsigned int, unsigned int)>&
+    frameFunction)
+{
+    // Each worker gets its own copy of the RBDL model (which holds the
+    // kinematics) while sharing the description of the segments. The copies
+    // are kept for the next calls, until the model or the threads change
+    std::vector<rigidbody::Joints>& models(*m_batchModels);
+    if (models.size() != m_threadPool->nbThreads()) {
+        models.assign(m_threadPool->nbThreads(), *this);
     }
+    m_threadPool->run(nbFrames, [&](unsigned int frame, unsigned int worker) {
+        frameFunction(models[worker], frame, worker);
+    });
+}
+
+void rigidbody::Joints::invalidateBatchModels()
+{
+    m_batchModels->clear();
 }
 
 utils::Matrix3d
@@ -1253,7 +2305,95 @@ void rigidbody::Joints::UpdateKinematicsCustom(
     const rigidbody::GeneralizedAcceleration *Qddot)
 {
     checkGeneralizedDimensions(Q, Qdot, Qddot);
+#ifndef BIORBD_USE_CASADI_MATH
+    if (isKinematicsCached(Q, Qdot, Qddot)) {
+        ++*m_nbKinematicsCacheHits;
+        return;
+    }
+    ++*m_nbKinematicsCacheMisses;
+#endif
     RigidBodyDynamics::UpdateKinematicsCustom(*this, Q, Qdot, Qddot);
+    cacheKinematics(Q, Qdot, Qddot);
+}
+
+void rigidbody::Joints::invalidateKinematicsCache()
+{
+    *m_isKinematicsComputed = false;
+    m_kinematicsCacheQ->resize(0);
+    m_kinematicsCacheQdot->resize(0);
+    m_kinematicsCacheQddot->resize(0);
+}
+
+unsigned long rigidbody::Joints::nbKinematicsCacheHits() const
+{
+    return *m_nbKinematicsCacheHits;
+}
+
+unsigned long rigidbody::Joints::nbKinematicsCacheMisses() const
+{
+    return *m_nbKinematicsCacheMisses;
+}
+
+void rigidbody::Joints::resetKinematicsCacheCounters()
+{
+    *m_nbKinematicsCacheHits = 0;
+    *m_nbKinematicsCacheMisses = 0;
+}
+
+bool rigidbody::Joints::isKinematicsCached(
+    const rigidbody::GeneralizedCoordinates *Q,
+    const rigidbody::GeneralizedVelocity *Qdot,
+    const rigidbody::GeneralizedAcceleration *Qddot) const
+{
+#ifdef BIORBD_USE_CASADI_MATH
+    // Symbolic variables cannot be compared
+    return false;
+#else
+    if (!*m_isKinematicsComputed) {
+        return false;
+    }
+    // Every level that is asked must be known and bitwise equal
+    if (Q && (m_kinematicsCacheQ->size() != Q->size()
+              || *m_kinematicsCacheQ != *Q)) {
+        return false;
+    }
+    if (Qdot && (m_kinematicsCacheQdot->size() != Qdot->size()
+                 || *m_kinematicsCacheQdot != *Qdot)) {
+        return false;
+    }
+    if (Qddot && (m_kinematicsCacheQddot->size() != Qddot->size()
+                  || *m_kinematicsCacheQddot != *Qddot)) {
+        return false;
+    }
+    return true;
+#endif
+}
+
+void rigidbody::Joints::cacheKinematics(
+    const rigidbody::GeneralizedCoordinates *Q,
+    const rigidbody::GeneralizedVelocity *Qdot,
+    const rigidbody::GeneralizedAcceleration *Qddot)
+{
+#ifdef BIORBD_USE_CASADI_MATH
+    return;
+#else
+    // RBDL only recomputes the levels it receives. Changing a lower level
+    // (e.g. Q) leaves the upper levels (e.g. velocities) out of date
+    if (Q) {
+        *m_kinematicsCacheQ = *Q;
+        *m_isKinematicsComputed = true;
+    }
+    if (Qdot) {
+        *m_kinematicsCacheQdot = *Qdot;
+    } else if (Q) {
+        m_kinematicsCacheQdot->resize(0);
+    }
+    if (Qddot) {
+        *m_kinematicsCacheQddot = *Qddot;
+    } else if (Q || Qdot) {
+        m_kinematicsCacheQddot->resize(0);
+    }
+#endif
 }
 
 void rigidbody::Joints::CalcMatRotJacobian(
@@ -1306,9 +2446,11 @@ void rigidbody::Joints::CalcMatRotJacobian(
             unsigned int q_index = this->mJoints[j].q_index;
             // If it's not a DoF in translation (3 4 5 in this->S)
 #ifdef BIORBD_USE_CASADI_MATH
-            if (this->S[j].is_zero() && this->S[j](4).is_zero() && this->S[j](5).is_zero())
+            if (this->S[j].is_zero() && this->S[j](4).is_zero() && this->S[j](5).is_zero()
+                    && this->mJoints[j].mJointType != RigidBodyDynamics::JointTypeTranslationXYZ)
 #else
-            if (this->S[j](3)!=1.0 && this->S[j](4)!=1.0 && this->S[j](5)!=1.0)
+            if (this->S[j](3)!=1.0 && this->S[j](4)!=1.0 && this->S[j](5)!=1.0
+                    && this->mJoints[j].mJointType != RigidBodyDynamics::JointTypeTranslationXYZ)
 #endif
             {
                 RigidBodyDynamics::Math::SpatialTransform X_base = this->X_base[j];
@@ -1329,6 +2471,122 @@ void rigidbody::Joints::CalcMatRotJacobian(
     }
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Joints::CalcMatRotJacobian(
+    const rigidbody::GeneralizedCoordinates &Q,
+    unsigned int bodyId,
+    const RigidBodyDynamics::Math::Matrix3d &rotation,
+    Eigen::Ref<Eigen::MatrixXd> G,
+    bool updateKin)
+{
+    // update the Kinematics if necessary
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, nullptr, nullptr);
+    }
+
+    assert (G.rows() == 9 && G.cols() == this->qdot_size );
+
+    // Same algorithm as above, with the orientation of the body computed once
+    RigidBodyDynamics::Math::Matrix3d bodyRotation(
+        RigidBodyDynamics::CalcBodyWorldOrientation(*this, Q, bodyId, false).transpose()
+        * rotation);
+
+    unsigned int reference_body_id = bodyId;
+    if (this->IsFixedBodyId(bodyId)) {
+        reference_body_id = this->mFixedBodies[bodyId - this->fixed_body_discriminator].mMovableParent;
+    }
+
+    for (unsigned int iAxes=0; iAxes<3; ++iAxes) {
+        RigidBodyDynamics::Math::SpatialTransform point_trans(
+            RigidBodyDynamics::Math::Matrix3d::Identity(), bodyRotation.col(iAxes));
+
+        for (unsigned int j = reference_body_id; j != 0; j = this->lambda[j]) {
+            // The DoF in translation do not change the orientation
+            if (this->S[j](3)!=1.0 && this->S[j](4)!=1.0 && this->S[j](5)!=1.0
+                    && this->mJoints[j].mJointType != RigidBodyDynamics::JointTypeTranslationXYZ) {
+                unsigned int q_index = this->mJoints[j].q_index;
+                RigidBodyDynamics::Math::SpatialTransform X_base = this->X_base[j];
+                X_base.r.setZero(); // Only keep the rotation matrix
+
+                if (this->mJoints[j].mDoFCount == 3) {
+                    G.block(iAxes*3, q_index, 3, 3) =
+                        ((point_trans * X_base.inverse()).toMatrix()
+                         * this->multdof3_S[j]).block(3, 0, 3, 3);
+                } else {
+                    G.block(iAxes*3, q_index, 3, 1) =
+                        point_trans.apply(X_base.inverse().apply(this->S[j])).block(3, 0, 3, 1);
+                }
+            }
+        }
+    }
+}
+
+void rigidbody::Joints::CalcPointJacobian(
+    const rigidbody::GeneralizedCoordinates &Q,
+    unsigned int bodyId,
+    const RigidBodyDynamics::Math::Vector3d &point,
+    Eigen::Ref<Eigen::MatrixXd> G,
+    bool updateKin)
+{
+    // update the Kinematics if necessary
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, nullptr, nullptr);
+    }
+
+    assert (G.rows() == 3 && G.cols() == this->qdot_size );
+
+    // Same algorithm as RBDL, but written directly into G so nothing is allocated
+    RigidBodyDynamics::Math::SpatialTransform point_trans(
+        RigidBodyDynamics::Math::Matrix3d::Identity(),
+        RigidBodyDynamics::CalcBodyToBaseCoordinates(*this, Q, bodyId, point, false));
+
+    unsigned int j = bodyId;
+    if (this->IsFixedBodyId(bodyId)) {
+        j = this->mFixedBodies[bodyId - this->fixed_body_discriminator].mMovableParent;
+    }
+
+    while (j != 0) {
+        unsigned int q_index = this->mJoints[j].q_index;
+        if (this->mJoints[j].mJointType == RigidBodyDynamics::JointTypeCustom) {
+            utils::Error::raise("Custom joints are not implemented for the point jacobian");
+        } else if (this->mJoints[j].mDoFCount == 3) {
+            G.block(0, q_index, 3, 3) =
+                ((point_trans * this->X_base[j].inverse()).toMatrix()
+                 * this->multdof3_S[j]).block(3, 0, 3, 3);
+        } else {
+            G.block(0, q_index, 3, 1) =
+                point_trans.apply(this->X_base[j].inverse().apply(this->S[j])).block(3, 0, 3, 1);
+        }
+        j = this->lambda[j]; // Pass to parent segment
+    }
+}
+
+void rigidbody::Joints::CalcMotionSubspaceInGlobal(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::MatrixXd> axes,
+    bool updateKin)
+{
+    // update the Kinematics if necessary
+    if (updateKin) {
+        UpdateKinematicsCustom (&Q, nullptr, nullptr);
+    }
+
+    assert (axes.rows() == 6 && axes.cols() == this->qdot_size );
+
+    for (unsigned int j=1; j<this->mBodies.size(); ++j) {
+        unsigned int q_index = this->mJoints[j].q_index;
+        if (this->mJoints[j].mJointType == RigidBodyDynamics::JointTypeCustom) {
+            utils::Error::raise("Custom joints are not implemented for the motion subspace");
+        } else if (this->mJoints[j].mDoFCount == 3) {
+            axes.block(0, q_index, 6, 3) =
+                this->X_base[j].inverse().toMatrix() * this->multdof3_S[j];
+        } else {
+            axes.col(q_index) = this->X_base[j].inverse().apply(this->S[j]);
+        }
+    }
+}
+#endif
+
 void rigidbody::Joints::checkGeneralizedDimensions(
     const rigidbody::GeneralizedCoordinates *Q,
     const rigidbody::GeneralizedVelocity *Qdot,
@@ -1,7 +1,11 @@
 #define BIORBD_API_EXPORTS
 #include "RigidBody/KalmanRecons.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "BiorbdModel.h"
+#include "Utils/Error.h"
 #include "Utils/Matrix.h"
 #include "Utils/Vector.h"
 #include "RigidBody/GeneralizedCoordinates.h"
@@ -19,7 +23,18 @@ rigidbody::KalmanRecons::KalmanRecons() :
     m_A(std::make_shared<utils::Matrix>()),
     m_Q(std::make_shared<utils::Matrix>()),
     m_R(std::make_shared<utils::Matrix>()),
-    m_Pp(std::make_shared<utils::Matrix>())
+    m_Pp(std::make_shared<utils::Matrix>()),
+    m_nbInitIterations(std::make_shared<unsigned int>(0)),
+    m_xkm(std::make_shared<utils::Vector>()),
+    m_Pkm(std::make_shared<utils::Matrix>()),
+    m_APkm(std::make_shared<utils::Matrix>()),
+    m_H(std::make_shared<utils::Matrix>()),
+    m_zest(std::make_shared<utils::Vector>()),
+    m_visibleRows(std::make_shared<std::vector<unsigned int>>()),
+    m_Hvisible(std::make_shared<utils::Matrix>()),
+    m_HP(std::make_shared<utils::Matrix>()),
+    m_S(std::make_shared<utils::Matrix>()),
+    m_innovation(std::make_shared<utils::Vector>())
 {
 
 }
@@ -36,7 +51,18 @@ rigidbody::KalmanRecons::KalmanRecons(
     m_A(std::make_shared<utils::Matrix>()),
     m_Q(std::make_shared<utils::Matrix>()),
     m_R(std::make_shared<utils::Matrix>()),
-    m_Pp(std::make_shared<utils::Matrix>())
+    m_Pp(std::make_shared<utils::Matrix>()),
+    m_nbInitIterations(std::make_shared<unsigned int>(0)),
+    m_xkm(std::make_shared<utils::Vector>()),
+    m_Pkm(std::make_shared<utils::Matrix>()),
+    m_APkm(std::make_shared<utils::Matrix>()),
+    m_H(std::make_shared<utils::Matrix>()),
+    m_zest(std::make_shared<utils::Vector>()),
+    m_visibleRows(std::make_shared<std::vector<unsigned int>>()),
+    m_Hvisible(std::make_shared<utils::Matrix>()),
+    m_HP(std::make_shared<utils::Matrix>()),
+    m_S(std::make_shared<utils::Matrix>()),
+    m_innovation(std::make_shared<utils::Vector>())
 {
 
 }
@@ -58,42 +84,297 @@ void rigidbody::KalmanRecons::DeepCopy(const
     *m_Q = *other.m_Q;
     *m_R = *other.m_R;
     *m_Pp = *other.m_Pp;
+    *m_nbInitIterations = *other.m_nbInitIterations;
+    *m_xkm = *other.m_xkm;
+    *m_Pkm = *other.m_Pkm;
+    *m_APkm = *other.m_APkm;
+    *m_H = *other.m_H;
+    *m_zest = *other.m_zest;
+    *m_visibleRows = *other.m_visibleRows;
+    *m_Hvisible = *other.m_Hvisible;
+    *m_HP = *other.m_HP;
+    *m_S = *other.m_S;
+    *m_innovation = *other.m_innovation;
+}
+
+const utils::Vector& rigidbody::KalmanRecons::predictState()
+{
+    // The blocks of A are multiples of the identity
+    unsigned int n(*m_nbDof);
+    unsigned int nbBlocks(static_cast<unsigned int>(m_A->rows()) / n);
+    m_xkm->setZero();
+    for (unsigned int i=0; i<nbBlocks; ++i) {
+        for (unsigned int k=0; k<nbBlocks; ++k) {
+            double c((*m_A)(i*n, k*n));
+            if (c != 0.0) {
+                m_xkm->segment(i*n, n) += c * m_xp->segment(k*n, n);
+            }
+        }
+    }
+    return *m_xkm;
+}
+
+void rigidbody::KalmanRecons::predictCovariance()
+{
+    // A*Pp*A' + Q, combining the blocks of rows then the blocks of columns
+    unsigned int n(*m_nbDof);
+    unsigned int nbBlocks(static_cast<unsigned int>(m_A->rows()) / n);
+    m_APkm->setZero();
+    for (unsigned int i=0; i<nbBlocks; ++i) {
+        for (unsigned int k=0; k<nbBlocks; ++k) {
+            double c((*m_A)(i*n, k*n));
+            if (c != 0.0) {
+                m_APkm->middleRows(i*n, n) += c * m_Pp->middleRows(k*n, n);
+            }
+        }
+    }
+    *m_Pkm = *m_Q;
+    for (unsigned int j=0; j<nbBlocks; ++j) {
+        for (unsigned int k=0; k<nbBlocks; ++k) {
+            double c((*m_A)(j*n, k*n));
+            if (c != 0.0) {
+                m_Pkm->middleCols(j*n, n) += c * m_APkm->middleCols(k*n, n);
+            }
+        }
+    }
 }
 
 void rigidbody::KalmanRecons::iteration(
-    utils::Vector measure,
+    const utils::Vector &measure,
     const utils::Vector &projectedMeasure,
-    const utils::Matrix &Hessian,
+    const utils::Matrix &jacobian,
     const std::vector<unsigned int> &occlusion)
 {
     // Prediction
-    const utils::Vector& xkm(*m_A * *m_xp);
-    const utils::Matrix& Pkm(*m_A * *m_Pp * m_A->transpose() + *m_Q);
+    predictState();
+    predictCovariance();
 
     // Correction
-    utils::Matrix InvTp( (Hessian * Pkm * Hessian.transpose() +
-                                  *m_R).inverse() );
-    manageOcclusionDuringIteration(InvTp, measure, occlusion);
-    const utils::Matrix& K(Pkm*Hessian.transpose() * InvTp); // Gain
+    correction(gatherVisibleMeasurements(measure, projectedMeasure, jacobian,
+                                         occlusion));
+}
+
+unsigned int rigidbody::KalmanRecons::gatherVisibleMeasurements(
+    const utils::Vector &measure,
+    const utils::Vector &projectedMeasure,
+    const utils::Matrix &jacobian,
+    const std::vector<unsigned int> &occlusion)
+{
+    // Only keep the rows of the visible measurements (the capacity is kept
+    // from one frame to the other)
+    std::vector<unsigned int>& rows(*m_visibleRows);
+    rows.resize(*m_nMeasure);
+    for (unsigned int i=0; i<*m_nMeasure; ++i) {
+        rows[i] = i;
+    }
+    unsigned int nbPerSensor(nbMeasurementsPerSensor());
+    for (unsigned int i=0; i<occlusion.size(); ++i) {
+        utils::Error::check(occlusion[i] < *m_nMeasure / nbPerSensor,
+                            "The occlusion indices must be lower than the number of sensors");
+        for (unsigned int j=0; j<nbPerSensor; ++j) {
+            rows[occlusion[i]*nbPerSensor + j] = *m_nMeasure;
+        }
+    }
+    rows.erase(std::remove(rows.begin(), rows.end(), *m_nMeasure), rows.end());
+    unsigned int nbVisible(static_cast<unsigned int>(rows.size()));
+    for (unsigned int i=0; i<nbVisible; ++i) {
+        m_Hvisible->row(i) = jacobian.row(rows[i]);
+        (*m_innovation)(i) = measure(rows[i]) - projectedMeasure(rows[i]);
+    }
+    return nbVisible;
+}
 
-    *m_xp = xkm+K*(measure-projectedMeasure); // New estimated state
-    const RigidBodyDynamics::Math::MatrixNd& temp(utils::Matrix::Identity(
-                3* *m_nbDof, 3* *m_nbDof) - K*Hessian);
-    *m_Pp =  temp * Pkm * temp.transpose() + K* *m_R*K.transpose();
+void rigidbody::KalmanRecons::correction(
+    unsigned int nbVisible,
+    bool updateState)
+{
+    if (nbVisible == 0) {
+        // Nothing to correct with
+        if (updateState) {
+            *m_xp = *m_xkm;
+        }
+        *m_Pp = *m_Pkm;
+        return;
+    }
 
+    unsigned int n(*m_nbDof);
+    const std::vector<unsigned int>& rows(*m_visibleRows);
+    Eigen::Ref<const Eigen::MatrixXd> H(m_Hvisible->topRows(nbVisible));
+    Eigen::Ref<Eigen::MatrixXd> HP(m_HP->topRows(nbVisible));
+    Eigen::Ref<Eigen::MatrixXd> S(m_S->topLeftCorner(nbVisible, nbVisible));
+
+    // Innovation covariance, H only has non-zero values in the Q columns
+    HP.noalias() = H * m_Pkm->topRows(n);
+    S.noalias() = HP.leftCols(n) * H.transpose();
+    for (unsigned int i=0; i<nbVisible; ++i) {
+        S(i, i) += (*m_R)(rows[i], rows[i]);
+    }
+    Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(S); // In place
+    utils::Error::check(llt.info() == Eigen::Success,
+                        "The innovation covariance of the Kalman filter is not positive definite");
+
+    // With W = L^-1*H*Pkm the gain is W'*L^-1 and the new covariance is Pkm - W'*W
+    llt.matrixL().solveInPlace(HP);
+    if (updateState) {
+        Eigen::Ref<Eigen::VectorXd> innovation(m_innovation->head(nbVisible));
+        llt.matrixL().solveInPlace(innovation);
+        *m_xp = *m_xkm; // New estimated state
+        m_xp->noalias() += HP.transpose() * innovation;
+    }
+    m_Pkm->selfadjointView<Eigen::Lower>().rankUpdate(HP.transpose(), -1.0);
+    m_Pp->triangularView<Eigen::Lower>() = *m_Pkm;
+    m_Pp->triangularView<Eigen::StrictlyUpper>() = m_Pkm->transpose();
 }
 
-void rigidbody::KalmanRecons::manageOcclusionDuringIteration(
-    utils::Matrix &InvTp,
-    utils::Vector &measure,
-    const std::vector<unsigned int> &occlusion)
+unsigned int rigidbody::KalmanRecons::initializePose(
+    const utils::Vector &measure,
+    const std::function<void(const rigidbody::GeneralizedCoordinates&, std::vector<unsigned int>&)>
+    &project)
 {
-    for (unsigned int i = 0; i < occlusion.size(); ++i)
-        for (unsigned int j=occlusion[i]; j< occlusion[i]+1; ++j) {
-            InvTp(j,j) =
-                0; // Artifact due to the fact that m_R has a value at (j:j+2,j:j+2)
-            measure(j) = 0;
+    unsigned int n(*m_nbDof);
+    rigidbody::GeneralizedCoordinates Q(m_xp->topRows(n));
+    utils::Matrix JtJ(n, n);
+    utils::Vector step(utils::Vector::Zero(n));
+    std::vector<unsigned int> occlusion;
+    double previousCost(std::numeric_limits<double>::infinity());
+
+    unsigned int nbIterations(0);
+    while (nbIterations < m_params->initMaxIterations()) {
+        project(Q, occlusion);
+        ++nbIterations;
+        unsigned int nbVisible(gatherVisibleMeasurements(measure, *m_zest, *m_H,
+                               occlusion));
+        if (nbVisible == 0) {
+            break;
         }
+        Eigen::Ref<const Eigen::MatrixXd> H(m_Hvisible->topRows(nbVisible));
+        Eigen::Ref<const Eigen::VectorXd> residual(m_innovation->head(nbVisible));
+
+        // Go back half the step if it made things worse
+        double cost(residual.squaredNorm());
+        if (cost > previousCost) {
+            step *= 0.5;
+            Q -= step;
+            if (step.lpNorm<Eigen::Infinity>() < m_params->initTolerance()) {
+                break;
+            }
+            continue;
+        }
+        previousCost = cost;
+
+        // Gauss-Newton step, the small damping leaves the degrees of freedom
+        // that are not measured untouched
+        JtJ.noalias() = H.transpose() * H;
+        JtJ.diagonal().array() += 1e-10 * (1.0 + JtJ.diagonal().maxCoeff());
+        step = JtJ.ldlt().solve(H.transpose() * residual);
+        Q += step;
+        if (step.lpNorm<Eigen::Infinity>() < m_params->initTolerance()) {
+            break;
+        }
+    }
+
+    m_xp->topRows(n) = Q;
+    m_xp->bottomRows(2*n).setZero();
+    return nbIterations;
+}
+
+void rigidbody::KalmanRecons::initializeCovariance(
+    const utils::Vector &measure,
+    const std::function<void(const rigidbody::GeneralizedCoordinates&, std::vector<unsigned int>&)>
+    &project)
+{
+    std::vector<unsigned int> occlusion;
+    project(rigidbody::GeneralizedCoordinates(m_xp->topRows(*m_nbDof)), occlusion);
+    unsigned int nbVisible(gatherVisibleMeasurements(measure, *m_zest, *m_H,
+                           occlusion));
+
+    utils::Matrix previous(*m_Pp);
+    for (unsigned int i=0; i<m_params->initMaxIterations(); ++i) {
+        predictCovariance();
+        correction(nbVisible, false);
+        if ((*m_Pp - previous).norm() <= m_params->initTolerance() * m_Pp->norm()) {
+            break;
+        }
+        previous = *m_Pp;
+    }
+}
+
+void rigidbody::KalmanRecons::packCovariance(
+    Eigen::Ref<Eigen::VectorXd> covariance) const
+{
+    unsigned int nbStates(3 * *m_nbDof);
+    unsigned int k(0);
+    for (unsigned int j=0; j<nbStates; ++j) {
+        covariance.segment(k, nbStates - j) = m_Pp->col(j).tail(nbStates - j);
+        k += nbStates - j;
+    }
+}
+
+void rigidbody::KalmanRecons::unpackCovariance(
+    const Eigen::Ref<const Eigen::VectorXd>& covariance)
+{
+    unsigned int nbStates(3 * *m_nbDof);
+    unsigned int k(0);
+    for (unsigned int j=0; j<nbStates; ++j) {
+        m_Pp->col(j).tail(nbStates - j) = covariance.segment(k, nbStates - j);
+        m_Pp->row(j).tail(nbStates - j) = covariance.segment(k, nbStates - j).transpose();
+        k += nbStates - j;
+    }
+}
+
+void rigidbody::KalmanRecons::smoothStates(
+    utils::Matrix& states,
+    const utils::Matrix& covariances)
+{
+    unsigned int nbFrames(static_cast<unsigned int>(states.cols()));
+    utils::Error::check(states.rows() == 3 * *m_nbDof
+                        && covariances.rows() == 3 * *m_nbDof * (3 * *m_nbDof + 1) / 2
+                        && covariances.cols() == nbFrames,
+                        "states and covariances must have one column per frame");
+    if (nbFrames == 0) {
+        return;
+    }
+
+    // The smoothed state of the last frame is its filtered state
+    utils::Vector difference(3 * *m_nbDof);
+    for (unsigned int f=nbFrames-1; f>0; --f) {
+        *m_xp = states.col(f-1);
+        unpackCovariance(covariances.col(f-1));
+        const utils::Vector& xkm(predictState());
+        predictCovariance();
+
+        // The gain of the smoother is Pp*A'*Pkm^-1, with Pp*A' = (A*Pp)'
+        difference = states.col(f) - xkm;
+        Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(*m_Pkm); // In place
+        utils::Error::check(llt.info() == Eigen::Success,
+                            "The predicted covariance of the Kalman filter is not positive definite");
+        llt.solveInPlace(difference);
+        states.col(f-1).noalias() += m_APkm->transpose() * difference;
+    }
+
+    *m_xp = states.col(nbFrames-1);
+    unpackCovariance(covariances.col(nbFrames-1));
+}
+
+unsigned int rigidbody::KalmanRecons::nbMeasurementsPerSensor() const
+{
+    return 1;
+}
+
+unsigned int rigidbody::KalmanRecons::nbInitIterations() const
+{
+    return *m_nbInitIterations;
+}
+
+void rigidbody::KalmanRecons::predictFrame(
+    rigidbody::GeneralizedCoordinates *Q,
+    rigidbody::GeneralizedVelocity *Qdot,
+    rigidbody::GeneralizedAcceleration *Qddot)
+{
+    predictState();
+    predictCovariance();
+    correction(0);
+    getState(Q, Qdot, Qddot);
 }
 
 void rigidbody::KalmanRecons::getState(
@@ -191,6 +472,18 @@ void rigidbody::KalmanRecons::initialize()
 
     // Matrix Pp
     *m_Pp = initCovariance(*m_nbDof, m_params->errorFactor());
+
+    // Buffers of the iteration
+    *m_xkm = utils::Vector(3 * *m_nbDof);
+    *m_Pkm = utils::Matrix(3 * *m_nbDof, 3 * *m_nbDof);
+    *m_APkm = utils::Matrix(3 * *m_nbDof, 3 * *m_nbDof);
+    *m_H = utils::Matrix::Zero(*m_nMeasure, *m_nbDof);
+    *m_zest = utils::Vector::Zero(*m_nMeasure);
+    m_visibleRows->reserve(*m_nMeasure);
+    *m_Hvisible = utils::Matrix(*m_nMeasure, *m_nbDof);
+    *m_HP = utils::Matrix(*m_nMeasure, 3 * *m_nbDof);
+    *m_S = utils::Matrix(*m_nMeasure, *m_nMeasure);
+    *m_innovation = utils::Vector(*m_nMeasure);
 }
 
 
@@ -249,10 +542,16 @@ utils::Matrix rigidbody::KalmanRecons::initCovariance(
 rigidbody::KalmanParam::KalmanParam(
     double frequency,
     double noiseFactor,
-    double errorFactor):
+    double errorFactor,
+    unsigned int initMaxIterations,
+    double initTolerance,
+    double imuNoiseFactor):
     m_acquisitionFrequency(frequency),
     m_noiseFactor(noiseFactor),
-    m_errorFactor(errorFactor) {}
+    m_errorFactor(errorFactor),
+    m_initMaxIterations(initMaxIterations),
+    m_initTolerance(initTolerance),
+    m_imuNoiseFactor(imuNoiseFactor) {}
 
 double rigidbody::KalmanParam::acquisitionFrequency() const
 {
@@ -268,3 +567,18 @@ double rigidbody::KalmanParam::errorFactor() const
 {
     return m_errorFactor;
 }
+
+unsigned int rigidbody::KalmanParam::initMaxIterations() const
+{
+    return m_initMaxIterations;
+}
+
+double rigidbody::KalmanParam::initTolerance() const
+{
+    return m_initTolerance;
+}
+
+double rigidbody::KalmanParam::imuNoiseFactor() const
+{
+    return m_imuNoiseFactor;
+}
@@ -16,7 +16,6 @@ using namespace BIORBD_NAMESPACE;
 
 rigidbody::KalmanReconsIMU::KalmanReconsIMU() :
     rigidbody::KalmanRecons(),
-    m_PpInitial(std::make_shared<utils::Matrix>()),
     m_firstIteration(std::make_shared<bool>(true))
 {
 
@@ -26,7 +25,6 @@ rigidbody::KalmanReconsIMU::KalmanReconsIMU(
     Model &model,
     rigidbody::KalmanParam params) :
     rigidbody::KalmanRecons(model, model.nbTechIMUs()*9, params),
-    m_PpInitial(std::make_shared<utils::Matrix>()),
     m_firstIteration(std::make_shared<bool>(true))
 {
     // Initialize the filter
@@ -45,29 +43,12 @@ void rigidbody::KalmanReconsIMU::DeepCopy(const
         rigidbody::KalmanReconsIMU &other)
 {
     rigidbody::KalmanRecons::DeepCopy(other);
-    *m_PpInitial = *other.m_PpInitial;
     *m_firstIteration = *other.m_firstIteration;
 }
 
-void rigidbody::KalmanReconsIMU::initialize()
+unsigned int rigidbody::KalmanReconsIMU::nbMeasurementsPerSensor() const
 {
-    rigidbody::KalmanRecons::initialize();
-
-    // Keep in mind the m_Pp from the start
-    *m_PpInitial = *m_Pp;
-}
-
-void rigidbody::KalmanReconsIMU::manageOcclusionDuringIteration(
-    utils::Matrix &InvTp,
-    utils::Vector &measure,
-    const std::vector<unsigned int> &occlusion)
-{
-    for (unsigned int i = 0; i < occlusion.size(); ++i)
-        for (unsigned int j=occlusion[i] * 9; j< occlusion[i] * 9+9; ++j) {
-            InvTp(j,j) =
-                0; // Artefact due to the fact that m_R has a value at (j:j+2,j:j+2)
-            measure[j] = 0;
-        }
+    return 9;
 }
 
 bool rigidbody::KalmanReconsIMU::first()
@@ -102,36 +83,44 @@ void rigidbody::KalmanReconsIMU::reconstructFrame(
     rigidbody::GeneralizedVelocity *Qdot,
     rigidbody::GeneralizedAcceleration *Qddot)
 {
-    // An iteration of the Kalman filter
     if (*m_firstIteration) {
         *m_firstIteration = false;
-        for (unsigned int i=0; i<300; ++i) {
-            // The first time, call in a recursive manner to have a decent initial position
-            reconstructFrame(model, IMUobs, nullptr, nullptr, nullptr);
-
-            // we don't need the velocity to get to the initial position
-            // Otherwise, there are risks of overshooting
-            m_xp->block(*m_nbDof, 0, *m_nbDof*2,
-                        1) = utils::Vector::Zero(*m_nbDof*2);
-        }
+        std::function<void(const rigidbody::GeneralizedCoordinates&, std::vector<unsigned int>&)>
+        project([&](const rigidbody::GeneralizedCoordinates& Q_tp,
+        std::vector<unsigned int>& occlusion) {
+            projectIMUs(model, Q_tp, IMUobs, occlusion);
+        });
+        *m_nbInitIterations = initializePose(IMUobs, project);
+        initializeCovariance(IMUobs, project);
     }
 
     // Projected state
-    const utils::Vector& xkm(*m_A * *m_xp);
-    rigidbody::GeneralizedCoordinates Q_tp(xkm.topRows(*m_nbDof));
-    model.UpdateKinematicsCustom (&Q_tp, nullptr, nullptr);
+    std::vector<unsigned int> occlusionIdx;
+    projectIMUs(model, predictState().topRows(*m_nbDof), IMUobs, occlusionIdx);
+
+    // Make the filter
+    iteration(IMUobs, *m_zest, *m_H, occlusionIdx);
 
-    // Projected markers
-    const std::vector<rigidbody::IMU>& zest_tp = model.technicalIMU(Q_tp,
-            false);
+    getState(Q, Qdot, Qddot);
+}
+
+void rigidbody::KalmanReconsIMU::projectIMUs(
+    Model &model,
+    const rigidbody::GeneralizedCoordinates &Q,
+    const utils::Vector &IMUobs,
+    std::vector<unsigned int> &occlusion)
+{
+    model.UpdateKinematicsCustom (&Q, nullptr, nullptr);
+
+    // Projected IMUs
+    const std::vector<rigidbody::IMU>& zest_tp = model.technicalIMU(Q, false);
     // Jacobian
     const std::vector<utils::Matrix>& J_tp = model.TechnicalIMUJacobian(
-                Q_tp, false);
-    // Create only one matrix for zest and Jacobian
-    utils::Matrix H(utils::Matrix::Zero(*m_nMeasure,
-                            *m_nbDof*3)); // 3*nCentrales => X,Y,Z ; 3*nbDof => Q, Qdot, Qddot
-    utils::Vector zest(utils::Vector::Zero(*m_nMeasure));
-    std::vector<unsigned int> occlusionIdx;
+                Q, false);
+    // 9*nIMU => the rotation matrices ; only the Q columns as it does not depend on Qdot and Qddot
+    utils::Matrix& H(*m_H);
+    utils::Vector& zest(*m_zest);
+    occlusion.clear();
     for (unsigned int i=0; i<*m_nMeasure/9; ++i) {
         utils::Scalar sum = 0;
         for (unsigned int j = 0; j < 9;
@@ -149,14 +138,9 @@ void rigidbody::KalmanReconsIMU::reconstructFrame(
                 zest.block(i*9+j*3, 0, 3, 1) = rot.block(0, j, 3, 1);
             }
         } else {
-            occlusionIdx.push_back(i);
+            occlusion.push_back(i);
         }
     }
-
-    // Make the filter
-    iteration(IMUobs, zest, H, occlusionIdx);
-
-    getState(Q, Qdot, Qddot);
 }
 
 void rigidbody::KalmanReconsIMU::reconstructFrame()
@@ -1,11 +1,14 @@
 #define BIORBD_API_EXPORTS
 #include "RigidBody/KalmanReconsMarkers.h"
 
+#include <algorithm>
 #include <rbdl/Model.h>
 #include <rbdl/Kinematics.h>
 #include "BiorbdModel.h"
+#include "ModelWorkspace.h"
 #include "Utils/Error.h"
 #include "Utils/Matrix.h"
+#include "Utils/ThreadPool.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedVelocity.h"
 #include "RigidBody/GeneralizedAcceleration.h"
@@ -17,8 +20,8 @@ using namespace BIORBD_NAMESPACE;
 
 rigidbody::KalmanReconsMarkers::KalmanReconsMarkers() :
     rigidbody::KalmanRecons(),
-    m_PpInitial(std::make_shared<utils::Matrix>()),
-    m_firstIteration(std::make_shared<bool>(true))
+    m_firstIteration(std::make_shared<bool>(true)),
+    m_occlusion(std::make_shared<std::vector<unsigned int>>())
 {
 
 }
@@ -27,9 +30,11 @@ rigidbody::KalmanReconsMarkers::KalmanReconsMarkers(
     Model &model,
     rigidbody::KalmanParam params) :
     rigidbody::KalmanRecons(model, model.nbTechnicalMarkers()*3, params),
-    m_PpInitial(std::make_shared<utils::Matrix>()),
-    m_firstIteration(std::make_shared<bool>(true))
+    m_firstIteration(std::make_shared<bool>(true)),
+    m_occlusion(std::make_shared<std::vector<unsigned int>>())
 {
+    // At most all the markers are occluded
+    m_occlusion->reserve(model.nbTechnicalMarkers());
 
     // Initialize the filter
     initialize();
@@ -48,29 +53,13 @@ void rigidbody::KalmanReconsMarkers::DeepCopy(const
         rigidbody::KalmanReconsMarkers &other)
 {
     rigidbody::KalmanRecons::DeepCopy(other);
-    *m_PpInitial = *other.m_PpInitial;
     *m_firstIteration = *other.m_firstIteration;
+    *m_occlusion = *other.m_occlusion;
 }
 
-void rigidbody::KalmanReconsMarkers::initialize()
+unsigned int rigidbody::KalmanReconsMarkers::nbMeasurementsPerSensor() const
 {
-    rigidbody::KalmanRecons::initialize();
-
-    // Keep in mind the initial m_Pp
-    m_PpInitial = m_Pp;
-}
-
-void rigidbody::KalmanReconsMarkers::manageOcclusionDuringIteration(
-    utils::Matrix &InvTp,
-    utils::Vector &measure,
-    const std::vector<unsigned int> &occlusion)
-{
-    for (unsigned int i = 0; i < occlusion.size(); ++i)
-        for (unsigned int j=occlusion[i] * 3; j< occlusion[i] * 3+3; ++j) {
-            InvTp(j,j) =
-                0; // Artefact due to the fact that m_R has a value at (j:j+2,j:j+2)
-            measure[j] = 0;
-        }
+    return 3;
 }
 
 bool rigidbody::KalmanReconsMarkers::first()
@@ -123,50 +112,61 @@ void rigidbody::KalmanReconsMarkers::reconstructFrame(
     rigidbody::GeneralizedAcceleration *Qddot,
     bool removeAxes)
 {
-    // An iteration of the Kalman filter
     if (*m_firstIteration) {
         *m_firstIteration = false;
-        utils::Vector TobsTP(Tobs);
-        TobsTP.block(3*model.nbTechnicalMarkers(0), 0,
-                     3*model.nbTechnicalMarkers()-3*model.nbTechnicalMarkers(0), 1) =
-                         utils::Vector::Zero(3*model.nbTechnicalMarkers()
-                                 -3*model.nbTechnicalMarkers(
-                                     0)); // Only keep the markers of the root
-        for (unsigned int j = 0; j < 2;
-                ++j) { // Do the root and then the rest of the body
-            if (j != 0) {
-                TobsTP = Tobs;    // Re-take all the markers
-            }
-
-            for (unsigned int i=0; i<50; ++i) {
-                // The first time, call in a recursive manner to get a descent initial position
-                reconstructFrame(model, TobsTP, nullptr, nullptr, nullptr);
-
-                // Reset Pp to initial (we are not interested in the velocity to get to the initial position)
-                m_Pp = m_PpInitial;
-                m_xp->block(*m_nbDof, 0, *m_nbDof*2,
-                            1) = utils::Vector::Zero(
-                                     *m_nbDof*2); // Set velocity and acceleration to zero
-            }
-        }
+
+        // Solve the pose of the root with its markers only, then the whole body
+        utils::Vector TobsRoot(Tobs);
+        TobsRoot.tail(3*(model.nbTechnicalMarkers() - model.nbTechnicalMarkers(
+                             0))).setZero();
+        *m_nbInitIterations = initializePose(TobsRoot,
+                                             [&](const rigidbody::GeneralizedCoordinates& Q_tp,
+        std::vector<unsigned int>& occlusion) {
+            projectMarkers(model, Q_tp, TobsRoot, occlusion, removeAxes);
+        });
+        std::function<void(const rigidbody::GeneralizedCoordinates&, std::vector<unsigned int>&)>
+        project([&](const rigidbody::GeneralizedCoordinates& Q_tp,
+        std::vector<unsigned int>& occlusion) {
+            projectMarkers(model, Q_tp, Tobs, occlusion, removeAxes);
+        });
+        *m_nbInitIterations += initializePose(Tobs, project);
+        initializeCovariance(Tobs, project);
     }
 
     // Projected state
-    const utils::Vector& xkm(*m_A * *m_xp);
-    const rigidbody::GeneralizedCoordinates& Q_tp(xkm.topRows(*m_nbDof));
-    model.UpdateKinematicsCustom (&Q_tp, nullptr, nullptr);
+    projectMarkers(model, predictState().topRows(*m_nbDof), Tobs, *m_occlusion,
+                   removeAxes);
+
+    // Filter
+    iteration(Tobs, *m_zest, *m_H, *m_occlusion);
+
+    getState(Q, Qdot, Qddot);
+}
+
+void rigidbody::KalmanReconsMarkers::projectMarkers(
+    Model &model,
+    const rigidbody::GeneralizedCoordinates &Q,
+    const utils::Vector &Tobs,
+    std::vector<unsigned int> &occlusion,
+    bool removeAxes)
+{
+    model.UpdateKinematicsCustom (&Q, nullptr, nullptr);
 
     // Projected markers
     const std::vector<rigidbody::NodeSegment>& zest_tp(
-        model.technicalMarkers(Q_tp, removeAxes, false));
-    // Jacobian
+        model.technicalMarkers(Q, removeAxes, false));
+    // Jacobian (3*nMarkers => X,Y,Z ; only the Q columns as it does not depend on Qdot and Qddot)
+    utils::Matrix& H(*m_H);
+#ifdef BIORBD_USE_CASADI_MATH
     const  std::vector<utils::Matrix>& J_tp(model.technicalMarkersJacobian(
-                Q_tp, removeAxes, false));
-    // Create only one matrix for zest and Jacobian
-    utils::Matrix H(utils::Matrix::Zero(*m_nMeasure,
-                            *m_nbDof*3)); // 3*nMarkers => X,Y,Z ; 3*nbDof => Q, Qdot, Qddot
-    utils::Vector zest(utils::Vector::Zero(*m_nMeasure));
-    std::vector<unsigned int> occlusionIdx;
+                Q, removeAxes, false));
+#else
+    // Directly in H, the rows of the occluded markers are ignored by the filter
+    model.technicalMarkersJacobian(
+        Q, H.block(0, 0, *m_nMeasure, *m_nbDof), removeAxes, false);
+#endif
+    utils::Vector& zest(*m_zest);
+    occlusion.clear();
     for (unsigned int i=0; i<*m_nMeasure/3;
             ++i) // Divided by 3 because we are integrate once xyz
 #ifdef BIORBD_USE_CASADI_MATH
@@ -178,16 +178,87 @@ void rigidbody::KalmanReconsMarkers::reconstructFrame(
                 !isnan(Tobs(i*3)*Tobs(i*3) + Tobs(i*3+1)*Tobs(i*3+1) + Tobs(i*3+2)*Tobs(
                            i*3+2))) {
 #endif
+#ifdef BIORBD_USE_CASADI_MATH
             H.block(i*3,0,3,*m_nbDof) = J_tp[i];
+#endif
             zest.block(i*3, 0, 3, 1) = zest_tp[i];
         } else {
-            occlusionIdx.push_back(i);
+            occlusion.push_back(i);
         }
+}
 
-    // Filter
-    iteration(Tobs, zest, H, occlusionIdx);
+void rigidbody::KalmanReconsMarkers::reconstructTrial(
+    Model &model,
+    const utils::Matrix &markers,
+    utils::Matrix &Q,
+    utils::Matrix &Qdot,
+    utils::Matrix &Qddot,
+    bool smooth,
+    bool removeAxes)
+{
+    unsigned int nbFrames(static_cast<unsigned int>(markers.cols()));
+    utils::Error::check(markers.rows() == *m_nMeasure,
+                        "markers must have 3*nbTechnicalMarkers rows");
+    utils::Error::check(
+        Q.rows() == *m_nbDof && Q.cols() == nbFrames
+        && Qdot.rows() == *m_nbDof && Qdot.cols() == nbFrames
+        && Qddot.rows() == *m_nbDof && Qddot.cols() == nbFrames,
+        "Q, Qdot and Qddot must have nbDof rows and as many columns as markers");
 
-    getState(Q, Qdot, Qddot);
+    // Forward pass, keeping the lower triangle of the covariances for the backward pass
+    unsigned int nbStates(3 * *m_nbDof);
+    utils::Matrix states(nbStates, nbFrames);
+    utils::Matrix covariances(smooth ? nbStates * (nbStates + 1) / 2 : 0, nbFrames);
+    utils::Vector Tobs(*m_nMeasure);
+    for (unsigned int f=0; f<nbFrames; ++f) {
+        Tobs = markers.col(f);
+        reconstructFrame(model, Tobs, nullptr, nullptr, nullptr, removeAxes);
+        states.col(f) = *m_xp;
+        if (smooth) {
+            packCovariance(covariances.col(f));
+        }
+    }
+
+    if (smooth) {
+        smoothStates(states, covariances);
+    }
+    Q = states.topRows(*m_nbDof);
+    Qdot = states.middleRows(*m_nbDof, *m_nbDof);
+    Qddot = states.bottomRows(*m_nbDof);
+}
+
+void rigidbody::KalmanReconsMarkers::reconstructTrials(
+    Model &model,
+    const std::vector<utils::Matrix> &markers,
+    std::vector<utils::Matrix> &Q,
+    std::vector<utils::Matrix> &Qdot,
+    std::vector<utils::Matrix> &Qddot,
+    const rigidbody::KalmanParam &params,
+    bool smooth,
+    bool removeAxes)
+{
+    unsigned int nbTrials(static_cast<unsigned int>(markers.size()));
+    Q.resize(nbTrials);
+    Qdot.resize(nbTrials);
+    Qddot.resize(nbTrials);
+    // The state of the filter has dof_count rows for Q, Qdot and Qddot
+    for (unsigned int i=0; i<nbTrials; ++i) {
+        unsigned int nbFrames(static_cast<unsigned int>(markers[i].cols()));
+        Q[i] = utils::Matrix(model.dof_count, nbFrames);
+        Qdot[i] = utils::Matrix(model.dof_count, nbFrames);
+        Qddot[i] = utils::Matrix(model.dof_count, nbFrames);
+    }
+
+    utils::ThreadPool pool(std::min(model.nbThreads(), std::max(nbTrials, 1u)));
+    std::vector<std::shared_ptr<ModelWorkspace>> workspaces;
+    for (unsigned int i=0; i<pool.nbThreads(); ++i) {
+        workspaces.push_back(std::make_shared<ModelWorkspace>(model));
+    }
+    pool.run(nbTrials, [&](unsigned int trial, unsigned int worker) {
+        rigidbody::KalmanReconsMarkers kalman(*workspaces[worker], params);
+        kalman.reconstructTrial(*workspaces[worker], markers[trial], Q[trial],
+                                Qdot[trial], Qddot[trial], smooth, removeAxes);
+    });
 }
 
 void rigidbody::KalmanReconsMarkers::reconstructFrame()
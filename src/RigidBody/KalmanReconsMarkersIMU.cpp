@@ -0,0 +1,248 @@
+#define BIORBD_API_EXPORTS
+#include "RigidBody/KalmanReconsMarkersIMU.h"
+
+#include <rbdl/Model.h>
+#include <rbdl/Kinematics.h>
+#include "BiorbdModel.h"
+#include "Utils/Error.h"
+#include "Utils/Matrix.h"
+#include "Utils/Rotation.h"
+#include "RigidBody/GeneralizedCoordinates.h"
+#include "RigidBody/GeneralizedVelocity.h"
+#include "RigidBody/GeneralizedAcceleration.h"
+#include "RigidBody/NodeSegment.h"
+#include "RigidBody/IMU.h"
+
+#include <cmath>
+
+using namespace BIORBD_NAMESPACE;
+
+rigidbody::KalmanReconsMarkersIMU::KalmanReconsMarkersIMU() :
+    rigidbody::KalmanRecons(),
+    m_nbMarkers(std::make_shared<unsigned int>(0)),
+    m_nbIMUs(std::make_shared<unsigned int>(0)),
+    m_measure(std::make_shared<utils::Vector>()),
+    m_firstIteration(std::make_shared<bool>(true)),
+    m_occlusion(std::make_shared<std::vector<unsigned int>>())
+{
+
+}
+
+rigidbody::KalmanReconsMarkersIMU::KalmanReconsMarkersIMU(
+    Model &model,
+    rigidbody::KalmanParam params) :
+    rigidbody::KalmanRecons(model,
+                            model.nbTechnicalMarkers()*3 + model.nbTechIMUs()*9, params),
+    m_nbMarkers(std::make_shared<unsigned int>(model.nbTechnicalMarkers())),
+    m_nbIMUs(std::make_shared<unsigned int>(model.nbTechIMUs())),
+    m_measure(std::make_shared<utils::Vector>()),
+    m_firstIteration(std::make_shared<bool>(true)),
+    m_occlusion(std::make_shared<std::vector<unsigned int>>())
+{
+    // At most all the markers and the 3 triplets of all the IMUs are occluded
+    m_occlusion->reserve(*m_nbMarkers + 3 * *m_nbIMUs);
+
+    // Initialize the filter
+    initialize();
+}
+
+rigidbody::KalmanReconsMarkersIMU
+rigidbody::KalmanReconsMarkersIMU::DeepCopy() const
+{
+    rigidbody::KalmanReconsMarkersIMU copy;
+    copy.DeepCopy(*this);
+    return copy;
+}
+
+void rigidbody::KalmanReconsMarkersIMU::DeepCopy(const
+        rigidbody::KalmanReconsMarkersIMU &other)
+{
+    rigidbody::KalmanRecons::DeepCopy(other);
+    *m_nbMarkers = *other.m_nbMarkers;
+    *m_nbIMUs = *other.m_nbIMUs;
+    *m_measure = *other.m_measure;
+    *m_firstIteration = *other.m_firstIteration;
+    *m_occlusion = *other.m_occlusion;
+}
+
+void rigidbody::KalmanReconsMarkersIMU::initialize()
+{
+    rigidbody::KalmanRecons::initialize();
+
+    // The IMUs have their own noise
+    for (unsigned int i=3 * *m_nbMarkers; i<*m_nMeasure; ++i) {
+        (*m_R)(i, i) = m_params->imuNoiseFactor();
+    }
+    *m_measure = utils::Vector::Zero(*m_nMeasure);
+}
+
+unsigned int rigidbody::KalmanReconsMarkersIMU::nbMeasurementsPerSensor() const
+{
+    return 3;
+}
+
+bool rigidbody::KalmanReconsMarkersIMU::first()
+{
+    return *m_firstIteration;
+}
+
+void rigidbody::KalmanReconsMarkersIMU::reconstructFrame(
+    Model &model,
+    const std::vector<rigidbody::NodeSegment> &Tobs,
+    const std::vector<rigidbody::IMU> &IMUobs,
+    rigidbody::GeneralizedCoordinates *Q,
+    rigidbody::GeneralizedVelocity *Qdot,
+    rigidbody::GeneralizedAcceleration *Qddot,
+    bool removeAxes)
+{
+    // Separate the tobs in a big vector
+    utils::Vector T(static_cast<unsigned int>(3*Tobs.size()));
+    for (unsigned int i=0; i<Tobs.size(); ++i) {
+        T.block(i*3, 0, 3, 1) = Tobs[i];
+    }
+
+    // Separate the IMUobs in a big vector
+    utils::Vector I(static_cast<unsigned int>(9*IMUobs.size()));
+    for (unsigned int i=0; i<IMUobs.size(); ++i)
+        for (unsigned int j=0; j<3; ++j) {
+            I.block(9*i+3*j, 0, 3, 1) = IMUobs[i].block(0,j,3,1);
+        }
+
+    // Reconstruct the kinematics
+    reconstructFrame(model, T, I, Q, Qdot, Qddot, removeAxes);
+}
+
+void rigidbody::KalmanReconsMarkersIMU::reconstructFrame(
+    Model &model,
+    const utils::Vector &Tobs,
+    const utils::Vector &IMUobs,
+    rigidbody::GeneralizedCoordinates *Q,
+    rigidbody::GeneralizedVelocity *Qdot,
+    rigidbody::GeneralizedAcceleration *Qddot,
+    bool removeAxes)
+{
+    utils::Error::check(Tobs.size() == 3 * *m_nbMarkers,
+                        "Tobs must have 3*nbTechnicalMarkers elements");
+    utils::Error::check(IMUobs.size() == 9 * *m_nbIMUs,
+                        "IMUobs must have 9*nbTechIMUs elements");
+    utils::Vector& measure(*m_measure);
+    measure.topRows(3 * *m_nbMarkers) = Tobs;
+    measure.bottomRows(9 * *m_nbIMUs) = IMUobs;
+
+    if (*m_firstIteration) {
+        *m_firstIteration = false;
+
+        // Solve the pose of the root with its markers only, then the whole body
+        utils::Vector measureRoot(utils::Vector::Zero(*m_nMeasure));
+        measureRoot.topRows(3*model.nbTechnicalMarkers(0)) =
+            Tobs.topRows(3*model.nbTechnicalMarkers(0));
+        *m_nbInitIterations = initializePose(measureRoot,
+                                             [&](const rigidbody::GeneralizedCoordinates& Q_tp,
+        std::vector<unsigned int>& occlusion) {
+            project(model, Q_tp, measureRoot, occlusion, removeAxes);
+        });
+        std::function<void(const rigidbody::GeneralizedCoordinates&, std::vector<unsigned int>&)>
+        projection([&](const rigidbody::GeneralizedCoordinates& Q_tp,
+        std::vector<unsigned int>& occlusion) {
+            project(model, Q_tp, measure, occlusion, removeAxes);
+        });
+        *m_nbInitIterations += initializePose(measure, projection);
+        initializeCovariance(measure, projection);
+    }
+
+    // Projected state
+    project(model, predictState().topRows(*m_nbDof), measure, *m_occlusion,
+            removeAxes);
+
+    // Filter
+    iteration(measure, *m_zest, *m_H, *m_occlusion);
+
+    getState(Q, Qdot, Qddot);
+}
+
+void rigidbody::KalmanReconsMarkersIMU::project(
+    Model &model,
+    const rigidbody::GeneralizedCoordinates &Q,
+    const utils::Vector &measure,
+    std::vector<unsigned int> &occlusion,
+    bool removeAxes)
+{
+    // One update of the kinematics for both sources
+    model.UpdateKinematicsCustom (&Q, nullptr, nullptr);
+
+    unsigned int nbMarkerRows(3 * *m_nbMarkers);
+    utils::Matrix& H(*m_H);
+    utils::Vector& zest(*m_zest);
+    occlusion.clear();
+
+    // Projected markers and their jacobian (only the Q columns as it does not depend on Qdot and Qddot)
+    const std::vector<rigidbody::NodeSegment>& markers(
+        model.technicalMarkers(Q, removeAxes, false));
+#ifdef BIORBD_USE_CASADI_MATH
+    const std::vector<utils::Matrix>& markersJacobian(
+        model.technicalMarkersJacobian(Q, removeAxes, false));
+#else
+    // Directly in H, the rows of the occluded markers are ignored by the filter
+    model.technicalMarkersJacobian(
+        Q, H.block(0, 0, nbMarkerRows, *m_nbDof), removeAxes, false);
+#endif
+    for (unsigned int i=0; i<*m_nbMarkers; ++i) {
+#ifdef BIORBD_USE_CASADI_MATH
+        // If there is a marker
+        if (!measure(i*3).is_zero() && !measure(i*3+1).is_zero()
+                && !measure(i*3+2).is_zero()) {
+            H.block(i*3, 0, 3, *m_nbDof) = markersJacobian[i];
+#else
+        utils::Scalar sum(measure.block(i*3, 0, 3, 1).squaredNorm());
+        if (sum != 0.0 && !std::isnan(sum)) { // If there is a marker (no zero or NaN)
+#endif
+            zest.block(i*3, 0, 3, 1) = markers[i];
+        } else {
+            occlusion.push_back(i);
+        }
+    }
+
+    // Projected IMUs and their jacobian, an IMU is made of 3 triplets (its columns)
+#ifdef BIORBD_USE_CASADI_MATH
+    const std::vector<rigidbody::IMU>& imus(model.technicalIMU(Q, false));
+    const std::vector<utils::Matrix>& imusJacobian(model.TechnicalIMUJacobian(Q,
+            false));
+#else
+    // Directly in zest and H, the rows of the occluded IMUs are ignored by the filter
+    unsigned int nbImuRows(9 * *m_nbIMUs);
+    model.technicalIMU(Q, zest.segment(nbMarkerRows, nbImuRows), false);
+    model.TechnicalIMUJacobian(
+        Q, H.block(nbMarkerRows, 0, nbImuRows, *m_nbDof), false);
+#endif
+    for (unsigned int i=0; i<*m_nbIMUs; ++i) {
+        unsigned int row(nbMarkerRows + i*9);
+#ifdef BIORBD_USE_CASADI_MATH
+        // If there is an IMU (one of its elements is not zero)
+        bool isVisible(false);
+        for (unsigned int j=0; j<9; ++j) {
+            isVisible = isVisible || !measure(row+j).is_zero();
+        }
+        if (isVisible) {
+            H.block(row, 0, 9, *m_nbDof) = imusJacobian[i];
+            const utils::Rotation& rot = imus[i].rot();
+            for (unsigned int j = 0; j < 3; ++j) {
+                zest.block(row+j*3, 0, 3, 1) = rot.block(0, j, 3, 1);
+            }
+            continue;
+        }
+#else
+        utils::Scalar sum(measure.block(row, 0, 9, 1).squaredNorm());
+        if (sum != 0.0 && !std::isnan(sum)) { // If there is an IMU (no zero or NaN)
+            continue;
+        }
+#endif
+        for (unsigned int j = 0; j < 3; ++j) {
+            occlusion.push_back(*m_nbMarkers + i*3 + j);
+        }
+    }
+}
+
+void rigidbody::KalmanReconsMarkersIMU::reconstructFrame()
+{
+    utils::Error::raise("Reconstructing kinematics for markers and IMU needs measurements");
+}
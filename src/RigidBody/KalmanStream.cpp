@@ -0,0 +1,396 @@
+#define BIORBD_API_EXPORTS
+#include "RigidBody/KalmanStream.h"
+
+#include <algorithm>
+#include <functional>
+#include "BiorbdModel.h"
+#include "ModelReader.h"
+#include "ModelWorkspace.h"
+#include "Utils/Error.h"
+#include "Utils/Path.h"
+#include "Utils/Vector3d.h"
+#include "RigidBody/KalmanReconsMarkers.h"
+#include "RigidBody/NodeSegment.h"
+
+using namespace BIORBD_NAMESPACE;
+
+rigidbody::KalmanStream::KalmanStream(
+    const Model& model,
+    const rigidbody::KalmanParam& params,
+    unsigned int capacity,
+    rigidbody::STREAM_DROP_POLICY dropPolicy,
+    bool removeAxes,
+    double latencyBinWidth,
+    unsigned int nbLatencyBins) :
+    m_model(std::make_shared<ModelWorkspace>(model)),
+    m_kalman(std::make_shared<rigidbody::KalmanReconsMarkers>(*m_model, params)),
+    m_nbMarkers(m_model->nbTechnicalMarkers()),
+    m_removeAxes(removeAxes),
+    m_dropPolicy(dropPolicy),
+    m_queue(dropPolicy == SKIP_TO_LATEST_FRAME ? 1 : capacity,
+            Frame{utils::Vector::Zero(3*m_nbMarkers), std::chrono::steady_clock::time_point(), 0}),
+    m_latestFrame(Frame{utils::Vector::Zero(dropPolicy == SKIP_TO_LATEST_FRAME ? 3*m_nbMarkers : 0),
+                        std::chrono::steady_clock::time_point(), 0}),
+    m_lastIndex(0),
+    m_front(&m_states[0]),
+    m_back(&m_states[1]),
+    m_hasPublished(false),
+    m_stop(false),
+    m_nbPushed(0),
+    m_nbProcessed(0),
+    m_nbDropped(0),
+    m_latencyBinWidth(latencyBinWidth),
+    m_latency(nbLatencyBins),
+    m_maxLatency(0)
+{
+    utils::Error::check(latencyBinWidth > 0, "The width of the latency bins must be positive");
+    utils::Error::check(nbLatencyBins > 0, "There must be at least one latency bin");
+    for (unsigned int i=0; i<2; ++i) {
+        m_states[i].Q = rigidbody::GeneralizedCoordinates(*m_model);
+        m_states[i].Qdot = rigidbody::GeneralizedVelocity(*m_model);
+        m_states[i].Qddot = rigidbody::GeneralizedAcceleration(*m_model);
+        m_states[i].frame = 0;
+    }
+    for (unsigned int i=0; i<nbLatencyBins; ++i) {
+        m_latency[i].store(0);
+    }
+}
+
+rigidbody::KalmanStream::~KalmanStream()
+{
+    m_stop.store(true, std::memory_order_release);
+    if (m_consumer.joinable()) {
+        m_consumer.join();
+    }
+}
+
+void rigidbody::KalmanStream::start()
+{
+    utils::Error::check(!m_consumer.joinable(), "The stream is already started");
+    m_error = nullptr;
+    m_stop.store(false, std::memory_order_release);
+    m_consumer = std::thread(&rigidbody::KalmanStream::consumerLoop, this);
+}
+
+void rigidbody::KalmanStream::stop()
+{
+    if (!m_consumer.joinable()) {
+        return;
+    }
+    m_stop.store(true, std::memory_order_release);
+    m_consumer.join();
+    if (m_error) {
+        std::exception_ptr error(m_error);
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool rigidbody::KalmanStream::isRunning() const
+{
+    return m_consumer.joinable();
+}
+
+bool rigidbody::KalmanStream::push(
+    const utils::Vector& markers)
+{
+    utils::Error::check(markers.size() == 3*m_nbMarkers,
+                        "The frame must have 3*nbTechnicalMarkers elements");
+    std::chrono::steady_clock::time_point now(std::chrono::steady_clock::now());
+    unsigned long index(m_nbPushed.fetch_add(1, std::memory_order_relaxed));
+
+    Frame* frame(writeSlot());
+    if (!frame) {
+        m_nbDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    frame->markers = markers;
+    frame->pushed = now;
+    frame->index = index;
+    commitWrite();
+    return true;
+}
+
+bool rigidbody::KalmanStream::push(
+    const std::vector<rigidbody::NodeSegment>& markers)
+{
+    utils::Error::check(markers.size() == m_nbMarkers,
+                        "The frame must have nbTechnicalMarkers markers");
+    std::chrono::steady_clock::time_point now(std::chrono::steady_clock::now());
+    unsigned long index(m_nbPushed.fetch_add(1, std::memory_order_relaxed));
+
+    Frame* frame(writeSlot());
+    if (!frame) {
+        m_nbDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    for (unsigned int i=0; i<m_nbMarkers; ++i) {
+        frame->markers.block(i*3, 0, 3, 1) = markers[i];
+    }
+    frame->pushed = now;
+    frame->index = index;
+    commitWrite();
+    return true;
+}
+
+bool rigidbody::KalmanStream::isFull() const
+{
+    // The latest frame always replaces the one that is waiting
+    return m_dropPolicy == REJECT_NEW_FRAMES
+           && m_queue.size() == m_queue.capacity();
+}
+
+bool rigidbody::KalmanStream::latest(
+    rigidbody::GeneralizedCoordinates& Q,
+    rigidbody::GeneralizedVelocity& Qdot,
+    rigidbody::GeneralizedAcceleration& Qddot,
+    unsigned long* frame) const
+{
+    std::lock_guard<std::mutex> lock(m_publishMutex);
+    if (!m_hasPublished) {
+        return false;
+    }
+    Q = m_front->Q;
+    Qdot = m_front->Qdot;
+    Qddot = m_front->Qddot;
+    if (frame) {
+        *frame = m_front->frame;
+    }
+    return true;
+}
+
+unsigned long rigidbody::KalmanStream::nbPushedFrames() const
+{
+    return m_nbPushed.load(std::memory_order_relaxed);
+}
+
+unsigned long rigidbody::KalmanStream::nbProcessedFrames() const
+{
+    return m_nbProcessed.load(std::memory_order_acquire);
+}
+
+unsigned long rigidbody::KalmanStream::nbDroppedFrames() const
+{
+    return m_nbDropped.load(std::memory_order_relaxed);
+}
+
+std::vector<unsigned long> rigidbody::KalmanStream::latencyHistogram() const
+{
+    std::vector<unsigned long> histogram(m_latency.size());
+    for (unsigned int i=0; i<histogram.size(); ++i) {
+        histogram[i] = m_latency[i].load(std::memory_order_relaxed);
+    }
+    return histogram;
+}
+
+double rigidbody::KalmanStream::latencyBinWidth() const
+{
+    return m_latencyBinWidth;
+}
+
+double rigidbody::KalmanStream::maxLatency() const
+{
+    return m_maxLatency.load(std::memory_order_relaxed);
+}
+
+unsigned int rigidbody::KalmanStream::nbTechnicalMarkers() const
+{
+    return m_nbMarkers;
+}
+
+unsigned int rigidbody::KalmanStream::capacity() const
+{
+    return m_queue.capacity();
+}
+
+rigidbody::STREAM_DROP_POLICY rigidbody::KalmanStream::dropPolicy() const
+{
+    return m_dropPolicy;
+}
+
+rigidbody::KalmanStream::Frame* rigidbody::KalmanStream::writeSlot()
+{
+    if (m_dropPolicy == SKIP_TO_LATEST_FRAME) {
+        return m_latestFrame.writeSlot();
+    } else {
+        return m_queue.writeSlot();
+    }
+}
+
+void rigidbody::KalmanStream::commitWrite()
+{
+    if (m_dropPolicy == SKIP_TO_LATEST_FRAME) {
+        // The frame that was still waiting is replaced by this one
+        if (m_latestFrame.commitWrite()) {
+            m_nbDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else {
+        m_queue.commitWrite();
+    }
+}
+
+bool rigidbody::KalmanStream::hasWaitingFrame() const
+{
+    if (m_dropPolicy == SKIP_TO_LATEST_FRAME) {
+        return m_latestFrame.hasNew();
+    } else {
+        return !m_queue.empty();
+    }
+}
+
+void rigidbody::KalmanStream::consumerLoop()
+{
+    try {
+        unsigned int nbIdle(0);
+        while (true) {
+            bool hasProcessed(m_dropPolicy == SKIP_TO_LATEST_FRAME ?
+                              processLatestFrame() : processQueuedFrame());
+            if (!hasProcessed) {
+                // The frames are checked once more after the stop request, so
+                // the frames pushed before it are reconstructed
+                if (m_stop.load(std::memory_order_acquire) && !hasWaitingFrame()) {
+                    return;
+                }
+                // Spin a little for a low latency, then leave the core
+                if (++nbIdle < 1000) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+                continue;
+            }
+            nbIdle = 0;
+        }
+    } catch (...) {
+        m_error = std::current_exception();
+    }
+}
+
+bool rigidbody::KalmanStream::processQueuedFrame()
+{
+    Frame* frame(m_queue.readSlot());
+    if (!frame) {
+        return false;
+    }
+    process(*frame);
+    m_queue.commitRead();
+    return true;
+}
+
+bool rigidbody::KalmanStream::processLatestFrame()
+{
+    Frame* frame(m_latestFrame.readSlot());
+    if (!frame) {
+        return false;
+    }
+
+    // The replaced frames are only predicted so the filter keeps its time
+    // step, which is meaningless before the filter is initialized by its
+    // first frame
+    if (!m_kalman->first()) {
+        for (unsigned long i=m_lastIndex + 1; i<frame->index; ++i) {
+            m_kalman->predictFrame();
+        }
+    }
+    process(*frame);
+    return true;
+}
+
+void rigidbody::KalmanStream::process(
+    const Frame& frame)
+{
+    m_kalman->reconstructFrame(*m_model, frame.markers, &m_back->Q, &m_back->Qdot,
+                               &m_back->Qddot, m_removeAxes);
+    m_back->frame = frame.index;
+    m_lastIndex = frame.index;
+    {
+        std::lock_guard<std::mutex> lock(m_publishMutex);
+        std::swap(m_front, m_back);
+        m_hasPublished = true;
+    }
+
+    double latency(std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - frame.pushed).count());
+    unsigned int bin(static_cast<unsigned int>(std::min(
+                         latency / m_latencyBinWidth, static_cast<double>(m_latency.size() - 1))));
+    m_latency[bin].fetch_add(1, std::memory_order_relaxed);
+    if (latency > m_maxLatency.load(std::memory_order_relaxed)) {
+        m_maxLatency.store(latency, std::memory_order_relaxed);
+    }
+    m_nbProcessed.fetch_add(1, std::memory_order_release);
+}
+
+rigidbody::MarkersFileReplayer::MarkersFileReplayer(
+    const utils::Path& path,
+    double frequency) :
+    m_frequency(frequency)
+{
+    utils::Error::check(frequency > 0, "The frequency must be positive");
+    std::vector<std::vector<utils::Vector3d>> markers(
+                Reader::readMarkerDataFile(path));
+    unsigned int nbMarkers(static_cast<unsigned int>(markers.size()));
+    unsigned int nbFrames(nbMarkers ? static_cast<unsigned int>(markers[0].size()) : 0);
+    for (unsigned int j=0; j<nbFrames; ++j) {
+        utils::Vector frame(3*nbMarkers);
+        for (unsigned int i=0; i<nbMarkers; ++i) {
+            frame.block(i*3, 0, 3, 1) = markers[i][j];
+        }
+        m_frames.push_back(frame);
+    }
+}
+
+rigidbody::MarkersFileReplayer::~MarkersFileReplayer()
+{
+    join();
+}
+
+unsigned int rigidbody::MarkersFileReplayer::nbFrames() const
+{
+    return static_cast<unsigned int>(m_frames.size());
+}
+
+const utils::Vector& rigidbody::MarkersFileReplayer::frame(
+    unsigned int index) const
+{
+    utils::Error::check(index < m_frames.size(), "Frame index out of range");
+    return m_frames[index];
+}
+
+void rigidbody::MarkersFileReplayer::start(
+    rigidbody::KalmanStream& stream,
+    bool realTime)
+{
+    utils::Error::check(!m_producer.joinable(), "The replay is already started");
+    utils::Error::check(m_frames.empty()
+                        || m_frames[0].size() == 3*stream.nbTechnicalMarkers(),
+                        "The file must have the technical markers of the model of the stream");
+    m_producer = std::thread(&rigidbody::MarkersFileReplayer::producerLoop, this,
+                             std::ref(stream), realTime);
+}
+
+void rigidbody::MarkersFileReplayer::join()
+{
+    if (m_producer.joinable()) {
+        m_producer.join();
+    }
+}
+
+void rigidbody::MarkersFileReplayer::producerLoop(
+    rigidbody::KalmanStream& stream,
+    bool realTime)
+{
+    std::chrono::steady_clock::time_point next(std::chrono::steady_clock::now());
+    std::chrono::duration<double> period(1.0 / m_frequency);
+    for (unsigned int j=0; j<m_frames.size(); ++j) {
+        if (realTime) {
+            std::this_thread::sleep_until(next);
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        } else {
+            // Wait for the consumer to make some room
+            while (stream.isFull()) {
+                std::this_thread::yield();
+            }
+        }
+        stream.push(m_frames[j]);
+    }
+}
@@ -1,8 +1,12 @@
 #define BIORBD_API_EXPORTS
 #include "RigidBody/Markers.h"
 
+#include <limits>
+#include <cmath>
+#include <algorithm>
 #include <rbdl/Model.h>
 #include <rbdl/Kinematics.h>
+#include "Utils/Error.h"
 #include "Utils/String.h"
 #include "Utils/Matrix.h"
 #include "RigidBody/GeneralizedCoordinates.h"
@@ -15,13 +19,23 @@
 using namespace BIORBD_NAMESPACE;
 
 rigidbody::Markers::Markers() :
-    m_marks(std::make_shared<std::vector<rigidbody::NodeSegment>>())
+    m_marks(std::make_shared<std::vector<rigidbody::NodeSegment>>()),
+    m_marksBodyId(std::make_shared<std::vector<unsigned int>>()),
+    m_marksPositionInLocal(
+        std::make_shared<std::vector<RigidBodyDynamics::Math::Vector3d>>()),
+    m_motionSubspaceInGlobal(
+        std::make_shared<RigidBodyDynamics::Math::MatrixNd>())
 {
     //ctor
 }
 
 rigidbody::Markers::Markers(const rigidbody::Markers &other) :
-    m_marks(other.m_marks)
+    m_marks(other.m_marks),
+    m_marksBodyId(other.m_marksBodyId),
+    m_marksPositionInLocal(other.m_marksPositionInLocal),
+    // The workspace of the jacobians is written on each call, so it is never shared
+    m_motionSubspaceInGlobal(
+        std::make_shared<RigidBodyDynamics::Math::MatrixNd>())
 {
 
 }
@@ -45,6 +59,8 @@ void rigidbody::Markers::DeepCopy(
     for (unsigned int i=0; i<other.m_marks->size(); ++i) {
         (*m_marks)[i] = (*other.m_marks)[i].DeepCopy();
     }
+    *m_marksBodyId = *other.m_marksBodyId;
+    *m_marksPositionInLocal = *other.m_marksPositionInLocal;
 }
 
 // Add a new marker to the markers pool
@@ -60,6 +76,12 @@ void rigidbody::Markers::addMarker(
     rigidbody::NodeSegment tp(pos, name, parentName, technical, anatomical,
                                       axesToRemove, id);
     m_marks->push_back(tp);
+
+    // Resolve the parent once so the kinematics does not have to look it up by name
+    const rigidbody::Joints* model = dynamic_cast<const rigidbody::Joints*>(this);
+    m_marksBodyId->push_back(model ? model->GetBodyId(parentName.c_str())
+                             : std::numeric_limits<unsigned int>::max());
+    m_marksPositionInLocal->push_back(tp);
 }
 
 const rigidbody::NodeSegment &rigidbody::Markers::marker(
@@ -94,14 +116,18 @@ rigidbody::NodeSegment rigidbody::Markers::marker(
     updateKin = true;
 #endif
 
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
+
     unsigned int id = model.GetBodyId(n.parent().c_str());
     if (removeAxis) {
         return rigidbody::NodeSegment(
                    RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, n.removeAxes(),
-                           updateKin));
+                           false));
     } else {
         return rigidbody::NodeSegment(
-                   RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, n, updateKin));
+                   RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, n, false));
     }
 }
 
@@ -118,14 +144,13 @@ rigidbody::NodeSegment rigidbody::Markers::marker(
     updateKin = true;
 #endif
 
-    const rigidbody::NodeSegment& node(marker(idx));
-    unsigned int id = model.GetBodyId(node.parent().c_str());
-
-    // Retrieve the position of the marker in the local reference
-    const rigidbody::NodeSegment& pos = marker(idx, removeAxis);
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
 
     return rigidbody::NodeSegment(
-               RigidBodyDynamics::CalcBodyToBaseCoordinates(model, Q, id, pos, updateKin));
+               RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                   model, Q, markerBodyId(idx), markerInLocal(idx, removeAxis), false));
 }
 
 // Get a marker
@@ -167,6 +192,86 @@ std::vector<rigidbody::NodeSegment> rigidbody::Markers::markers(
     return pos;
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Markers::markers(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::Matrix3Xd> markers,
+    bool removeAxis,
+    bool updateKin)
+{
+#ifndef SKIP_ASSERT
+    utils::Error::check(static_cast<unsigned int>(markers.cols()) == nbMarkers(),
+                                "Wrong number of columns for the markers");
+#endif
+    // Assuming that this is also a joint type (via BiorbdModel)
+    rigidbody::Joints &model = dynamic_cast<rigidbody::Joints &>(*this);
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
+
+    for (unsigned int i=0; i<nbMarkers(); ++i) {
+        markers.col(i) = RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                             model, Q, markerBodyId(i), markerInLocal(i, removeAxis), false);
+    }
+}
+
+template<typename T>
+void rigidbody::Markers::fillMarkersBatch(
+    const utils::Matrix &Q,
+    Eigen::Ref<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>> markers,
+    bool removeAxis)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    rigidbody::Joints &model = dynamic_cast<rigidbody::Joints &>(*this);
+    unsigned int nbFrames(static_cast<unsigned int>(Q.cols()));
+    utils::Error::check(Q.rows() == model.nbQ(), "Q must have nbQ rows");
+    utils::Error::check(
+        markers.rows() == 3*nbMarkers() && markers.cols() == nbFrames,
+        "markers must have 3*nbMarkers rows and as many columns as Q");
+
+    // The positions in local are converted once to the precision of the output
+    Eigen::Matrix<T, 3, Eigen::Dynamic> positionsInLocal(3, nbMarkers());
+    std::vector<unsigned int> parents(nbMarkers());
+    for (unsigned int i=0; i<nbMarkers(); ++i) {
+        positionsInLocal.col(i) = markerInLocal(i, removeAxis).cast<T>();
+        parents[i] = static_cast<unsigned int>(
+                         model.GetBodyBiorbdId(marker(i).parent()));
+    }
+
+    std::vector<rigidbody::GeneralizedCoordinates> q(
+        model.nbThreads(), rigidbody::GeneralizedCoordinates(model));
+    std::vector<std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>>>
+            jcs(model.nbThreads());
+    model.runBatch(nbFrames, [&](rigidbody::Joints& worker, unsigned int frame,
+    unsigned int w) {
+        q[w] = Q.col(frame);
+        worker.allGlobalJCS(q[w], jcs[w], true);
+        for (unsigned int i=0; i<nbMarkers(); ++i) {
+            const Eigen::Matrix4d& rt(jcs[w][parents[i]]);
+            markers.col(frame).segment(3*i, 3) =
+                rt.block<3, 3>(0, 0).cast<T>() * positionsInLocal.col(i)
+                + rt.block<3, 1>(0, 3).cast<T>();
+        }
+    });
+}
+
+void rigidbody::Markers::markersBatch(
+    const utils::Matrix &Q,
+    Eigen::Ref<Eigen::MatrixXd> markers,
+    bool removeAxis)
+{
+    fillMarkersBatch<double>(Q, markers, removeAxis);
+}
+
+void rigidbody::Markers::markersBatch(
+    const utils::Matrix &Q,
+    Eigen::Ref<Eigen::MatrixXf> markers,
+    bool removeAxis)
+{
+    fillMarkersBatch<float>(Q, markers, removeAxis);
+}
+#endif
+
 // Get a marker's velocity
 rigidbody::NodeSegment rigidbody::Markers::markerVelocity(
     const rigidbody::GeneralizedCoordinates &Q,
@@ -181,15 +286,14 @@ rigidbody::NodeSegment rigidbody::Markers::markerVelocity(
     updateKin = true;
 #endif
 
-    const rigidbody::NodeSegment& node(marker(idx));
-    unsigned int id(model.GetBodyId(node.parent().c_str()));
-
-    // Retrieve the position of the marker in the local reference
-    const rigidbody::NodeSegment& pos(marker(idx, removeAxis));
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q, &Qdot);
+    }
 
     // Calculate the velocity of the point
     return rigidbody::NodeSegment(RigidBodyDynamics::CalcPointVelocity(
-            model, Q, Qdot, id, pos, updateKin));
+            model, Q, Qdot, markerBodyId(idx), markerInLocal(idx, removeAxis),
+            false));
 }
 
 // Get the makers' velocities
@@ -224,16 +328,14 @@ rigidbody::NodeSegment rigidbody::Markers::markerAcceleration(
     updateKin = true;
 #endif
 
-    const rigidbody::NodeSegment& node(marker(idx));
-    unsigned int id(model.GetBodyId(node.parent().c_str()));
-
-    // Retrieve the position of the marker in the local reference
-    const rigidbody::NodeSegment& pos(marker(idx, removeAxis));
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q, &Qdot, &Qddot);
+    }
 
     // Calculate the acceleration of the point
     return rigidbody::NodeSegment(RigidBodyDynamics::CalcPointAcceleration(
-            model, Q, Qdot, Qddot, id, pos,
-            updateKin));
+            model, Q, Qdot, Qddot, markerBodyId(idx), markerInLocal(idx, removeAxis),
+            false));
 }
 
 std::vector<rigidbody::NodeSegment>
@@ -372,6 +474,17 @@ std::vector<utils::Matrix> rigidbody::Markers::markersJacobian(
     return markersJacobian(Q, removeAxis, updateKin, false);
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Markers::markersJacobian(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::MatrixXd> jacobian,
+    bool removeAxis,
+    bool updateKin)
+{
+    markersJacobian(Q, jacobian, removeAxis, updateKin, false);
+}
+#endif
+
 std::vector<utils::Matrix>
 rigidbody::Markers::technicalMarkersJacobian(
     const rigidbody::GeneralizedCoordinates &Q,
@@ -381,6 +494,17 @@ rigidbody::Markers::technicalMarkersJacobian(
     return markersJacobian(Q, removeAxis, updateKin, true);
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Markers::technicalMarkersJacobian(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::MatrixXd> jacobian,
+    bool removeAxis,
+    bool updateKin)
+{
+    markersJacobian(Q, jacobian, removeAxis, updateKin, true);
+}
+#endif
+
 // Get the Jacobian of the technical markers
 utils::Matrix rigidbody::Markers::markersJacobian(
     const rigidbody::GeneralizedCoordinates &Q,
@@ -394,11 +518,14 @@ utils::Matrix rigidbody::Markers::markersJacobian(
 #ifdef BIORBD_USE_CASADI_MATH
     updateKin = true;
 #endif
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
     utils::Matrix G(utils::Matrix::Zero(3, model.nbQ()));;
 
     // Calculate the Jacobien of this Tag
     unsigned int id = model.GetBodyId(parentName.c_str());
-    RigidBodyDynamics::CalcPointJacobian(model, Q, id, p, G, updateKin);
+    RigidBodyDynamics::CalcPointJacobian(model, Q, id, p, G, false);
 
     return G;
 }
@@ -435,9 +562,160 @@ bool rigidbody::Markers::inverseKinematics(
     }
 
     // Call the base function
-    return RigidBodyDynamics::InverseKinematics(
-               dynamic_cast<rigidbody::Joints &>(*this),
-               Qinit, body_id, body_pointEigen, markersInRbdl, Q);
+    bool isConverged = RigidBodyDynamics::InverseKinematics(
+               model, Qinit, body_id, body_pointEigen, markersInRbdl, Q);
+
+    // The kinematics was left at the last iterate of the solver
+    model.invalidateKinematicsCache();
+    return isConverged;
+}
+
+unsigned int rigidbody::Markers::inverseKinematics(
+    const utils::Matrix &markers,
+    const rigidbody::GeneralizedCoordinates &Qinit,
+    utils::Matrix &Q,
+    Eigen::Ref<Eigen::VectorXd> residuals,
+    bool removeAxes,
+    unsigned int maxIterations,
+    double tolerance)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    rigidbody::Joints &model = dynamic_cast<rigidbody::Joints &>(*this);
+    unsigned int nbFrames(static_cast<unsigned int>(markers.cols()));
+    utils::Error::check(model.nbQuat() == 0,
+                        "The inverse kinematics of a trial does not handle quaternions");
+    utils::Error::check(markers.rows() == 3*nbTechnicalMarkers(),
+                        "markers must have 3*nbTechnicalMarkers rows");
+    utils::Error::check(Qinit.size() == model.nbQ(), "Qinit must have nbQ elements");
+    utils::Error::check(
+        Q.rows() == model.nbQ() && Q.cols() == nbFrames && residuals.size() == nbFrames,
+        "Q and residuals must respectively have nbQ rows and as many columns as markers, and nbFrames elements");
+
+    // The technical markers are resolved once for the whole trial
+    std::vector<unsigned int> bodyIds;
+    std::vector<RigidBodyDynamics::Math::Vector3d> positionsInLocal;
+    for (unsigned int i=0; i<nbMarkers(); ++i) {
+        if ((*m_marks)[i].isTechnical()) {
+            bodyIds.push_back(markerBodyId(i));
+            positionsInLocal.push_back(markerInLocal(i, removeAxes));
+        }
+    }
+
+    unsigned int nbChunks(std::min(model.nbThreads(), std::max(nbFrames, 1u)));
+    unsigned int chunkSize((nbFrames + nbChunks - 1) / nbChunks);
+    std::vector<unsigned int> nbNotConverged(nbChunks, 0);
+    model.runBatch(nbChunks, [&](rigidbody::Joints& worker, unsigned int chunk,
+    unsigned int) {
+        unsigned int nbQ(worker.nbQ());
+        rigidbody::GeneralizedCoordinates q(Qinit);
+        rigidbody::GeneralizedCoordinates qTrial(Qinit);
+        RigidBodyDynamics::Math::MatrixNd axes(6, nbQ);
+        Eigen::MatrixXd jacobian(markers.rows(), nbQ);
+        Eigen::VectorXd error(markers.rows());
+        Eigen::MatrixXd JtJ(nbQ, nbQ);
+        Eigen::MatrixXd system(nbQ, nbQ);
+        Eigen::VectorXd gradient(nbQ);
+        Eigen::VectorXd step(nbQ);
+        std::vector<unsigned int> visible;
+
+        // Squared distance between the visible markers and the model ones at Q
+        auto evaluate = [&](const rigidbody::GeneralizedCoordinates& qEval,
+        unsigned int frame) {
+            worker.UpdateKinematicsCustom(&qEval);
+            for (unsigned int i=0; i<visible.size(); ++i) {
+                unsigned int m(visible[i]);
+                error.segment<3>(3*i) = markers.block<3, 1>(3*m, frame)
+                                        - RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                                            worker, qEval, bodyIds[m], positionsInLocal[m], false);
+            }
+            return error.head(3*visible.size()).squaredNorm();
+        };
+
+        unsigned int lastFrame(std::min(nbFrames, (chunk + 1) * chunkSize));
+        for (unsigned int frame=chunk * chunkSize; frame<lastFrame; ++frame) {
+            // The occluded markers are dropped from the least squares
+            visible.clear();
+            for (unsigned int m=0; m<bodyIds.size(); ++m) {
+                if (markers.block<3, 1>(3*m, frame).allFinite()) {
+                    visible.push_back(m);
+                }
+            }
+            if (visible.empty()) {
+                Q.col(frame) = q;
+                residuals(frame) = NAN;
+                ++nbNotConverged[chunk];
+                continue;
+            }
+
+            unsigned int nbRows(static_cast<unsigned int>(3*visible.size()));
+            double cost(evaluate(q, frame));
+            double damping(1e-3);
+            bool isConverged(false);
+            bool isStalled(false);
+            for (unsigned int it=0; it<maxIterations && !isConverged && !isStalled; ++it) {
+                // Stacked jacobian of the visible markers at q (see markersJacobian)
+                worker.CalcMotionSubspaceInGlobal(q, axes, false);
+                jacobian.topRows(nbRows).setZero();
+                for (unsigned int i=0; i<visible.size(); ++i) {
+                    unsigned int bodyId(bodyIds[visible[i]]);
+                    RigidBodyDynamics::Math::Vector3d position(
+                        markers.block<3, 1>(3*visible[i], frame) - error.segment<3>(3*i));
+                    if (worker.IsFixedBodyId(bodyId)) {
+                        bodyId = worker.mFixedBodies[bodyId - worker.fixed_body_discriminator].mMovableParent;
+                    }
+                    for (unsigned int j = bodyId; j != 0; j = worker.lambda[j]) {
+                        unsigned int q_index = worker.mJoints[j].q_index;
+                        for (unsigned int k=0; k<worker.mJoints[j].mDoFCount; ++k) {
+                            jacobian.block<3, 1>(3*i, q_index + k) =
+                                axes.block<3, 1>(3, q_index + k)
+                                + axes.block<3, 1>(0, q_index + k).cross(position);
+                        }
+                    }
+                }
+                JtJ.noalias() = jacobian.topRows(nbRows).transpose() * jacobian.topRows(nbRows);
+                gradient.noalias() = jacobian.topRows(nbRows).transpose() * error.head(nbRows);
+
+                // Increase the damping until the step decreases the cost
+                for (bool isFirstTrial(true);; isFirstTrial = false) {
+                    system = JtJ;
+                    system.diagonal() += damping * (JtJ.diagonal().array() + 1e-12).matrix();
+                    step = system.ldlt().solve(gradient);
+                    qTrial = q + step;
+                    double costTrial(evaluate(qTrial, frame));
+                    if (costTrial <= cost) {
+                        q = qTrial;
+                        cost = costTrial;
+                        damping = std::max(damping * 0.1, 1e-12);
+                        isConverged = step.norm() < tolerance;
+                        break;
+                    }
+                    if (isFirstTrial && step.norm() < tolerance) {
+                        // Only the rounding errors prevent the cost from decreasing
+                        isConverged = true;
+                        break;
+                    }
+                    damping *= 10;
+                    if (damping > 1e12) {
+                        // No step decreases the cost anymore before the
+                        // tolerance is reached, the frame is a failure
+                        isStalled = true;
+                        break;
+                    }
+                }
+            }
+            if (!isConverged) {
+                ++nbNotConverged[chunk];
+            }
+            Q.col(frame) = q;
+            residuals(frame) = std::sqrt(cost / static_cast<double>(visible.size()));
+        }
+    });
+
+    unsigned int nbFailures(0);
+    for (unsigned int n : nbNotConverged) {
+        nbFailures += n;
+    }
+    return nbFailures;
 }
 #endif
 
@@ -455,29 +733,126 @@ std::vector<utils::Matrix> rigidbody::Markers::markersJacobian(
     updateKin = true;
 #endif
 
+#ifndef BIORBD_USE_CASADI_MATH
+    // Compute all the markers at once and split the result
+    unsigned int nbRows(3 * (lookForTechnical ? nbTechnicalMarkers() : nbMarkers()));
+    utils::Matrix stacked(nbRows, model.nbQdot());
+    markersJacobian(Q, stacked, removeAxis, updateKin, lookForTechnical);
+
+    std::vector<utils::Matrix> G;
+    for (unsigned int i=0; i<nbRows; i+=3) {
+        G.push_back(stacked.block(i, 0, 3, model.nbQdot()));
+    }
+    return G;
+#else
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
+
     std::vector<utils::Matrix> G;
 
     for (unsigned int idx=0; idx<nbMarkers(); ++idx) {
         // Actual marker
-        const rigidbody::NodeSegment& node(marker(idx));
-        if (lookForTechnical && !node.isTechnical()) {
+        if (lookForTechnical && !(*m_marks)[idx].isTechnical()) {
             continue;
         }
 
-        unsigned int id = model.GetBodyId(node.parent().c_str());
-        const utils::Vector3d& pos(marker(idx, removeAxis));
         utils::Matrix G_tp(utils::Matrix::Zero(3,model.nbQ()));
 
         // Calculate the Jacobian of this Tag
-        RigidBodyDynamics::CalcPointJacobian(model, Q, id, pos, G_tp, updateKin);
-#ifndef BIORBD_USE_CASADI_MATH
-        updateKin = false;
-#endif
+        RigidBodyDynamics::CalcPointJacobian(
+            model, Q, markerBodyId(idx), markerInLocal(idx, removeAxis), G_tp, false);
 
         G.push_back(G_tp);
     }
 
     return G;
+#endif
+}
+
+#ifndef BIORBD_USE_CASADI_MATH
+void rigidbody::Markers::markersJacobian(
+    const rigidbody::GeneralizedCoordinates &Q,
+    Eigen::Ref<Eigen::MatrixXd> jacobian,
+    bool removeAxis,
+    bool updateKin,
+    bool lookForTechnical)
+{
+    // Assuming that this is also a joint type (via BiorbdModel)
+    rigidbody::Joints &model = dynamic_cast<rigidbody::Joints &>(*this);
+#ifndef SKIP_ASSERT
+    utils::Error::check(static_cast<unsigned int>(jacobian.rows())
+                                == 3*(lookForTechnical ? nbTechnicalMarkers() : nbMarkers())
+                                && static_cast<unsigned int>(jacobian.cols()) == model.nbQdot(),
+                                "Wrong size for the markers jacobian");
+#endif
+    if (updateKin) {
+        model.UpdateKinematicsCustom(&Q);
+    }
+
+    // The spatial axes of all the DoF are computed once and shared by all the markers
+    if (m_motionSubspaceInGlobal->cols() != jacobian.cols()) {
+        m_motionSubspaceInGlobal->resize(6, jacobian.cols());
+    }
+    model.CalcMotionSubspaceInGlobal(Q, *m_motionSubspaceInGlobal, false);
+    const RigidBodyDynamics::Math::MatrixNd& axes(*m_motionSubspaceInGlobal);
+
+    jacobian.setZero();
+    unsigned int row(0);
+    for (unsigned int idx=0; idx<nbMarkers(); ++idx) {
+        if (lookForTechnical && !(*m_marks)[idx].isTechnical()) {
+            continue;
+        }
+
+        unsigned int bodyId(markerBodyId(idx));
+        const RigidBodyDynamics::Math::Vector3d& position(
+            RigidBodyDynamics::CalcBodyToBaseCoordinates(
+                model, Q, bodyId, markerInLocal(idx, removeAxis), false));
+        if (model.IsFixedBodyId(bodyId)) {
+            bodyId = model.mFixedBodies[bodyId - model.fixed_body_discriminator].mMovableParent;
+        }
+
+        // Each DoF the marker depends on moves it by v + w x position
+        for (unsigned int j = bodyId; j != 0; j = model.lambda[j]) {
+            unsigned int q_index = model.mJoints[j].q_index;
+            for (unsigned int k=0; k<model.mJoints[j].mDoFCount; ++k) {
+                jacobian.block<3, 1>(row, q_index + k) =
+                    axes.block<3, 1>(3, q_index + k)
+                    + axes.block<3, 1>(0, q_index + k).cross(position);
+            }
+        }
+        row += 3;
+    }
+}
+#endif
+
+unsigned int rigidbody::Markers::markerBodyId(
+    unsigned int idx) const
+{
+    unsigned int id((*m_marksBodyId)[idx]);
+    if (id == std::numeric_limits<unsigned int>::max()) {
+        // The marker was added while not being part of a model, it is looked
+        // up without being stored as the ids are shared between the copies
+        id = dynamic_cast<const rigidbody::Joints &>(*this).GetBodyId(
+                 (*m_marks)[idx].parent().c_str());
+    }
+    return id;
+}
+
+RigidBodyDynamics::Math::Vector3d rigidbody::Markers::markerInLocal(
+    unsigned int idx,
+    bool removeAxis) const
+{
+    RigidBodyDynamics::Math::Vector3d pos((*m_marksPositionInLocal)[idx]);
+    if (removeAxis) {
+        const rigidbody::NodeSegment& node((*m_marks)[idx]);
+        for (unsigned int i=0; i<3; ++i) {
+            if (node.isAxisRemoved(i)) {
+                pos(i) = 0;
+            }
+        }
+    }
+    return pos;
 }
 
 unsigned int rigidbody::Markers::nbTechnicalMarkers()
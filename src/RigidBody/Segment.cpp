@@ -211,11 +211,8 @@ void rigidbody::Segment::setType()
 
 unsigned int rigidbody::Segment::id() const
 {
-    if (*m_nbDof!=0) {
-        return (*m_idxDof)[*m_nbDof-1];
-    } else {
-        return (*m_idxDof)[*m_nbDof];
-    }
+    // The segment is the last body of its chain
+    return m_idxDof->back();
 }
 
 int rigidbody::Segment::platformIdx() const
@@ -476,17 +473,12 @@ void rigidbody::Segment::setDofCharacteristicsOnLastBody()
 {
     m_dofCharacteristics->clear();
 
-    if (*m_nbDof!=0) {
-        m_dofCharacteristics->resize(*m_nbDof);
-        for (unsigned int i=0; i<*m_nbDof-1; i++) {
-            (*m_dofCharacteristics)[i] = rigidbody::SegmentCharacteristics();
-        }
-
-        (*m_dofCharacteristics)[*m_nbDof-1] = *m_characteristics;
-    } else {
-        m_dofCharacteristics->resize(1);
-        (*m_dofCharacteristics)[0] = *m_characteristics;
+    // There is one body per joint (a fixed one if the segment has no DoF)
+    m_dofCharacteristics->resize(m_dof->size());
+    for (unsigned int i=0; i<m_dof->size()-1; i++) {
+        (*m_dofCharacteristics)[i] = rigidbody::SegmentCharacteristics();
     }
+    (*m_dofCharacteristics)[m_dof->size()-1] = *m_characteristics;
 }
 
 void rigidbody::Segment::setJointAxis()
@@ -522,11 +514,47 @@ void rigidbody::Segment::setJointAxis()
     }
 }
 
+void rigidbody::Segment::collapseJointAxis()
+{
+    std::vector<RigidBodyDynamics::Joint> dof;
+
+    // Translations, the order of the DoF must match the one of the RBDL joint
+    if (!m_seqT->tolower().compare("xyz")) {
+        dof.push_back(RigidBodyDynamics::Joint(
+                          RigidBodyDynamics::JointTypeTranslationXYZ));
+    } else {
+        for (unsigned int i=0; i<*m_nbDofTrans; ++i) {
+            dof.push_back((*m_dof)[i]);
+        }
+    }
+
+    // Rotations, RBDL Euler joints are the same as a chain of revolute joints
+    utils::String seqR(m_seqR->tolower());
+    if (!seqR.compare("xyz")) {
+        dof.push_back(RigidBodyDynamics::Joint(
+                          RigidBodyDynamics::JointTypeEulerXYZ));
+    } else if (!seqR.compare("zyx")) {
+        dof.push_back(RigidBodyDynamics::Joint(
+                          RigidBodyDynamics::JointTypeEulerZYX));
+    } else if (!seqR.compare("yxz")) {
+        dof.push_back(RigidBodyDynamics::Joint(
+                          RigidBodyDynamics::JointTypeEulerYXZ));
+    } else {
+        for (unsigned int i=*m_nbDofTrans; i<m_dof->size(); ++i) {
+            dof.push_back((*m_dof)[i]);
+        }
+    }
+    *m_dof = dof;
+}
+
 void rigidbody::Segment::setJoints(
     rigidbody::Joints& model)
 {
-    setDofCharacteristicsOnLastBody(); // Apply the segment caracteristics only to the last segment
     setJointAxis(); // Choose the axis order in relation to the selected sequence
+    if (model.isCollapsingDofs()) {
+        collapseJointAxis(); // Gather the DoF into multi-DoF joints when possible
+    }
+    setDofCharacteristicsOnLastBody(); // Apply the segment caracteristics only to the last segment
 
 
     RigidBodyDynamics::Math::SpatialTransform zero (
@@ -534,23 +562,14 @@ void rigidbody::Segment::setJoints(
         RigidBodyDynamics::Math::Vector3d(0,0,0));
     // Create the articulations (intra segment)
     m_idxDof->clear();
-
-    if (*m_nbDof==0) {
-        m_idxDof->resize(1);
-    } else {
-        m_idxDof->resize(*m_nbDof);
-    }
+    m_idxDof->resize(m_dof->size());
 
     unsigned int parent_id(model.GetBodyId(parent().c_str()));
 
     if (parent_id == std::numeric_limits<unsigned int>::max()) {
         parent_id = 0;
     }
-    if (*m_nbDof==0)
-        (*m_idxDof)[0] = model.AddBody(
-                             parent_id, *m_cor, (*m_dof)[0],
-                             (*m_dofCharacteristics)[0], name());
-    else if (*m_nbDof == 1)
+    if (m_dof->size() == 1)
         (*m_idxDof)[0] = model.AddBody(
                              parent_id, *m_cor, (*m_dof)[0],
                              (*m_dofCharacteristics)[0], name());
@@ -558,8 +577,8 @@ void rigidbody::Segment::setJoints(
         (*m_idxDof)[0] = model.AddBody(
                              parent_id, *m_cor, (*m_dof)[0],
                              (*m_dofCharacteristics)[0]);
-        for (unsigned int i=1; i<*m_nbDof; i++)
-            if (i!=*m_nbDof-1)
+        for (unsigned int i=1; i<m_dof->size(); i++)
+            if (i!=m_dof->size()-1)
                 (*m_idxDof)[i] = model.AddBody(
                                      (*m_idxDof)[i-1], zero,
                                      (*m_dof)[i], (*m_dofCharacteristics)[i]);
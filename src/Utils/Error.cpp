@@ -19,6 +19,15 @@ void utils::Error::check(
 
 }
 
+void utils::Error::check(
+    bool cond,
+    const char *message)
+{
+    if (!cond) {
+        throw std::runtime_error(message);
+    }
+}
+
 void utils::Error::warning(
     bool cond,
     const utils::String& message)
@@ -0,0 +1,187 @@
+#define BIORBD_API_EXPORTS
+#include "Utils/ThreadPool.h"
+
+using namespace BIORBD_NAMESPACE;
+
+namespace
+{
+// If the current thread is computing a task of any pool
+thread_local bool isInTask(false);
+
+// Flag the current thread as computing a task for the lifetime of the guard
+class TaskGuard
+{
+public:
+    TaskGuard() :
+        m_previous(isInTask)
+    {
+        isInTask = true;
+    }
+    ~TaskGuard()
+    {
+        isInTask = m_previous;
+    }
+private:
+    bool m_previous;
+};
+}
+
+utils::ThreadPool::ThreadPool(
+    unsigned int nbThreads) :
+    m_nbThreads(1),
+    m_workers(),
+    m_generation(0),
+    m_nbPending(0),
+    m_stop(false),
+    m_task(nullptr),
+    m_nbTasks(0),
+    m_error()
+{
+    setNbThreads(nbThreads);
+}
+
+utils::ThreadPool::~ThreadPool()
+{
+    stopWorkers();
+}
+
+void utils::ThreadPool::setNbThreads(
+    unsigned int nbThreads)
+{
+    std::lock_guard<std::mutex> runLock(m_runMutex);
+    stopWorkers();
+    if (nbThreads == 0) {
+        nbThreads = std::thread::hardware_concurrency();
+    }
+    m_nbThreads = nbThreads == 0 ? 1 : nbThreads;
+}
+
+unsigned int utils::ThreadPool::nbThreads() const
+{
+    return m_nbThreads;
+}
+
+void utils::ThreadPool::run(
+    unsigned int nbTasks,
+    const std::function<void(unsigned int, unsigned int)>& task)
+{
+    if (isInTask) {
+        // A run from a task (of this pool or another one) would wait for
+        // busy workers, so it is computed serially by the calling thread
+        for (unsigned int i = 0; i < nbTasks; ++i) {
+            task(i, 0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(m_runMutex);
+    if (m_nbThreads == 1) {
+        TaskGuard guard;
+        for (unsigned int i = 0; i < nbTasks; ++i) {
+            task(i, 0);
+        }
+        return;
+    }
+    if (m_workers.size() != m_nbThreads - 1) {
+        startWorkers();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_nbTasks = nbTasks;
+        m_error = nullptr;
+        m_nbPending = static_cast<unsigned int>(m_workers.size());
+        ++m_generation;
+    }
+    m_wakeUp.notify_all();
+
+    // The calling thread is the first worker
+    runChunk(0);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] {
+            return m_nbPending == 0;
+        });
+        m_task = nullptr;
+        error = m_error;
+        m_error = nullptr;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void utils::ThreadPool::startWorkers()
+{
+    stopWorkers();
+    m_stop = false;
+    for (unsigned int i = 1; i < m_nbThreads; ++i) {
+        m_workers.push_back(std::thread(&utils::ThreadPool::workerLoop, this, i,
+                                        m_generation));
+    }
+}
+
+void utils::ThreadPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void utils::ThreadPool::workerLoop(
+    unsigned int worker,
+    unsigned long generation)
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this, generation] {
+                return m_stop || m_generation != generation;
+            });
+            if (m_stop) {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        runChunk(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_nbPending;
+            if (m_nbPending == 0) {
+                m_done.notify_one();
+            }
+        }
+    }
+}
+
+void utils::ThreadPool::runChunk(
+    unsigned int worker)
+{
+    // Contiguous chunks so the task/worker association only depends on the number of threads
+    unsigned int first(static_cast<unsigned int>(
+                           static_cast<unsigned long long>(m_nbTasks) * worker / m_nbThreads));
+    unsigned int last(static_cast<unsigned int>(
+                          static_cast<unsigned long long>(m_nbTasks) * (worker + 1) / m_nbThreads));
+    TaskGuard guard;
+    try {
+        for (unsigned int i = first; i < last; ++i) {
+            (*m_task)(i, worker);
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error) {
+            m_error = std::current_exception();
+        }
+    }
+}
@@ -0,0 +1,16 @@
+#include "BiorbdModel.h"
+#include "ModelCodeGenerator.h"
+#include "Utils/Path.h"
+
+using namespace BIORBD_NAMESPACE;
+
+// Write the code of a model at build time so the unit tests can compare it to biorbd
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        return 1;
+    }
+    Model model(argv[1]);
+    CodeGenerator::generateModel(model, utils::Path(argv[2]));
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <cstdlib>
+#include <new>
+#include <gtest/gtest.h>
+
+#include "BiorbdModel.h"
+#include "biorbdConfig.h"
+#include "Utils/Matrix.h"
+#include "Utils/RotoTrans.h"
+#include "Utils/Vector3d.h"
+#include "RigidBody/GeneralizedCoordinates.h"
+#include "RigidBody/NodeSegment.h"
+
+using namespace BIORBD_NAMESPACE;
+
+static double requiredPrecision(1e-10);
+#ifdef MODULE_ACTUATORS
+    static std::string
+    modelPathForGeneralTesting("models/pyomecaman_withActuators.bioMod");
+#else // MODULE_ACTUATORS
+    static std::string modelPathForGeneralTesting("models/pyomecaman.bioMod");
+#endif // MODULE_ACTUATORS
+
+#if !defined(BIORBD_USE_CASADI_MATH) && !defined(_WIN32)
+// Count the heap allocations made while the counter is active. The global
+// allocation functions are replaced in this executable only, so the other
+// tests are not affected.
+static bool isCountingAllocations(false);
+static size_t nbAllocations(0);
+void* operator new(size_t size)
+{
+    if (isCountingAllocations) {
+        ++nbAllocations;
+    }
+    void* ptr(std::malloc(size == 0 ? 1 : size));
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+TEST(Markers, allocationFree)
+{
+    Model model(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    std::vector<double> val(model.nbQ());
+    for (size_t i=0; i<val.size(); ++i) {
+        val[i] = static_cast<double>(i) * 0.1;
+    }
+    FILL_VECTOR(Q, val);
+
+    Eigen::Matrix3Xd markers(3, model.nbMarkers());
+    Eigen::MatrixXd jacobian(3*model.nbMarkers(), model.nbQdot());
+    std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>> jcs;
+    Eigen::Vector3d com;
+
+    // Warm up so the outputs and the caches have their final size
+    model.markers(Q, markers);
+    model.markersJacobian(Q, jacobian);
+    model.allGlobalJCS(Q, jcs);
+    model.CoM(Q, com);
+
+    // Steady state
+    Q[0] += 0.1;
+    nbAllocations = 0;
+    isCountingAllocations = true;
+    model.markers(Q, markers);
+    model.markersJacobian(Q, jacobian);
+    model.allGlobalJCS(Q, jcs);
+    model.CoM(Q, com);
+    isCountingAllocations = false;
+    EXPECT_EQ(nbAllocations, 0u);
+
+    // Same values as the allocating versions
+    std::vector<rigidbody::NodeSegment> markersExpected(model.markers(Q));
+    std::vector<utils::Matrix> jacobianExpected(model.markersJacobian(Q));
+    std::vector<utils::RotoTrans> jcsExpected(model.allGlobalJCS(Q));
+    utils::Vector3d comExpected(model.CoM(Q));
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            EXPECT_NEAR(markers(j, i), markersExpected[i](j), requiredPrecision);
+            for (unsigned int k=0; k<model.nbQdot(); ++k) {
+                EXPECT_NEAR(jacobian(3*i+j, k), jacobianExpected[i](j, k),
+                            requiredPrecision);
+            }
+        }
+    }
+    EXPECT_EQ(jcs.size(), jcsExpected.size());
+    for (unsigned int i=0; i<jcs.size(); ++i) {
+        for (unsigned int j=0; j<4; ++j) {
+            for (unsigned int k=0; k<4; ++k) {
+                EXPECT_NEAR(jcs[i](j, k), jcsExpected[i](j, k), requiredPrecision);
+            }
+        }
+    }
+    for (unsigned int j=0; j<3; ++j) {
+        EXPECT_NEAR(com(j), comExpected(j), requiredPrecision);
+    }
+
+#ifndef SKIP_ASSERT
+    Eigen::Matrix3Xd markersWrongSize(3, 1);
+    Eigen::MatrixXd jacobianWrongSize(3, model.nbQdot());
+    EXPECT_THROW(model.markers(Q, markersWrongSize), std::runtime_error);
+    EXPECT_THROW(model.markersJacobian(Q, jacobianWrongSize), std::runtime_error);
+#endif
+}
+#endif
@@ -1,10 +1,13 @@
 #include <iostream>
+#include <thread>
 #include <gtest/gtest.h>
 #include <rbdl/Dynamics.h>
 
 #include "BiorbdModel.h"
 #include "RigidBody/Joints.h"
 #include "ModelWriter.h"
+#include "ModelWorkspace.h"
+#include "ForwardSimulation.h"
 #include "biorbdConfig.h"
 #include "Utils/String.h"
 #include "Utils/RotoTrans.h"
@@ -15,6 +18,12 @@
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedVelocity.h"
 #include "RigidBody/GeneralizedTorque.h"
+#include "Utils/Quaternion.h"
+#ifdef MODULE_MUSCLES
+    #include "Muscles/MuscleGroup.h"
+    #include "Muscles/Muscle.h"
+    #include "Muscles/State.h"
+#endif
 
 using namespace BIORBD_NAMESPACE;
 
@@ -94,6 +103,307 @@ TEST(GenericTests, mass)
     EXPECT_NEAR(mass, 52.41212, requiredPrecision);
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(ModelWorkspace, sharedDescription)
+{
+    Model model(modelPathForGeneralTesting);
+    ModelWorkspace workspace(model);
+    ModelWorkspace otherWorkspace(workspace);
+
+    // The description of the model is shared
+    EXPECT_EQ(workspace.nbQ(), model.nbQ());
+    EXPECT_EQ(workspace.nbMarkers(), model.nbMarkers());
+    EXPECT_EQ(&workspace.segment(0), &model.segment(0));
+    EXPECT_EQ(&otherWorkspace.segment(0), &model.segment(0));
+    EXPECT_EQ(&workspace.marker(0), &model.marker(0));
+
+    // The kinematics is not
+    rigidbody::GeneralizedCoordinates Q(model);
+    rigidbody::GeneralizedCoordinates Qws(model);
+    Q.setZero();
+    Qws.setOnes();
+    std::vector<rigidbody::NodeSegment> markers(model.markers(Q));
+    std::vector<rigidbody::NodeSegment> markersWs(workspace.markers(Qws));
+    std::vector<rigidbody::NodeSegment> markersNoUpdate(
+        model.markers(Q, true, false));
+    std::vector<rigidbody::NodeSegment> markersWsNoUpdate(
+        workspace.markers(Qws, true, false));
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            EXPECT_NEAR(markersNoUpdate[i][j], markers[i][j], requiredPrecision);
+            EXPECT_NEAR(markersWsNoUpdate[i][j], markersWs[i][j], requiredPrecision);
+        }
+    }
+}
+
+#ifdef MODULE_MUSCLES
+TEST(ModelWorkspace, ownMuscles)
+{
+    Model model("models/arm26.bioMod");
+    ModelWorkspace workspace(model);
+
+    EXPECT_EQ(workspace.nbMuscles(), model.nbMuscles());
+    EXPECT_NE(&workspace.muscleGroup(0).muscle(0),
+              &model.muscleGroup(0).muscle(0));
+    EXPECT_STREQ(workspace.muscleGroup(0).muscle(0).name().c_str(),
+                 model.muscleGroup(0).muscle(0).name().c_str());
+
+    rigidbody::GeneralizedCoordinates Q(model);
+    rigidbody::GeneralizedCoordinates Qws(model);
+    Q.setZero();
+    Qws.setOnes();
+    model.updateMuscles(Q, true);
+    workspace.updateMuscles(Qws, true);
+    EXPECT_NE(workspace.muscleGroup(0).muscle(0).length(workspace, Qws, 0),
+              model.muscleGroup(0).muscle(0).length(model, Q, 0));
+}
+
+TEST(ModelWorkspace, concurrentFirstLookup)
+{
+    Model model("models/arm26.bioMod");
+    rigidbody::GeneralizedCoordinates Q(model);
+    Q.setOnes();
+    model.updateMuscles(Q, true);
+    std::vector<double> lengthsExpected;
+    for (unsigned int i=0; i<model.nbMuscleGroups(); ++i) {
+        for (unsigned int j=0; j<model.muscleGroup(i).nbMuscles(); ++j) {
+            lengthsExpected.push_back(model.muscleGroup(i).muscle(j).length(model, Q, 0));
+        }
+    }
+    std::vector<rigidbody::NodeSegment> markersExpected(model.markers(Q));
+
+    // The body ids are resolved before the workspaces do their first lookup
+    ModelWorkspace workspace0(model);
+    ModelWorkspace workspace1(model);
+    ModelWorkspace* workspaces[2] = {&workspace0, &workspace1};
+    std::vector<double> lengths[2];
+    std::vector<rigidbody::NodeSegment> markers[2];
+    std::vector<std::thread> threads;
+    for (unsigned int t=0; t<2; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            ModelWorkspace& workspace(*workspaces[t]);
+            workspace.updateMuscles(Q, true);
+            for (unsigned int i=0; i<workspace.nbMuscleGroups(); ++i) {
+                for (unsigned int j=0; j<workspace.muscleGroup(i).nbMuscles(); ++j) {
+                    lengths[t].push_back(
+                        workspace.muscleGroup(i).muscle(j).length(workspace, Q, 0));
+                }
+            }
+            markers[t] = workspace.markers(Q);
+        }));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (unsigned int t=0; t<2; ++t) {
+        ASSERT_EQ(lengths[t].size(), lengthsExpected.size());
+        for (unsigned int i=0; i<lengthsExpected.size(); ++i) {
+            EXPECT_NEAR(lengths[t][i], lengthsExpected[i], requiredPrecision);
+        }
+        ASSERT_EQ(markers[t].size(), markersExpected.size());
+        for (unsigned int i=0; i<markersExpected.size(); ++i) {
+            for (unsigned int j=0; j<3; ++j) {
+                EXPECT_NEAR(markers[t][i][j], markersExpected[i][j], requiredPrecision);
+            }
+        }
+    }
+}
+#endif
+
+TEST(ForwardSimulation, freeFall)
+{
+    // Without any torque, the center of mass follows a parabola
+    Model model(modelFreeFall);
+    DECLARE_GENERALIZED_COORDINATES(Q0, model);
+    DECLARE_GENERALIZED_VELOCITY(Qdot0, model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Q0(i) = static_cast<double>(i) * 0.1 - 0.3;
+        Qdot0(i) = static_cast<double>(i) * 0.2 - 1.0;
+    }
+    unsigned int nbIntervals(20);
+    double dt(0.01);
+    double duration(nbIntervals * dt);
+    utils::Matrix Tau(model.nbGeneralizedTorque(), nbIntervals);
+    Tau.setZero();
+    utils::Vector3d comExpected(model.CoM(Q0) + model.CoMdot(Q0, Qdot0) * duration
+                                + model.getGravity() * (duration * duration / 2));
+
+    for (rigidbody::INTEGRATOR_TYPE type : {
+                rigidbody::RUNGE_KUTTA_4, rigidbody::RUNGE_KUTTA_45
+            }) {
+        ForwardSimulation simulation(model, type);
+        simulation.setNbSubSteps(4);
+        simulation.setTolerances(1e-12, 1e-12);
+        utils::Matrix Q(model.nbQ(), nbIntervals + 1);
+        utils::Matrix Qdot(model.nbQdot(), nbIntervals + 1);
+        simulation.integrate(Q0, Qdot0, Tau, dt, Q, Qdot);
+
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            EXPECT_NEAR(Q(i, 0), Q0(i), requiredPrecision);
+            EXPECT_NEAR(Qdot(i, 0), Qdot0(i), requiredPrecision);
+        }
+        rigidbody::GeneralizedCoordinates QFinal(Q.col(nbIntervals));
+        utils::Vector3d com(model.CoM(QFinal));
+        for (unsigned int i=0; i<3; ++i) {
+            EXPECT_NEAR(com(i), comExpected(i), 1e-6);
+        }
+    }
+
+    // The semi-implicit Euler converges to the same trajectory
+    ForwardSimulation simulation(model, rigidbody::SEMI_IMPLICIT_EULER);
+    EXPECT_STREQ(rigidbody::INTEGRATOR_TYPE_toStr(simulation.integrator()),
+                 "SemiImplicitEuler");
+    simulation.setNbSubSteps(1000);
+    utils::Matrix Q(model.nbQ(), nbIntervals + 1);
+    utils::Matrix Qdot(model.nbQdot(), nbIntervals + 1);
+    simulation.integrate(Q0, Qdot0, Tau, dt, Q, Qdot);
+    rigidbody::GeneralizedCoordinates QFinal(Q.col(nbIntervals));
+    utils::Vector3d com(model.CoM(QFinal));
+    for (unsigned int i=0; i<3; ++i) {
+        EXPECT_NEAR(com(i), comExpected(i), 1e-3);
+    }
+
+    utils::Matrix wrongQ(model.nbQ(), nbIntervals);
+    EXPECT_THROW(simulation.integrate(Q0, Qdot0, Tau, dt, wrongQ, Qdot),
+                 std::runtime_error);
+    EXPECT_THROW(simulation.setNbSubSteps(0), std::runtime_error);
+}
+
+TEST(ForwardSimulation, quaternion)
+{
+    Model model("models/simple_quat.bioMod");
+    DECLARE_GENERALIZED_COORDINATES(Q0, model);
+    DECLARE_GENERALIZED_VELOCITY(Qdot0, model);
+    utils::Quaternion quat0(utils::Quaternion::fromXYZAngles(
+                                utils::Vector3d(0.3, -0.2, 0.5)));
+    Q0 << quat0[1], quat0[2], quat0[3], quat0[0];
+    Qdot0 << 1.0, -2.0, 3.0;
+    unsigned int nbIntervals(10);
+    double dt(0.1);
+    utils::Matrix Tau(model.nbGeneralizedTorque(), nbIntervals);
+    Tau.setZero();
+
+    ForwardSimulation reference(model, rigidbody::RUNGE_KUTTA_45);
+    reference.setTolerances(1e-13, 1e-13);
+    utils::Matrix QRef(model.nbQ(), nbIntervals + 1);
+    utils::Matrix QdotRef(model.nbQdot(), nbIntervals + 1);
+    reference.integrate(Q0, Qdot0, Tau, dt, QRef, QdotRef);
+
+    // The quaternions stay unitary and the Runge-Kutta 4 keeps its order on the rotations
+    ForwardSimulation simulation(model, rigidbody::RUNGE_KUTTA_4);
+    std::vector<double> errors;
+    for (unsigned int nbSubSteps : {10, 20}) {
+        simulation.setNbSubSteps(nbSubSteps);
+        utils::Matrix Q(model.nbQ(), nbIntervals + 1);
+        utils::Matrix Qdot(model.nbQdot(), nbIntervals + 1);
+        simulation.integrate(Q0, Qdot0, Tau, dt, Q, Qdot);
+        for (unsigned int i=0; i<nbIntervals + 1; ++i) {
+            EXPECT_NEAR(Q.col(i).norm(), 1, requiredPrecision);
+            EXPECT_NEAR(QRef.col(i).norm(), 1, requiredPrecision);
+        }
+        errors.push_back((Q.col(nbIntervals) - QRef.col(nbIntervals)).norm());
+    }
+    EXPECT_LT(errors[0], 1e-4);
+    EXPECT_GT(errors[0] / errors[1], 12);
+}
+
+TEST(ForwardSimulation, ensemble)
+{
+    Model model(modelPathForGeneralTesting);
+    unsigned int nbRuns(5);
+    unsigned int nbIntervals(4);
+    double dt(0.02);
+    utils::Matrix Q0(model.nbQ(), nbRuns);
+    utils::Matrix Qdot0(model.nbQdot(), nbRuns);
+    utils::Matrix Tau(model.nbGeneralizedTorque(), nbIntervals * nbRuns);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        for (unsigned int j=0; j<nbRuns; ++j) {
+            Q0(i, j) = static_cast<double>(i + j) * 0.05 - 0.2;
+            Qdot0(i, j) = static_cast<double>(i) * 0.1 - static_cast<double>(j) * 0.2;
+        }
+        for (unsigned int j=0; j<nbIntervals * nbRuns; ++j) {
+            Tau(i, j) = static_cast<double>(i * j % 7) - 3.0;
+        }
+    }
+
+    ForwardSimulation simulation(model, rigidbody::RUNGE_KUTTA_45);
+    utils::Matrix Q(model.nbQ(), (nbIntervals + 1) * nbRuns);
+    utils::Matrix Qdot(model.nbQdot(), (nbIntervals + 1) * nbRuns);
+    for (unsigned int nbThreads : {1, 3}) {
+        simulation.setNbThreads(nbThreads);
+        EXPECT_EQ(simulation.nbThreads(), nbThreads);
+        simulation.integrateEnsemble(Q0, Qdot0, Tau, dt, Q, Qdot);
+
+        // Each run is the same as if it was integrated alone
+        for (unsigned int j=0; j<nbRuns; ++j) {
+            rigidbody::GeneralizedCoordinates Q0Run(Q0.col(j));
+            rigidbody::GeneralizedVelocity Qdot0Run(Qdot0.col(j));
+            utils::Matrix TauRun(Tau.middleCols(j * nbIntervals, nbIntervals));
+            utils::Matrix QRun(model.nbQ(), nbIntervals + 1);
+            utils::Matrix QdotRun(model.nbQdot(), nbIntervals + 1);
+            simulation.integrate(Q0Run, Qdot0Run, TauRun, dt, QRun, QdotRun);
+            for (unsigned int k=0; k<nbIntervals + 1; ++k) {
+                for (unsigned int i=0; i<model.nbQ(); ++i) {
+                    EXPECT_NEAR(Q(i, j * (nbIntervals + 1) + k), QRun(i, k), requiredPrecision);
+                    EXPECT_NEAR(Qdot(i, j * (nbIntervals + 1) + k), QdotRun(i, k),
+                                requiredPrecision);
+                }
+            }
+        }
+    }
+
+    utils::Matrix TauWrongSize(model.nbGeneralizedTorque(), nbIntervals * nbRuns + 1);
+    EXPECT_THROW(simulation.integrateEnsemble(Q0, Qdot0, TauWrongSize, dt, Q, Qdot),
+                 std::runtime_error);
+}
+
+#ifdef MODULE_MUSCLES
+TEST(ForwardSimulation, activationDynamics)
+{
+    Model model("models/arm26.bioMod");
+    DECLARE_GENERALIZED_COORDINATES(Q0, model);
+    DECLARE_GENERALIZED_VELOCITY(Qdot0, model);
+    Q0.setZero();
+    Qdot0.setZero();
+    unsigned int nbIntervals(10);
+    double dt(0.01);
+    utils::Vector activations0(model.nbMuscles());
+    activations0.setConstant(0.1);
+    utils::Matrix excitations(model.nbMuscles(), nbIntervals);
+    excitations.setConstant(1);
+    utils::Matrix Tau(model.nbGeneralizedTorque(), nbIntervals);
+    Tau.setZero();
+
+    SCALAR_TO_DOUBLE(activationBefore, model.stateSet()[0]->activation());
+    ForwardSimulation simulation(model);
+    utils::Matrix Q(model.nbQ(), nbIntervals + 1);
+    utils::Matrix Qdot(model.nbQdot(), nbIntervals + 1);
+    utils::Matrix activations(model.nbMuscles(), nbIntervals + 1);
+    simulation.integrate(Q0, Qdot0, activations0, excitations, Tau, dt, Q, Qdot,
+                         activations);
+
+    // The muscles are activated and move the arm
+    for (unsigned int i=0; i<model.nbMuscles(); ++i) {
+        EXPECT_NEAR(activations(i, 0), 0.1, requiredPrecision);
+        for (unsigned int j=0; j<nbIntervals; ++j) {
+            EXPECT_GT(activations(i, j + 1), activations(i, j));
+            EXPECT_LE(activations(i, j + 1), 1);
+        }
+    }
+    EXPECT_GT((Q.col(nbIntervals) - Q.col(0)).norm(), 0);
+
+    // The model itself is left untouched
+    SCALAR_TO_DOUBLE(activationAfter, model.stateSet()[0]->activation());
+    EXPECT_NEAR(activationAfter, activationBefore, requiredPrecision);
+
+    utils::Matrix wrongExcitations(model.nbMuscles() + 1, nbIntervals);
+    EXPECT_THROW(simulation.integrate(Q0, Qdot0, activations0, wrongExcitations, Tau,
+                                      dt, Q, Qdot, activations), std::runtime_error);
+}
+#endif
+#endif
+
 TEST(MeshFile, FileIO)
 {
     EXPECT_NO_THROW(Model model(modelPathWithMeshFile));
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <gtest/gtest.h>
+
+#include "BiorbdModel.h"
+#include "ModelCodeGenerator.h"
+#include "Utils/Error.h"
+#include "Utils/Path.h"
+#include "Utils/Matrix.h"
+#include "Utils/RotoTrans.h"
+#include "RigidBody/GeneralizedCoordinates.h"
+#include "RigidBody/GeneralizedVelocity.h"
+#include "RigidBody/GeneralizedAcceleration.h"
+#include "RigidBody/GeneralizedTorque.h"
+#include "RigidBody/NodeSegment.h"
+#include "pyomecamanGenerated.h"
+#ifdef MODULE_MUSCLES
+#include "Muscles/Muscle.h"
+#include "arm26Generated.h"
+#endif
+
+using namespace BIORBD_NAMESPACE;
+
+static double requiredPrecision(1e-10);
+
+static std::string modelPathForGeneralTesting("models/pyomecaman.bioMod");
+#ifdef MODULE_MUSCLES
+static std::string modelPathForMuscleTesting("models/arm26.bioMod");
+#endif
+
+TEST(CodeGeneration, rigidbody)
+{
+    Model model(modelPathForGeneralTesting);
+    ASSERT_EQ(pyomecamanGenerated::nbQ, model.nbQ());
+    ASSERT_EQ(pyomecamanGenerated::nbSegments, model.nbSegment());
+    ASSERT_EQ(pyomecamanGenerated::nbMarkers, model.nbMarkers());
+
+    pyomecamanGenerated::VectorQ q, qdot, qddot, tau, result;
+    rigidbody::GeneralizedCoordinates Q(model);
+    rigidbody::GeneralizedVelocity Qdot(model);
+    rigidbody::GeneralizedAcceleration Qddot(model);
+    rigidbody::GeneralizedTorque Tau(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        q(i) = Q(i) = 0.1 * static_cast<double>(i) - 0.3;
+        qdot(i) = Qdot(i) = -0.2 * static_cast<double>(i) + 0.5;
+        qddot(i) = Qddot(i) = 0.3 * static_cast<double>(i);
+        tau(i) = Tau(i) = 1.1 * static_cast<double>(i) - 2.0;
+    }
+
+    {
+        Eigen::Matrix<double, 4, 4*pyomecamanGenerated::nbSegments> jcs;
+        pyomecamanGenerated::globalJCS(q, jcs);
+        std::vector<utils::RotoTrans> jcsExpected(model.allGlobalJCS(Q));
+        for (unsigned int s=0; s<model.nbSegment(); ++s) {
+            for (unsigned int i=0; i<4; ++i) {
+                for (unsigned int j=0; j<4; ++j) {
+                    EXPECT_NEAR(jcs(i, 4*s + j), jcsExpected[s](i, j), requiredPrecision);
+                }
+            }
+        }
+    }
+
+    {
+        Eigen::Matrix<double, 3, pyomecamanGenerated::nbMarkers> markers;
+        pyomecamanGenerated::markers(q, markers);
+        std::vector<rigidbody::NodeSegment> markersExpected(model.markers(Q, false));
+        Eigen::Matrix<double, 3*pyomecamanGenerated::nbMarkers, pyomecamanGenerated::nbQ>
+        jacobian;
+        pyomecamanGenerated::markersJacobian(q, jacobian);
+        std::vector<utils::Matrix> jacobianExpected(model.markersJacobian(Q, false));
+        for (unsigned int m=0; m<model.nbMarkers(); ++m) {
+            for (unsigned int i=0; i<3; ++i) {
+                EXPECT_NEAR(markers(i, m), markersExpected[m](i), requiredPrecision);
+                for (unsigned int j=0; j<model.nbQ(); ++j) {
+                    EXPECT_NEAR(jacobian(3*m + i, j), jacobianExpected[m](i, j),
+                                requiredPrecision);
+                }
+            }
+        }
+    }
+
+    {
+        pyomecamanGenerated::inverseDynamics(q, qdot, qddot, result);
+        rigidbody::GeneralizedTorque TauExpected(model.InverseDynamics(Q, Qdot, Qddot));
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            EXPECT_NEAR(result(i), TauExpected(i), 1e-8);
+        }
+    }
+
+    {
+        pyomecamanGenerated::forwardDynamics(q, qdot, tau, result);
+        rigidbody::GeneralizedAcceleration QddotExpected(model.ForwardDynamics(Q, Qdot,
+                Tau));
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            EXPECT_NEAR(result(i), QddotExpected(i), 1e-8);
+        }
+    }
+}
+
+TEST(CodeGeneration, errors)
+{
+    Model model(modelPathForGeneralTesting);
+    EXPECT_THROW(CodeGenerator::generateModel(model,
+                 utils::Path("generated/not-an-identifier")), std::runtime_error);
+
+    Model quaternion("models/simple_quat.bioMod");
+    EXPECT_THROW(CodeGenerator::generateModel(quaternion,
+                 utils::Path("generated/quaternion")), std::runtime_error);
+}
+
+#ifdef MODULE_MUSCLES
+TEST(CodeGeneration, muscles)
+{
+    Model model(modelPathForMuscleTesting);
+    ASSERT_EQ(arm26Generated::nbMuscles, model.nbMuscles());
+
+    arm26Generated::VectorQ q;
+    rigidbody::GeneralizedCoordinates Q(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        q(i) = Q(i) = 0.3 + 0.2 * static_cast<double>(i);
+    }
+
+    Eigen::Matrix<double, arm26Generated::nbMuscles, 1> musculoTendonLength, length;
+    arm26Generated::musculoTendonLength(q, musculoTendonLength);
+    arm26Generated::musclesLength(q, length);
+    Eigen::Matrix<double, arm26Generated::nbMuscles, arm26Generated::nbQ> jacobian;
+    arm26Generated::musclesLengthJacobian(q, jacobian);
+
+    model.updateMuscles(Q, true);
+    utils::Matrix jacobianExpected(model.musclesLengthJacobian());
+    for (unsigned int m=0; m<model.nbMuscles(); ++m) {
+        EXPECT_NEAR(musculoTendonLength(m),
+                    model.muscle(m).position().musculoTendonLength(), requiredPrecision);
+        EXPECT_NEAR(length(m), model.muscle(m).position().length(), requiredPrecision);
+        for (unsigned int j=0; j<model.nbQ(); ++j) {
+            EXPECT_NEAR(jacobian(m, j), jacobianExpected(m, j), requiredPrecision);
+        }
+    }
+}
+#endif
@@ -3,6 +3,7 @@
 
 #include <rbdl/Dynamics.h>
 #include "BiorbdModel.h"
+#include "ModelTemplatedKinematics.h"
 #include "biorbdConfig.h"
 #include "Utils/Matrix.h"
 #include "RigidBody/GeneralizedCoordinates.h"
@@ -2329,6 +2330,37 @@ TEST(MuscleJacobian, jacobianLength)
     }
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(MuscleJacobian, templatedKinematics)
+{
+    Model model(modelPathForMuscleJacobian);
+    TemplatedKinematics kinematics(model);
+    ASSERT_EQ(kinematics.nbMuscles(), model.nbMuscleTotal());
+
+    rigidbody::GeneralizedCoordinates Q(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Q(i) = 0.4 + 0.3 * static_cast<double>(i);
+    }
+    Eigen::VectorXd q(Q);
+    Eigen::VectorXd musculoTendonLength;
+    Eigen::VectorXd length;
+    Eigen::MatrixXd jacobian;
+    kinematics.musclesLength(q, musculoTendonLength, length);
+    kinematics.musclesLengthJacobian(q, jacobian);
+
+    model.updateMuscles(Q, true);
+    utils::Matrix jacobianExpected(model.musclesLengthJacobian());
+    for (unsigned int m=0; m<model.nbMuscleTotal(); ++m) {
+        EXPECT_NEAR(musculoTendonLength(m),
+                    model.muscle(m).position().musculoTendonLength(), requiredPrecision);
+        EXPECT_NEAR(length(m), model.muscle(m).position().length(), requiredPrecision);
+        for (unsigned int j=0; j<model.nbQ(); ++j) {
+            EXPECT_NEAR(jacobian(m, j), jacobianExpected(m, j), requiredPrecision);
+        }
+    }
+}
+#endif
+
 #ifndef BIORBD_USE_CASADI_MATH
 TEST(MuscleFatigue, FatigueXiaDerivativeViaPointers)
 {
@@ -1,14 +1,24 @@
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
 #include <gtest/gtest.h>
 #include <rbdl/rbdl_math.h>
 #include <rbdl/Dynamics.h>
 
 #include "BiorbdModel.h"
+#include "ModelDescription.h"
+#include "ModelTemplatedKinematics.h"
+#include "ModelFunctionCache.h"
 #include "biorbdConfig.h"
 #include "Utils/String.h"
 #include "Utils/Range.h"
 #include "Utils/SpatialVector.h"
+#include "Utils/Matrix.h"
 #include "Utils/Matrix3d.h"
+#include "Utils/RotoTrans.h"
+#include "Utils/Path.h"
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/GeneralizedVelocity.h"
 #include "RigidBody/GeneralizedAcceleration.h"
@@ -21,6 +31,8 @@
 #ifdef MODULE_KALMAN
     #include "RigidBody/KalmanReconsMarkers.h"
     #include "RigidBody/KalmanReconsIMU.h"
+    #include "RigidBody/KalmanReconsMarkersIMU.h"
+    #include "RigidBody/KalmanStream.h"
 #endif
 
 using namespace BIORBD_NAMESPACE;
@@ -37,6 +49,7 @@ static std::string
 modelPathForLoopConstraintTesting("models/loopConstrainedModel.bioMod");
 static std::string modelNoRoot("models/pyomecaman_freeFall.bioMod");
 static std::string modelSimple("models/cube.bioMod");
+static std::string modelPathWithMultiDofJoints("models/multiDofJoints.bioMod");
 
 TEST(Gravity, change)
 {
@@ -343,6 +356,38 @@ TEST(IMUs, deepCopy)
     EXPECT_EQ(deepCopyLater.nbIMUs(), 4);
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(IMUs, stackedTechnical)
+{
+    Model model(modelPathForPyomecaman_withIMUs);
+    rigidbody::GeneralizedCoordinates Q(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Q(i) = 0.1 * static_cast<double>(i) + 0.2;
+    }
+    std::vector<rigidbody::IMU> imus(model.technicalIMU(Q));
+    std::vector<utils::Matrix> jacobians(model.TechnicalIMUJacobian(Q));
+
+    // The stacked versions give the same values, column by column
+    unsigned int nbTech(model.nbTechIMUs());
+    Eigen::VectorXd rotations(9*nbTech);
+    Eigen::MatrixXd jacobian(Eigen::MatrixXd::Constant(9*nbTech, model.nbQdot(), 1.0));
+    model.technicalIMU(Q, rotations, false);
+    model.TechnicalIMUJacobian(Q, jacobian, false);
+    for (unsigned int i=0; i<nbTech; ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            for (unsigned int k=0; k<3; ++k) {
+                EXPECT_NEAR(rotations(9*i + 3*j + k), imus[i](k, j), requiredPrecision);
+            }
+        }
+        for (unsigned int r=0; r<9; ++r) {
+            for (unsigned int c=0; c<model.nbQdot(); ++c) {
+                EXPECT_NEAR(jacobian(9*i + r, c), jacobians[i](r, c), requiredPrecision);
+            }
+        }
+    }
+}
+#endif
+
 TEST(Joints, copy)
 {
     {
@@ -777,6 +822,95 @@ TEST(CoM, kinematics)
     }
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(CoM, jacobian)
+{
+    Model model(modelPathWithMultiDofJoints);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    DECLARE_GENERALIZED_VELOCITY(Qdot, model);
+    DECLARE_GENERALIZED_ACCELERATION(Qddot, model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Q(i) = static_cast<double>(i) * 0.1 - 0.4;
+        Qdot(i) = static_cast<double>(i) * 0.3 - 1.0;
+        Qddot(i) = static_cast<double>(i) * 2.0 - 7.0;
+    }
+
+    utils::Matrix jacobian(3, model.nbQdot());
+    utils::Vector3d jacobianDotQdot;
+    model.CoMJacobian(Q, Qdot, jacobian, jacobianDotQdot);
+    utils::Matrix jacobianReturned(model.CoMJacobian(Q));
+
+    // Against the velocity and the acceleration computed from each segment
+    utils::Vector3d comDot(model.CoMdot(Q, Qdot));
+    utils::Vector3d comDdot(model.CoMddot(Q, Qdot, Qddot));
+    utils::Vector3d comDotFromJacobian(jacobian * Qdot);
+    utils::Vector3d comDdotFromJacobian(jacobian * Qddot + jacobianDotQdot);
+    for (unsigned int i=0; i<3; ++i) {
+        EXPECT_NEAR(comDotFromJacobian(i), comDot(i), requiredPrecision);
+        EXPECT_NEAR(comDdotFromJacobian(i), comDdot(i), requiredPrecision);
+        for (unsigned int j=0; j<model.nbQdot(); ++j) {
+            EXPECT_NEAR(jacobianReturned(i, j), jacobian(i, j), requiredPrecision);
+        }
+    }
+
+    Model modelGeneral(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(QGeneral, modelGeneral);
+    utils::Matrix wrongSize(3, modelGeneral.nbQdot()+1);
+    EXPECT_THROW(modelGeneral.CoMJacobian(QGeneral, wrongSize), std::runtime_error);
+}
+
+TEST(Joints, centroidalMomentum)
+{
+    Model model(modelPathWithMultiDofJoints);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    DECLARE_GENERALIZED_VELOCITY(Qdot, model);
+    DECLARE_GENERALIZED_ACCELERATION(Qddot, model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Q(i) = static_cast<double>(i) * 0.1 - 0.4;
+        Qdot(i) = static_cast<double>(i) * 0.3 - 1.0;
+        Qddot(i) = static_cast<double>(i) * 2.0 - 7.0;
+    }
+
+    utils::Matrix centroidalMatrix(model.centroidalMomentumMatrix(Q));
+    utils::Vector bias(model.centroidalMomentumBias(Q, Qdot));
+    utils::Vector momentum(centroidalMatrix * Qdot);
+    utils::Vector momentumDot(centroidalMatrix * Qddot + bias);
+
+    // Against the momenta computed from the center of mass
+    utils::Vector3d angularMomentum(model.CalcAngularMomentum(Q, Qdot, true));
+    utils::Vector3d comDot(model.CoMdot(Q, Qdot));
+    utils::Vector3d comDdot(model.CoMddot(Q, Qdot, Qddot));
+    for (unsigned int i=0; i<3; ++i) {
+        EXPECT_NEAR(momentum(i), angularMomentum(i), requiredPrecision);
+        EXPECT_NEAR(momentum(i+3), model.mass() * comDot(i), requiredPrecision);
+        EXPECT_NEAR(momentumDot(i+3), model.mass() * comDdot(i), requiredPrecision);
+    }
+
+    // The rate of change of the angular momentum by central differences in time
+    double h(1e-5);
+    rigidbody::GeneralizedCoordinates QPlus(Q + Qdot * h + Qddot * (h*h/2));
+    rigidbody::GeneralizedCoordinates QMinus(Q - Qdot * h + Qddot * (h*h/2));
+    rigidbody::GeneralizedVelocity QdotPlus(Qdot + Qddot * h);
+    rigidbody::GeneralizedVelocity QdotMinus(Qdot - Qddot * h);
+    utils::Vector3d angularMomentumDot(
+        (model.CalcAngularMomentum(QPlus, QdotPlus, true)
+         - model.CalcAngularMomentum(QMinus, QdotMinus, true)) / (2*h));
+    for (unsigned int i=0; i<3; ++i) {
+        EXPECT_NEAR(momentumDot(i), angularMomentumDot(i), 1e-5);
+    }
+
+    Model modelGeneral(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(QGeneral, modelGeneral);
+    DECLARE_GENERALIZED_VELOCITY(QdotGeneral, modelGeneral);
+    utils::Matrix wrongMatrix(6, modelGeneral.nbQdot()+1);
+    utils::Vector wrongBias(5);
+    EXPECT_THROW(modelGeneral.centroidalMomentumMatrix(QGeneral, wrongMatrix),
+                 std::runtime_error);
+    EXPECT_THROW(modelGeneral.centroidalMomentumBias(QGeneral, QdotGeneral, wrongBias),
+                 std::runtime_error);
+}
+#endif
+
 TEST(Segment, copy)
 {
     Model model(modelPathForGeneralTesting);
@@ -854,6 +988,74 @@ TEST(Markers, allPositions)
     }
 }
 
+TEST(Markers, addedAfterLoading)
+{
+    Model model(modelPathMeshEqualsMarker);
+    rigidbody::GeneralizedCoordinates Q(model);
+    FILL_VECTOR(Q, QtestEqualsMarker);
+
+    // Directly to the model or through a shallow copy that is not a model
+    rigidbody::NodeSegment first(model.marker(0));
+    model.addMarker(first, "copyOfFirst", first.parent(), true, true, "", -1);
+    rigidbody::Markers markers(model);
+    markers.addMarker(first, "otherCopyOfFirst", first.parent(), true, true, "",
+                      -1);
+    EXPECT_EQ(model.nbMarkers(), 6);
+
+    std::vector<rigidbody::NodeSegment> positions(model.markers(Q));
+    for (unsigned int i=4; i<model.nbMarkers(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            SCALAR_TO_DOUBLE(mark, positions[i][j]);
+            EXPECT_NEAR(mark, expectedMarkers[0][j], requiredPrecision);
+        }
+    }
+}
+
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(Markers, stackedJacobian)
+{
+    Model model(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    std::vector<double> val(model.nbQ());
+    for (size_t i=0; i<val.size(); ++i) {
+        val[i] = 0.3 - static_cast<double>(i) * 0.1;
+    }
+    FILL_VECTOR(Q, val);
+
+    // Each marker against the jacobian of a single point computed by RBDL
+    Eigen::MatrixXd jacobian(3*model.nbMarkers(), model.nbQdot());
+    model.markersJacobian(Q, jacobian);
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        rigidbody::NodeSegment marker(model.marker(i));
+        utils::Matrix expected(model.markersJacobian(Q, marker.parent(), marker,
+                               true));
+        for (unsigned int j=0; j<3; ++j) {
+            for (unsigned int k=0; k<model.nbQdot(); ++k) {
+                EXPECT_NEAR(jacobian(3*i+j, k), expected(j, k), requiredPrecision);
+            }
+        }
+    }
+
+    // Only the technical markers
+    Eigen::MatrixXd technicalJacobian(3*model.nbTechnicalMarkers(), model.nbQdot());
+    model.technicalMarkersJacobian(Q, technicalJacobian);
+    unsigned int row(0);
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        if (!model.marker(i).isTechnical()) {
+            continue;
+        }
+        for (unsigned int j=0; j<3; ++j) {
+            for (unsigned int k=0; k<model.nbQdot(); ++k) {
+                EXPECT_NEAR(technicalJacobian(row+j, k), jacobian(3*i+j, k),
+                            requiredPrecision);
+            }
+        }
+        row += 3;
+    }
+    EXPECT_EQ(row, 3*model.nbTechnicalMarkers());
+}
+#endif
+
 TEST(Markers, individualPositions)
 {
     Model model(modelPathMeshEqualsMarker);
@@ -902,6 +1104,62 @@ TEST(Markers, individualPositions)
     }
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(Markers, inverseKinematicsTrial)
+{
+    Model model(modelPathForGeneralTesting);
+    unsigned int nbFrames(20);
+    unsigned int nbTechnical(model.nbTechnicalMarkers());
+    utils::Matrix Qexpected(model.nbQ(), nbFrames);
+    utils::Matrix markers(3*nbTechnical, nbFrames);
+    for (unsigned int j=0; j<nbFrames; ++j) {
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            Qexpected(i, j) = 0.2 + 0.02 * static_cast<double>(j) * std::cos(
+                                  static_cast<double>(i));
+        }
+        rigidbody::GeneralizedCoordinates Q(Qexpected.col(j));
+        std::vector<rigidbody::NodeSegment> technical(model.technicalMarkers(Q));
+        for (unsigned int m=0; m<nbTechnical; ++m) {
+            markers.block(3*m, j, 3, 1) = technical[m];
+        }
+    }
+    // Occlude a marker on some frames and every marker on another one
+    markers.block(0, 3, 3, 1).setConstant(NAN);
+    markers.block(3, 10, 1, 1).setConstant(NAN);
+    markers.col(15).setConstant(NAN);
+
+    // Each chunk of frames starts from Qinit, so the results only match
+    // between the numbers of threads within the tolerance
+    rigidbody::GeneralizedCoordinates Qinit(Qexpected.col(0));
+    Qinit.array() += 0.05;
+    for (unsigned int nbThreads : {1, 3}) {
+        model.setNbThreads(nbThreads);
+        utils::Matrix Q(model.nbQ(), nbFrames);
+        Eigen::VectorXd residuals(nbFrames);
+        EXPECT_EQ(model.inverseKinematics(markers, Qinit, Q, residuals), 1u);
+        for (unsigned int j=0; j<nbFrames; ++j) {
+            if (j == 15) {
+                // Without any marker, the previous frame is kept
+                EXPECT_TRUE(std::isnan(residuals(j)));
+                for (unsigned int i=0; i<model.nbQ(); ++i) {
+                    EXPECT_EQ(Q(i, j), Q(i, j-1));
+                }
+                continue;
+            }
+            EXPECT_LT(residuals(j), 1e-8);
+            for (unsigned int i=0; i<model.nbQ(); ++i) {
+                EXPECT_NEAR(Q(i, j), Qexpected(i, j), 1e-6);
+            }
+        }
+    }
+
+    utils::Matrix QWrongSize(model.nbQ(), nbFrames + 1);
+    Eigen::VectorXd residuals(nbFrames);
+    EXPECT_THROW(model.inverseKinematics(markers, Qinit, QWrongSize, residuals),
+                 std::runtime_error);
+}
+#endif
+
 TEST(Mesh, position)
 {
     Model model(modelPathMeshEqualsMarker);
@@ -1035,6 +1293,333 @@ TEST(Dynamics, ForwardDynAndExternalForces)
 }
 
 
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(Joints, collapsedDofs)
+{
+    Model model(modelPathWithMultiDofJoints);
+    Model modelCollapsed(modelPathWithMultiDofJoints, true);
+    EXPECT_FALSE(model.isCollapsingDofs());
+    EXPECT_TRUE(modelCollapsed.isCollapsingDofs());
+    EXPECT_THROW(modelCollapsed.setCollapseDofs(false), std::runtime_error);
+
+    // Same generalized coordinates, but fewer bodies
+    EXPECT_EQ(modelCollapsed.nbQ(), model.nbQ());
+    EXPECT_EQ(modelCollapsed.nbQdot(), model.nbQdot());
+    std::vector<utils::String> names(model.nameDof());
+    std::vector<utils::String> namesCollapsed(modelCollapsed.nameDof());
+    ASSERT_EQ(namesCollapsed.size(), names.size());
+    for (unsigned int i=0; i<names.size(); ++i) {
+        EXPECT_STREQ(namesCollapsed[i].c_str(), names[i].c_str());
+    }
+    EXPECT_EQ(model.mBodies.size(), 16u);
+    EXPECT_EQ(modelCollapsed.mBodies.size(), 8u);
+
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    DECLARE_GENERALIZED_VELOCITY(QDot, model);
+    DECLARE_GENERALIZED_ACCELERATION(QDDot, model);
+    DECLARE_GENERALIZED_TORQUE(Tau, model);
+    std::vector<double> val(model.nbQ());
+    for (size_t i=0; i<val.size(); ++i) {
+        val[i] = static_cast<double>(i) * 0.1 - 0.4;
+    }
+    FILL_VECTOR(Q, val);
+    FILL_VECTOR(QDot, val);
+    FILL_VECTOR(QDDot, val);
+    FILL_VECTOR(Tau, val);
+    std::vector<utils::SpatialVector> f_ext;
+    for (size_t i=0; i<2; ++i) {
+        double di = static_cast<double>(i);
+        f_ext.push_back(utils::SpatialVector(
+                            (di+1)*1.1, (di+1)*2.2, (di+1)*3.3, (di+1)*4.4, (di+1)*5.5, (di+1)*6.6));
+    }
+
+    // Kinematics
+    std::vector<rigidbody::NodeSegment> markers(model.markers(Q));
+    std::vector<rigidbody::NodeSegment> markersCollapsed(modelCollapsed.markers(Q));
+    std::vector<utils::Matrix> jacobian(model.markersJacobian(Q));
+    std::vector<utils::Matrix> jacobianCollapsed(modelCollapsed.markersJacobian(Q));
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            EXPECT_NEAR(markersCollapsed[i](j), markers[i](j), requiredPrecision);
+            for (unsigned int k=0; k<model.nbQdot(); ++k) {
+                EXPECT_NEAR(jacobianCollapsed[i](j, k), jacobian[i](j, k), requiredPrecision);
+            }
+        }
+    }
+    utils::Vector3d com(model.CoM(Q));
+    utils::Vector3d comCollapsed(modelCollapsed.CoM(Q));
+    utils::Matrix comJacobian(model.CoMJacobian(Q));
+    utils::Matrix comJacobianCollapsed(modelCollapsed.CoMJacobian(Q));
+    for (unsigned int j=0; j<3; ++j) {
+        EXPECT_NEAR(comCollapsed(j), com(j), requiredPrecision);
+        for (unsigned int k=0; k<model.nbQdot(); ++k) {
+            EXPECT_NEAR(comJacobianCollapsed(j, k), comJacobian(j, k), requiredPrecision);
+        }
+    }
+
+    // Momentum
+    utils::Matrix centroidalMatrix(model.centroidalMomentumMatrix(Q));
+    utils::Matrix centroidalMatrixCollapsed(modelCollapsed.centroidalMomentumMatrix(Q));
+    utils::Vector bias(model.centroidalMomentumBias(Q, QDot));
+    utils::Vector biasCollapsed(modelCollapsed.centroidalMomentumBias(Q, QDot));
+    for (unsigned int j=0; j<6; ++j) {
+        EXPECT_NEAR(biasCollapsed(j), bias(j), requiredPrecision);
+        for (unsigned int k=0; k<model.nbQdot(); ++k) {
+            EXPECT_NEAR(centroidalMatrixCollapsed(j, k), centroidalMatrix(j, k),
+                        requiredPrecision);
+        }
+    }
+
+    // Dynamics
+    utils::Matrix M(model.massMatrix(Q));
+    utils::Matrix MCollapsed(modelCollapsed.massMatrix(Q));
+    rigidbody::GeneralizedTorque TauID(model.InverseDynamics(Q, QDot, QDDot, &f_ext));
+    rigidbody::GeneralizedTorque TauIDCollapsed(
+        modelCollapsed.InverseDynamics(Q, QDot, QDDot, &f_ext));
+    rigidbody::GeneralizedAcceleration QDDotFD(model.ForwardDynamics(Q, QDot, Tau,
+            &f_ext));
+    rigidbody::GeneralizedAcceleration QDDotFDCollapsed(
+        modelCollapsed.ForwardDynamics(Q, QDot, Tau, &f_ext));
+    utils::Matrix dTau_dQ, dTau_dQDot, dTau_dQDDot;
+    model.InverseDynamicsDerivatives(Q, QDot, QDDot, dTau_dQ, dTau_dQDot, dTau_dQDDot,
+                                     &f_ext);
+    utils::Matrix dTau_dQCollapsed, dTau_dQDotCollapsed, dTau_dQDDotCollapsed;
+    modelCollapsed.InverseDynamicsDerivatives(Q, QDot, QDDot, dTau_dQCollapsed,
+            dTau_dQDotCollapsed, dTau_dQDDotCollapsed, &f_ext);
+    for (unsigned int i=0; i<model.nbQdot(); ++i) {
+        EXPECT_NEAR(TauIDCollapsed(i), TauID(i), requiredPrecision);
+        EXPECT_NEAR(QDDotFDCollapsed(i), QDDotFD(i), 1e-8);
+        for (unsigned int j=0; j<model.nbQdot(); ++j) {
+            EXPECT_NEAR(MCollapsed(i, j), M(i, j), requiredPrecision);
+            EXPECT_NEAR(dTau_dQCollapsed(i, j), dTau_dQ(i, j), requiredPrecision);
+            EXPECT_NEAR(dTau_dQDotCollapsed(i, j), dTau_dQDot(i, j), requiredPrecision);
+        }
+    }
+}
+
+TEST(MassMatrix, inverse)
+{
+    Model model(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    std::vector<double> val(model.nbQ());
+    for (size_t i=0; i<val.size(); ++i) {
+        val[i] = static_cast<double>(i) * 0.1;
+    }
+    FILL_VECTOR(Q, val);
+
+    utils::Matrix MinvExpected(model.massMatrix(Q).inverse());
+    utils::Matrix Minv(model.massMatrixInverse(Q));
+    EXPECT_EQ(Minv.rows(), model.nbQdot());
+    EXPECT_EQ(Minv.cols(), model.nbQdot());
+    for (unsigned int i=0; i<model.nbQdot(); ++i) {
+        for (unsigned int j=0; j<model.nbQdot(); ++j) {
+            EXPECT_NEAR(Minv(i, j), MinvExpected(i, j), requiredPrecision);
+        }
+    }
+}
+
+TEST(MassMatrix, LTDL)
+{
+    Model model(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    std::vector<double> val(model.nbQ());
+    for (size_t i=0; i<val.size(); ++i) {
+        val[i] = static_cast<double>(i) * 0.1;
+    }
+    FILL_VECTOR(Q, val);
+
+    utils::Matrix M(model.massMatrix(Q));
+    utils::Matrix LTDL;
+    model.massMatrixLTDL(Q, LTDL);
+
+    // Several right-hand sides solved at once from the same factorization
+    utils::Matrix B(model.nbQdot(), 3);
+    for (unsigned int i=0; i<model.nbQdot(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            B(i, j) = static_cast<double>(i+1) * 0.3 - static_cast<double>(j);
+        }
+    }
+    utils::Matrix XExpected(M.llt().solve(B));
+    utils::Matrix X(B);
+    model.massMatrixLTDLSolve(LTDL, X);
+    for (unsigned int i=0; i<model.nbQdot(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            EXPECT_NEAR(X(i, j), XExpected(i, j), requiredPrecision);
+        }
+    }
+
+    utils::Matrix wrongSize(model.nbQdot()+1, 1);
+    EXPECT_THROW(model.massMatrixLTDLSolve(LTDL, wrongSize), std::runtime_error);
+}
+
+TEST(Dynamics, InverseDynamicsDerivatives)
+{
+    Model model(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    DECLARE_GENERALIZED_VELOCITY(QDot, model);
+    DECLARE_GENERALIZED_ACCELERATION(QDDot, model);
+    std::vector<utils::SpatialVector> f_ext;
+    for (size_t i=0; i<2; ++i) {
+        double di = static_cast<double>(i);
+        f_ext.push_back(utils::SpatialVector(
+                            (di+1)*1.1, (di+1)*2.2, (di+1)*3.3, (di+1)*4.4, (di+1)*5.5, (di+1)*6.6));
+    }
+    std::vector<double> val(model.nbQ());
+    for (size_t i=0; i<val.size(); ++i) {
+        val[i] = static_cast<double>(i) * 0.1;
+    }
+    FILL_VECTOR(Q, val);
+    FILL_VECTOR(QDot, val);
+    FILL_VECTOR(QDDot, val);
+
+    for (unsigned int withForces=0; withForces<2; ++withForces) {
+        std::vector<utils::SpatialVector>* forces(withForces ? &f_ext : nullptr);
+        utils::Matrix dTau_dQ, dTau_dQDot, dTau_dQDDot;
+        rigidbody::GeneralizedTorque Tau(model.InverseDynamicsDerivatives(
+                Q, QDot, QDDot, dTau_dQ, dTau_dQDot, dTau_dQDDot, forces));
+
+        // Same torques as RBDL and the mass matrix as derivative with respect to QDDot
+        rigidbody::GeneralizedTorque TauExpected(model.InverseDynamics(Q, QDot, QDDot,
+                forces));
+        utils::Matrix M(model.massMatrix(Q));
+        for (unsigned int i=0; i<model.nbGeneralizedTorque(); ++i) {
+            EXPECT_NEAR(Tau(i), TauExpected(i), requiredPrecision);
+            for (unsigned int j=0; j<model.nbQddot(); ++j) {
+                EXPECT_NEAR(dTau_dQDDot(i, j), M(i, j), requiredPrecision);
+            }
+        }
+
+        // Against central finite differences
+        double h(1e-6);
+        for (unsigned int j=0; j<model.nbQdot(); ++j) {
+            rigidbody::GeneralizedCoordinates QPlus(Q), QMinus(Q);
+            QPlus[j] += h;
+            QMinus[j] -= h;
+            rigidbody::GeneralizedVelocity QDotPlus(QDot), QDotMinus(QDot);
+            QDotPlus[j] += h;
+            QDotMinus[j] -= h;
+            utils::Vector dQ((model.InverseDynamics(QPlus, QDot, QDDot, forces)
+                              - model.InverseDynamics(QMinus, QDot, QDDot, forces)) / (2*h));
+            utils::Vector dQDot((model.InverseDynamics(Q, QDotPlus, QDDot, forces)
+                                 - model.InverseDynamics(Q, QDotMinus, QDDot, forces)) / (2*h));
+            for (unsigned int i=0; i<model.nbGeneralizedTorque(); ++i) {
+                EXPECT_NEAR(dTau_dQ(i, j), dQ(i), 1e-5 * std::max(1.0, std::fabs(dQ(i))));
+                EXPECT_NEAR(dTau_dQDot(i, j), dQDot(i),
+                            1e-5 * std::max(1.0, std::fabs(dQDot(i))));
+            }
+        }
+    }
+}
+
+TEST(Dynamics, ForwardDynamicsDerivatives)
+{
+    Model model(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    DECLARE_GENERALIZED_VELOCITY(QDot, model);
+    DECLARE_GENERALIZED_TORQUE(Tau, model);
+    std::vector<utils::SpatialVector> f_ext;
+    for (size_t i=0; i<2; ++i) {
+        double di = static_cast<double>(i);
+        f_ext.push_back(utils::SpatialVector(
+                            (di+1)*1.1, (di+1)*2.2, (di+1)*3.3, (di+1)*4.4, (di+1)*5.5, (di+1)*6.6));
+    }
+    std::vector<double> val(model.nbQ());
+    for (size_t i=0; i<val.size(); ++i) {
+        val[i] = static_cast<double>(i) * 0.1;
+    }
+    FILL_VECTOR(Q, val);
+    FILL_VECTOR(QDot, val);
+    FILL_VECTOR(Tau, val);
+
+    for (unsigned int withForces=0; withForces<2; ++withForces) {
+        std::vector<utils::SpatialVector>* forces(withForces ? &f_ext : nullptr);
+        utils::Matrix dQDDot_dQ, dQDDot_dQDot, dQDDot_dTau;
+        model.ForwardDynamicsDerivatives(Q, QDot, Tau, dQDDot_dQ, dQDDot_dQDot,
+                                         dQDDot_dTau, forces);
+
+        // Against central finite differences
+        double h(1e-6);
+        for (unsigned int j=0; j<model.nbQdot(); ++j) {
+            rigidbody::GeneralizedCoordinates QPlus(Q), QMinus(Q);
+            QPlus[j] += h;
+            QMinus[j] -= h;
+            rigidbody::GeneralizedVelocity QDotPlus(QDot), QDotMinus(QDot);
+            QDotPlus[j] += h;
+            QDotMinus[j] -= h;
+            rigidbody::GeneralizedTorque TauPlus(Tau), TauMinus(Tau);
+            TauPlus[j] += h;
+            TauMinus[j] -= h;
+            utils::Vector dQ((model.ForwardDynamics(QPlus, QDot, Tau, forces)
+                              - model.ForwardDynamics(QMinus, QDot, Tau, forces)) / (2*h));
+            utils::Vector dQDot((model.ForwardDynamics(Q, QDotPlus, Tau, forces)
+                                 - model.ForwardDynamics(Q, QDotMinus, Tau, forces)) / (2*h));
+            utils::Vector dTau((model.ForwardDynamics(Q, QDot, TauPlus, forces)
+                                - model.ForwardDynamics(Q, QDot, TauMinus, forces)) / (2*h));
+            for (unsigned int i=0; i<model.nbQddot(); ++i) {
+                EXPECT_NEAR(dQDDot_dQ(i, j), dQ(i), 1e-5 * std::max(1.0, std::fabs(dQ(i))));
+                EXPECT_NEAR(dQDDot_dQDot(i, j), dQDot(i),
+                            1e-5 * std::max(1.0, std::fabs(dQDot(i))));
+                EXPECT_NEAR(dQDDot_dTau(i, j), dTau(i),
+                            1e-5 * std::max(1.0, std::fabs(dTau(i))));
+            }
+        }
+    }
+}
+
+TEST(Dynamics, DerivativesSphericalJoint)
+{
+    Model model("models/simple_quat.bioMod");
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    DECLARE_GENERALIZED_VELOCITY(QDot, model);
+    DECLARE_GENERALIZED_ACCELERATION(QDDot, model);
+    DECLARE_GENERALIZED_TORQUE(Tau, model);
+    FILL_VECTOR(Q, std::vector<double>({0.7035975447302919, 0.7035975447302919,
+                                        0.07035975447302918, 0.07035975447302918}));
+    FILL_VECTOR(QDot, std::vector<double>({0.3, -0.6, 0.9}));
+    FILL_VECTOR(QDDot, std::vector<double>({-1.2, 0.4, 0.7}));
+    FILL_VECTOR(Tau, std::vector<double>({0.5, 1.5, -2.5}));
+
+    utils::Matrix dTau_dQ, dTau_dQDot, dTau_dQDDot;
+    model.InverseDynamicsDerivatives(Q, QDot, QDDot, dTau_dQ, dTau_dQDot,
+                                     dTau_dQDDot);
+    utils::Matrix dQDDot_dQ, dQDDot_dQDot, dQDDot_dTau;
+    model.ForwardDynamicsDerivatives(Q, QDot, Tau, dQDDot_dQ, dQDDot_dQDot,
+                                     dQDDot_dTau);
+
+    // The derivatives with respect to Q are along a rotation vector in the
+    // local reference frame, that is the direction of the quaternion moved
+    // by a unit angular velocity
+    double h(1e-6);
+    for (unsigned int j=0; j<model.nbQdot(); ++j) {
+        rigidbody::GeneralizedCoordinates omega(utils::Vector::Zero(model.nbQdot()));
+        omega[j] = 1;
+        utils::Vector direction(model.computeQdot(Q, omega));
+        rigidbody::GeneralizedCoordinates QPlus(Q + h * direction);
+        rigidbody::GeneralizedCoordinates QMinus(Q - h * direction);
+        rigidbody::GeneralizedVelocity QDotPlus(QDot), QDotMinus(QDot);
+        QDotPlus[j] += h;
+        QDotMinus[j] -= h;
+        utils::Vector dTauQ((model.InverseDynamics(QPlus, QDot, QDDot)
+                             - model.InverseDynamics(QMinus, QDot, QDDot)) / (2*h));
+        utils::Vector dTauQDot((model.InverseDynamics(Q, QDotPlus, QDDot)
+                                - model.InverseDynamics(Q, QDotMinus, QDDot)) / (2*h));
+        utils::Vector dQDDotQ((model.ForwardDynamics(QPlus, QDot, Tau)
+                               - model.ForwardDynamics(QMinus, QDot, Tau)) / (2*h));
+        utils::Vector dQDDotQDot((model.ForwardDynamics(Q, QDotPlus, Tau)
+                                  - model.ForwardDynamics(Q, QDotMinus, Tau)) / (2*h));
+        for (unsigned int i=0; i<model.nbQdot(); ++i) {
+            EXPECT_NEAR(dTau_dQ(i, j), dTauQ(i), 1e-5 * std::max(1.0, std::fabs(dTauQ(i))));
+            EXPECT_NEAR(dTau_dQDot(i, j), dTauQDot(i),
+                        1e-5 * std::max(1.0, std::fabs(dTauQDot(i))));
+            EXPECT_NEAR(dQDDot_dQ(i, j), dQDDotQ(i),
+                        1e-5 * std::max(1.0, std::fabs(dQDDotQ(i))));
+            EXPECT_NEAR(dQDDot_dQDot(i, j), dQDDotQDot(i),
+                        1e-5 * std::max(1.0, std::fabs(dQDDotQDot(i))));
+        }
+    }
+}
+#endif
+
 TEST(QDot, ComputeConstraintImpulsesDirect)
 {
     Model model(modelPathForGeneralTesting);
@@ -1136,6 +1721,499 @@ TEST(Dynamics, ForwardAccelerationConstraint)
     }
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(Dynamics, ContactSolvers)
+{
+    rigidbody::CONTACT_SOLVER_TYPE types[] = {
+        rigidbody::DIRECT, rigidbody::RANGE_SPACE_SPARSE, rigidbody::NULL_SPACE
+    };
+    {
+        Model model(modelPathForGeneralTesting);
+        rigidbody::GeneralizedCoordinates Q(model);
+        rigidbody::GeneralizedVelocity QDot(model);
+        rigidbody::GeneralizedTorque Tau(model);
+        Q.setOnes();
+        QDot.setOnes();
+        Tau.setOnes();
+
+        EXPECT_EQ(model.contactSolver(), rigidbody::DIRECT);
+        utils::Vector forcesOfModel(model.getConstraints().getForce());
+        rigidbody::GeneralizedAcceleration QDDot_expected(
+            model.ForwardDynamicsConstraintsDirect(Q, QDot, Tau));
+        utils::Vector forces_expected(
+            model.ContactForcesFromForwardDynamicsConstraintsDirect(Q, QDot, Tau));
+        rigidbody::GeneralizedVelocity QDotPost_expected(
+            model.ComputeConstraintImpulsesDirect(Q, QDot));
+
+        // The *Direct functions leave the constraint set of the model untouched
+        EXPECT_EQ((model.getConstraints().getForce() - forcesOfModel).norm(), 0.0);
+
+        for (auto type : types) {
+            model.setContactSolver(type);
+            EXPECT_EQ(model.contactSolver(), type);
+
+            rigidbody::GeneralizedAcceleration QDDot(
+                model.ForwardDynamicsConstraints(Q, QDot, Tau));
+            for (unsigned int i = 0; i<model.nbQddot(); ++i) {
+                EXPECT_NEAR(QDDot(i), QDDot_expected(i), 1e-8);
+            }
+            utils::Vector forces(
+                model.ContactForcesFromForwardDynamicsConstraints(Q, QDot, Tau));
+            for (unsigned int i = 0; i<forces_expected.size(); ++i) {
+                EXPECT_NEAR(forces(i), forces_expected(i), 1e-8);
+            }
+            rigidbody::GeneralizedVelocity QDotPost(
+                model.ComputeConstraintImpulses(Q, QDot));
+            for (unsigned int i = 0; i<model.nbQdot(); ++i) {
+                EXPECT_NEAR(QDotPost(i), QDotPost_expected(i), 1e-8);
+            }
+
+            // The solver is carried by the copies of the constraint set
+            rigidbody::Contacts copy(
+                static_cast<rigidbody::Contacts&>(model).DeepCopy());
+            EXPECT_EQ(copy.contactSolver(), type);
+        }
+
+        EXPECT_GE(model.timeContactSolver(rigidbody::NULL_SPACE, Q, QDot, Tau, 10),
+                  0.);
+        EXPECT_THROW(model.timeContactSolver(rigidbody::DIRECT, Q, QDot, Tau, 0),
+                     std::runtime_error);
+        rigidbody::CONTACT_SOLVER_TYPE fastest(
+            model.selectFastestContactSolver(Q, QDot, Tau, 10));
+        EXPECT_EQ(model.contactSolver(), fastest);
+        EXPECT_STRNE(rigidbody::CONTACT_SOLVER_TYPE_toStr(fastest), "NoType");
+    }
+    {
+        Model model(modelPathForLoopConstraintTesting);
+        rigidbody::GeneralizedCoordinates Q(model);
+        rigidbody::GeneralizedVelocity QDot(model);
+        rigidbody::GeneralizedTorque Tau(model);
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            Q(i) = 0.1 * static_cast<double>(i);
+            QDot(i) = -0.2 * static_cast<double>(i);
+            Tau(i) = 0.5 * static_cast<double>(i);
+        }
+
+        rigidbody::GeneralizedAcceleration QDDot_expected(
+            model.ForwardDynamicsConstraintsDirect(Q, QDot, Tau));
+        for (auto type : types) {
+            model.setContactSolver(type);
+            rigidbody::GeneralizedAcceleration QDDot(
+                model.ForwardDynamicsConstraints(Q, QDot, Tau));
+            for (unsigned int i = 0; i<model.nbQddot(); ++i) {
+                EXPECT_NEAR(QDDot(i), QDDot_expected(i),
+                            1e-6 * std::max(1.0, std::fabs(QDDot_expected(i))));
+            }
+        }
+    }
+}
+
+TEST(Dynamics, Batch)
+{
+    Model model(modelPathForGeneralTesting);
+    unsigned int nbFrames(7);
+    utils::Matrix Q(model.nbQ(), nbFrames);
+    utils::Matrix QDot(model.nbQdot(), nbFrames);
+    utils::Matrix QDDot(model.nbQddot(), nbFrames);
+    utils::Matrix Tau(model.nbGeneralizedTorque(), nbFrames);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        for (unsigned int j=0; j<nbFrames; ++j) {
+            Q(i, j) = 0.1 * static_cast<double>(i) - 0.2 * static_cast<double>(j);
+            QDot(i, j) = 0.3 * static_cast<double>(i + j);
+            QDDot(i, j) = -0.5 * static_cast<double>(i) + static_cast<double>(j);
+            Tau(i, j) = 1.1 * static_cast<double>(i) * static_cast<double>(j);
+        }
+    }
+
+    for (unsigned int nbThreads : {1, 3}) {
+        model.setNbThreads(nbThreads);
+        EXPECT_EQ(model.nbThreads(), nbThreads);
+
+        utils::Matrix TauID(model.nbGeneralizedTorque(), nbFrames);
+        utils::Matrix TauNLE(model.nbGeneralizedTorque(), nbFrames);
+        utils::Matrix QDDotFD(model.nbQddot(), nbFrames);
+        utils::Matrix M(model.nbQdot(), model.nbQdot() * nbFrames);
+        model.InverseDynamicsBatch(Q, QDot, QDDot, TauID);
+        model.NonLinearEffectBatch(Q, QDot, TauNLE);
+        model.ForwardDynamicsBatch(Q, QDot, Tau, QDDotFD);
+        model.massMatrixBatch(Q, M);
+
+        for (unsigned int j=0; j<nbFrames; ++j) {
+            rigidbody::GeneralizedCoordinates q(Q.col(j));
+            rigidbody::GeneralizedVelocity qdot(QDot.col(j));
+            rigidbody::GeneralizedAcceleration qddot(QDDot.col(j));
+            rigidbody::GeneralizedTorque tau(Tau.col(j));
+            rigidbody::GeneralizedTorque tauID(model.InverseDynamics(q, qdot, qddot));
+            rigidbody::GeneralizedTorque tauNLE(model.NonLinearEffect(q, qdot));
+            rigidbody::GeneralizedAcceleration qddotFD(model.ForwardDynamics(q, qdot, tau));
+            utils::Matrix m(model.massMatrix(q));
+            for (unsigned int i=0; i<model.nbQdot(); ++i) {
+                EXPECT_NEAR(TauID(i, j), tauID(i), requiredPrecision);
+                EXPECT_NEAR(TauNLE(i, j), tauNLE(i), requiredPrecision);
+                EXPECT_NEAR(QDDotFD(i, j), qddotFD(i), requiredPrecision);
+                for (unsigned int k=0; k<model.nbQdot(); ++k) {
+                    EXPECT_NEAR(M(i, j * model.nbQdot() + k), m(i, k), requiredPrecision);
+                }
+            }
+        }
+    }
+
+    // The results do not depend on the number of threads
+    utils::Matrix QDDotSingleThread(model.nbQddot(), nbFrames);
+    utils::Matrix QDDotMultiThread(model.nbQddot(), nbFrames);
+    model.setNbThreads(1);
+    model.ForwardDynamicsBatch(Q, QDot, Tau, QDDotSingleThread);
+    model.setNbThreads(4);
+    model.ForwardDynamicsBatch(Q, QDot, Tau, QDDotMultiThread);
+    for (unsigned int i=0; i<model.nbQddot(); ++i) {
+        for (unsigned int j=0; j<nbFrames; ++j) {
+            EXPECT_EQ(QDDotSingleThread(i, j), QDDotMultiThread(i, j));
+        }
+    }
+
+    // The copies kept by the workers follow the modifications of the model
+    utils::Matrix TauNLEGravity(model.nbGeneralizedTorque(), nbFrames);
+    model.setGravity(utils::Vector3d(0, 0, -1));
+    model.NonLinearEffectBatch(Q, QDot, TauNLEGravity);
+    for (unsigned int j=0; j<nbFrames; ++j) {
+        rigidbody::GeneralizedCoordinates q(Q.col(j));
+        rigidbody::GeneralizedVelocity qdot(QDot.col(j));
+        rigidbody::GeneralizedTorque tauNLE(model.NonLinearEffect(q, qdot));
+        for (unsigned int i=0; i<model.nbQdot(); ++i) {
+            EXPECT_NEAR(TauNLEGravity(i, j), tauNLE(i), requiredPrecision);
+        }
+    }
+
+    // The number of frames must match
+    utils::Matrix TauWrongSize(model.nbGeneralizedTorque(), nbFrames + 1);
+    EXPECT_THROW(model.InverseDynamicsBatch(Q, QDot, QDDot, TauWrongSize),
+                 std::runtime_error);
+}
+
+TEST(Kinematics, BatchPrecision)
+{
+    Model model(modelPathForGeneralTesting);
+    model.setNbThreads(3);
+    unsigned int nbFrames(11);
+    utils::Matrix Q(model.nbQ(), nbFrames);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        for (unsigned int j=0; j<nbFrames; ++j) {
+            Q(i, j) = 0.3 * static_cast<double>(i) - 0.25 * static_cast<double>(j);
+        }
+    }
+
+    // Double precision matches the frame by frame kinematics
+    Eigen::MatrixXd markers(3*model.nbMarkers(), nbFrames);
+    Eigen::MatrixXd mesh(3*model.nbMeshVertices(), nbFrames);
+    model.markersBatch(Q, markers, false);
+    model.meshPointsBatch(Q, mesh);
+    for (unsigned int j=0; j<nbFrames; ++j) {
+        rigidbody::GeneralizedCoordinates q(Q.col(j));
+        std::vector<rigidbody::NodeSegment> markersExpected(model.markers(q, false));
+        for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+            for (unsigned int k=0; k<3; ++k) {
+                EXPECT_NEAR(markers(3*i+k, j), markersExpected[i](k), requiredPrecision);
+            }
+        }
+        std::vector<utils::Matrix> meshExpected(model.meshPointsInMatrix(q));
+        unsigned int row(0);
+        for (unsigned int s=0; s<meshExpected.size(); ++s) {
+            for (unsigned int v=0; v<static_cast<unsigned int>(meshExpected[s].cols());
+                    ++v, row += 3) {
+                for (unsigned int k=0; k<3; ++k) {
+                    EXPECT_NEAR(mesh(row+k, j), meshExpected[s](k, v), requiredPrecision);
+                }
+            }
+        }
+        EXPECT_EQ(row, 3*model.nbMeshVertices());
+    }
+
+    // Single precision stays within a few float epsilons of the double results
+    Eigen::MatrixXf markersFloat(3*model.nbMarkers(), nbFrames);
+    Eigen::MatrixXf meshFloat(3*model.nbMeshVertices(), nbFrames);
+    model.markersBatch(Q, markersFloat, false);
+    model.meshPointsBatch(Q, meshFloat);
+    double markersError((markersFloat.cast<double>() - markers).cwiseAbs().maxCoeff());
+    double meshError((meshFloat.cast<double>() - mesh).cwiseAbs().maxCoeff());
+    EXPECT_LT(markersError, 1e-5 * std::max(1.0, markers.cwiseAbs().maxCoeff()));
+    EXPECT_LT(meshError, 1e-5 * std::max(1.0, mesh.cwiseAbs().maxCoeff()));
+
+    // Removing the axes behaves as the frame by frame kinematics
+    model.markersBatch(Q, markers);
+    std::vector<rigidbody::NodeSegment> markersRemoved(model.markers(
+                rigidbody::GeneralizedCoordinates(Q.col(0))));
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        for (unsigned int k=0; k<3; ++k) {
+            EXPECT_NEAR(markers(3*i+k, 0), markersRemoved[i](k), requiredPrecision);
+        }
+    }
+
+    // The dynamics of other poses does not leave stale kinematics in the workers
+    utils::Matrix QOther(Q.array() + 0.5);
+    utils::Matrix QDotZero(utils::Matrix::Zero(model.nbQdot(), nbFrames));
+    utils::Matrix TauZero(utils::Matrix::Zero(model.nbGeneralizedTorque(), nbFrames));
+    utils::Matrix QDDot(model.nbQddot(), nbFrames);
+    model.ForwardDynamicsBatch(QOther, QDotZero, TauZero, QDDot);
+    Eigen::MatrixXd markersAgain(3*model.nbMarkers(), nbFrames);
+    Eigen::MatrixXd meshAgain(3*model.nbMeshVertices(), nbFrames);
+    model.markersBatch(Q, markersAgain);
+    model.InverseDynamicsBatch(QOther, QDotZero, QDDot, TauZero);
+    model.meshPointsBatch(Q, meshAgain);
+    for (unsigned int j=0; j<nbFrames; ++j) {
+        for (unsigned int i=0; i<3*model.nbMarkers(); ++i) {
+            EXPECT_NEAR(markersAgain(i, j), markers(i, j), requiredPrecision);
+        }
+        for (unsigned int i=0; i<3*model.nbMeshVertices(); ++i) {
+            EXPECT_NEAR(meshAgain(i, j), mesh(i, j), requiredPrecision);
+        }
+    }
+
+    Eigen::MatrixXf markersWrongSize(3*model.nbMarkers(), nbFrames + 1);
+    Eigen::MatrixXf meshWrongSize(3, nbFrames);
+    EXPECT_THROW(model.markersBatch(Q, markersWrongSize), std::runtime_error);
+    EXPECT_THROW(model.meshPointsBatch(Q, meshWrongSize), std::runtime_error);
+}
+
+TEST(ModelDescription, rigidbody)
+{
+    Model model(modelPathWithMultiDofJoints);
+    ModelDescription description(model);
+    EXPECT_EQ(description.nbQ(), model.nbQ());
+    ASSERT_EQ(description.segments().size(), model.nbSegment());
+    ASSERT_EQ(description.markers().size(), model.nbMarkers());
+
+    unsigned int q(0);
+    for (unsigned int s=0; s<model.nbSegment(); ++s) {
+        const ModelDescription::Segment& segment(description.segments()[s]);
+        EXPECT_EQ(segment.parent, model.GetBodyBiorbdId(model.segment(s).parent()));
+        EXPECT_LT(segment.parent, static_cast<int>(s));
+        ASSERT_EQ(segment.dofs.size(), model.segment(s).nbDof());
+        for (unsigned int i=0; i<segment.dofs.size(); ++i) {
+            EXPECT_EQ(segment.dofs[i].isRotation, i >= model.segment(s).nbDofTrans());
+            EXPECT_LT(segment.dofs[i].axis, 3);
+            EXPECT_EQ(segment.dofs[i].q, q++);
+        }
+        SCALAR_TO_DOUBLE(mass, model.segment(s).characteristics().mass());
+        EXPECT_NEAR(segment.mass, mass, requiredPrecision);
+    }
+    EXPECT_EQ(q, model.nbQ());
+
+    for (unsigned int m=0; m<model.nbMarkers(); ++m) {
+        const ModelDescription::Point& marker(description.markers()[m]);
+        EXPECT_EQ(static_cast<int>(marker.segment),
+                  model.GetBodyBiorbdId(model.marker(m).parent()));
+        for (unsigned int i=0; i<3; ++i) {
+            EXPECT_NEAR(marker.position(i), model.marker(m)(i), requiredPrecision);
+            EXPECT_NEAR(marker.positionAxisRemoved(i), model.marker(m).removeAxes()(i),
+                        requiredPrecision);
+        }
+    }
+
+    Model quaternion("models/simple_quat.bioMod");
+    EXPECT_THROW(ModelDescription quaternionDescription(quaternion),
+                 std::runtime_error);
+}
+
+TEST(TemplatedKinematics, rigidbody)
+{
+    for (std::string path : {
+                modelPathForGeneralTesting, modelPathWithMultiDofJoints
+            }) {
+        Model model(path);
+        TemplatedKinematics kinematics(model);
+        ASSERT_EQ(kinematics.nbQ(), model.nbQ());
+        ASSERT_EQ(kinematics.nbSegment(), model.nbSegment());
+        ASSERT_EQ(kinematics.nbMarkers(), model.nbMarkers());
+
+        DECLARE_GENERALIZED_COORDINATES(Q, model);
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            Q(i) = static_cast<double>(i) * 0.2 - 0.7;
+        }
+        Eigen::VectorXd q(Q);
+
+        Eigen::Matrix<double, 4, Eigen::Dynamic> jcs;
+        kinematics.globalJCS(q, jcs);
+        std::vector<utils::RotoTrans> jcsExpected(model.allGlobalJCS(Q));
+        for (unsigned int s=0; s<model.nbSegment(); ++s) {
+            for (unsigned int i=0; i<4; ++i) {
+                for (unsigned int j=0; j<4; ++j) {
+                    EXPECT_NEAR(jcs(i, 4*s+j), jcsExpected[s](i, j), requiredPrecision);
+                }
+            }
+        }
+
+        for (bool removeAxis : {true, false}) {
+            Eigen::Matrix<double, 3, Eigen::Dynamic> markers;
+            Eigen::MatrixXd jacobian;
+            kinematics.markers(q, markers, removeAxis);
+            kinematics.markersJacobian(q, jacobian, removeAxis);
+            std::vector<rigidbody::NodeSegment> markersExpected(model.markers(Q,
+                    removeAxis));
+            std::vector<utils::Matrix> jacobianExpected(model.markersJacobian(Q,
+                    removeAxis));
+            for (unsigned int m=0; m<model.nbMarkers(); ++m) {
+                for (unsigned int i=0; i<3; ++i) {
+                    EXPECT_NEAR(markers(i, m), markersExpected[m](i), requiredPrecision);
+                    for (unsigned int j=0; j<model.nbQ(); ++j) {
+                        EXPECT_NEAR(jacobian(3*m+i, j), jacobianExpected[m](i, j),
+                                    requiredPrecision);
+                    }
+                }
+            }
+        }
+
+        Eigen::Vector3d com;
+        Eigen::MatrixXd comJacobian;
+        kinematics.CoM(q, com);
+        kinematics.CoMJacobian(q, comJacobian);
+        utils::Vector3d comExpected(model.CoM(Q));
+        utils::Matrix comJacobianExpected(model.CoMJacobian(Q));
+        for (unsigned int i=0; i<3; ++i) {
+            EXPECT_NEAR(com(i), comExpected(i), requiredPrecision);
+            for (unsigned int j=0; j<model.nbQ(); ++j) {
+                EXPECT_NEAR(comJacobian(i, j), comJacobianExpected(i, j), requiredPrecision);
+            }
+        }
+
+        // Any scalar type can be used
+        Eigen::VectorXf qFloat(q.cast<float>());
+        Eigen::Matrix<float, 3, Eigen::Dynamic> markersFloat;
+        kinematics.markers(qFloat, markersFloat);
+        std::vector<rigidbody::NodeSegment> markersExpected(model.markers(Q));
+        for (unsigned int m=0; m<model.nbMarkers(); ++m) {
+            for (unsigned int i=0; i<3; ++i) {
+                EXPECT_NEAR(markersFloat(i, m), markersExpected[m](i), 1e-4);
+            }
+        }
+    }
+
+    Model quaternion("models/simple_quat.bioMod");
+    EXPECT_THROW(TemplatedKinematics kinematics(quaternion), std::runtime_error);
+    Model model(modelPathForGeneralTesting);
+    TemplatedKinematics kinematics(model);
+    Eigen::MatrixXd jacobian;
+    EXPECT_THROW(kinematics.markersJacobian(Eigen::VectorXd::Zero(model.nbQ() + 1),
+                                            jacobian), std::runtime_error);
+}
+#endif
+
+#ifdef BIORBD_USE_CASADI_MATH
+TEST(FunctionCache, casadi)
+{
+    Model model(modelPathForGeneralTesting);
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    DECLARE_GENERALIZED_VELOCITY(QDot, model);
+    DECLARE_GENERALIZED_TORQUE(Tau, model);
+    std::vector<double> val(model.nbQ());
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        val[i] = 0.1 * static_cast<double>(i) - 0.3;
+    }
+    FILL_VECTOR(Q, val);
+    FILL_VECTOR(QDot, val);
+    FILL_VECTOR(Tau, val);
+    CALL_BIORBD_FUNCTION_3ARGS(QDDotExpected, model, ForwardDynamics, Q, QDot, Tau);
+
+    ModelFunctionCache cache(model);
+    const casadi::Function& forwardDynamics(cache.ForwardDynamics());
+    EXPECT_EQ(&cache.ForwardDynamics(), &forwardDynamics);
+    EXPECT_EQ(cache.nbFunctions(), 1u);
+    casadi::DM QDDot(forwardDynamics(casadi::DMDict{ {"Q", Q}, {"Qdot", QDot}, {"Tau", Tau} }).at("ForwardDynamics"));
+    for (unsigned int i=0; i<model.nbQddot(); ++i) {
+        EXPECT_NEAR(static_cast<double>(QDDot(i, 0)),
+                    static_cast<double>(QDDotExpected(i, 0)), requiredPrecision);
+    }
+
+    // The inverse dynamics of the forward dynamics gives back the torques
+    casadi::DM TauID(cache.InverseDynamics()(casadi::DMDict{ {"Q", Q}, {"Qdot", QDot}, {"Qddot", QDDot} }).at("InverseDynamics"));
+    for (unsigned int i=0; i<model.nbGeneralizedTorque(); ++i) {
+        EXPECT_NEAR(static_cast<double>(TauID(i, 0)), static_cast<double>(Tau(i, 0)),
+                    1e-8);
+    }
+    casadi::DM markers(cache.markers()(casadi::DMDict{ {"Q", Q} }).at("markers"));
+    EXPECT_EQ(static_cast<unsigned int>(markers.size1()), 3u);
+    EXPECT_EQ(static_cast<unsigned int>(markers.size2()), model.nbMarkers());
+    EXPECT_EQ(cache.nbFunctions(), 3u);
+
+    // Expanding gives the same values, from new functions
+    cache.setExpand(true);
+    EXPECT_EQ(cache.nbFunctions(), 0u);
+    QDDot = cache.ForwardDynamics()(casadi::DMDict{ {"Q", Q}, {"Qdot", QDot}, {"Tau", Tau} }).at("ForwardDynamics");
+    for (unsigned int i=0; i<model.nbQddot(); ++i) {
+        EXPECT_NEAR(static_cast<double>(QDDot(i, 0)),
+                    static_cast<double>(QDDotExpected(i, 0)), requiredPrecision);
+    }
+
+    // A second cache reads the functions stored by the first one
+    cache.setCacheFolder("temp_functionCache");
+    cache.clear();
+    cache.ForwardDynamics();
+    ModelFunctionCache cacheFromDisk(model);
+    cacheFromDisk.setExpand(true);
+    cacheFromDisk.setCacheFolder("temp_functionCache");
+    QDDot = cacheFromDisk.ForwardDynamics()(casadi::DMDict{ {"Q", Q}, {"Qdot", QDot}, {"Tau", Tau} }).at("ForwardDynamics");
+    for (unsigned int i=0; i<model.nbQddot(); ++i) {
+        EXPECT_NEAR(static_cast<double>(QDDot(i, 0)),
+                    static_cast<double>(QDDotExpected(i, 0)), requiredPrecision);
+    }
+}
+
+TEST(FunctionCache, casadiModelsOnDisk)
+{
+    // A model modified after being loaded does not reuse the files of the
+    // original one
+    Model model(modelPathForGeneralTesting);
+    Model modified(modelPathForGeneralTesting);
+    modified.setGravity(utils::Vector3d(0, -2.2, 0));
+    DECLARE_GENERALIZED_COORDINATES(Q, model);
+    DECLARE_GENERALIZED_VELOCITY(QDot, model);
+    DECLARE_GENERALIZED_TORQUE(Tau, model);
+    std::vector<double> val(model.nbQ());
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        val[i] = 0.1 * static_cast<double>(i) - 0.3;
+    }
+    FILL_VECTOR(Q, val);
+    FILL_VECTOR(QDot, val);
+    FILL_VECTOR(Tau, val);
+    for (Model* current : {&model, &modified, &model}) {
+        CALL_BIORBD_FUNCTION_3ARGS(QDDotExpected, (*current), ForwardDynamics, Q, QDot, Tau);
+        ModelFunctionCache cache(*current);
+        cache.setCacheFolder("temp_functionCacheModels");
+        casadi::DM QDDot(cache.ForwardDynamics()(casadi::DMDict{ {"Q", Q}, {"Qdot", QDot}, {"Tau", Tau} }).at("ForwardDynamics"));
+        for (unsigned int i=0; i<current->nbQddot(); ++i) {
+            EXPECT_NEAR(static_cast<double>(QDDot(i, 0)),
+                        static_cast<double>(QDDotExpected(i, 0)), requiredPrecision);
+        }
+    }
+
+    // Models built in code with the same shapes keep their functions in memory
+    std::vector<utils::Range> ranges(1);
+    for (double mass : {1.0, 2.0, 1.0}) {
+        Model pendulum;
+        pendulum.AddSegment("pendulum", "root", "x", ranges, ranges, ranges,
+                            rigidbody::SegmentCharacteristics(
+                                mass, utils::Vector3d(0, 0, -1),
+                                utils::Matrix3d(1, 0, 0, 0, 1, 0, 0, 0, 1)),
+                            utils::RotoTrans());
+        DECLARE_GENERALIZED_COORDINATES(QPendulum, pendulum);
+        DECLARE_GENERALIZED_VELOCITY(QDotPendulum, pendulum);
+        DECLARE_GENERALIZED_TORQUE(TauPendulum, pendulum);
+        std::vector<double> valPendulum(1, 0.5);
+        FILL_VECTOR(QPendulum, valPendulum);
+        FILL_VECTOR(QDotPendulum, valPendulum);
+        FILL_VECTOR(TauPendulum, valPendulum);
+        CALL_BIORBD_FUNCTION_3ARGS(QDDotExpected, pendulum, ForwardDynamics,
+                                   QPendulum, QDotPendulum, TauPendulum);
+
+        ModelFunctionCache cache(pendulum);
+        cache.setCacheFolder("temp_functionCacheInMemory");
+        casadi::DM QDDot(cache.ForwardDynamics()(casadi::DMDict{ {"Q", QPendulum}, {"Qdot", QDotPendulum}, {"Tau", TauPendulum} }).at("ForwardDynamics"));
+        EXPECT_NEAR(static_cast<double>(QDDot(0, 0)),
+                    static_cast<double>(QDDotExpected(0, 0)), requiredPrecision);
+    }
+    EXPECT_FALSE(utils::Path::isFolderExist("temp_functionCacheInMemory/"));
+}
+#endif
+
 TEST(QuaternionInModel, sizes)
 {
     Model m("models/simple_quat.bioMod");
@@ -1180,6 +2258,55 @@ TEST(Kinematics, computeQdot)
     }
 }
 
+#ifndef BIORBD_USE_CASADI_MATH
+TEST(Kinematics, cache)
+{
+    Model model(modelPathMeshEqualsMarker);
+    rigidbody::GeneralizedCoordinates Q(model);
+    FILL_VECTOR(Q, QtestEqualsMarker);
+
+    // Asking for different quantities at the same Q only computes once
+    model.resetKinematicsCacheCounters();
+    std::vector<rigidbody::NodeSegment> markers(model.markers(Q));
+    std::vector<utils::RotoTrans> jcs(model.allGlobalJCS(Q));
+    utils::Vector3d com(model.CoM(Q));
+    model.meshPoints(Q);
+    EXPECT_EQ(model.nbKinematicsCacheMisses(), 1);
+    EXPECT_EQ(model.nbKinematicsCacheHits(), 3);
+
+    // Results must not be affected by the cache
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            EXPECT_NEAR(markers[i][j], expectedMarkers[i][j], requiredPrecision);
+        }
+    }
+
+    // Changing Q, asking for velocities or modifying the model recomputes
+    Q[0] += 0.1;
+    model.markers(Q);
+    EXPECT_EQ(model.nbKinematicsCacheMisses(), 2);
+    rigidbody::GeneralizedVelocity Qdot(model);
+    Qdot.setOnes();
+    model.markersVelocity(Q, Qdot);
+    EXPECT_EQ(model.nbKinematicsCacheMisses(), 3);
+    model.markersVelocity(Q, Qdot);
+    EXPECT_EQ(model.nbKinematicsCacheMisses(), 3);
+    model.setGravity(utils::Vector3d(0, 0, -9.81));
+    model.markers(Q);
+    EXPECT_EQ(model.nbKinematicsCacheMisses(), 4);
+
+    // Going back to the first Q gives back the first results
+    FILL_VECTOR(Q, QtestEqualsMarker);
+    markers = model.markers(Q);
+    EXPECT_EQ(model.nbKinematicsCacheMisses(), 5);
+    for (unsigned int i=0; i<model.nbMarkers(); ++i) {
+        for (unsigned int j=0; j<3; ++j) {
+            EXPECT_NEAR(markers[i][j], expectedMarkers[i][j], requiredPrecision);
+        }
+    }
+}
+#endif
+
 #ifdef MODULE_KALMAN
 #ifndef SKIP_LONG_TESTS
 TEST(Kalman, markers)
@@ -1205,7 +2332,7 @@ TEST(Kalman, markers)
     rigidbody::GeneralizedAcceleration Qddot(model);
     kalman.reconstructFrame(model, targetMarkers, &Q, &Qdot, &Qddot);
 
-    // Compare results (since the initialization of the filter is done 50X, it is expected to have converged)
+    // Compare results (since the pose is solved on the first frame, it is expected to have converged)
     for (unsigned int i=0; i<nQToTest; ++i) {
         SCALAR_TO_DOUBLE(q, Q[i]);
         SCALAR_TO_DOUBLE(qdot, Qdot[i]);
@@ -1251,6 +2378,314 @@ TEST(Kalman, markers)
 }
 #endif
 
+#if !defined(SKIP_LONG_TESTS) && !defined(BIORBD_USE_CASADI_MATH)
+TEST(Kalman, markersInitialization)
+{
+    Model model(modelPathForGeneralTesting);
+    rigidbody::KalmanParam params;
+    rigidbody::KalmanReconsMarkers kalman(model, params);
+    EXPECT_EQ(kalman.nbInitIterations(), 0);
+
+    // A pose away from the zero the filter starts from
+    rigidbody::GeneralizedCoordinates Qref(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Qref(i, 0) = 0.1 + 0.02 * i;
+    }
+    std::vector<rigidbody::NodeSegment> targetMarkers(model.markers(Qref));
+
+    rigidbody::GeneralizedCoordinates Q(model);
+    rigidbody::GeneralizedVelocity Qdot(model);
+    rigidbody::GeneralizedAcceleration Qddot(model);
+    kalman.reconstructFrame(model, targetMarkers, &Q, &Qdot, &Qddot);
+
+    // The initialization stops on its tolerance, long before its limits
+    EXPECT_GT(kalman.nbInitIterations(), 0);
+    EXPECT_LT(kalman.nbInitIterations(), params.initMaxIterations());
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        EXPECT_NEAR(Q[i], Qref[i], 1e-6);
+        EXPECT_NEAR(Qdot[i], 0, 1e-6);
+        EXPECT_NEAR(Qddot[i], 0, 1e-6);
+    }
+
+    // The number of iterations is bounded (root, then whole body)
+    rigidbody::KalmanReconsMarkers kalmanBounded(
+        model, rigidbody::KalmanParam(100, 1e-10, 1e-5, 1));
+    kalmanBounded.reconstructFrame(model, targetMarkers, &Q, &Qdot, &Qddot);
+    EXPECT_EQ(kalmanBounded.nbInitIterations(), 2);
+}
+#endif
+
+#if !defined(SKIP_LONG_TESTS) && !defined(BIORBD_USE_CASADI_MATH)
+TEST(Kalman, markersOcclusion)
+{
+    Model model(modelPathForGeneralTesting);
+    rigidbody::KalmanReconsMarkers kalmanNaN(model);
+    rigidbody::KalmanReconsMarkers kalmanZero(model);
+
+    rigidbody::GeneralizedCoordinates Qref(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Qref(i, 0) = 0.2;
+    }
+    std::vector<rigidbody::NodeSegment> targetMarkers(model.markers(Qref));
+    rigidbody::GeneralizedCoordinates QNaN(model), QZero(model);
+    kalmanNaN.reconstructFrame(model, targetMarkers, &QNaN);
+    kalmanZero.reconstructFrame(model, targetMarkers, &QZero);
+
+    // A marker is occluded if it is NaN or zero, either way it is removed from the filter
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Qref(i, 0) = 0.25;
+    }
+    targetMarkers = model.markers(Qref);
+    std::vector<rigidbody::NodeSegment> markersNaN(targetMarkers);
+    std::vector<rigidbody::NodeSegment> markersZero(targetMarkers);
+    for (unsigned int i=1; i<markersNaN.size(); i+=3) {
+        markersNaN[i].setConstant(NAN);
+        markersZero[i].setZero();
+    }
+    for (unsigned int j=0; j<5; ++j) {
+        kalmanNaN.reconstructFrame(model, markersNaN, &QNaN);
+        kalmanZero.reconstructFrame(model, markersZero, &QZero);
+    }
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        EXPECT_FALSE(std::isnan(QNaN(i)));
+        EXPECT_NEAR(QNaN(i), QZero(i), 1e-10);
+    }
+}
+#endif
+
+#ifndef BIORBD_USE_CASADI_MATH
+// Give access to the internals of the filter to compare them to the dense formulation
+class KalmanReconsMarkersInternals : public rigidbody::KalmanReconsMarkers
+{
+public:
+    KalmanReconsMarkersInternals(
+        Model& model) :
+        rigidbody::KalmanReconsMarkers(model)
+    {
+
+    }
+
+    void setMeasurementNoise(
+        const utils::Vector& noise)
+    {
+        m_R->diagonal() = noise;
+    }
+
+    // Project the markers at the predicted state and filter them
+    void filter(
+        Model& model,
+        const utils::Vector& Tobs,
+        std::vector<unsigned int>& occlusion)
+    {
+        projectMarkers(model, predictState().topRows(*m_nbDof), Tobs, occlusion, true);
+        iteration(Tobs, *m_zest, *m_H, occlusion);
+    }
+
+    // The gain W'*L^-1 from the Cholesky factorization of the last correction
+    utils::Matrix gain() const
+    {
+        unsigned int nbVisible(static_cast<unsigned int>(m_visibleRows->size()));
+        utils::Matrix W(m_HP->topRows(nbVisible));
+        m_S->topLeftCorner(nbVisible, nbVisible).triangularView<Eigen::Lower>()
+        .transpose().solveInPlace(W);
+        return W.transpose();
+    }
+
+    const utils::Vector& state() const
+    {
+        return *m_xp;
+    }
+    const utils::Matrix& covariance() const
+    {
+        return *m_Pp;
+    }
+    const utils::Matrix& evolution() const
+    {
+        return *m_A;
+    }
+    const utils::Matrix& processNoise() const
+    {
+        return *m_Q;
+    }
+    const utils::Matrix& measurementNoise() const
+    {
+        return *m_R;
+    }
+    const utils::Vector& projectedMarkers() const
+    {
+        return *m_zest;
+    }
+    const utils::Matrix& markersJacobian() const
+    {
+        return *m_H;
+    }
+};
+
+TEST(Kalman, denseFormulation)
+{
+    Model model(modelPathForGeneralTesting);
+    unsigned int nbDof(model.dof_count);
+    unsigned int nbStates(3*nbDof);
+    unsigned int nbMeasure(3*model.nbTechnicalMarkers());
+    KalmanReconsMarkersInternals kalman(model);
+    rigidbody::GeneralizedCoordinates Q(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Q[i] = 0.2;
+    }
+    kalman.setInitState(&Q);
+
+    // An ill-conditioned measurement noise
+    utils::Vector noise(nbMeasure);
+    for (unsigned int i=0; i<nbMeasure; ++i) {
+        noise(i) = i % 2 ? 1e-12 : 1e-2;
+    }
+    kalman.setMeasurementNoise(noise);
+
+    utils::Vector xp(kalman.state());
+    utils::Matrix Pp(kalman.covariance());
+    const utils::Matrix& A(kalman.evolution());
+    for (unsigned int f=0; f<6; ++f) {
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            Q[i] = 0.2 + 0.02 * f;
+        }
+        std::vector<rigidbody::NodeSegment> markers(model.technicalMarkers(Q));
+        utils::Vector Tobs(nbMeasure);
+        for (unsigned int i=0; i<markers.size(); ++i) {
+            Tobs.block(i*3, 0, 3, 1) = markers[i];
+        }
+        if (f == 3) {
+            Tobs.block(3, 0, 3, 1).setZero();
+        }
+
+        // Prediction with the dense evolution matrix
+        utils::Vector xkm(A * xp);
+        utils::Matrix Pkm(A * Pp * A.transpose() + kalman.processNoise());
+        if (f == 4) {
+            // A frame without any measurement is only predicted
+            kalman.predictFrame();
+            xp = xkm;
+            Pp = Pkm;
+        } else {
+            std::vector<unsigned int> occlusion;
+            kalman.filter(model, Tobs, occlusion);
+
+            // Correction with the inverse of the innovation covariance and the Joseph form
+            std::vector<unsigned int> rows;
+            for (unsigned int i=0; i<nbMeasure; ++i) {
+                if (std::find(occlusion.begin(), occlusion.end(), i/3) == occlusion.end()) {
+                    rows.push_back(i);
+                }
+            }
+            unsigned int nbVisible(static_cast<unsigned int>(rows.size()));
+            EXPECT_EQ(nbVisible, f == 3 ? nbMeasure - 3 : nbMeasure);
+            utils::Matrix H(utils::Matrix::Zero(nbVisible, nbStates));
+            utils::Matrix R(utils::Matrix::Zero(nbVisible, nbVisible));
+            utils::Vector innovation(nbVisible);
+            for (unsigned int i=0; i<nbVisible; ++i) {
+                H.block(i, 0, 1, nbDof) = kalman.markersJacobian().row(rows[i]);
+                R(i, i) = kalman.measurementNoise()(rows[i], rows[i]);
+                innovation(i) = Tobs(rows[i]) - kalman.projectedMarkers()(rows[i]);
+            }
+            utils::Matrix K(Pkm * H.transpose()
+                            * (H * Pkm * H.transpose() + R).inverse());
+            xp = xkm + K * innovation;
+            utils::Matrix IKH(utils::Matrix::Identity(nbStates, nbStates) - K * H);
+            Pp = IKH * Pkm * IKH.transpose() + K * R * K.transpose();
+
+            utils::Matrix gain(kalman.gain());
+            ASSERT_EQ(gain.rows(), K.rows());
+            ASSERT_EQ(gain.cols(), K.cols());
+            double scale(K.cwiseAbs().maxCoeff());
+            for (unsigned int i=0; i<nbStates; ++i) {
+                for (unsigned int j=0; j<nbVisible; ++j) {
+                    EXPECT_NEAR(gain(i, j), K(i, j), 1e-6 * scale);
+                }
+            }
+        }
+
+        double scaleState(xp.cwiseAbs().maxCoeff());
+        double scaleCovariance(Pp.cwiseAbs().maxCoeff());
+        for (unsigned int i=0; i<nbStates; ++i) {
+            EXPECT_NEAR(kalman.state()(i), xp(i), 1e-6 * scaleState);
+            for (unsigned int j=0; j<nbStates; ++j) {
+                EXPECT_NEAR(kalman.covariance()(i, j), Pp(i, j), 1e-6 * scaleCovariance);
+            }
+        }
+
+        // Carry on from the state of the filter so the linearizations match
+        xp = kalman.state();
+        Pp = kalman.covariance();
+    }
+}
+#endif
+
+#if !defined(SKIP_LONG_TESTS) && !defined(BIORBD_USE_CASADI_MATH)
+TEST(Kalman, markersTrial)
+{
+    Model model(modelPathForGeneralTesting);
+    unsigned int nbFrames(20);
+    utils::Matrix markers(3*model.nbTechnicalMarkers(), nbFrames);
+    for (unsigned int f=0; f<nbFrames; ++f) {
+        rigidbody::GeneralizedCoordinates Q(model);
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            Q(i) = 0.2 + 0.3 * std::sin(0.1 * f + 0.5 * i);
+        }
+        std::vector<rigidbody::NodeSegment> targetMarkers(model.technicalMarkers(Q));
+        for (unsigned int m=0; m<targetMarkers.size(); ++m) {
+            markers.block(3*m, f, 3, 1) = targetMarkers[m];
+        }
+    }
+
+    // Without smoothing, the trial is the same as reconstructing frame by frame
+    rigidbody::KalmanReconsMarkers kalmanFrame(model);
+    rigidbody::KalmanReconsMarkers kalmanTrial(model);
+    utils::Matrix Q(model.nbQ(), nbFrames);
+    utils::Matrix Qdot(model.nbQ(), nbFrames);
+    utils::Matrix Qddot(model.nbQ(), nbFrames);
+    kalmanTrial.reconstructTrial(model, markers, Q, Qdot, Qddot, false);
+    rigidbody::GeneralizedCoordinates QFrame(model);
+    rigidbody::GeneralizedVelocity QdotFrame(model);
+    rigidbody::GeneralizedAcceleration QddotFrame(model);
+    for (unsigned int f=0; f<nbFrames; ++f) {
+        kalmanFrame.reconstructFrame(model, utils::Vector(markers.col(f)),
+                                     &QFrame, &QdotFrame, &QddotFrame);
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            EXPECT_NEAR(Q(i, f), QFrame(i), 1e-10);
+            EXPECT_NEAR(Qdot(i, f), QdotFrame(i), 1e-10);
+            EXPECT_NEAR(Qddot(i, f), QddotFrame(i), 1e-10);
+        }
+    }
+
+    // The smoothed last frame is the filtered one, the other frames are corrected
+    rigidbody::KalmanReconsMarkers kalmanSmooth(model);
+    utils::Matrix QSmooth(model.nbQ(), nbFrames);
+    utils::Matrix QdotSmooth(model.nbQ(), nbFrames);
+    utils::Matrix QddotSmooth(model.nbQ(), nbFrames);
+    kalmanSmooth.reconstructTrial(model, markers, QSmooth, QdotSmooth, QddotSmooth);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        EXPECT_NEAR(QSmooth(i, nbFrames-1), Q(i, nbFrames-1), 1e-10);
+        EXPECT_NEAR(QdotSmooth(i, nbFrames-1), Qdot(i, nbFrames-1), 1e-10);
+    }
+    EXPECT_GT((QdotSmooth - Qdot).norm(), 1e-6);
+
+    // Independent trials on the threads give the same results
+    model.setNbThreads(2);
+    std::vector<utils::Matrix> trials(3, markers);
+    std::vector<utils::Matrix> QTrials, QdotTrials, QddotTrials;
+    rigidbody::KalmanReconsMarkers::reconstructTrials(
+        model, trials, QTrials, QdotTrials, QddotTrials);
+    ASSERT_EQ(QTrials.size(), trials.size());
+    for (unsigned int t=0; t<QTrials.size(); ++t) {
+        for (unsigned int f=0; f<nbFrames; ++f) {
+            for (unsigned int i=0; i<model.nbQ(); ++i) {
+                EXPECT_NEAR(QTrials[t](i, f), QSmooth(i, f), 1e-10);
+                EXPECT_NEAR(QddotTrials[t](i, f), QddotSmooth(i, f), 1e-10);
+            }
+        }
+    }
+}
+#endif
+
 #ifndef SKIP_LONG_TESTS
 TEST(Kalman, imu)
 {
@@ -1278,7 +2713,7 @@ TEST(Kalman, imu)
     rigidbody::GeneralizedAcceleration Qddot(model);
     kalman.reconstructFrame(model, targetImus, &Q, &Qdot, &Qddot);
 
-    // Compare results (since the initialization of the filter is done 50X, it is expected to have converged)
+    // Compare results (since the pose is solved on the first frame, it is expected to have converged)
     for (unsigned int i=0; i<nQToTest; ++i) {
         SCALAR_TO_DOUBLE(q, Q[i]);
         SCALAR_TO_DOUBLE(qdot, Qdot[i]);
@@ -1344,5 +2779,157 @@ TEST(Kalman, imu)
 }
 #endif
 
+#if !defined(SKIP_LONG_TESTS) && !defined(BIORBD_USE_CASADI_MATH)
+TEST(Kalman, markersIMU)
+{
+    Model model(modelPathForPyomecaman_withIMUs);
+    rigidbody::KalmanReconsMarkersIMU kalman(model);
+
+    // Compute reference
+    rigidbody::GeneralizedCoordinates Qref(model);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        Qref(i, 0) = 0.2;
+    }
+    std::vector<rigidbody::NodeSegment> targetMarkers(model.technicalMarkers(Qref));
+    std::vector<rigidbody::IMU> targetImus(model.technicalIMU(Qref));
+
+    rigidbody::GeneralizedCoordinates Q(model);
+    rigidbody::GeneralizedVelocity Qdot(model);
+    rigidbody::GeneralizedAcceleration Qddot(model);
+    kalman.reconstructFrame(model, targetMarkers, targetImus, &Q, &Qdot, &Qddot);
+
+    // The translations are reconstructed from the markers, the rest from both
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        EXPECT_NEAR(Q[i], Qref[i], 1e-6);
+        EXPECT_NEAR(Qdot[i], 0, 1e-6);
+        EXPECT_NEAR(Qddot[i], 0, 1e-6);
+    }
+
+    // Without any IMU, the fused filter is the filter on the markers
+    rigidbody::KalmanReconsMarkersIMU kalmanNoImu(model);
+    rigidbody::KalmanReconsMarkers kalmanMarkers(model);
+    utils::Vector noImu(utils::Vector::Constant(9*model.nbTechIMUs(), NAN));
+    rigidbody::GeneralizedCoordinates QMarkers(model);
+    for (unsigned int j=0; j<5; ++j) {
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            Qref(i, 0) = 0.2 + 0.01 * j;
+        }
+        utils::Vector markers(3*model.nbTechnicalMarkers());
+        targetMarkers = model.technicalMarkers(Qref);
+        for (unsigned int i=0; i<targetMarkers.size(); ++i) {
+            markers.block(i*3, 0, 3, 1) = targetMarkers[i];
+        }
+        kalmanNoImu.reconstructFrame(model, markers, noImu, &Q);
+        kalmanMarkers.reconstructFrame(model, markers, &QMarkers);
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            EXPECT_NEAR(Q[i], QMarkers[i], 1e-8);
+        }
+    }
+}
+#endif
+
+#if !defined(SKIP_LONG_TESTS) && !defined(BIORBD_USE_CASADI_MATH)
+TEST(Kalman, stream)
+{
+    Model model(modelPathForGeneralTesting);
+    unsigned int nbFrames(20);
+
+    // Write a trial in a bioMark file
+    std::vector<std::vector<rigidbody::NodeSegment>> trial;
+    for (unsigned int j=0; j<nbFrames; ++j) {
+        rigidbody::GeneralizedCoordinates Q(model);
+        for (unsigned int i=0; i<model.nbQ(); ++i) {
+            Q(i, 0) = 0.2 + 0.01 * j;
+        }
+        trial.push_back(model.technicalMarkers(Q));
+    }
+    utils::String path("temporary.bioMark");
+    {
+        std::ofstream file(path.c_str());
+        file << std::setprecision(17);
+        file << "version 1\nnbmark " << model.nbTechnicalMarkers()
+             << "\nnbintervals " << nbFrames - 1 << "\n";
+        for (unsigned int i=0; i<model.nbTechnicalMarkers(); ++i) {
+            file << "Marker " << i << "\n";
+            for (unsigned int j=0; j<nbFrames; ++j) {
+                file << trial[j][i](0) << " " << trial[j][i](1) << " " << trial[j][i](2)
+                     << "\n";
+            }
+        }
+    }
+    rigidbody::MarkersFileReplayer replayer(path);
+    remove(path.c_str());
+    ASSERT_EQ(replayer.nbFrames(), nbFrames);
+
+    // Replay it as fast as the stream accepts the frames, none is dropped
+    rigidbody::KalmanStream stream(model, rigidbody::KalmanParam(), 4);
+    rigidbody::GeneralizedCoordinates Q(model);
+    rigidbody::GeneralizedVelocity Qdot(model);
+    rigidbody::GeneralizedAcceleration Qddot(model);
+    EXPECT_FALSE(stream.latest(Q, Qdot, Qddot));
+    stream.start();
+    replayer.start(stream, false);
+    replayer.join();
+    stream.stop();
+    EXPECT_EQ(stream.nbPushedFrames(), nbFrames);
+    EXPECT_EQ(stream.nbProcessedFrames(), nbFrames);
+    EXPECT_EQ(stream.nbDroppedFrames(), 0);
+    std::vector<unsigned long> histogram(stream.latencyHistogram());
+    unsigned long nbLatencies(0);
+    for (unsigned int i=0; i<histogram.size(); ++i) {
+        nbLatencies += histogram[i];
+    }
+    EXPECT_EQ(nbLatencies, nbFrames);
+    EXPECT_GT(stream.maxLatency(), 0);
+
+    // The stream gives the same state as the filter used frame by frame
+    unsigned long frame;
+    ASSERT_TRUE(stream.latest(Q, Qdot, Qddot, &frame));
+    EXPECT_EQ(frame, nbFrames - 1);
+    rigidbody::KalmanReconsMarkers kalman(model);
+    rigidbody::GeneralizedCoordinates QRef(model);
+    for (unsigned int j=0; j<nbFrames; ++j) {
+        kalman.reconstructFrame(model, replayer.frame(j), &QRef);
+    }
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        EXPECT_NEAR(Q[i], QRef[i], 1e-10);
+    }
+
+    // The latest frame replaces the waiting ones and initializes the filter
+    rigidbody::KalmanStream skipping(model, rigidbody::KalmanParam(), 8,
+                                     rigidbody::SKIP_TO_LATEST_FRAME);
+    for (unsigned int j=0; j<10; ++j) {
+        EXPECT_TRUE(skipping.push(trial[j]));
+        EXPECT_FALSE(skipping.isFull());
+    }
+    skipping.start();
+    skipping.stop();
+    EXPECT_EQ(skipping.nbPushedFrames(), 10);
+    EXPECT_EQ(skipping.nbProcessedFrames(), 1);
+    EXPECT_EQ(skipping.nbDroppedFrames(), 9);
+    ASSERT_TRUE(skipping.latest(Q, Qdot, Qddot, &frame));
+    EXPECT_EQ(frame, 9);
+
+    // Once initialized, the replaced frames are only predicted
+    for (unsigned int j=10; j<13; ++j) {
+        EXPECT_TRUE(skipping.push(trial[j]));
+    }
+    skipping.start();
+    skipping.stop();
+    EXPECT_EQ(skipping.nbProcessedFrames(), 2);
+    EXPECT_EQ(skipping.nbDroppedFrames(), 11);
+    ASSERT_TRUE(skipping.latest(Q, Qdot, Qddot, &frame));
+    EXPECT_EQ(frame, 12);
+    rigidbody::KalmanReconsMarkers kalmanSkipping(model);
+    kalmanSkipping.reconstructFrame(model, replayer.frame(9));
+    kalmanSkipping.predictFrame();
+    kalmanSkipping.predictFrame();
+    kalmanSkipping.reconstructFrame(model, replayer.frame(12), &QRef);
+    for (unsigned int i=0; i<model.nbQ(); ++i) {
+        EXPECT_NEAR(Q[i], QRef[i], 1e-10);
+    }
+}
+#endif
+
 
 #endif
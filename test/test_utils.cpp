@@ -1,4 +1,5 @@
 #include <iostream>
+#include <thread>
 #include <gtest/gtest.h>
 #include <rbdl/Dynamics.h>
 
@@ -6,11 +7,15 @@
 #include "Utils/String.h"
 #include "Utils/Path.h"
 #include "Utils/Matrix.h"
+#include "Utils/Vector.h"
 #include "Utils/Vector3d.h"
 #include "Utils/RotoTrans.h"
 #include "Utils/RotoTransNode.h"
 #include "Utils/Rotation.h"
 #include "Utils/Quaternion.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/RingBuffer.h"
+#include "Utils/TripleBuffer.h"
 
 #include "RigidBody/GeneralizedCoordinates.h"
 #include "RigidBody/NodeSegment.h"
@@ -1322,3 +1327,164 @@ TEST(Vector, normGradient)
         }
     }
 }
+
+TEST(ThreadPool, run)
+{
+    utils::ThreadPool pool(3);
+    EXPECT_EQ(pool.nbThreads(), 3);
+
+    // All the tasks are computed once, each worker getting a contiguous chunk
+    std::vector<unsigned int> workers(10, 100);
+    pool.run(10, [&](unsigned int task, unsigned int worker) {
+        workers[task] = worker;
+    });
+    std::vector<unsigned int> expectedWorkers = {0, 0, 0, 1, 1, 1, 2, 2, 2, 2};
+    for (unsigned int i=0; i<workers.size(); ++i) {
+        EXPECT_EQ(workers[i], expectedWorkers[i]);
+    }
+
+    // Exceptions are forwarded to the caller
+    EXPECT_THROW(pool.run(10, [](unsigned int task, unsigned int) {
+        if (task == 7) {
+            throw std::runtime_error("Failed task");
+        }
+    }), std::runtime_error);
+
+    // A run from a task, even on the same pool, is computed serially by the calling thread
+    std::vector<unsigned int> nbNested(10, 0);
+    pool.run(10, [&](unsigned int task, unsigned int) {
+        pool.run(4, [&](unsigned int, unsigned int worker) {
+            nbNested[task] += worker + 1;
+        });
+    });
+    for (unsigned int i=0; i<nbNested.size(); ++i) {
+        EXPECT_EQ(nbNested[i], 4);
+    }
+
+    pool.setNbThreads(1);
+    EXPECT_EQ(pool.nbThreads(), 1);
+    pool.run(10, [&](unsigned int task, unsigned int worker) {
+        workers[task] = worker;
+    });
+    for (unsigned int i=0; i<workers.size(); ++i) {
+        EXPECT_EQ(workers[i], 0);
+    }
+}
+
+TEST(RingBuffer, pushPop)
+{
+    utils::RingBuffer<utils::Vector> buffer(3, utils::Vector::Zero(2));
+    EXPECT_EQ(buffer.capacity(), 3);
+    EXPECT_TRUE(buffer.empty());
+
+    // The elements come out in order and a full buffer rejects new ones
+    utils::Vector value(2);
+    for (unsigned int i=0; i<3; ++i) {
+        value.setConstant(i);
+        EXPECT_TRUE(buffer.push(value));
+    }
+    EXPECT_EQ(buffer.size(), 3);
+    EXPECT_FALSE(buffer.push(value));
+    for (unsigned int i=0; i<2; ++i) {
+        EXPECT_TRUE(buffer.pop(value));
+        EXPECT_EQ(value(1), i);
+    }
+
+    // The slots are reused once the indices wrap around
+    for (unsigned int i=3; i<5; ++i) {
+        utils::Vector* slot(buffer.writeSlot());
+        ASSERT_NE(slot, nullptr);
+        slot->setConstant(i);
+        buffer.commitWrite();
+    }
+    EXPECT_EQ(buffer.writeSlot(), nullptr);
+    for (unsigned int i=2; i<5; ++i) {
+        utils::Vector* slot(buffer.readSlot());
+        ASSERT_NE(slot, nullptr);
+        EXPECT_EQ((*slot)(0), i);
+        buffer.commitRead();
+    }
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_FALSE(buffer.pop(value));
+
+    // One thread produces while another one consumes
+    utils::RingBuffer<utils::Vector> queue(4, utils::Vector::Zero(2));
+    unsigned int nbElements(10000);
+    std::thread producer([&]() {
+        utils::Vector element(2);
+        for (unsigned int i=0; i<nbElements;) {
+            element.setConstant(i);
+            if (queue.push(element)) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    bool inOrder(true);
+    for (unsigned int i=0; i<nbElements;) {
+        utils::Vector* slot(queue.readSlot());
+        if (!slot) {
+            std::this_thread::yield();
+            continue;
+        }
+        inOrder = inOrder && (*slot)(0) == i && (*slot)(1) == i;
+        queue.commitRead();
+        ++i;
+    }
+    producer.join();
+    EXPECT_TRUE(inOrder);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(TripleBuffer, latest)
+{
+    utils::TripleBuffer<utils::Vector> buffer(utils::Vector::Zero(2));
+    EXPECT_FALSE(buffer.hasNew());
+    EXPECT_EQ(buffer.readSlot(), nullptr);
+
+    // A value that is not read is replaced by the newer one
+    buffer.writeSlot()->setConstant(1);
+    EXPECT_FALSE(buffer.commitWrite());
+    buffer.writeSlot()->setConstant(2);
+    EXPECT_TRUE(buffer.commitWrite());
+    EXPECT_TRUE(buffer.hasNew());
+    utils::Vector* slot(buffer.readSlot());
+    ASSERT_NE(slot, nullptr);
+    EXPECT_EQ((*slot)(0), 2);
+    EXPECT_FALSE(buffer.hasNew());
+    EXPECT_EQ(buffer.readSlot(), nullptr);
+
+    // The slot being read is not written by the next values
+    for (unsigned int i=3; i<6; ++i) {
+        buffer.writeSlot()->setConstant(i);
+        buffer.commitWrite();
+    }
+    EXPECT_EQ((*slot)(0), 2);
+    slot = buffer.readSlot();
+    ASSERT_NE(slot, nullptr);
+    EXPECT_EQ((*slot)(0), 5);
+
+    // One thread produces while another one reads, the values only increase
+    utils::TripleBuffer<utils::Vector> latest(utils::Vector::Zero(2));
+    unsigned int nbElements(10000);
+    std::thread producer([&]() {
+        for (unsigned int i=1; i<=nbElements; ++i) {
+            latest.writeSlot()->setConstant(i);
+            latest.commitWrite();
+        }
+    });
+    bool increasing(true);
+    double last(0);
+    while (last < nbElements) {
+        utils::Vector* value(latest.readSlot());
+        if (!value) {
+            std::this_thread::yield();
+            continue;
+        }
+        increasing = increasing && (*value)(0) > last && (*value)(1) == (*value)(0);
+        last = (*value)(0);
+    }
+    producer.join();
+    EXPECT_TRUE(increasing);
+}